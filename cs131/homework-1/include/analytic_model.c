@@ -0,0 +1,146 @@
+#include "analytic_model.h"
+
+#include <math.h>
+
+//Implementation in C of an analytical model of the simulator, used to predict a point's wait time
+//without simulating it. The processors and memory modules form a closed queueing network: every processor
+//always has exactly one outstanding request, and each module serves its queue first-come first-served.
+//Mean value analysis solves such a network exactly for exponential service; the simulator's fixed latencies
+//make it an approximation, which the pruned sweep checks against simulated points.
+
+//Probability that a normal variable with mean 0 and deviation (sigma) is at most (x).
+static double normal_cdf(double x,double sigma){
+	return 0.5 * erfc(-x / (sigma * M_SQRT2));
+}
+
+//Fraction of the requests of a (dist) session that go to each of (modules) memory modules.
+//Drifting means and hot regions still place every mean uniformly at random, so the ratios do not depend on them.
+//Gaussian requests are drawn around a uniformly chosen mean, truncated to an integer and folded into
+//the module range with abs(sample % modules) like run_simulator() does. Averaging over the means and
+//over every fold of the tails telescopes into two values of the normal distribution function per module.
+void visit_ratios(const simulatorConfig* config,distribution dist,int modules,double* ratios){
+	double sigma = gaussian_sigma(config->sigmaFraction,config->sigmaModules,modules);
+	int i;
+
+	for(i = 0; i < modules; i++){
+		if(dist == Uniform){
+			ratios[i] = 1.0 / modules;
+		} else {
+			ratios[i] = (normal_cdf(modules - 1 - i,sigma) + normal_cdf(-i,sigma)) / modules;
+		}
+	}
+}
+
+//Cycles a request for a module with an access latency of (latency) takes.
+//An access that finds its module free starts on the cycle it is issued, so the processor is granted
+//again (latency) cycles later; an access taken from the module's queue starts once the previous one
+//has completed and keeps the module for the whole latency.
+static void access_cycles(int latency,double weight,double* direct,double* queued){
+	*direct += weight * latency;
+	*queued += weight * latency;
+}
+
+//Predict the result of simulating (processCount) processors and (modules) memory modules.
+//The wait time is 1 - 1 / C, where C is the mean number of cycles from one grant of a processor
+//to the next, since a processor waits on every other cycle. NUMA machines add the remote latency to
+//the share of requests that leave the node; the bandwidth of the inter-node link is not modelled.
+void estimate_point(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* result){
+	double* ratios = (double*) malloc(modules * sizeof(double));
+	double* direct = (double*) malloc(modules * sizeof(double));
+	double* queued = (double*) malloc(modules * sizeof(double));
+	double* queueLengths = (double*) malloc(modules * sizeof(double));
+	double remoteShare = 0.0;
+	double cycleTime = 1.0;
+	bool symmetric = true;
+	int i,n;
+
+	if(config->nodeCount > 1){
+		remoteShare = (1.0 - config->localRatio) * (1.0 - 1.0 / config->nodeCount);
+	}
+
+	//Demands of a module: the share of requests it receives times the cycles each one takes,
+	//averaged over reads and writes to local and remote modules.
+	visit_ratios(config,dist,modules,ratios);
+	for(i = 0; i < modules; i++){
+		int read = config->readLatency;
+		int write = config->writeLatency;
+		int j;
+
+		for(j = 0; j < config->overrideCount; j++){
+			if(config->overrides[j].module == i){
+				read = config->overrides[j].readLatency;
+				write = config->overrides[j].writeLatency;
+			}
+		}
+
+		direct[i] = 0.0;
+		queued[i] = 0.0;
+		access_cycles(read,(1.0 - config->writeRatio) * (1.0 - remoteShare),&(direct[i]),&(queued[i]));
+		access_cycles(write,config->writeRatio * (1.0 - remoteShare),&(direct[i]),&(queued[i]));
+		access_cycles(read + config->remoteLatency,(1.0 - config->writeRatio) * remoteShare,&(direct[i]),&(queued[i]));
+		access_cycles(write + config->remoteLatency,config->writeRatio * remoteShare,&(direct[i]),&(queued[i]));
+
+		direct[i] *= ratios[i];
+		queued[i] *= ratios[i];
+		queueLengths[i] = 0.0;
+		symmetric = symmetric && direct[i] == direct[0] && queued[i] == queued[0];
+	}
+
+	//Add the processors one at a time: a request arriving at a module finds the queue the network
+	//had with one processor less and waits for every access in it before its own.
+	//When every module has the same demands the queues stay equal and this has a closed form.
+	if(symmetric){
+		cycleTime = modules * (direct[0] + queued[0] * (double) (processCount - 1) / modules);
+	}
+	for(n = 1; n <= processCount && !symmetric; n++){
+		cycleTime = 0.0;
+		for(i = 0; i < modules; i++){
+			queueLengths[i] = direct[i] + queued[i] * queueLengths[i];
+			cycleTime += queueLengths[i];
+		}
+
+		for(i = 0; i < modules; i++){
+			queueLengths[i] *= n / cycleTime;
+		}
+	}
+
+	free(ratios);
+	free(direct);
+	free(queued);
+	free(queueLengths);
+
+	result->processCount = processCount;
+	result->moduleCount = modules;
+	result->cycles = 0;
+	result->waitTime = cycleTime > 1.0 ? 1.0 - 1.0 / cycleTime : 0.0;
+
+	//The wait is split between local and remote modules by the share of requests that leave the node.
+	result->numa = config->nodeCount > 1;
+	result->localWait = result->numa ? result->waitTime * (1.0 - remoteShare) : 0.0;
+	result->remoteWait = result->numa ? result->waitTime * remoteShare : 0.0;
+
+	result->openLoop = false;
+	result->cached = false;
+	result->buffered = false;
+	result->modeled = true;
+	result->modelWait = result->waitTime;
+	result->estimated = true;
+}
+
+void init_deviation(modelDeviation* deviation){
+	deviation->simulated = 0;
+	deviation->estimated = 0;
+	deviation->totalDeviation = 0.0;
+	deviation->maxDeviation = 0.0;
+}
+
+//Account a point that was simulated although an estimate was available.
+void record_deviation(modelDeviation* deviation,double estimate,double simulated){
+	double difference = fabs(estimate - simulated);
+
+	deviation->simulated++;
+	deviation->totalDeviation += difference;
+	if(difference > deviation->maxDeviation){
+		deviation->maxDeviation = difference;
+	}
+}
@@ -0,0 +1,22 @@
+#ifndef ANALYTIC_MODEL_H
+#define ANALYTIC_MODEL_H
+
+#include "simulator.h"
+
+#define MODEL_ANCHOR_SPACING 64	//Module counts between the points of a pruned row that are always simulated
+
+//How far the estimates of a pruned sweep were from the points that were simulated anyway.
+typedef struct modelDeviation {
+	long simulated;	//Points simulated to check or replace the estimate
+	long estimated;	//Points whose logged wait time is the estimate
+	double totalDeviation;	//Sum of |estimate - simulation| over the simulated points
+	double maxDeviation;
+} modelDeviation;
+
+void visit_ratios(const simulatorConfig* config,distribution dist,int modules,double* ratios);
+void estimate_point(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* result);
+
+void init_deviation(modelDeviation* deviation);
+void record_deviation(modelDeviation* deviation,double estimate,double simulated);
+
+#endif
@@ -0,0 +1,126 @@
+#include "arrivals.h"
+#include "rng.h"
+
+#include <math.h>
+
+//Implementation in C of the open-loop request generators. Every gap (between requests, or the length
+//of an on or off period) is geometric, which is the discrete-time counterpart of an exponential gap:
+//a geometric variate with success probability q is 1 + floor(E / -log(1 - q)) for an exponential E.
+//The exponentials are drawn in batches so the logarithms are computed in one tight loop.
+
+//Scale of the gaps of a geometric distribution with mean (mean) cycles (at least one).
+static double geometric_scale(double mean){
+	return mean > 1.0 ? -1.0 / log(1.0 - 1.0 / mean) : 0.0;
+}
+
+//Refill the batch of exponential variates from the calling thread's random stream.
+static void refill_exponentials(arrivalSource* source){
+	int i;
+
+	for(i = 0; i < ARRIVAL_BATCH; i++){
+		source->exponentials[i] = (double) next_random() + 1.0;
+	}
+
+	//Uniform variates in (0, 1] never give an infinite logarithm.
+	for(i = 0; i < ARRIVAL_BATCH; i++){
+		source->exponentials[i] = -log(source->exponentials[i] / ((double) RAND_MAX + 1.0));
+	}
+
+	source->position = 0;
+}
+
+//Draw a geometric gap of at least one cycle with the given scale.
+static int next_gap(arrivalSource* source,double scale){
+	if(scale == 0.0){
+		return 1;
+	}
+
+	if(source->position == ARRIVAL_BATCH){
+		refill_exponentials(source);
+	}
+
+	return 1 + (int) (source->exponentials[source->position++] * scale);
+}
+
+//Schedule the next request of (process) after cycle (cycle).
+//On-off processors skip the off periods that start before the next request.
+static void schedule_arrival(arrivalSource* source,int process,int cycle){
+	int next = cycle + next_gap(source,source->arrivalScale);
+
+	if(source->process == ArrivalsOnOff){
+		while(next > source->periodEnd[process]){
+			int start = source->periodEnd[process] + next_gap(source,source->idleScale) + 1;
+
+			source->periodEnd[process] = start + next_gap(source,source->burstScale) - 1;
+			next = start - 1 + next_gap(source,source->arrivalScale);
+		}
+	}
+
+	source->nextArrival[process] = next;
+}
+
+//Check if the arrival parameters describe a process the generator can produce: the rate is at most
+//one request per cycle, also during the on periods of an on-off process.
+bool arrivals_valid(arrivalProcess process,double rate,int burstCycles,int idleCycles){
+	if(process == ArrivalsClosed){
+		return true;
+	}
+
+	if(rate <= 0.0 || rate > 1.0){
+		return false;
+	}
+
+	return process != ArrivalsOnOff || (burstCycles > 0 && idleCycles > 0 && rate * (burstCycles + idleCycles) / burstCycles <= 1.0);
+}
+
+//Initialize the generators of (processCount) processors issuing (rate) requests per cycle on average.
+//On-off processors issue requests only during on periods of (burstCycles) cycles on average,
+//separated by off periods of (idleCycles) cycles on average. Processors start in an on period.
+void setup_arrivals(arrivalSource* source,arrivalProcess process,double rate,int burstCycles,int idleCycles,int processCount){
+	int i;
+
+	source->process = process;
+	source->processCount = processCount;
+	source->nextArrival = NULL;
+	source->periodEnd = NULL;
+	source->position = ARRIVAL_BATCH;
+
+	if(process == ArrivalsClosed){
+		return;
+	}
+
+	//During on periods requests arrive faster, so that the mean over both periods is (rate).
+	if(process == ArrivalsOnOff){
+		rate *= (double) (burstCycles + idleCycles) / burstCycles;
+	}
+
+	source->arrivalScale = geometric_scale(1.0 / rate);
+	source->burstScale = geometric_scale(burstCycles);
+	source->idleScale = geometric_scale(idleCycles);
+
+	source->nextArrival = (int*) malloc(processCount * sizeof(int));
+	source->periodEnd = (int*) malloc(processCount * sizeof(int));
+
+	for(i = 0; i < processCount; i++){
+		source->periodEnd[i] = process == ArrivalsOnOff ? next_gap(source,source->burstScale) : 0;
+		schedule_arrival(source,i,0);
+	}
+}
+
+//Check if (process) receives a request on cycle (cycle), and schedule its next one if it does.
+//Must be called for every cycle in order; gaps are at least one cycle, so at most one request is due.
+bool arrival_due(arrivalSource* source,int process,int cycle){
+	if(source->nextArrival[process] > cycle){
+		return false;
+	}
+
+	schedule_arrival(source,process,cycle);
+	return true;
+}
+
+void free_arrivals(arrivalSource* source){
+	free(source->nextArrival);
+	free(source->periodEnd);
+	source->nextArrival = NULL;
+	source->periodEnd = NULL;
+}
@@ -0,0 +1,35 @@
+#ifndef ARRIVALS_H
+#define ARRIVALS_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define ARRIVAL_BATCH 256	//Exponential variates drawn at once for the inter-arrival times
+
+//How processors issue requests.
+typedef enum {
+	ArrivalsClosed = 0,	//Original model: a processor requests again as soon as it is granted
+	ArrivalsPoisson = 1,	//Requests arrive with geometric gaps (the discrete-time Poisson process)
+	ArrivalsOnOff = 2	//Poisson arrivals during on periods separated by silent off periods
+} arrivalProcess;
+
+//Open-loop request generator of all the processors of a simulation.
+typedef struct arrivalSource {
+	arrivalProcess process;
+	int processCount;
+	double arrivalScale;	//Scale turning an exponential variate into an inter-arrival gap
+	double burstScale;	//Same for the length of an on period
+	double idleScale;	//Same for the length of an off period
+	int* nextArrival;	//Cycle of each processor's next request
+	int* periodEnd;	//Last cycle of each processor's current on period
+
+	double exponentials[ARRIVAL_BATCH];	//Batch of exponential variates with mean 1
+	int position;	//Next unused variate of the batch
+} arrivalSource;
+
+void setup_arrivals(arrivalSource* source,arrivalProcess process,double rate,int burstCycles,int idleCycles,int processCount);
+bool arrivals_valid(arrivalProcess process,double rate,int burstCycles,int idleCycles);
+bool arrival_due(arrivalSource* source,int process,int cycle);
+void free_arrivals(arrivalSource* source);
+
+#endif
@@ -0,0 +1,372 @@
+#include "coordinator.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//Implementation in C of a sweep coordinator that spreads the points of run_session() over many workers.
+//Workers are reached through a sweepTransport; results are merged back into the usual log files in grid order.
+
+#define MAX_CHUNK_MODULES 256
+#define COORDINATOR_POLL_MS 100
+
+//Number of points in the grid of a session.
+int sweep_point_count(const sweepPlan* plan){
+	return 2 * plan->configSize * plan->modules;
+}
+
+//Index of point (row, modules) in the order run_session() writes the logs in.
+int sweep_point_index(const sweepPlan* plan,int row,int modules){
+	return row * plan->modules + (modules - 1);
+}
+
+//Simulate one point of the grid. Points are always seeded individually so that any worker
+//computes exactly what a serial session with seedPerPoint would.
+void simulate_sweep_point(const sweepPlan* plan,int row,int modules,simulationResult* result){
+	simulatorConfig config = *(plan->config);
+	distribution dist = row < plan->configSize ? Uniform : Gaussian;
+
+	config.seedPerPoint = true;
+	simulate_point(&config,dist,plan->processorConfigs[row % plan->configSize],modules,result);
+}
+
+//Bookkeeping of the coordinator: which points are done and which chunk every worker runs.
+typedef struct coordinator {
+	const sweepPlan* plan;
+	sweepTransport* transport;
+	int workers;
+
+	simulationResult* results;
+	bool* received;
+	int receivedCount;
+	int nextToWrite;	//First point that has not been written to the logs yet
+
+	int row;	//Next unassigned point of the grid
+	int module;
+
+	sweepChunk* lost;	//Runs of points lost with their workers, handed out before the unassigned ones
+	int lostCount;
+	int lostCapacity;
+
+	sweepChunk* chunks;	//Chunk each worker is running
+	bool* busy;
+	bool* alive;
+
+	resultWriter writer;	//Writes the uniform (stream 0) and gaussian (stream 1) logs
+	bool writing;
+
+	int* workerNodes;	//Host node every worker is pinned to (NULL when the workers are not placed)
+	long* nodePoints;	//Points and simulated cycles finished on every host node
+	long* nodeCycles;
+} coordinator;
+
+//Number of grid points not handed to any worker yet.
+static int unassigned_points(coordinator* coord){
+	int rows = 2 * coord->plan->configSize;
+
+	if(coord->row >= rows){
+		return 0;
+	}
+
+	return (rows - coord->row - 1) * coord->plan->modules + (coord->plan->modules - coord->module + 1);
+}
+
+//Cut the next chunk from the unassigned part of the grid.
+//Chunks shrink as the sweep nears its end (guided scheduling) so the last chunks finish close together.
+static bool next_chunk(coordinator* coord,sweepChunk* chunk){
+	int remaining = unassigned_points(coord);
+	int size;
+
+	if(remaining == 0){
+		return false;
+	}
+
+	size = remaining / (4 * coord->workers);
+	size = size < 1 ? 1 : size;
+	size = size > MAX_CHUNK_MODULES ? MAX_CHUNK_MODULES : size;
+
+	chunk->row = coord->row;
+	chunk->firstModule = coord->module;
+	chunk->endModule = coord->module + size;
+	if(chunk->endModule > coord->plan->modules + 1){
+		chunk->endModule = coord->plan->modules + 1;
+	}
+
+	coord->module = chunk->endModule;
+	if(coord->module > coord->plan->modules){
+		coord->row++;
+		coord->module = 1;
+	}
+
+	return true;
+}
+
+//Take the unfinished tail of the busiest worker's chunk so an idle worker can share it.
+//The victim is told to stop where the stolen part begins.
+static bool steal_chunk(coordinator* coord,sweepChunk* chunk){
+	int victim = -1;
+	int largest = 1;
+	int i;
+
+	for(i = 0; i < coord->workers; i++){
+		if(!coord->busy[i] || !coord->alive[i]){
+			continue;
+		}
+
+		int current = coord->transport->progress(coord->transport,i);
+		int remaining = coord->chunks[i].endModule - (current < coord->chunks[i].firstModule ? coord->chunks[i].firstModule : current + 1);
+
+		if(remaining > largest){
+			largest = remaining;
+			victim = i;
+		}
+	}
+
+	if(victim < 0){
+		return false;
+	}
+
+	chunk->row = coord->chunks[victim].row;
+	chunk->endModule = coord->chunks[victim].endModule;
+	chunk->firstModule = chunk->endModule - largest / 2;
+
+	coord->transport->shrink(coord->transport,victim,chunk->firstModule);
+	coord->chunks[victim].endModule = chunk->firstModule;
+
+	return true;
+}
+
+//Take the first run of points lost with a worker.
+static bool next_lost_chunk(coordinator* coord,sweepChunk* chunk){
+	if(coord->lostCount == 0){
+		return false;
+	}
+
+	*chunk = coord->lost[0];
+	coord->lostCount--;
+	memmove(coord->lost,coord->lost + 1,coord->lostCount * sizeof(sweepChunk));
+	return true;
+}
+
+//Give an idle worker new work: points lost with another worker, fresh points, or the tail of a straggler's chunk.
+static void dispatch(coordinator* coord,int worker){
+	sweepChunk chunk;
+
+	//The worker has finished whatever it ran before, so it must not be picked as its own victim.
+	coord->busy[worker] = false;
+
+	if(!next_lost_chunk(coord,&chunk) && !next_chunk(coord,&chunk) && !steal_chunk(coord,&chunk)){
+		return;
+	}
+
+	coord->chunks[worker] = chunk;
+	coord->busy[worker] = coord->transport->assign(coord->transport,worker,&chunk);
+}
+
+//Queue the points a lost worker did not report back, as runs of consecutive missing points,
+//so that only they are simulated again and the rest of the grid is not handed out twice.
+static void requeue_lost_chunk(coordinator* coord,int worker){
+	const sweepChunk* lost = &(coord->chunks[worker]);
+	int rowStart = sweep_point_index(coord->plan,lost->row,1);
+	int modules = lost->firstModule;
+
+	if(!coord->busy[worker]){
+		return;
+	}
+
+	while(modules < lost->endModule){
+		if(coord->received[rowStart + modules - 1]){
+			modules++;
+			continue;
+		}
+
+		if(coord->lostCount == coord->lostCapacity){
+			coord->lostCapacity = coord->lostCapacity > 0 ? 2 * coord->lostCapacity : coord->workers;
+			coord->lost = (sweepChunk*) realloc(coord->lost,coord->lostCapacity * sizeof(sweepChunk));
+		}
+
+		sweepChunk* run = &(coord->lost[coord->lostCount++]);
+
+		run->row = lost->row;
+		run->firstModule = modules;
+		while(modules < lost->endModule && !coord->received[rowStart + modules - 1]){
+			modules++;
+		}
+		run->endModule = modules;
+	}
+
+	coord->busy[worker] = false;
+}
+
+//Queue every point that is complete and directly follows the already written ones.
+//The grid index of a point is its sequence in the logs, so rows leave in order whatever order workers finish in.
+static void flush_results(coordinator* coord){
+	int uniformPoints = coord->plan->configSize * coord->plan->modules;
+
+	while(coord->nextToWrite < sweep_point_count(coord->plan) && coord->received[coord->nextToWrite]){
+		put_result(&(coord->writer),coord->nextToWrite < uniformPoints ? 0 : 1,&(coord->results[coord->nextToWrite]));
+		coord->nextToWrite++;
+	}
+}
+
+//Work out the host node of every worker the same way the workers place themselves.
+static void map_worker_nodes(coordinator* coord,placementPolicy policy){
+	hostLayout layout;
+	int i,cpu;
+
+	if(policy == PlacementNone || !read_host_layout(&layout)){
+		return;
+	}
+
+	coord->workerNodes = (int*) malloc(coord->workers * sizeof(int));
+	coord->nodePoints = (long*) calloc(PLACEMENT_MAX_NODES,sizeof(long));
+	coord->nodeCycles = (long*) calloc(PLACEMENT_MAX_NODES,sizeof(long));
+	for(i = 0; i < coord->workers; i++){
+		placement_slot(&layout,policy,i,&cpu,&(coord->workerNodes[i]));
+	}
+
+	free_host_layout(&layout);
+}
+
+//Print the points and simulated cycles every host node finished per second of the session.
+static void report_node_throughput(coordinator* coord,placementPolicy policy,hugePagePolicy pages,double seconds){
+	int node,i;
+
+	printf("Worker placement %s, %s huge pages, %.2f s\n",placement_name(policy),huge_page_name(pages),seconds);
+	for(node = 0; node < PLACEMENT_MAX_NODES; node++){
+		int workers = 0;
+
+		for(i = 0; i < coord->workers; i++){
+			workers += coord->workerNodes[i] == node ? 1 : 0;
+		}
+		if(workers == 0){
+			continue;
+		}
+
+		printf("  node %d: %d workers, %ld points, %.1f points/s, %.3g cycles/s\n",node,workers,coord->nodePoints[node],
+			coord->nodePoints[node] / seconds,coord->nodeCycles[node] / seconds);
+	}
+}
+
+//Run the whole simulation session of run_session() on (workers) workers reached through (transport).
+//The logs have the same schema and row order as a serial session with seedPerPoint enabled.
+//Returns 0 on success and -1 if the workers could not be started or were all lost.
+int run_distributed_session(int* processorConfigs,int configSize,int modules,const char* uniformLogs,const char* gaussianLogs,const simulatorConfig* config,int workers,sweepTransport* transport){
+	sweepPlan plan;
+	coordinator coord;
+	sweepEvent event;
+	int i,status = 0;
+
+	plan.config = config;
+	plan.processorConfigs = processorConfigs;
+	plan.configSize = configSize;
+	plan.modules = modules;
+
+	memset(&coord,0,sizeof(coord));
+	coord.plan = &plan;
+	coord.transport = transport;
+	coord.workers = workers;
+	coord.results = (simulationResult*) malloc(sweep_point_count(&plan) * sizeof(simulationResult));
+	coord.received = (bool*) calloc(sweep_point_count(&plan),sizeof(bool));
+	coord.row = 0;
+	coord.module = 1;
+	coord.chunks = (sweepChunk*) calloc(workers,sizeof(sweepChunk));
+	coord.busy = (bool*) calloc(workers,sizeof(bool));
+	coord.alive = (bool*) calloc(workers,sizeof(bool));
+
+	stats_begin_session(sweep_point_count(&plan),workers);
+	map_worker_nodes(&coord,config->placement);
+	long started = stats_now();
+
+	if(transport->start(transport,workers,&plan) <= 0){
+		transport->stop(transport);
+		status = -1;
+		goto cleanup;
+	}
+
+	//The writer thread starts once the workers are forked, so that they do not inherit it.
+	const char* paths[2] = {uniformLogs,gaussianLogs};
+	coord.writing = writer_open(&(coord.writer),paths,2,config->logSync);
+	if(!coord.writing){
+		transport->stop(transport);
+		status = -1;
+		goto cleanup;
+	}
+	put_log_header(&(coord.writer),0,config);
+	put_log_header(&(coord.writer),1,config);
+
+	while(coord.receivedCount < sweep_point_count(&plan)){
+		int polled = transport->next_event(transport,&event,COORDINATOR_POLL_MS);
+		int living = 0;
+
+		if(polled < 0){
+			status = -1;
+			break;
+		}
+
+		if(polled > 0){
+			switch(event.type){
+				case PointFinished:
+					//Split chunks may compute a point twice; both copies are identical.
+					if(!coord.received[event.record.point]){
+						coord.results[event.record.point] = event.record.result;
+						coord.received[event.record.point] = true;
+						coord.receivedCount++;
+						if(coord.workerNodes != NULL){
+							coord.nodePoints[coord.workerNodes[event.worker]]++;
+							coord.nodeCycles[coord.workerNodes[event.worker]] += event.record.result.cycles;
+						}
+						flush_results(&coord);
+					}
+					break;
+				case WorkerReady:
+					coord.alive[event.worker] = true;
+					dispatch(&coord,event.worker);
+					break;
+				case WorkerLost:
+					requeue_lost_chunk(&coord,event.worker);
+					coord.alive[event.worker] = false;
+					break;
+			}
+		}
+
+		//Idle workers retry as long as there is work left; stop if nobody is left to do it.
+		for(i = 0; i < workers; i++){
+			if(coord.alive[i]){
+				living++;
+				if(!coord.busy[i]){
+					dispatch(&coord,i);
+				}
+			}
+		}
+
+		if(living == 0 && polled == 0){
+			status = -1;
+			break;
+		}
+	}
+
+	transport->stop(transport);
+	stats_end_session();
+
+	if(coord.workerNodes != NULL && status == 0){
+		report_node_throughput(&coord,config->placement,config->hugePages,(stats_now() - started) / 1e9);
+	}
+
+cleanup:
+	if(coord.writing && !writer_close(&(coord.writer))){
+		status = -1;
+	}
+
+	free(coord.results);
+	free(coord.received);
+	free(coord.chunks);
+	free(coord.lost);
+	free(coord.busy);
+	free(coord.alive);
+	free(coord.workerNodes);
+	free(coord.nodePoints);
+	free(coord.nodeCycles);
+
+	return status;
+}
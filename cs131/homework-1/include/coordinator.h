@@ -0,0 +1,13 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include "simulator.h"
+#include "transport.h"
+
+int sweep_point_count(const sweepPlan* plan);
+int sweep_point_index(const sweepPlan* plan,int row,int modules);
+void simulate_sweep_point(const sweepPlan* plan,int row,int modules,simulationResult* result);
+
+int run_distributed_session(int* processorConfigs,int configSize,int modules,const char* uniformLogs,const char* gaussianLogs,const simulatorConfig* config,int workers,sweepTransport* transport);
+
+#endif
@@ -0,0 +1,354 @@
+#include "kernels.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+//Implementation in C of the instruction set variants of the simulator's hot kernels and of the
+//dispatch that picks one at startup. The variants are compiled with target attributes so a single
+//binary carries all of them and still runs on processors that only have the baseline instructions.
+
+static const char* isaNames[ISA_COUNT] = {"scalar","sse4.2","avx2","avx512"};
+
+static randomFillKernel fillKernel = NULL;
+static tagMatchKernel matchKernel = NULL;
+static isaVariant selectedIsa = IsaScalar;
+static bool isaSelected = false;
+static pthread_once_t defaultSelection = PTHREAD_ONCE_INIT;
+
+//Reference variant: one value at a time.
+static void fill_scalar(uint32_t* values,int count){
+	int i;
+
+	for(i = 0; i < count; i++){
+		values[i] = values[i - 31] + values[i - 3];
+	}
+}
+
+//The vector variants compute a block of L values at once. Expanding the r[i - 3] term of every lane
+//until it falls before the block gives, for lane j with d = j / 3:
+//	r[k + j] = sum of r[k + j - 31 - 3t] for t = 0 .. d, plus r[k + j mod 3 - 3]
+//so each block is a few masked loads of values computed earlier and one permutation of the last three.
+#ifdef KERNELS_X86
+
+__attribute__((target("sse4.2")))
+static void fill_sse42(uint32_t* values,int count){
+	const __m128i lanes3 = _mm_setr_epi32(0,0,0,-1);
+	int i;
+
+	for(i = 0; i < count; i += 4){
+		uint32_t* block = values + i;
+		__m128i sum = _mm_loadu_si128((const __m128i*) (block - 31));
+
+		sum = _mm_add_epi32(sum,_mm_and_si128(_mm_loadu_si128((const __m128i*) (block - 34)),lanes3));
+		sum = _mm_add_epi32(sum,_mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) (block - 3)),_MM_SHUFFLE(0,2,1,0)));
+		_mm_storeu_si128((__m128i*) block,sum);
+	}
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(uint32_t* values,int count){
+	const __m256i lanes3 = _mm256_setr_epi32(0,0,0,-1,-1,-1,-1,-1);
+	const __m256i lanes6 = _mm256_setr_epi32(0,0,0,0,0,0,-1,-1);
+	const __m256i lastThree = _mm256_setr_epi32(0,1,2,0,1,2,0,1);
+	int i;
+
+	for(i = 0; i < count; i += 8){
+		uint32_t* block = values + i;
+		__m256i sum = _mm256_loadu_si256((const __m256i*) (block - 31));
+
+		sum = _mm256_add_epi32(sum,_mm256_and_si256(_mm256_loadu_si256((const __m256i*) (block - 34)),lanes3));
+		sum = _mm256_add_epi32(sum,_mm256_and_si256(_mm256_loadu_si256((const __m256i*) (block - 37)),lanes6));
+		sum = _mm256_add_epi32(sum,_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*) (block - 3)),lastThree));
+		_mm256_storeu_si256((__m256i*) block,sum);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void fill_avx512(uint32_t* values,int count){
+	const __m512i lastThree = _mm512_setr_epi32(0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0);
+	int i,t;
+
+	for(i = 0; i < count; i += 16){
+		uint32_t* block = values + i;
+		__m512i sum = _mm512_permutexvar_epi32(lastThree,_mm512_loadu_si512((const void*) (block - 3)));
+
+		//Term t is used by lanes 3t and up.
+		for(t = 0; t <= 5; t++){
+			__mmask16 lanes = (__mmask16) (0xffff << (3 * t));
+			sum = _mm512_add_epi32(sum,_mm512_maskz_loadu_epi32(lanes,(const void*) (block - 31 - 3 * t)));
+		}
+
+		_mm512_storeu_si512((void*) block,sum);
+	}
+}
+
+#endif
+
+//Reference variant of the tag match: index of the first of (count) tags equal to (tag), or -1.
+static int match_scalar(const uint32_t* tags,int count,uint32_t tag){
+	int i;
+
+	for(i = 0; i < count; i++){
+		if(tags[i] == tag){
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+//The vector variants compare a register of tags at once and take the first set bit of the equality mask.
+#ifdef KERNELS_X86
+
+__attribute__((target("sse4.2")))
+static int match_sse42(const uint32_t* tags,int count,uint32_t tag){
+	const __m128i wanted = _mm_set1_epi32((int) tag);
+	int i;
+
+	for(i = 0; i < count; i += 4){
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (tags + i)),wanted)));
+		if(mask != 0){
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return -1;
+}
+
+__attribute__((target("avx2")))
+static int match_avx2(const uint32_t* tags,int count,uint32_t tag){
+	const __m256i wanted = _mm256_set1_epi32((int) tag);
+	int i;
+
+	for(i = 0; i < count; i += 8){
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (tags + i)),wanted)));
+		if(mask != 0){
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return -1;
+}
+
+__attribute__((target("avx512f")))
+static int match_avx512(const uint32_t* tags,int count,uint32_t tag){
+	const __m512i wanted = _mm512_set1_epi32((int) tag);
+	int i;
+
+	for(i = 0; i < count; i += 16){
+		__mmask16 mask = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512((const void*) (tags + i)),wanted);
+		if(mask != 0){
+			return i + __builtin_ctz((unsigned int) mask);
+		}
+	}
+
+	return -1;
+}
+
+#endif
+
+//Kernel of every variant (NULL when it was not compiled for this architecture).
+static randomFillKernel variant_kernel(isaVariant isa){
+	switch(isa){
+		case IsaScalar:
+			return fill_scalar;
+#ifdef KERNELS_X86
+		case IsaSSE42:
+			return fill_sse42;
+		case IsaAVX2:
+			return fill_avx2;
+		case IsaAVX512:
+			return fill_avx512;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+//Tag match kernel of every variant (NULL when it was not compiled for this architecture).
+static tagMatchKernel variant_match_kernel(isaVariant isa){
+	switch(isa){
+		case IsaScalar:
+			return match_scalar;
+#ifdef KERNELS_X86
+		case IsaSSE42:
+			return match_sse42;
+		case IsaAVX2:
+			return match_avx2;
+		case IsaAVX512:
+			return match_avx512;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+//Check if the processor can run a variant.
+bool isa_supported(isaVariant isa){
+	if(variant_kernel(isa) == NULL){
+		return false;
+	}
+
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+	switch(isa){
+		case IsaSSE42:
+			return __builtin_cpu_supports("sse4.2");
+		case IsaAVX2:
+			return __builtin_cpu_supports("avx2");
+		case IsaAVX512:
+			return __builtin_cpu_supports("avx512f");
+		default:
+			break;
+	}
+#endif
+
+	return isa == IsaScalar;
+}
+
+const char* isa_name(isaVariant isa){
+	return isa >= 0 && isa < ISA_COUNT ? isaNames[isa] : "unknown";
+}
+
+//Widest variant the processor supports.
+isaVariant best_isa(void){
+	int isa;
+
+	for(isa = ISA_COUNT - 1; isa > IsaScalar; isa--){
+		if(isa_supported((isaVariant) isa)){
+			return (isaVariant) isa;
+		}
+	}
+
+	return IsaScalar;
+}
+
+//Variant the kernels run with (the best one until another is selected).
+isaVariant active_isa(void){
+	return isaSelected ? selectedIsa : best_isa();
+}
+
+//Use the variant called (name), or the best supported one for NULL or "auto".
+//Must be called before simulations start on other threads.
+//Returns false if the name is unknown or the processor does not support the variant.
+bool select_isa(const char* name){
+	int isa;
+
+	if(name == NULL || strcmp(name,"auto") == 0){
+		selectedIsa = best_isa();
+	} else {
+		for(isa = 0; isa < ISA_COUNT; isa++){
+			if(strcmp(name,isaNames[isa]) == 0){
+				break;
+			}
+		}
+
+		if(isa == ISA_COUNT || !isa_supported((isaVariant) isa)){
+			return false;
+		}
+		selectedIsa = (isaVariant) isa;
+	}
+
+	isaSelected = true;
+	fillKernel = variant_kernel(selectedIsa);
+	matchKernel = variant_match_kernel(selectedIsa);
+	return true;
+}
+
+//Pick the best variant unless one was selected before the kernels were first used.
+static void select_default_isa(void){
+	if(!isaSelected){
+		select_isa(NULL);
+	}
+}
+
+//Extend the random sequence r[i] = r[i - 31] + r[i - 3] by (count) values written to (values)[0 .. count - 1]
+//with the selected variant. The KERNEL_HISTORY values before (values) must hold the end of the sequence
+//and (count) must be a multiple of KERNEL_BLOCK_MULTIPLE.
+void fill_random_values(uint32_t* values,int count){
+	pthread_once(&defaultSelection,select_default_isa);
+	fillKernel(values,count);
+}
+
+//Tag match kernel of the selected variant. It finds the first of (count) tags equal to (tag), or returns -1,
+//and (count) must be a multiple of KERNEL_TAG_MULTIPLE. Callers keep the kernel rather than dispatching every lookup.
+tagMatchKernel tag_match_kernel(void){
+	pthread_once(&defaultSelection,select_default_isa);
+	return matchKernel;
+}
+
+//Compare the tag match of (isa) with the scalar variant on rows of random tags drawn from a small range,
+//so that rows hold the tag several times, once, or not at all. Returns whether they agree.
+static bool match_agrees(isaVariant isa){
+	uint32_t tags[4 * KERNEL_TAG_MULTIPLE];
+	uint32_t word = 0x2545f491U;
+	int row,i,count;
+
+	for(row = 0; row < 1024; row++){
+		for(i = 0; i < 4 * KERNEL_TAG_MULTIPLE; i++){
+			word ^= word << 13;
+			word ^= word >> 17;
+			word ^= word << 5;
+			tags[i] = word % 97;
+		}
+
+		for(count = KERNEL_TAG_MULTIPLE; count <= 4 * KERNEL_TAG_MULTIPLE; count += KERNEL_TAG_MULTIPLE){
+			uint32_t tag = (uint32_t) (row % 100);
+			if(variant_match_kernel(isa)(tags,count,tag) != match_scalar(tags,count,tag)){
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+//Run every supported variant on the same input and compare it with the scalar variant.
+//Returns the number of variants whose output differs.
+int kernels_self_test(FILE* out){
+	const int count = 4096;
+	uint32_t* expected = (uint32_t*) malloc((KERNEL_HISTORY + count) * sizeof(uint32_t));
+	uint32_t* actual = (uint32_t*) malloc((KERNEL_HISTORY + count) * sizeof(uint32_t));
+	uint32_t word = 0x9e3779b9U;
+	int failures = 0;
+	int i,isa;
+
+	//Any history works: the kernels only add 32-bit words, so fill it with a simple xorshift stream.
+	for(i = 0; i < KERNEL_HISTORY; i++){
+		word ^= word << 13;
+		word ^= word >> 17;
+		word ^= word << 5;
+		expected[i] = word;
+	}
+
+	fill_scalar(expected + KERNEL_HISTORY,count);
+
+	for(isa = 0; isa < ISA_COUNT; isa++){
+		if(!isa_supported((isaVariant) isa)){
+			fprintf(out,"  %-8s unsupported\n",isaNames[isa]);
+			continue;
+		}
+
+		memcpy(actual,expected,KERNEL_HISTORY * sizeof(uint32_t));
+		memset(actual + KERNEL_HISTORY,0,count * sizeof(uint32_t));
+
+		//Fill in several calls, as the random streams do, so the block boundaries are exercised too.
+		for(i = 0; i < count; i += 256){
+			variant_kernel((isaVariant) isa)(actual + KERNEL_HISTORY + i,256);
+		}
+
+		bool same = memcmp(actual,expected,(KERNEL_HISTORY + count) * sizeof(uint32_t)) == 0 && match_agrees((isaVariant) isa);
+		fprintf(out,"  %-8s %s\n",isaNames[isa],same ? "ok" : "MISMATCH");
+		failures += same ? 0 : 1;
+	}
+
+	free(expected);
+	free(actual);
+	return failures;
+}
@@ -0,0 +1,35 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//Instruction set variants of the hot kernels. Every variant produces exactly the same results;
+//the fastest one the processor supports is used unless another is requested.
+typedef enum {
+	IsaScalar = 0,
+	IsaSSE42 = 1,
+	IsaAVX2 = 2,
+	IsaAVX512 = 3,
+	ISA_COUNT = 4
+} isaVariant;
+
+typedef void (*randomFillKernel)(uint32_t* values,int count);
+typedef int (*tagMatchKernel)(const uint32_t* tags,int count,uint32_t tag);
+
+#define KERNEL_HISTORY 48	//Values before the fill position the vector kernels read
+#define KERNEL_BLOCK_MULTIPLE 16
+#define KERNEL_TAG_MULTIPLE 16	//Tags the match kernels compare at least, and in multiples of
+
+void fill_random_values(uint32_t* values,int count);
+tagMatchKernel tag_match_kernel(void);
+
+bool isa_supported(isaVariant isa);
+const char* isa_name(isaVariant isa);
+isaVariant best_isa(void);
+isaVariant active_isa(void);
+bool select_isa(const char* name);
+int kernels_self_test(FILE* out);
+
+#endif
@@ -0,0 +1,121 @@
+#include "locality.h"
+#include "simulator.h"
+#include "variance.h"
+
+#include <string.h>
+
+//Implementation in C of the locality model of Gaussian requests. Every random draw comes from the
+//simulation's own stream (through uniformRange()), so a drifting point is replayed exactly by its trace.
+
+//Deviation of the Gaussian requests of a point with (modules) memory modules: (sigmaModules) modules when set,
+//otherwise (sigmaFraction) of the modules, and by default the module count divided by GAUSSIAN_SIGMA_DIVISOR.
+double gaussian_sigma(double sigmaFraction,double sigmaModules,int modules){
+	if(sigmaModules > 0.0){
+		return sigmaModules;
+	}
+	if(sigmaFraction > 0.0){
+		return modules * sigmaFraction;
+	}
+
+	return (double) modules / GAUSSIAN_SIGMA_DIVISOR;
+}
+
+void setup_locality(localityEngine* engine,double sigma,int epochCycles,double driftDistance,int regionCount,int processCount,int modules){
+	engine->processCount = processCount;
+	engine->moduleCount = modules;
+	engine->sigma = sigma;
+	engine->epochCycles = epochCycles;
+	engine->driftDistance = driftDistance;
+	engine->regionCount = regionCount < processCount ? regionCount : processCount;
+	engine->means = (int*) calloc(processCount,sizeof(int));
+	engine->regionMeans = engine->regionCount > 0 ? (int*) calloc(engine->regionCount,sizeof(int)) : NULL;
+	engine->scaledDraws = false;
+	engine->nextEpoch = INT_MAX;
+	engine->epochs = 0;
+}
+
+//Random position in [0, range). Scaled draws put a random number at the same relative position whatever the
+//module count, so that points with common random numbers place their means alike.
+static int draw_position(localityEngine* engine,int range){
+	return engine->scaledDraws ? scaled_draw(range) : uniformRange(0,range);
+}
+
+//Start a simulation. The means only drift when the requests are Gaussian (enabled),
+//so that uniform points draw exactly the random numbers they always did.
+void locality_begin(localityEngine* engine,bool enabled){
+	engine->nextEpoch = enabled && engine->epochCycles > 0 ? engine->epochCycles : INT_MAX;
+	engine->epochs = 0;
+}
+
+//Choose the first mean of (process) and return it. Must be called for every processor in order.
+//Without regions the mean is drawn uniformly; with regions, processor (process) joins region
+//(process % regionCount), whose centre is drawn by the first processor to join it.
+int locality_assign(localityEngine* engine,int process){
+	int region = engine->regionCount > 0 ? process % engine->regionCount : 0;
+
+	if(engine->regionCount > 0 && process >= engine->regionCount){
+		engine->means[process] = engine->regionMeans[region];
+	} else {
+		engine->means[process] = draw_position(engine,engine->moduleCount);
+		if(engine->regionCount > 0){
+			engine->regionMeans[region] = engine->means[process];
+		}
+	}
+
+	return engine->means[process];
+}
+
+//Move (mean) by a random offset of at most (driftDistance) of the modules, or draw it anew.
+static int drift_mean(localityEngine* engine,int mean){
+	int modules = engine->moduleCount;
+	int distance = (int) (engine->driftDistance * modules);
+
+	if(engine->driftDistance >= 1.0){
+		return draw_position(engine,modules);
+	}
+	if(distance == 0){
+		return mean;
+	}
+
+	mean = (mean + draw_position(engine,2 * distance + 1) - distance) % modules;
+	return mean < 0 ? mean + modules : mean;
+}
+
+//Apply one epoch of drift to every mean at once and schedule the next epoch.
+void locality_drift(localityEngine* engine){
+	int i;
+
+	if(engine->regionCount > 0){
+		for(i = 0; i < engine->regionCount; i++){
+			engine->regionMeans[i] = drift_mean(engine,engine->regionMeans[i]);
+		}
+		for(i = 0; i < engine->processCount; i++){
+			engine->means[i] = engine->regionMeans[i % engine->regionCount];
+		}
+	} else {
+		for(i = 0; i < engine->processCount; i++){
+			engine->means[i] = drift_mean(engine,engine->means[i]);
+		}
+	}
+
+	engine->epochs++;
+	engine->nextEpoch += engine->epochCycles;
+}
+
+//Copy the means and the epoch of (source) into (destination), set up for the same processors and regions.
+void copy_locality(localityEngine* destination,const localityEngine* source){
+	memcpy(destination->means,source->means,source->processCount * sizeof(int));
+	if(source->regionMeans != NULL){
+		memcpy(destination->regionMeans,source->regionMeans,source->regionCount * sizeof(int));
+	}
+
+	destination->nextEpoch = source->nextEpoch;
+	destination->epochs = source->epochs;
+}
+
+void free_locality(localityEngine* engine){
+	free(engine->means);
+	free(engine->regionMeans);
+	engine->means = NULL;
+	engine->regionMeans = NULL;
+}
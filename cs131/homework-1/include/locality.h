@@ -0,0 +1,41 @@
+#ifndef LOCALITY_H
+#define LOCALITY_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+
+//Where the Gaussian requests of every processor are centred, and how those centres move.
+//Processors keep a mean module and draw their requests around it with deviation (sigma). Every
+//(epochCycles) cycles all the means drift at once, so a cycle only pays for one comparison.
+//With hot regions, processors share the means of a few regions and migrate together.
+typedef struct localityEngine {
+	int processCount;
+	int moduleCount;
+	double sigma;	//Deviation of a request around its processor's mean, in modules
+	int epochCycles;	//Cycles between drifts of the means (0 = the means never move)
+	double driftDistance;	//Largest move of a mean per epoch as a fraction of the modules (1 or more draws it anew)
+	int regionCount;	//Hot regions shared by the processors (0 = every processor has its own mean)
+	bool scaledDraws;	//Place the means by the fraction of the modules a random number represents (see scaled_draw())
+	int* means;	//Current mean of every processor
+	int* regionMeans;	//Current centre of every hot region (NULL without regions)
+	int nextEpoch;	//Cycle the means drift next (INT_MAX when they do not)
+	long epochs;	//Drifts applied so far
+} localityEngine;
+
+double gaussian_sigma(double sigmaFraction,double sigmaModules,int modules);
+void setup_locality(localityEngine* engine,double sigma,int epochCycles,double driftDistance,int regionCount,int processCount,int modules);
+void locality_begin(localityEngine* engine,bool enabled);
+int locality_assign(localityEngine* engine,int process);
+void locality_drift(localityEngine* engine);
+void copy_locality(localityEngine* destination,const localityEngine* source);
+void free_locality(localityEngine* engine);
+
+//Called at the start of every simulated cycle; the means only change on the first cycle of an epoch.
+static inline void locality_cycle(localityEngine* engine,int cycle){
+	if(cycle >= engine->nextEpoch){
+		locality_drift(engine);
+	}
+}
+
+#endif
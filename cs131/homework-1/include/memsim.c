@@ -0,0 +1,266 @@
+#include "memsim.h"
+#include "rng.h"
+
+#include <string.h>
+#include <pthread.h>
+
+//Implementation in C of the libmemsim engines. A batch is split point by point between the
+//engine's worker threads; every point is seeded on its own (as with --seed-per-point), so its
+//result does not depend on the thread that simulates it or on the other points of the batch.
+
+//A submitted batch, shared by the workers until all of its points are finished.
+typedef struct memsimBatch {
+	const memsimPoint* points;
+	int count;
+	simulationResult* results;	//May be NULL when only the callback is used
+	memsimCallback callback;	//May be NULL when only the array is used
+	void* context;
+
+	int next;	//Next point to hand out
+	int finished;	//Points whose result was delivered
+	pthread_cond_t done;
+
+	struct memsimBatch* nextBatch;
+} memsimBatch;
+
+struct memsimEngine {
+	simulatorConfig config;	//Copy of the caller's configuration, with its own overrides
+
+	int threadCount;
+	pthread_t* threads;
+
+	pthread_mutex_t lock;	//Protects everything below and the progress of every queued batch
+	pthread_cond_t work;
+	memsimBatch* first;	//Batches that still have points to hand out, oldest first
+	memsimBatch* last;
+	bool stopping;
+};
+
+//Simulate one point of a batch on the calling thread and deliver its result.
+static void run_point(memsimEngine* engine,memsimBatch* batch,int index){
+	simulationResult result;
+	const memsimPoint* point = &(batch->points[index]);
+
+	simulate_point(&(engine->config),point->dist,point->processCount,point->moduleCount,&result);
+
+	if(batch->results != NULL){
+		batch->results[index] = result;
+	}
+
+	if(batch->callback != NULL){
+		batch->callback(batch->context,index,point,&result);
+	}
+}
+
+//Take the next point of the oldest batch. Must be called with the engine locked.
+//Returns the point's index, or -1 if no batch has points left.
+static int claim_point(memsimEngine* engine,memsimBatch** batch){
+	memsimBatch* current = engine->first;
+
+	if(current == NULL){
+		return -1;
+	}
+
+	int index = current->next++;
+
+	//Once all of its points are handed out, the batch leaves the queue; its submitter still waits on it.
+	if(current->next == current->count){
+		engine->first = current->nextBatch;
+		if(engine->first == NULL){
+			engine->last = NULL;
+		}
+	}
+
+	*batch = current;
+	return index;
+}
+
+//Record that a point of (batch) finished. Must be called with the engine locked.
+static void finish_point(memsimBatch* batch){
+	batch->finished++;
+	if(batch->finished == batch->count){
+		pthread_cond_signal(&(batch->done));
+	}
+}
+
+//Body of a worker thread: simulate points with a private random stream until the engine is destroyed.
+static void* worker_main(void* argument){
+	memsimEngine* engine = (memsimEngine*) argument;
+	threadRandom generator;
+	memsimBatch* batch;
+
+	use_thread_random(&generator);
+
+	pthread_mutex_lock(&(engine->lock));
+	while(true){
+		int index = claim_point(engine,&batch);
+
+		if(index < 0){
+			if(engine->stopping){
+				break;
+			}
+			pthread_cond_wait(&(engine->work),&(engine->lock));
+			continue;
+		}
+
+		pthread_mutex_unlock(&(engine->lock));
+		run_point(engine,batch,index);
+		pthread_mutex_lock(&(engine->lock));
+
+		finish_point(batch);
+	}
+	pthread_mutex_unlock(&(engine->lock));
+
+	use_thread_random(NULL);
+	return NULL;
+}
+
+//Version of the interface and of the model the library was built with.
+int memsim_api_version(void){
+	return MEMSIM_API_VERSION;
+}
+
+//Create an engine simulating points with (config) (the defaults if NULL) on (threads) worker threads.
+//With 0 threads, batches are simulated on the thread that submits them.
+//Returns NULL if the engine could not be created or (config) is not valid (see validate_config()).
+memsimEngine* memsim_create(const simulatorConfig* config,int threads){
+	memsimEngine* engine;
+	int i;
+
+	if(threads < 0 || (config != NULL && !validate_config(config,0))){
+		return NULL;
+	}
+
+	engine = (memsimEngine*) calloc(1,sizeof(memsimEngine));
+	if(engine == NULL){
+		return NULL;
+	}
+
+	if(config != NULL){
+		engine->config = *config;
+	} else {
+		default_config(&(engine->config));
+	}
+
+	//The engine keeps its own copy of the overrides so the caller may free its configuration.
+	if(engine->config.overrideCount > 0){
+		size_t size = engine->config.overrideCount * sizeof(moduleLatency);
+		engine->config.overrides = (moduleLatency*) malloc(size);
+		memcpy(engine->config.overrides,config->overrides,size);
+	}
+	if(config != NULL && !copy_patterns(&(engine->config.patterns),&(config->patterns))){
+		free(engine->config.overrides);
+		free(engine);
+		return NULL;
+	}
+
+	//Points are independent of each other and of the threads simulating them.
+	engine->config.seedPerPoint = true;
+	//Nor does an engine summarize its variance-reduced points: its workers would add to the caller's summary at once.
+	engine->config.varianceReport = NULL;
+
+	pthread_mutex_init(&(engine->lock),NULL);
+	pthread_cond_init(&(engine->work),NULL);
+	engine->threads = (pthread_t*) malloc((threads > 0 ? threads : 1) * sizeof(pthread_t));
+
+	for(i = 0; i < threads; i++){
+		if(pthread_create(&(engine->threads[i]),NULL,worker_main,engine) != 0){
+			break;
+		}
+		engine->threadCount++;
+	}
+
+	if(engine->threadCount < threads){
+		memsim_destroy(engine);
+		return NULL;
+	}
+
+	return engine;
+}
+
+//Simulate (count) points and deliver every result to (results)[index] and/or (callback).
+//Blocks until the whole batch is finished; several threads may submit to one engine at once.
+//Returns 0, or -1 if the arguments are invalid.
+int memsim_submit(memsimEngine* engine,const memsimPoint* points,int count,simulationResult* results,memsimCallback callback,void* context){
+	memsimBatch batch;
+	int i;
+
+	if(engine == NULL || count < 0 || (count > 0 && points == NULL)){
+		return -1;
+	}
+
+	for(i = 0; i < count; i++){
+		if(points[i].processCount < 1 || points[i].moduleCount < 1 || (points[i].dist != Uniform && points[i].dist != Gaussian)){
+			return -1;
+		}
+	}
+
+	if(count == 0){
+		return 0;
+	}
+
+	batch.points = points;
+	batch.count = count;
+	batch.results = results;
+	batch.callback = callback;
+	batch.context = context;
+	batch.next = 0;
+	batch.finished = 0;
+	batch.nextBatch = NULL;
+
+	//Without worker threads the caller simulates the batch itself, with a stream of its own.
+	if(engine->threadCount == 0){
+		threadRandom generator;
+		threadRandom* previous = use_thread_random(&generator);
+
+		for(i = 0; i < count; i++){
+			run_point(engine,&batch,i);
+		}
+
+		use_thread_random(previous);
+		return 0;
+	}
+
+	pthread_cond_init(&(batch.done),NULL);
+
+	pthread_mutex_lock(&(engine->lock));
+	if(engine->last == NULL){
+		engine->first = &batch;
+	} else {
+		engine->last->nextBatch = &batch;
+	}
+	engine->last = &batch;
+	pthread_cond_broadcast(&(engine->work));
+
+	while(batch.finished < batch.count){
+		pthread_cond_wait(&(batch.done),&(engine->lock));
+	}
+	pthread_mutex_unlock(&(engine->lock));
+
+	pthread_cond_destroy(&(batch.done));
+	return 0;
+}
+
+//Stop the worker threads of an engine and free it. No batch may be in progress.
+void memsim_destroy(memsimEngine* engine){
+	int i;
+
+	if(engine == NULL){
+		return;
+	}
+
+	pthread_mutex_lock(&(engine->lock));
+	engine->stopping = true;
+	pthread_cond_broadcast(&(engine->work));
+	pthread_mutex_unlock(&(engine->lock));
+
+	for(i = 0; i < engine->threadCount; i++){
+		pthread_join(engine->threads[i],NULL);
+	}
+
+	pthread_cond_destroy(&(engine->work));
+	pthread_mutex_destroy(&(engine->lock));
+	free(engine->threads);
+	free_config(&(engine->config));
+	free(engine);
+}
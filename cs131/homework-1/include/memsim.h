@@ -0,0 +1,30 @@
+#ifndef MEMSIM_H
+#define MEMSIM_H
+
+#include "simulator.h"
+
+//Public interface of libmemsim: evaluate batches of sweep points from another program.
+//Every engine owns a copy of its configuration and its worker threads, so independent engines
+//never share state, and one engine may be given batches from several threads at once.
+
+#define MEMSIM_API_VERSION 15	//Changes when the interface or the results for a configuration change
+
+typedef struct memsimEngine memsimEngine;
+
+//One point to simulate.
+typedef struct memsimPoint {
+	distribution dist;
+	int processCount;
+	int moduleCount;
+} memsimPoint;
+
+//Receives the result of (points)[index] as soon as it is known. Results of one batch arrive in
+//any order and, for an engine with worker threads, on those threads and possibly concurrently.
+typedef void (*memsimCallback)(void* context,int index,const memsimPoint* point,const simulationResult* result);
+
+int memsim_api_version(void);
+memsimEngine* memsim_create(const simulatorConfig* config,int threads);
+int memsim_submit(memsimEngine* engine,const memsimPoint* points,int count,simulationResult* results,memsimCallback callback,void* context);
+void memsim_destroy(memsimEngine* engine);
+
+#endif
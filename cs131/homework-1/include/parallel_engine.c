@@ -0,0 +1,745 @@
+#include "parallel_engine.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <float.h>
+#include <math.h>
+#include <sched.h>
+#include <string.h>
+
+//Implementation in C of the data-parallel cycle engine. Every thread owns a partition of the processors and a
+//shard of the modules. A cycle goes through three steps:
+//  1. Each thread reads, for its processors, which of them sit the cycle out and which find their module
+//     ready for them as the previous cycle left it.
+//  2. Each thread passes over its processors in order: a processor whose module is ready and not yet reserved
+//     on the cycle is granted and draws its next request, whose module it reserves at once. Once the partition
+//     before it has settled its grants, the thread checks its processors against the modules the earlier
+//     partitions' grants reserve, passes over them again if any of them is blocked, and publishes the modules
+//     its own grants reserve for the partitions after it.
+//  3. Each thread carries out its processors' grants and waits and sends the reservations and queue entries to
+//     the buckets of the partitions owning the modules. Each shard applies them in processor order and
+//     completes the accesses due at the end of the cycle.
+//The threads meet at a barrier once per cycle, at its end, and all of them take the same convergence decision from the partitions' wait totals. Requests are drawn from per-block streams, through
+//buffers a pass can read again, so the outcome is the same for any number of threads.
+
+//Whether the engine covers the configuration: a flat machine of single-ported modules with closed-loop, uncached
+//and unbuffered processors that draw their requests around fixed means.
+bool parallel_supports(const simulatorConfig* config){
+	return config->nodeCount <= 1 && config->arrivals == ArrivalsClosed && config->driftEpoch == 0 && config->hotRegions == 0 &&
+		config->modulePorts == 1 && !config->coalesceReads && config->cacheSets == 0 && config->writeBuffer == 0 &&
+		config->patterns.programCount == 0;
+}
+
+//Number of threads a point of (processCount) processors and (modules) modules runs on when (threads) are asked
+//for: every thread needs a block of (blockProcessors) processors and a module.
+int parallel_threads(int processCount,int modules,int threads,int blockProcessors){
+	int blocks = (processCount + blockProcessors - 1) / blockProcessors;
+
+	threads = threads < 1 ? 1 : threads;
+	threads = threads > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : threads;
+	threads = threads > blocks ? blocks : threads;
+	return threads > modules ? modules : threads;
+}
+
+//Seed the streams of (blocks) blocks of processors from (seed). The first block's stream is the one
+//seed_random(seed) starts, so a point with a single block draws what run_simulator() draws.
+void seed_block_streams(threadRandom* streams,int blocks,unsigned int seed){
+	threadRandom* previous = switch_thread_random(NULL);
+	int i;
+
+	for(i = 0; i < blocks; i++){
+		use_thread_random(&(streams[i]));
+		seed_random(seed + (unsigned int) i * PARALLEL_STREAM_STRIDE);
+	}
+
+	switch_thread_random(previous);
+}
+
+//Wait until (flag) holds (value), spinning a while before yielding the core to the threads being waited for.
+//Returns false if the simulation of (engine) was cancelled meanwhile.
+static bool wait_for(parallelEngine* engine,atomic_int* flag,int value){
+	int spins = 0;
+
+	while(atomic_load_explicit(flag,memory_order_acquire) != value){
+		if(++spins > PARALLEL_SPIN_LIMIT){
+			if(atomic_load_explicit(&(engine->cancelled),memory_order_relaxed)){
+				return false;
+			}
+			sched_yield();
+		}
+	}
+
+	return true;
+}
+
+//Meet the other threads; the last to arrive releases them. (sense) is the calling thread's own sense.
+static bool barrier_wait(parallelEngine* engine,int* sense){
+	parallelBarrier* barrier = &(engine->barrier);
+
+	*sense = !*sense;
+
+	if(atomic_fetch_sub_explicit(&(barrier->remaining),1,memory_order_acq_rel) == 1){
+		atomic_store_explicit(&(barrier->remaining),barrier->parties,memory_order_relaxed);
+		atomic_store_explicit(&(barrier->sense),*sense,memory_order_release);
+		return true;
+	}
+
+	return wait_for(engine,&(barrier->sense),*sense);
+}
+
+//Module of a new request of (processor) from the random values at (values), drawn like run_simulator() does.
+static int draw_request(parallelEngine* engine,int processor,const int* values){
+	if(engine->dist == Uniform){
+		return values[0] % engine->moduleCount;
+	}
+
+	double x = (double) values[0] / RAND_MAX;
+	double y = (double) values[1] / RAND_MAX;
+	double z = engine->means[processor] + (sqrt(-2 * log(x)) * cos(2 * M_PI * y) * engine->sigma);
+
+	return abs((int) z % engine->moduleCount);
+}
+
+//Whether a new request is a write, from the value after its module's. Sessions without writes draw nothing.
+static bool draw_write(parallelEngine* engine,const int* values){
+	return engine->writeRatio > 0.0 && ((double) values[engine->dist == Uniform ? 1 : 2] / RAND_MAX) < engine->writeRatio;
+}
+
+//Take the (count) next values of the calling thread's stream.
+static void take_values(int* values,int count){
+	int i;
+
+	for(i = 0; i < count; i++){
+		values[i] = (int) next_random();
+	}
+}
+
+static int latency_of(parallelEngine* engine,int processor,int module){
+	return engine->writes[processor] ? engine->writeLatency[module] : engine->readLatency[module];
+}
+
+//Append a message to (bucket), growing it when a processor range sends more than expected.
+static void post(parallelMessage** messages,int* count,int* capacity,int processor,int module,int due){
+	if(*count == *capacity){
+		*capacity *= 2;
+		*messages = (parallelMessage*) realloc(*messages,*capacity * sizeof(parallelMessage));
+	}
+
+	(*messages)[*count].processor = processor;
+	(*messages)[*count].module = module;
+	(*messages)[*count].due = due;
+	(*count)++;
+}
+
+//Capacities of the message arrays of every outgoing bucket, parallel to (outgoing), kept by the sender.
+typedef struct bucketCapacity {
+	int reserves;
+	int waits;
+} bucketCapacity;
+
+//The access of (module) completes at the end of (cycle): hand the module to the first waiting processor or free it.
+static void complete(parallelEngine* engine,parallelPartition* partition,int module,int cycle){
+	int next = engine->heads[module];
+
+	if(next == -1){
+		engine->busy[module] = false;
+		return;
+	}
+
+	int latency = latency_of(engine,next,module);
+
+	engine->heads[module] = engine->nextWaiting[next];
+	if(engine->heads[module] == -1){
+		engine->tails[module] = -1;
+	}
+	engine->queued[next] = false;
+	engine->attached[module] = next;
+	engine->servedFrom[next] = cycle + latency;
+
+	if(engine->heads[module] == -1 && latency <= 1){
+		engine->busy[module] = false;
+	} else {
+		wheel_schedule(&(partition->wheel),module - partition->firstModule,cycle + latency);
+	}
+}
+
+//Step 1 of (cycle) for the processors of (partition): which of them sit the cycle out and which find their module
+//free or theirs, and enough values in every block's buffer for each of its processors to be granted.
+static void prepare_processors(parallelEngine* engine,parallelPartition* partition,int cycle){
+	int needed = engine->blockProcessors * engine->drawValues;
+	int p,b;
+
+	for(p = partition->firstProcessor; p < partition->lastProcessor; p++){
+		int module = engine->requests[p];
+
+		engine->stalled[p] = engine->readyCycles[p] > cycle || engine->servedFrom[p] > cycle;
+		engine->finished[p] = (engine->readyCycles[p] == cycle || engine->servedFrom[p] == cycle) && latency_of(engine,p,module) > 1;
+		engine->available[p] = !engine->stalled[p] && (engine->finished[p] || !engine->busy[module] || engine->attached[module] == -1 ||
+			engine->attached[module] == p);
+		engine->blockedOutside[p] = false;
+		engine->drawSlots[p] = -1;
+	}
+
+	for(b = partition->firstProcessor / engine->blockProcessors; b * engine->blockProcessors < partition->lastProcessor; b++){
+		if(engine->valueCounts[b] < needed){
+			switch_thread_random(&(engine->streams[b]));
+			take_values(engine->values + (size_t) b * needed + engine->valueCounts[b],needed - engine->valueCounts[b]);
+			engine->valueCounts[b] = needed;
+		}
+	}
+}
+
+//Whether a grant of the current pass of (partition) already reserved (module).
+static bool claimed(parallelPartition* partition,int module){
+	int slot = (int) (((unsigned int) module * 0x9e3779b1U) & (unsigned int) partition->claimedMask);
+
+	while(partition->claimedStamps[slot] == partition->pass){
+		if(partition->claimedModules[slot] == module){
+			return true;
+		}
+		slot = (slot + 1) & partition->claimedMask;
+	}
+
+	return false;
+}
+
+//Add (module) to the modules the current pass of (partition) reserved.
+static void claim(parallelPartition* partition,int module){
+	int slot = (int) (((unsigned int) module * 0x9e3779b1U) & (unsigned int) partition->claimedMask);
+
+	while(partition->claimedStamps[slot] == partition->pass){
+		if(partition->claimedModules[slot] == module){
+			return;
+		}
+		slot = (slot + 1) & partition->claimedMask;
+	}
+
+	partition->claimedStamps[slot] = partition->pass;
+	partition->claimedModules[slot] = module;
+}
+
+//Pass over the processors of (partition) in order and decide their grants, given which of them an earlier
+//partition's grants block. A granted processor draws its next request from its block's buffer and reserves its
+//module at once, so a later processor of the partition that requests the module waits. Fills (claims).
+static void grant_processors(parallelEngine* engine,parallelPartition* partition){
+	int stride = engine->blockProcessors * engine->drawValues;
+	int first,p;
+
+	partition->pass++;
+	partition->claimCount = 0;
+
+	for(first = partition->firstProcessor; first < partition->lastProcessor; first += engine->blockProcessors){
+		const int* values = engine->values + (size_t) (first / engine->blockProcessors) * stride;
+		int last = first + engine->blockProcessors < partition->lastProcessor ? first + engine->blockProcessors : partition->lastProcessor;
+		int slot = 0;
+
+		for(p = first; p < last; p++){
+			engine->granted[p] = engine->finished[p] || (engine->available[p] && !engine->blockedOutside[p] && !claimed(partition,engine->requests[p]));
+			if(!engine->granted[p]){
+				continue;
+			}
+
+			//A draw only changes when an earlier processor of the block changed its outcome.
+			if(engine->drawSlots[p] != slot){
+				engine->drawn[p] = draw_request(engine,p,values + slot * engine->drawValues);
+				engine->drawnWrites[p] = draw_write(engine,values + slot * engine->drawValues);
+				engine->drawSlots[p] = slot;
+			}
+			slot++;
+
+			claim(partition,engine->drawn[p]);
+			partition->claims[partition->claimCount].processor = p;
+			partition->claims[partition->claimCount].module = engine->drawn[p];
+			partition->claims[partition->claimCount].due = 0;
+			partition->claimCount++;
+		}
+	}
+}
+
+static bool same_claims(const parallelMessage* claims,int count,const parallelMessage* others,int otherCount){
+	int k;
+
+	if(count != otherCount){
+		return false;
+	}
+	for(k = 0; k < count; k++){
+		if(claims[k].processor != others[k].processor || claims[k].module != others[k].module){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Publish the claims of (partition) in the claim masks, replacing what it published there before.
+static void publish_claims(parallelEngine* engine,parallelPartition* partition){
+	atomic_ullong* masks = engine->claimMasks;
+	unsigned long long bit = 1ULL << partition->index;
+	int k;
+
+	if(same_claims(partition->claims,partition->claimCount,partition->published,partition->publishedCount)){
+		return;
+	}
+
+	for(k = 0; k < partition->publishedCount; k++){
+		atomic_fetch_and_explicit(&(masks[partition->published[k].module]),~bit,memory_order_relaxed);
+	}
+	for(k = 0; k < partition->claimCount; k++){
+		atomic_fetch_or_explicit(&(masks[partition->claims[k].module]),bit,memory_order_relaxed);
+	}
+
+	memcpy(partition->published,partition->claims,partition->claimCount * sizeof(parallelMessage));
+	partition->publishedCount = partition->claimCount;
+}
+
+//Mark the processors of (partition) whose module an earlier partition's grants reserve according to the claim masks.
+//Returns whether any processor is marked.
+static bool mark_blocked(parallelEngine* engine,parallelPartition* partition){
+	atomic_ullong* masks = engine->claimMasks;
+	unsigned long long earlier = (1ULL << partition->index) - 1;
+	bool changed = false;
+	int p;
+
+	for(p = partition->firstProcessor; p < partition->lastProcessor; p++){
+		if(engine->available[p] && !engine->finished[p]){
+			bool blocked = (atomic_load_explicit(&(masks[engine->requests[p]]),memory_order_relaxed) & earlier) != 0;
+
+			changed = changed || blocked != engine->blockedOutside[p];
+			engine->blockedOutside[p] = blocked;
+		}
+	}
+
+	return changed;
+}
+
+//Step 2 of (cycle): settle the grants of (partition) once the partitions before it have settled theirs. Its first
+//pass ignores the other partitions, and is only taken again when a settled grant of an earlier partition reserves
+//the module of one of its processors. Each partition hands over to the next through its stamp, so the partitions
+//settle in order without meeting at a barrier.
+//Returns false if the simulation was cancelled.
+static bool settle_grants(parallelEngine* engine,parallelPartition* partition,int cycle){
+	grant_processors(engine,partition);
+
+	if(partition->index > 0){
+		if(!wait_for(engine,&(engine->partitions[partition->index - 1].settled),cycle)){
+			return false;
+		}
+		if(mark_blocked(engine,partition)){
+			grant_processors(engine,partition);
+		}
+	}
+
+	//Only the later partitions read the claims, and they read them once the stamp shows the cycle.
+	if(partition->index < engine->threadCount - 1){
+		publish_claims(engine,partition);
+	}
+	atomic_store_explicit(&(partition->settled),cycle,memory_order_release);
+
+	return true;
+}
+
+//Step 3 of (cycle) for the processors of (partition): a granted processor takes its new request and reserves its
+//module, the others wait and join the queue of theirs, and every block gives up the values its grants used.
+//The reservations and queue entries go to the buckets of the partitions owning the modules.
+//Returns the number of the partition's processors that waited on the cycle.
+static long commit_processors(parallelEngine* engine,parallelPartition* partition,bucketCapacity* capacities,int cycle){
+	int stride = engine->blockProcessors * engine->drawValues;
+	long waits = 0;
+	int first,p,d;
+
+	for(d = 0; d < engine->threadCount; d++){
+		partition->outgoing[d].reserveCount = 0;
+		partition->outgoing[d].waitCount = 0;
+	}
+
+	for(first = partition->firstProcessor; first < partition->lastProcessor; first += engine->blockProcessors){
+		int block = first / engine->blockProcessors;
+		int last = first + engine->blockProcessors < partition->lastProcessor ? first + engine->blockProcessors : partition->lastProcessor;
+		int used = 0;
+
+		for(p = first; p < last; p++){
+			if(engine->granted[p]){
+				int module = engine->drawn[p];
+
+				//(drawn) keeps the module the processor was granted, for the trace.
+				engine->drawn[p] = engine->requests[p];
+				engine->requests[p] = module;
+				engine->writes[p] = engine->drawnWrites[p];
+				engine->readyCycles[p] = cycle + latency_of(engine,p,module);
+				used += engine->drawValues;
+
+				d = module / engine->shardModules;
+				post(&(partition->outgoing[d].reserves),&(partition->outgoing[d].reserveCount),&(capacities[d].reserves),p,module,engine->readyCycles[p] - 1);
+			} else {
+				engine->waitTimes[p]++;
+				waits++;
+				if(!engine->stalled[p] && !engine->queued[p]){
+					d = engine->requests[p] / engine->shardModules;
+					post(&(partition->outgoing[d].waits),&(partition->outgoing[d].waitCount),&(capacities[d].waits),p,engine->requests[p],0);
+				}
+			}
+		}
+
+		memmove(engine->values + (size_t) block * stride,engine->values + (size_t) block * stride + used,(engine->valueCounts[block] - used) * sizeof(int));
+		engine->valueCounts[block] -= used;
+	}
+
+	for(d = 0; d < engine->threadCount; d++){
+		atomic_store_explicit(&(partition->outgoing[d].stamp),cycle,memory_order_release);
+	}
+
+	return waits;
+}
+
+//Step 3 of (cycle) for the module shard of (partition): the reservations of the cycle's grants and the processors
+//joining a queue, both in processor order, then the accesses that complete at the end of the cycle.
+//Returns false if the simulation was cancelled.
+static bool update_modules(parallelEngine* engine,parallelPartition* partition,int cycle){
+	int s,k;
+
+	//A reservation occupies its module even while it serves another access; the last one names the holder.
+	for(s = 0; s < engine->threadCount; s++){
+		parallelBucket* bucket = &(engine->partitions[s].outgoing[partition->index]);
+
+		if(!wait_for(engine,&(bucket->stamp),cycle)){
+			return false;
+		}
+		for(k = 0; k < bucket->reserveCount; k++){
+			parallelMessage* message = &(bucket->reserves[k]);
+			int local = message->module - partition->firstModule;
+
+			engine->attached[message->module] = message->processor;
+			engine->busy[message->module] = true;
+			if(!wheel_pending(&(partition->wheel),local)){
+				wheel_schedule(&(partition->wheel),local,message->due);
+			}
+		}
+	}
+
+	//Every processor has sent its messages by now, so the queue flags it read are free to change.
+	for(s = 0; s < engine->threadCount; s++){
+		parallelBucket* bucket = &(engine->partitions[s].outgoing[partition->index]);
+
+		for(k = 0; k < bucket->waitCount; k++){
+			int p = bucket->waits[k].processor;
+			int module = bucket->waits[k].module;
+
+			engine->nextWaiting[p] = -1;
+			if(engine->tails[module] == -1){
+				engine->heads[module] = p;
+			} else {
+				engine->nextWaiting[engine->tails[module]] = p;
+			}
+			engine->tails[module] = p;
+			engine->queued[p] = true;
+		}
+	}
+
+	int firedCount = wheel_advance(&(partition->wheel),cycle,partition->fired);
+	for(k = 0; k < firedCount; k++){
+		complete(engine,partition,partition->firstModule + partition->fired[k],cycle);
+	}
+
+	return true;
+}
+
+//Relative change between two means of the waiting shares, as run_simulator() measures it.
+static double change_of(double past,double current){
+	past = past == 0 ? 0.1 : past;
+	current = current == 0 ? 0.1 : current;
+	return fabs(1.0 - (current / past));
+}
+
+//Mean of the processors' waiting shares after (cycle), or with (previous) set after the cycle before it, summed in
+//processor order like getAverageWaitTime(). Only valid until the grants of the next cycle are settled.
+static double ordered_share(parallelEngine* engine,int cycle,bool previous){
+	double total = 0.0;
+	int p;
+
+	for(p = 0; p < engine->processCount; p++){
+		int waits = engine->waitTimes[p] - (previous && !engine->granted[p] ? 1 : 0);
+
+		total += (double) waits / (previous ? cycle - 1 : cycle);
+	}
+
+	return total / engine->processCount;
+}
+
+//Run the cycles of (partition) until the wait converges. Every thread runs this, the calling thread as partition 0.
+static void* run_partition(void* argument){
+	parallelPartition* partition = (parallelPartition*) argument;
+	parallelEngine* engine = partition->engine;
+	bucketCapacity* capacities = (bucketCapacity*) malloc(engine->threadCount * sizeof(bucketCapacity));
+	threadRandom* previous = switch_thread_random(NULL);
+	//A sum in processor order of the shares is off their exact mean by a few rounding errors per processor.
+	double margin = 4.0 * (engine->processCount + 4) * DBL_EPSILON;
+	double percentDiff = 1.0;
+	long waits = 0,pastTotal = -1;
+	int sense = 0;
+	int cycle,s,p;
+
+	for(s = 0; s < engine->threadCount; s++){
+		capacities[s].reserves = (partition->lastProcessor - partition->firstProcessor) / engine->threadCount + engine->blockProcessors;
+		capacities[s].waits = capacities[s].reserves;
+		partition->outgoing[s].reserves = (parallelMessage*) malloc(capacities[s].reserves * sizeof(parallelMessage));
+		partition->outgoing[s].waits = (parallelMessage*) malloc(capacities[s].waits * sizeof(parallelMessage));
+	}
+
+	for(cycle = 2; ; cycle++){
+		prepare_processors(engine,partition,cycle);
+		if(!settle_grants(engine,partition,cycle)){
+			break;
+		}
+		waits += commit_processors(engine,partition,capacities,cycle);
+		partition->waitTotals[cycle & 1] = waits;
+		if(!update_modules(engine,partition,cycle) || !barrier_wait(engine,&sense)){
+			break;
+		}
+
+		//The calling thread records the cycle's grants in processor order before anyone starts the next one.
+		if(engine->tracing){
+			if(partition->index == 0){
+				for(p = 0; p < engine->processCount; p++){
+					if(engine->granted[p]){
+						trace_event(cycle,p,engine->drawn[p],TraceGrant,0);
+					}
+				}
+			}
+			if(!barrier_wait(engine,&sense)){
+				break;
+			}
+		}
+
+		//Every thread sees the same totals and ends on the same cycle.
+		long total = 0;
+		for(s = 0; s < engine->threadCount; s++){
+			total += engine->partitions[s].waitTotals[cycle & 1];
+		}
+
+		if(pastTotal >= 0){
+			percentDiff = change_of((double) pastTotal / (cycle - 1) / engine->processCount,(double) total / cycle / engine->processCount);
+
+			//So close to the threshold the decision hangs on rounding, as when no processor waited on the cycle;
+			//take it on the sums run_simulator() forms, which every thread reads before any moves on.
+			if(fabs(percentDiff - CONVERGENCE_THRESHOLD) < margin){
+				percentDiff = change_of(ordered_share(engine,cycle,true),ordered_share(engine,cycle,false));
+				if(!barrier_wait(engine,&sense)){
+					break;
+				}
+			}
+		}
+		pastTotal = total;
+
+		if(percentDiff < CONVERGENCE_THRESHOLD){
+			if(partition->index == 0){
+				engine->cycles = cycle;
+			}
+			break;
+		}
+	}
+
+	//The buckets are only freed once every thread is done reading them.
+	barrier_wait(engine,&sense);
+	for(s = 0; s < engine->threadCount; s++){
+		free(partition->outgoing[s].reserves);
+		free(partition->outgoing[s].waits);
+	}
+	free(capacities);
+	switch_thread_random(previous);
+
+	return NULL;
+}
+
+//Simulate (processCount) processors and (modules) memory modules on (threads) threads and store the outcome in
+//(result). Every block of (blockProcessors) processors draws its requests from its own stream, seeded from (seed)
+//by seed_block_streams(). Grants go into the trace the calling thread records, if any.
+//Returns the number of threads used, or -1 if the threads could not be started.
+int parallel_simulate(const simulatorConfig* config,distribution dist,int processCount,int modules,unsigned int seed,int threads,
+	int blockProcessors,simulationResult* result){
+	parallelEngine engine;
+	int blocks = (processCount + blockProcessors - 1) / blockProcessors;
+	int started = 1;
+	int i,p,m;
+
+	memset(&engine,0,sizeof(engine));
+	engine.processCount = processCount;
+	engine.moduleCount = modules;
+	engine.dist = dist;
+	engine.sigma = gaussian_sigma(config->sigmaFraction,config->sigmaModules,modules);
+	engine.writeRatio = config->writeRatio;
+	engine.threadCount = parallel_threads(processCount,modules,threads,blockProcessors);
+	engine.blockProcessors = blockProcessors;
+	engine.drawValues = (dist == Gaussian ? 2 : 1) + (config->writeRatio > 0.0 ? 1 : 0);
+	engine.shardModules = (modules + engine.threadCount - 1) / engine.threadCount;
+	engine.tracing = trace_active();
+
+	engine.requests = (int*) malloc(processCount * sizeof(int));
+	engine.writes = (bool*) calloc(processCount,sizeof(bool));
+	engine.means = (int*) calloc(processCount,sizeof(int));
+	engine.readyCycles = (int*) calloc(processCount,sizeof(int));
+	engine.waitTimes = (int*) calloc(processCount,sizeof(int));
+	engine.stalled = (bool*) calloc(processCount,sizeof(bool));
+	engine.available = (bool*) calloc(processCount,sizeof(bool));
+	engine.finished = (bool*) calloc(processCount,sizeof(bool));
+	engine.blockedOutside = (bool*) calloc(processCount,sizeof(bool));
+	engine.granted = (bool*) calloc(processCount,sizeof(bool));
+	engine.drawn = (int*) calloc(processCount,sizeof(int));
+	engine.drawnWrites = (bool*) calloc(processCount,sizeof(bool));
+	engine.drawSlots = (int*) calloc(processCount,sizeof(int));
+	engine.queued = (bool*) calloc(processCount,sizeof(bool));
+	engine.servedFrom = (int*) calloc(processCount,sizeof(int));
+	engine.nextWaiting = (int*) malloc(processCount * sizeof(int));
+	engine.readLatency = (int*) malloc(modules * sizeof(int));
+	engine.writeLatency = (int*) malloc(modules * sizeof(int));
+	engine.busy = (bool*) calloc(modules,sizeof(bool));
+	engine.attached = (int*) malloc(modules * sizeof(int));
+	engine.heads = (int*) malloc(modules * sizeof(int));
+	engine.tails = (int*) malloc(modules * sizeof(int));
+	engine.claimMasks = (atomic_ullong*) malloc(modules * sizeof(atomic_ullong));
+	engine.streams = (threadRandom*) malloc(blocks * sizeof(threadRandom));
+	engine.values = (int*) malloc((size_t) blocks * blockProcessors * PARALLEL_DRAW_VALUES * sizeof(int));
+	engine.valueCounts = (int*) calloc(blocks,sizeof(int));
+	engine.partitions = (parallelPartition*) aligned_alloc(64,engine.threadCount * sizeof(parallelPartition));
+
+	int maxLatency = 1;
+	for(m = 0; m < modules; m++){
+		engine.readLatency[m] = config->readLatency;
+		engine.writeLatency[m] = config->writeLatency;
+		engine.attached[m] = -1;
+		engine.heads[m] = -1;
+		engine.tails[m] = -1;
+		atomic_init(&(engine.claimMasks[m]),0);
+	}
+	for(i = 0; i < config->overrideCount; i++){
+		if(config->overrides[i].module < modules){
+			engine.readLatency[config->overrides[i].module] = config->overrides[i].readLatency;
+			engine.writeLatency[config->overrides[i].module] = config->overrides[i].writeLatency;
+		}
+	}
+	for(m = 0; m < modules; m++){
+		maxLatency = engine.readLatency[m] > maxLatency ? engine.readLatency[m] : maxLatency;
+		maxLatency = engine.writeLatency[m] > maxLatency ? engine.writeLatency[m] : maxLatency;
+	}
+
+	//The first requests do not occupy their modules, like the first batch of run_simulator().
+	seed_block_streams(engine.streams,blocks,seed);
+	threadRandom* previous = switch_thread_random(NULL);
+	for(p = 0; p < processCount; p++){
+		int values[PARALLEL_DRAW_VALUES];
+
+		switch_thread_random(&(engine.streams[p / blockProcessors]));
+		if(dist == Gaussian){
+			engine.means[p] = uniformRange(0,modules);
+		}
+		take_values(values,engine.drawValues);
+		engine.requests[p] = draw_request(&engine,p,values);
+		engine.writes[p] = draw_write(&engine,values);
+		engine.nextWaiting[p] = -1;
+	}
+	switch_thread_random(previous);
+
+	for(i = 0; i < engine.threadCount; i++){
+		parallelPartition* partition = &(engine.partitions[i]);
+		int claimSlots = 2;
+
+		memset(partition,0,sizeof(parallelPartition));
+		partition->index = i;
+		partition->engine = &engine;
+		partition->firstProcessor = (int) ((long) blocks * i / engine.threadCount) * blockProcessors;
+		partition->lastProcessor = (int) ((long) blocks * (i + 1) / engine.threadCount) * blockProcessors;
+		partition->lastProcessor = partition->lastProcessor > processCount ? processCount : partition->lastProcessor;
+		partition->firstModule = i * engine.shardModules < modules ? i * engine.shardModules : modules;
+		partition->lastModule = (i + 1) * engine.shardModules < modules ? (i + 1) * engine.shardModules : modules;
+		partition->outgoing = (parallelBucket*) aligned_alloc(64,engine.threadCount * sizeof(parallelBucket));
+		for(m = 0; m < engine.threadCount; m++){
+			atomic_init(&(partition->outgoing[m].stamp),0);
+		}
+		init_wheel(&(partition->wheel),partition->lastModule - partition->firstModule,maxLatency + 1);
+		partition->fired = (int*) malloc((partition->lastModule - partition->firstModule + 1) * sizeof(int));
+
+		//A partition claims at most one module per processor; the set stays at most half full.
+		int processors = partition->lastProcessor - partition->firstProcessor;
+		while(claimSlots < 2 * processors){
+			claimSlots <<= 1;
+		}
+		partition->claims = (parallelMessage*) malloc(processors * sizeof(parallelMessage));
+		partition->published = (parallelMessage*) malloc(processors * sizeof(parallelMessage));
+		atomic_init(&(partition->settled),0);
+		partition->claimedModules = (int*) malloc(claimSlots * sizeof(int));
+		partition->claimedStamps = (int*) calloc(claimSlots,sizeof(int));
+		partition->claimedMask = claimSlots - 1;
+	}
+
+	atomic_init(&(engine.barrier.remaining),engine.threadCount);
+	atomic_init(&(engine.barrier.sense),0);
+	engine.barrier.parties = engine.threadCount;
+	atomic_init(&(engine.cancelled),false);
+
+	for(i = 1; i < engine.threadCount; i++){
+		if(pthread_create(&(engine.partitions[i].thread),NULL,run_partition,&(engine.partitions[i])) != 0){
+			atomic_store(&(engine.cancelled),true);
+			break;
+		}
+		started++;
+	}
+	if(started == engine.threadCount){
+		run_partition(&(engine.partitions[0]));
+	}
+	for(i = 1; i < started; i++){
+		pthread_join(engine.partitions[i].thread,NULL);
+	}
+
+	if(started == engine.threadCount){
+		//The mean of every processor's waiting share, summed in processor order like getAverageWaitTime().
+		double waitTime = 0.0;
+		for(p = 0; p < processCount; p++){
+			waitTime += (double) engine.waitTimes[p] / engine.cycles;
+		}
+
+		memset(result,0,sizeof(simulationResult));
+		result->processCount = processCount;
+		result->moduleCount = modules;
+		result->cycles = engine.cycles;
+		result->waitTime = waitTime / processCount;
+		stats_add_cycles(engine.cycles - 1);
+	}
+
+	for(i = 0; i < engine.threadCount; i++){
+		free_wheel(&(engine.partitions[i].wheel));
+		free(engine.partitions[i].fired);
+		free(engine.partitions[i].outgoing);
+		free(engine.partitions[i].claims);
+		free(engine.partitions[i].published);
+		free(engine.partitions[i].claimedModules);
+		free(engine.partitions[i].claimedStamps);
+	}
+	free(engine.partitions);
+	free(engine.streams);
+	free(engine.values);
+	free(engine.valueCounts);
+	free(engine.requests);
+	free(engine.writes);
+	free(engine.means);
+	free(engine.readyCycles);
+	free(engine.waitTimes);
+	free(engine.stalled);
+	free(engine.available);
+	free(engine.finished);
+	free(engine.blockedOutside);
+	free(engine.granted);
+	free(engine.drawn);
+	free(engine.drawnWrites);
+	free(engine.drawSlots);
+	free(engine.queued);
+	free(engine.servedFrom);
+	free(engine.nextWaiting);
+	free(engine.readLatency);
+	free(engine.writeLatency);
+	free(engine.busy);
+	free(engine.attached);
+	free(engine.heads);
+	free(engine.tails);
+	free(engine.claimMasks);
+
+	return started == engine.threadCount ? engine.threadCount : -1;
+}
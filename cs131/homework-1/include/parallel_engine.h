@@ -0,0 +1,136 @@
+#ifndef PARALLEL_ENGINE_H
+#define PARALLEL_ENGINE_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "simulator.h"
+#include "rng.h"
+
+#define PARALLEL_MAX_THREADS 64	//Also the number of partitions a module's claim mask has bits for
+#define PARALLEL_BLOCK_PROCESSORS 64	//Processors sharing one random stream by default; threads own whole blocks
+#define PARALLEL_STREAM_STRIDE 0x9e3779b9U	//Distance between the seeds of consecutive blocks' streams
+#define PARALLEL_DRAW_VALUES 3	//Most random values a new request takes: two for a Gaussian module, one for the write
+#define PARALLEL_SPIN_LIMIT 512	//Spins at a barrier or bucket before a thread yields its core
+
+//Message handed from a processor's partition to the partition owning the module it names.
+typedef struct parallelMessage {
+	int processor;
+	int module;
+	int due;	//Last cycle of a reserved access (reservations only)
+} parallelMessage;
+
+//Messages one partition sends another at the end of a cycle. Written only by the sender and read only by the
+//receiver once (stamp) shows the cycle they belong to, so the hand-off needs no lock.
+typedef struct parallelBucket {
+	_Alignas(64) atomic_int stamp;	//Cycle whose messages the bucket holds
+	int reserveCount;
+	int waitCount;
+	parallelMessage* reserves;	//Modules newly requested by the cycle's grants
+	parallelMessage* waits;	//Processors that wait for their module and join its queue
+} parallelBucket;
+
+//Share of one thread: a range of processors (whole random blocks) and a shard of the modules.
+typedef struct parallelPartition {
+	_Alignas(64) int index;
+	int firstProcessor;
+	int lastProcessor;	//One past the last processor
+	int firstModule;
+	int lastModule;	//One past the last module
+
+	parallelBucket* outgoing;	//One bucket per destination partition
+	timingWheel wheel;	//Completion events of the shard, indexed from (firstModule)
+	int* fired;
+
+	//Modules the partition's grants reserve on the current cycle, in processor order: as of its latest pass, and
+	//as it last published them in the engine's claim masks
+	parallelMessage* claims;
+	int claimCount;
+	parallelMessage* published;
+	int publishedCount;
+	_Alignas(64) atomic_int settled;	//Cycle whose grants the partition has settled and published
+
+	//Open-addressing set of the modules claimed so far by the current pass; only entries stamped with (pass) count
+	int* claimedModules;
+	int* claimedStamps;
+	int claimedMask;
+	int pass;
+
+	long waitTotals[2];	//Wait cycles of the partition's processors so far, by cycle parity
+	struct parallelEngine* engine;
+	pthread_t thread;
+} parallelPartition;
+
+//Sense-reversing barrier the threads meet at.
+typedef struct parallelBarrier {
+	_Alignas(64) atomic_int remaining;
+	_Alignas(64) atomic_int sense;
+	int parties;
+} parallelBarrier;
+
+//Data-parallel cycle engine for a single large configuration. It computes the closed-loop model of run_simulator():
+//the processors are granted in processor order, a grant reserves the module of the processor's next request
+//for the rest of the cycle as well, and the accesses due on a cycle complete at its end. The result does not
+//depend on the number of threads.
+typedef struct parallelEngine {
+	int processCount;
+	int moduleCount;
+	distribution dist;
+	double sigma;
+	double writeRatio;
+	int threadCount;
+	int blockProcessors;	//Processors per random stream
+	int drawValues;	//Random values every new request takes
+	int shardModules;	//Modules per shard (the last one may have fewer)
+	bool tracing;	//Whether the calling thread records a trace the grants go into
+
+	//Per processor, written by the processor's partition
+	int* requests;	//Module of the current request
+	bool* writes;
+	int* means;	//Mean of the Gaussian requests
+	int* readyCycles;	//Cycle the processor is granted its current request on at the earliest
+	int* waitTimes;
+	bool* stalled;	//Whether the processor sits the cycle out
+	bool* available;	//Whether its module could serve it as the cycle started
+	bool* finished;	//Whether its multi-cycle access ended on the previous cycle, which nothing keeps from being granted
+	bool* blockedOutside;	//Whether a grant of an earlier partition on the cycle reserved its module
+	bool* granted;
+	int* drawn;	//Next request drawn for the processor if it is granted; once the cycle is over, the module it got
+	bool* drawnWrites;
+	int* drawSlots;	//Grant of its block on the cycle that (drawn) was drawn for (-1 for none)
+
+	//Per processor, written by the partition owning the module the processor waits for
+	bool* queued;
+	int* servedFrom;	//Cycle from which a processor handed a module by its queue may be granted
+	int* nextWaiting;	//Next processor in the same module queue (-1 ends it)
+
+	//Per module, written by the module's shard
+	int* readLatency;
+	int* writeLatency;
+	bool* busy;
+	int* attached;
+	int* heads;	//Queue of the processors waiting for each module (-1 when empty)
+	int* tails;
+
+	//Per module, one bit per partition: the partitions whose settled grants reserve the module on the current cycle
+	atomic_ullong* claimMasks;
+
+	//Per block of processors
+	threadRandom* streams;
+	int* values;	//Values drawn from the block's stream but not used yet, (blockProcessors * PARALLEL_DRAW_VALUES) per block
+	int* valueCounts;
+
+	parallelPartition* partitions;
+	parallelBarrier barrier;
+	atomic_bool cancelled;	//Set when a thread could not be started; waiting threads give up
+	int cycles;	//Cycle the simulation converged on
+} parallelEngine;
+
+bool parallel_supports(const simulatorConfig* config);
+int parallel_threads(int processCount,int modules,int threads,int blockProcessors);
+void seed_block_streams(threadRandom* streams,int blocks,unsigned int seed);
+int parallel_simulate(const simulatorConfig* config,distribution dist,int processCount,int modules,unsigned int seed,int threads,
+	int blockProcessors,simulationResult* result);
+
+#endif
@@ -0,0 +1,557 @@
+#include "pattern_vm.h"
+#include "placement.h"
+#include "rng.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//Implementation in C of the access pattern programs. A pattern file holds one or more programs in a small
+//assembly language, one instruction per line; '#' starts a comment and "name:" defines a label of the program:
+//
+//	program                 starts the next program (processor p runs program p mod the program count)
+//	set|add|sub|mul r, x    arithmetic on a register, wrapping around at 32 bits
+//	div|mod|and r, x        division, modulo (the result is never negative) and bitwise and; by 0 they give 0
+//	rand r, x               a uniform random number in [0, x)
+//	draw r                  a module from the distribution of the point (uniform, or around the processor's mean)
+//	chase r                 the module after module r on a random chain through every module (pointer chasing)
+//	read x | write x        request module x mod the module count, and stop until the request is granted
+//	jump label              continue at (label)
+//	loop r, label           count r down and continue at (label) while it is positive
+//
+//Operands are registers r0 to r7, the read-only registers id (the processor's index), procs and modules, or
+//integers. A program starts with every general register at 0 and starts over once it runs off its end.
+//
+//The programs are compiled to 8-byte instructions that the interpreter runs with threaded dispatch: every
+//instruction jumps straight to the code of the next one through a table of labels, so there is no dispatch
+//loop to predict. Compilers without labels as values get a switch in a loop instead.
+
+#if defined(__GNUC__)
+#define PATTERN_THREADED
+#endif
+
+#define PATTERN_LINE_LENGTH 256
+#define PATTERN_MAX_LABELS 256	//Labels of a single program
+#define PATTERN_LABEL_LENGTH 32
+#define PATTERN_ID_SLOT 8	//Slots of the read-only registers
+#define PATTERN_PROCS_SLOT 9
+#define PATTERN_MODULES_SLOT 10
+
+typedef enum {
+	FormArithmetic = 0,	//register, operand
+	FormRegister = 1,	//register
+	FormOperand = 2,	//operand
+	FormLabel = 3,	//label
+	FormLoop = 4	//register, label
+} patternForm;
+
+//Assembly mnemonics and the instruction their immediate form compiles to (the register form follows it).
+static const struct {
+	const char* name;
+	patternForm form;
+	patternCode code;
+} mnemonics[] = {
+	{"set",FormArithmetic,OpSetI},
+	{"add",FormArithmetic,OpAddI},
+	{"sub",FormArithmetic,OpSubI},
+	{"mul",FormArithmetic,OpMulI},
+	{"div",FormArithmetic,OpDivI},
+	{"mod",FormArithmetic,OpModI},
+	{"and",FormArithmetic,OpAndI},
+	{"rand",FormArithmetic,OpRandI},
+	{"draw",FormRegister,OpDraw},
+	{"chase",FormRegister,OpChase},
+	{"read",FormOperand,OpReadI},
+	{"write",FormOperand,OpWriteI},
+	{"jump",FormLabel,OpJump},
+	{"loop",FormLoop,OpLoop}
+};
+
+//Labels of the program being compiled, and the jumps waiting for them.
+typedef struct patternLabels {
+	char names[PATTERN_MAX_LABELS][PATTERN_LABEL_LENGTH];
+	int ops[PATTERN_MAX_LABELS];
+	int count;
+	char pending[PATTERN_MAX_OPS][PATTERN_LABEL_LENGTH];	//Label every jump of the program refers to
+	int pendingOps[PATTERN_MAX_OPS];
+	int pendingCount;
+} patternLabels;
+
+void init_patterns(patternSet* set){
+	memset(set,0,sizeof(patternSet));
+}
+
+//Parse an operand: a register (slot and true) or an integer (value and false). Returns false when it is neither.
+static bool parse_operand(const char* text,int32_t* value,bool* isRegister){
+	char* end;
+
+	*isRegister = true;
+	if(text[0] == 'r' && text[1] >= '0' && text[1] < '0' + PATTERN_REGISTERS && text[2] == '\0'){
+		*value = text[1] - '0';
+		return true;
+	}
+	if(strcmp(text,"id") == 0){
+		*value = PATTERN_ID_SLOT;
+		return true;
+	}
+	if(strcmp(text,"procs") == 0){
+		*value = PATTERN_PROCS_SLOT;
+		return true;
+	}
+	if(strcmp(text,"modules") == 0){
+		*value = PATTERN_MODULES_SLOT;
+		return true;
+	}
+
+	*isRegister = false;
+	long number = strtol(text,&end,0);
+	*value = (int32_t) number;
+	return text[0] != '\0' && *end == '\0' && number >= INT32_MIN && number <= INT32_MAX;
+}
+
+//Parse the register an instruction writes: r0 to r7 only.
+static bool parse_target(const char* text,uint8_t* target){
+	int32_t slot;
+	bool isRegister;
+
+	if(!parse_operand(text,&slot,&isRegister) || !isRegister || slot >= PATTERN_REGISTERS){
+		return false;
+	}
+	*target = (uint8_t) slot;
+	return true;
+}
+
+//Resolve the jumps of the program that starts at instruction (start) and close it with a jump back to its start.
+static bool finish_program(patternSet* set,patternLabels* labels,int start,const char* path){
+	bool requests = false;
+	int i,j;
+
+	if(start == set->opCount){
+		fprintf(stderr,"%s: program %d is empty\n",path,set->programCount);
+		return false;
+	}
+
+	for(i = 0; i < labels->pendingCount; i++){
+		for(j = 0; j < labels->count && strcmp(labels->names[j],labels->pending[i]) != 0; j++);
+		if(j == labels->count){
+			fprintf(stderr,"%s: program %d has no label %s\n",path,set->programCount,labels->pending[i]);
+			return false;
+		}
+		set->ops[labels->pendingOps[i]].jump = (uint16_t) labels->ops[j];
+	}
+
+	for(i = start; i < set->opCount; i++){
+		requests |= set->ops[i].code >= OpReadI && set->ops[i].code <= OpWriteR;
+	}
+	if(!requests){
+		fprintf(stderr,"%s: program %d never issues a request\n",path,set->programCount);
+		return false;
+	}
+
+	if(set->opCount == PATTERN_MAX_OPS){
+		fprintf(stderr,"%s: more than %d instructions\n",path,PATTERN_MAX_OPS);
+		return false;
+	}
+	memset(&(set->ops[set->opCount]),0,sizeof(patternOp));
+	set->ops[set->opCount].code = OpJump;
+	set->ops[set->opCount].jump = (uint16_t) start;
+	set->opCount++;
+
+	set->starts[set->programCount++] = start;
+	labels->count = 0;
+	labels->pendingCount = 0;
+	return true;
+}
+
+//Compile one instruction, split into (words), at the end of (set).
+static bool compile_op(patternSet* set,patternLabels* labels,char words[4][PATTERN_LINE_LENGTH],int wordCount,const char* path,int line){
+	patternOp op;
+	const char* label = NULL;
+	bool isRegister = false;
+	int m;
+
+	for(m = 0; m < (int) (sizeof(mnemonics) / sizeof(mnemonics[0])) && strcmp(mnemonics[m].name,words[0]) != 0; m++);
+	if(m == (int) (sizeof(mnemonics) / sizeof(mnemonics[0]))){
+		fprintf(stderr,"%s:%d: unknown instruction %s\n",path,line,words[0]);
+		return false;
+	}
+
+	int expected = mnemonics[m].form == FormArithmetic || mnemonics[m].form == FormLoop ? 3 : 2;
+	if(wordCount != expected){
+		fprintf(stderr,"%s:%d: %s takes %d operand%s\n",path,line,words[0],expected - 1,expected == 2 ? "" : "s");
+		return false;
+	}
+
+	memset(&op,0,sizeof(patternOp));
+	op.code = (uint8_t) mnemonics[m].code;
+	switch(mnemonics[m].form){
+		case FormArithmetic:
+		case FormOperand:
+			if(mnemonics[m].form == FormArithmetic && !parse_target(words[1],&(op.target))){
+				fprintf(stderr,"%s:%d: %s is not a register from r0 to r%d\n",path,line,words[1],PATTERN_REGISTERS - 1);
+				return false;
+			}
+			if(!parse_operand(words[expected - 1],&(op.value),&isRegister)){
+				fprintf(stderr,"%s:%d: %s is not a register or an integer\n",path,line,words[expected - 1]);
+				return false;
+			}
+			op.code += isRegister ? 1 : 0;
+			if(!isRegister && op.value == 0 && (op.code == OpDivI || op.code == OpModI)){
+				fprintf(stderr,"%s:%d: %s by 0\n",path,line,words[0]);
+				return false;
+			}
+			break;
+		case FormRegister:
+		case FormLoop:
+			if(!parse_target(words[1],&(op.target))){
+				fprintf(stderr,"%s:%d: %s is not a register from r0 to r%d\n",path,line,words[1],PATTERN_REGISTERS - 1);
+				return false;
+			}
+			label = mnemonics[m].form == FormLoop ? words[2] : NULL;
+			break;
+		case FormLabel:
+			label = words[1];
+			break;
+	}
+
+	if(set->opCount == PATTERN_MAX_OPS - 1){
+		fprintf(stderr,"%s:%d: more than %d instructions\n",path,line,PATTERN_MAX_OPS);
+		return false;
+	}
+
+	if(label != NULL){
+		snprintf(labels->pending[labels->pendingCount],PATTERN_LABEL_LENGTH,"%s",label);
+		labels->pendingOps[labels->pendingCount++] = set->opCount;
+	}
+	set->ops[set->opCount++] = op;
+	return true;
+}
+
+//Compile the programs of the pattern file (path) into (set), which must have been initialized.
+//Returns false, with a message on stderr, if the file cannot be read or does not compile.
+bool load_patterns(patternSet* set,const char* path){
+	char text[PATTERN_LINE_LENGTH];
+	patternLabels* labels = (patternLabels*) calloc(1,sizeof(patternLabels));
+	FILE* file = fopen(path,"r");
+	int start = -1;
+	int line = 0;
+	bool ok = true;
+	int i;
+
+	free_patterns(set);
+	if(file == NULL || labels == NULL){
+		fprintf(stderr,"Could not read pattern file %s\n",path);
+		if(file != NULL){
+			fclose(file);
+		}
+		free(labels);
+		return false;
+	}
+	set->ops = (patternOp*) malloc(PATTERN_MAX_OPS * sizeof(patternOp));
+
+	while(ok && fgets(text,sizeof(text),file) != NULL){
+		char words[4][PATTERN_LINE_LENGTH];
+		char* cursor = text;
+		int wordCount = 0;
+
+		line++;
+		text[strcspn(text,"#\r\n")] = '\0';
+
+		//Split the line into words at blanks and commas.
+		while(*cursor != '\0'){
+			int length;
+
+			cursor += strspn(cursor," \t,");
+			length = (int) strcspn(cursor," \t,");
+			if(length == 0){
+				break;
+			}
+			if(wordCount == 4){
+				fprintf(stderr,"%s:%d: too many operands\n",path,line);
+				ok = false;
+				break;
+			}
+			memcpy(words[wordCount],cursor,length);
+			words[wordCount++][length] = '\0';
+			cursor += length;
+		}
+		if(!ok || wordCount == 0){
+			continue;
+		}
+
+		if(strcmp(words[0],"program") == 0 && wordCount == 1){
+			if(start >= 0){
+				ok = finish_program(set,labels,start,path);
+			}
+			if(ok && set->programCount == PATTERN_MAX_PROGRAMS){
+				fprintf(stderr,"%s:%d: more than %d programs\n",path,line,PATTERN_MAX_PROGRAMS);
+				ok = false;
+			}
+			start = set->opCount;
+			continue;
+		}
+
+		//Instructions before the first "program" line make up the first program.
+		if(start < 0){
+			start = set->opCount;
+		}
+
+		//A label names the instruction that follows it, on the same line or the next.
+		int length = (int) strlen(words[0]);
+		if(length > 1 && words[0][length - 1] == ':'){
+			words[0][length - 1] = '\0';
+			if(length > PATTERN_LABEL_LENGTH || labels->count == PATTERN_MAX_LABELS){
+				fprintf(stderr,"%s:%d: label %s is too long or one too many\n",path,line,words[0]);
+				ok = false;
+				continue;
+			}
+			for(i = 0; i < labels->count; i++){
+				if(strcmp(labels->names[i],words[0]) == 0){
+					fprintf(stderr,"%s:%d: label %s is defined twice\n",path,line,words[0]);
+					ok = false;
+				}
+			}
+			strcpy(labels->names[labels->count],words[0]);
+			labels->ops[labels->count++] = set->opCount;
+
+			for(i = 1; i < wordCount; i++){
+				strcpy(words[i - 1],words[i]);
+			}
+			if(--wordCount == 0){
+				continue;
+			}
+		}
+
+		ok = ok && compile_op(set,labels,words,wordCount,path,line);
+	}
+
+	if(ok && start < 0){
+		fprintf(stderr,"%s: no program\n",path);
+		ok = false;
+	}
+	if(ok){
+		ok = finish_program(set,labels,start,path);
+	}
+
+	fclose(file);
+	free(labels);
+	if(!ok){
+		free_patterns(set);
+		return false;
+	}
+
+	//FNV-1a over the instructions and the program starts.
+	uint64_t hash = 14695981039346656037ULL;
+	const unsigned char* bytes = (const unsigned char*) set->ops;
+	for(i = 0; i < set->opCount * (int) sizeof(patternOp); i++){
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	for(i = 0; i < set->programCount; i++){
+		hash = (hash ^ (uint32_t) set->starts[i]) * 1099511628211ULL;
+	}
+	set->hash = (uint32_t) (hash ^ (hash >> 32));
+	set->hash = set->hash == 0 ? 1 : set->hash;
+
+	for(i = 0; i < set->opCount; i++){
+		set->chases |= set->ops[i].code == OpChase;
+	}
+
+	return true;
+}
+
+//Make (destination) an independent copy of the programs of (source). Returns false if it could not be allocated.
+bool copy_patterns(patternSet* destination,const patternSet* source){
+	*destination = *source;
+	if(source->programCount == 0){
+		destination->ops = NULL;
+		return true;
+	}
+
+	destination->ops = (patternOp*) malloc(source->opCount * sizeof(patternOp));
+	if(destination->ops == NULL){
+		init_patterns(destination);
+		return false;
+	}
+	memcpy(destination->ops,source->ops,source->opCount * sizeof(patternOp));
+	return true;
+}
+
+void free_patterns(patternSet* set){
+	free(set->ops);
+	init_patterns(set);
+}
+
+//Link every module into a single random cycle for the chase instruction: Sattolo's shuffle makes the module
+//after i, chain[i], a permutation with one cycle. The chain only depends on the module count and leaves the
+//simulation's random stream alone.
+static void build_chain(int* chain,int modules){
+	uint32_t state = 2463534242U ^ (uint32_t) modules;
+	int i;
+
+	for(i = 0; i < modules; i++){
+		chain[i] = i;
+	}
+	for(i = modules - 1; i > 0; i--){
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		int j = (int) (state % (uint32_t) i);
+		int swap = chain[i];
+		chain[i] = chain[j];
+		chain[j] = swap;
+	}
+}
+
+//Set up the programs of (processCount) processors, each at the start of its program with cleared registers.
+//A set without programs sets up nothing.
+void setup_pattern_vm(patternVm* vm,const patternSet* set,int processCount,int modules){
+	int p;
+
+	vm->set = set != NULL && set->programCount > 0 ? set : NULL;
+	vm->processCount = processCount;
+	vm->moduleCount = modules;
+	vm->pcs = NULL;
+	vm->registers = NULL;
+	vm->chain = NULL;
+
+	if(vm->set == NULL){
+		return;
+	}
+
+	vm->pcs = (int*) placed_malloc(processCount * sizeof(int));
+	vm->registers = (int32_t*) placed_calloc((size_t) processCount * PATTERN_SLOTS,sizeof(int32_t));
+	for(p = 0; p < processCount; p++){
+		int32_t* r = &(vm->registers[p * PATTERN_SLOTS]);
+
+		vm->pcs[p] = set->starts[p % set->programCount];
+		r[PATTERN_ID_SLOT] = p;
+		r[PATTERN_PROCS_SLOT] = processCount;
+		r[PATTERN_MODULES_SLOT] = modules;
+	}
+
+	if(set->chases){
+		vm->chain = (int*) placed_malloc(modules * sizeof(int));
+		build_chain(vm->chain,modules);
+	}
+}
+
+//Module (value) refers to: its remainder by the module count, which is never negative. Most values already
+//name a module, and skip the division.
+static inline int pattern_module(const patternVm* vm,int32_t value){
+	if((uint32_t) value < (uint32_t) vm->moduleCount){
+		return value;
+	}
+
+	int module = value % vm->moduleCount;
+
+	return module < 0 ? module + vm->moduleCount : module;
+}
+
+static inline int32_t pattern_div(int32_t a,int32_t b){
+	if(b == 0){
+		return 0;
+	}
+	return b == -1 ? (int32_t) (0U - (uint32_t) a) : a / b;
+}
+
+static inline int32_t pattern_mod(int32_t a,int32_t b){
+	if(b == 0 || b == -1){
+		return 0;
+	}
+
+	int32_t rest = a % b;
+	return rest < 0 ? rest + (b < 0 ? -b : b) : rest;
+}
+
+static inline int32_t pattern_rand(int32_t bound){
+	return bound > 0 ? (int32_t) ((uint32_t) next_random() % (uint32_t) bound) : 0;
+}
+
+//Run the program of (process) up to its next request and return the module it requests; (write) tells
+//whether the request is a write. A program that jumps PATTERN_STEP_LIMIT times without a request reads
+//module 0 and carries on from where it stopped on its next request.
+int pattern_next(patternVm* vm,int process,bool* write,patternDraw draw,void* context){
+	const patternOp* ops = vm->set->ops;
+	const patternOp* op = &(ops[vm->pcs[process]]);
+	int32_t* r = &(vm->registers[process * PATTERN_SLOTS]);
+	int steps = PATTERN_STEP_LIMIT;
+	int32_t value;
+
+#ifdef PATTERN_THREADED
+	static const void* dispatch[OP_COUNT] = {
+		&&op_set_i,&&op_set_r,&&op_add_i,&&op_add_r,&&op_sub_i,&&op_sub_r,&&op_mul_i,&&op_mul_r,&&op_div_i,&&op_div_r,&&op_mod_i,&&op_mod_r,
+		&&op_and_i,&&op_and_r,&&op_rand_i,&&op_rand_r,&&op_draw,&&op_chase,&&op_read_i,&&op_read_r,&&op_write_i,&&op_write_r,&&op_jump,&&op_loop
+	};
+#define OP(name,code) op_##name:
+#define NEXT() goto *dispatch[op->code]
+	NEXT();
+#else
+#define OP(name,code) case code:
+#define NEXT() continue
+	for(;;){
+	switch(op->code){
+#endif
+
+	OP(set_i,OpSetI) r[op->target] = op->value; op++; NEXT();
+	OP(set_r,OpSetR) r[op->target] = r[op->value]; op++; NEXT();
+	OP(add_i,OpAddI) r[op->target] = (int32_t) ((uint32_t) r[op->target] + (uint32_t) op->value); op++; NEXT();
+	OP(add_r,OpAddR) r[op->target] = (int32_t) ((uint32_t) r[op->target] + (uint32_t) r[op->value]); op++; NEXT();
+	OP(sub_i,OpSubI) r[op->target] = (int32_t) ((uint32_t) r[op->target] - (uint32_t) op->value); op++; NEXT();
+	OP(sub_r,OpSubR) r[op->target] = (int32_t) ((uint32_t) r[op->target] - (uint32_t) r[op->value]); op++; NEXT();
+	OP(mul_i,OpMulI) r[op->target] = (int32_t) ((uint32_t) r[op->target] * (uint32_t) op->value); op++; NEXT();
+	OP(mul_r,OpMulR) r[op->target] = (int32_t) ((uint32_t) r[op->target] * (uint32_t) r[op->value]); op++; NEXT();
+	OP(div_i,OpDivI) r[op->target] = pattern_div(r[op->target],op->value); op++; NEXT();
+	OP(div_r,OpDivR) r[op->target] = pattern_div(r[op->target],r[op->value]); op++; NEXT();
+	OP(mod_i,OpModI) r[op->target] = pattern_mod(r[op->target],op->value); op++; NEXT();
+	OP(mod_r,OpModR) r[op->target] = pattern_mod(r[op->target],r[op->value]); op++; NEXT();
+	OP(and_i,OpAndI) r[op->target] &= op->value; op++; NEXT();
+	OP(and_r,OpAndR) r[op->target] &= r[op->value]; op++; NEXT();
+	OP(rand_i,OpRandI) r[op->target] = pattern_rand(op->value); op++; NEXT();
+	OP(rand_r,OpRandR) r[op->target] = pattern_rand(r[op->value]); op++; NEXT();
+	OP(draw,OpDraw) r[op->target] = draw(context,process); op++; NEXT();
+	OP(chase,OpChase) r[op->target] = vm->chain[pattern_module(vm,r[op->target])]; op++; NEXT();
+	OP(read_i,OpReadI) value = op->value; *write = false; goto request;
+	OP(read_r,OpReadR) value = r[op->value]; *write = false; goto request;
+	OP(write_i,OpWriteI) value = op->value; *write = true; goto request;
+	OP(write_r,OpWriteR) value = r[op->value]; *write = true; goto request;
+	OP(jump,OpJump) op = &(ops[op->jump]); if(--steps == 0) goto runaway; NEXT();
+	OP(loop,OpLoop) op = --r[op->target] > 0 ? &(ops[op->jump]) : op + 1; if(--steps == 0) goto runaway; NEXT();
+
+#ifndef PATTERN_THREADED
+	}
+	}
+#endif
+#undef OP
+#undef NEXT
+
+request:
+	//A program usually continues with the jump back to its loop, which is taken now rather than dispatched.
+	op++;
+	vm->pcs[process] = (int) ((op->code == OpJump ? &(ops[op->jump]) : op) - ops);
+	return pattern_module(vm,value);
+
+runaway:
+	vm->pcs[process] = (int) (op - ops);
+	*write = false;
+	return 0;
+}
+
+//Make (destination) continue exactly where (source) is. Both must run the same programs on the same point.
+void copy_pattern_vm(patternVm* destination,const patternVm* source){
+	if(source->set == NULL){
+		return;
+	}
+
+	memcpy(destination->pcs,source->pcs,source->processCount * sizeof(int));
+	memcpy(destination->registers,source->registers,(size_t) source->processCount * PATTERN_SLOTS * sizeof(int32_t));
+}
+
+void free_pattern_vm(patternVm* vm){
+	placed_free(vm->pcs);
+	placed_free(vm->registers);
+	placed_free(vm->chain);
+	vm->pcs = NULL;
+	vm->registers = NULL;
+	vm->chain = NULL;
+	vm->set = NULL;
+}
@@ -0,0 +1,85 @@
+#ifndef PATTERN_VM_H
+#define PATTERN_VM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PATTERN_MAX_PROGRAMS 64
+#define PATTERN_MAX_OPS 4096	//Instructions of all the programs of a file
+#define PATTERN_REGISTERS 8	//General registers r0 to r7 of every processor
+#define PATTERN_SLOTS 12	//Registers per processor: the general ones, then id, procs and modules, then padding
+#define PATTERN_STEP_LIMIT 4096	//Jumps a program may take without issuing a request before it is cut short
+
+//Instructions of the bytecode. Operations with an _I and an _R form take an immediate or a register
+//as their operand; the order is the order of the interpreter's dispatch table.
+typedef enum {
+	OpSetI = 0,
+	OpSetR,
+	OpAddI,
+	OpAddR,
+	OpSubI,
+	OpSubR,
+	OpMulI,
+	OpMulR,
+	OpDivI,
+	OpDivR,
+	OpModI,
+	OpModR,
+	OpAndI,
+	OpAndR,
+	OpRandI,
+	OpRandR,
+	OpDraw,
+	OpChase,
+	OpReadI,
+	OpReadR,
+	OpWriteI,
+	OpWriteR,
+	OpJump,
+	OpLoop,
+	OP_COUNT
+} patternCode;
+
+//One instruction packed into 8 bytes.
+typedef struct patternOp {
+	uint8_t code;
+	uint8_t target;	//Register the instruction writes or counts down
+	uint16_t jump;	//Instruction a jump or loop continues at
+	int32_t value;	//Immediate operand, or the register of an _R operand
+} patternOp;
+
+//Programs compiled from a pattern file. Processor p runs program (p mod programCount).
+typedef struct patternSet {
+	patternOp* ops;	//Instructions of all the programs, each ending with a jump back to its start
+	int opCount;
+	int starts[PATTERN_MAX_PROGRAMS];	//First instruction of every program
+	int programCount;	//0 when the processors draw their requests from the distribution
+	bool chases;	//Whether a program follows the pointer chain
+	uint32_t hash;	//Hash of the bytecode, identifying the programs in caches and traces
+} patternSet;
+
+//Draws a module for the draw instruction from the distribution of the point (context) simulates.
+typedef int (*patternDraw)(void* context,int process);
+
+//State of the programs of one simulation: every processor's next instruction and registers.
+typedef struct patternVm {
+	const patternSet* set;	//NULL when the processors draw their requests from the distribution
+	int processCount;
+	int moduleCount;
+	int* pcs;	//Next instruction of every processor
+	int32_t* registers;	//(PATTERN_SLOTS) registers per processor
+	int* chain;	//Module that follows every module on the pointer chain (NULL when no program chases)
+} patternVm;
+
+void init_patterns(patternSet* set);
+bool load_patterns(patternSet* set,const char* path);
+bool copy_patterns(patternSet* destination,const patternSet* source);
+void free_patterns(patternSet* set);
+
+void setup_pattern_vm(patternVm* vm,const patternSet* set,int processCount,int modules);
+int pattern_next(patternVm* vm,int process,bool* write,patternDraw draw,void* context);
+void copy_pattern_vm(patternVm* destination,const patternVm* source);
+void free_pattern_vm(patternVm* vm);
+
+#endif
@@ -0,0 +1,294 @@
+#define _GNU_SOURCE	//sched_setaffinity(), MAP_HUGETLB
+#include "placement.h"
+
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+//Implementation in C of the placement of sweep workers on the host: pinning a worker to one core, preferring
+//the memory of that core's node for everything the worker touches first, and an arena on that node for the
+//state setup_simulator() allocates for every point. The memory policy calls go through syscall() so that
+//the simulator does not need libnuma.
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#define NODE_PATH "/sys/devices/system/node/node%d/cpulist"
+
+_Thread_local placementArena* activeArena = NULL;
+static placementArena workerArena;
+
+//Add the cores of a list such as "0-3,8,10-11" that the process may run on to (layout), as cores of (node).
+static void add_cpu_list(hostLayout* layout,const char* list,int node,const cpu_set_t* allowed){
+	const char* cursor = list;
+
+	while(*cursor != '\0' && *cursor != '\n'){
+		char* end;
+		int first = (int) strtol(cursor,&end,10);
+		int last = first;
+
+		if(end == cursor){
+			break;
+		}
+		if(*end == '-'){
+			cursor = end + 1;
+			last = (int) strtol(cursor,&end,10);
+		}
+
+		for(int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++){
+			if(CPU_ISSET(cpu,allowed)){
+				layout->cpus[layout->cpuCount] = cpu;
+				layout->cpuNodes[layout->cpuCount] = node;
+				layout->cpuCount++;
+			}
+		}
+
+		cursor = *end == ',' ? end + 1 : end;
+	}
+}
+
+//Read the host's nodes and the cores of each that the process may use. Hosts without NUMA information
+//are described as a single node. Returns false if no core could be found.
+bool read_host_layout(hostLayout* layout){
+	cpu_set_t allowed;
+	char path[64];
+	char list[4096];
+	int node;
+
+	memset(layout,0,sizeof(hostLayout));
+	if(sched_getaffinity(0,sizeof(allowed),&allowed) != 0){
+		return false;
+	}
+
+	layout->cpus = (int*) malloc(CPU_SETSIZE * sizeof(int));
+	layout->cpuNodes = (int*) malloc(CPU_SETSIZE * sizeof(int));
+
+	for(node = 0; node < PLACEMENT_MAX_NODES; node++){
+		snprintf(path,sizeof(path),NODE_PATH,node);
+		FILE* file = fopen(path,"r");
+
+		if(file == NULL){
+			continue;
+		}
+		if(fgets(list,sizeof(list),file) != NULL){
+			add_cpu_list(layout,list,node,&allowed);
+			layout->nodeCount = node + 1;
+		}
+		fclose(file);
+	}
+
+	if(layout->cpuCount == 0){
+		for(int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+			if(CPU_ISSET(cpu,&allowed)){
+				layout->cpus[layout->cpuCount] = cpu;
+				layout->cpuNodes[layout->cpuCount] = 0;
+				layout->cpuCount++;
+			}
+		}
+		layout->nodeCount = 1;
+	}
+
+	return layout->cpuCount > 0;
+}
+
+void free_host_layout(hostLayout* layout){
+	free(layout->cpus);
+	free(layout->cpuNodes);
+	layout->cpus = NULL;
+	layout->cpuNodes = NULL;
+}
+
+//Core and node of worker (worker) under (policy). Workers beyond the core count share cores in the same order.
+//Returns false for PlacementNone, which leaves the worker where the operating system puts it.
+bool placement_slot(const hostLayout* layout,placementPolicy policy,int worker,int* cpu,int* node){
+	int index = worker % layout->cpuCount;
+
+	if(policy == PlacementNone){
+		return false;
+	}
+
+	if(policy == PlacementScatter){
+		int nodesWithCpus = 0;
+		int counts[PLACEMENT_MAX_NODES] = {0};
+		int i;
+
+		for(i = 0; i < layout->cpuCount; i++){
+			nodesWithCpus += counts[layout->cpuNodes[i]]++ == 0 ? 1 : 0;
+		}
+
+		//The (worker / nodes)-th core of the (worker % nodes)-th node that has cores.
+		int wanted = worker % nodesWithCpus;
+		int rank = worker / nodesWithCpus;
+		int target = -1;
+
+		for(i = 0; i < PLACEMENT_MAX_NODES; i++){
+			if(counts[i] > 0 && wanted-- == 0){
+				target = i;
+				break;
+			}
+		}
+
+		rank %= counts[target];
+		for(i = 0; i < layout->cpuCount; i++){
+			if(layout->cpuNodes[i] == target && rank-- == 0){
+				index = i;
+				break;
+			}
+		}
+	}
+
+	*cpu = layout->cpus[index];
+	*node = layout->cpuNodes[index];
+	return true;
+}
+
+//Map the arena of the calling worker with the pages asked for, preferring (node) when it is not negative.
+static bool open_arena(placementArena* arena,int node,hugePagePolicy pages){
+	size_t bytes = PLACEMENT_ARENA_BYTES;
+
+	memset(arena,0,sizeof(placementArena));
+	arena->node = node;
+	arena->pages = pages;
+	arena->base = MAP_FAILED;
+
+	if(pages == HugePagesExplicit){
+		arena->base = (char*) mmap(NULL,bytes,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,-1,0);
+		arena->hugeBacked = arena->base != MAP_FAILED;
+	}
+	if(arena->base == MAP_FAILED){
+		arena->base = (char*) mmap(NULL,bytes,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+		if(arena->base == MAP_FAILED){
+			return false;
+		}
+		if(pages != HugePagesNone){
+			arena->hugeBacked = madvise(arena->base,bytes,MADV_HUGEPAGE) == 0;
+		}
+	}
+
+	if(node >= 0){
+		unsigned long mask[PLACEMENT_MAX_NODES / (8 * sizeof(unsigned long)) + 1] = {0};
+
+		mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+		syscall(SYS_mbind,arena->base,bytes,MPOL_PREFERRED,mask,PLACEMENT_MAX_NODES + 1,0);
+	}
+
+	//Touch every page from the pinned worker, so they are placed now rather than during the first points.
+	memset(arena->base,0,bytes);
+	arena->capacity = bytes;
+	return true;
+}
+
+//Place the calling worker process: pin it to its core, make its node the preferred one for its memory and
+//give it an arena there. Returns false if the worker could not be pinned; a missing arena only costs locality.
+bool place_worker(placementPolicy policy,hugePagePolicy pages,int worker){
+	hostLayout layout;
+	int cpu = -1,node = -1;
+
+	if(policy == PlacementNone && pages == HugePagesNone){
+		return true;
+	}
+
+	if(!read_host_layout(&layout)){
+		fprintf(stderr,"Worker %d: could not read the host layout\n",worker);
+		return false;
+	}
+
+	if(placement_slot(&layout,policy,worker,&cpu,&node)){
+		cpu_set_t set;
+		unsigned long mask[PLACEMENT_MAX_NODES / (8 * sizeof(unsigned long)) + 1] = {0};
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu,&set);
+		if(sched_setaffinity(0,sizeof(set),&set) != 0){
+			fprintf(stderr,"Worker %d: could not pin to core %d\n",worker,cpu);
+			free_host_layout(&layout);
+			return false;
+		}
+
+		//Whatever the worker allocates outside the arena is placed on its node by first touch.
+		mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+		syscall(SYS_set_mempolicy,MPOL_PREFERRED,mask,PLACEMENT_MAX_NODES + 1);
+	}
+	free_host_layout(&layout);
+
+	if(!open_arena(&workerArena,node,pages)){
+		fprintf(stderr,"Worker %d: could not map its arena; its state stays on the heap\n",worker);
+		return true;
+	}
+	if(pages != HugePagesNone && !workerArena.hugeBacked && worker == 0){
+		fprintf(stderr,"Worker %d: %s huge pages unavailable, the workers use normal pages\n",worker,huge_page_name(pages));
+	}
+
+	activeArena = &workerArena;
+	return true;
+}
+
+//Unmap the arena of the calling worker. Nothing allocated from it may be used afterwards.
+void release_placement(void){
+	if(activeArena != NULL){
+		munmap(activeArena->base,activeArena->capacity);
+		activeArena = NULL;
+	}
+}
+
+//Allocate (bytes) from the arena, or from the heap when the arena is full.
+void* placed_alloc(size_t bytes,bool zeroed){
+	placementArena* arena = activeArena;
+	size_t size = (bytes + PLACEMENT_ALIGNMENT - 1) & ~((size_t) PLACEMENT_ALIGNMENT - 1);
+
+	if(arena->used + size > arena->capacity){
+		arena->fallbacks++;
+		return zeroed ? calloc(1,bytes > 0 ? bytes : 1) : malloc(bytes);
+	}
+
+	void* pointer = arena->base + arena->used;
+	arena->used += size;
+	arena->live++;
+	if(zeroed){
+		memset(pointer,0,bytes);
+	}
+
+	return pointer;
+}
+
+//Free an allocation. Arena memory is reclaimed once all of it is free; heap fallbacks are freed at once.
+void placed_release(void* pointer){
+	placementArena* arena = activeArena;
+
+	if(pointer == NULL){
+		return;
+	}
+	if((char*) pointer < arena->base || (char*) pointer >= arena->base + arena->capacity){
+		free(pointer);
+		return;
+	}
+
+	if(--(arena->live) == 0){
+		arena->used = 0;
+	}
+}
+
+const char* placement_name(placementPolicy policy){
+	switch(policy){
+		case PlacementCompact:
+			return "compact";
+		case PlacementScatter:
+			return "scatter";
+		default:
+			return "none";
+	}
+}
+
+const char* huge_page_name(hugePagePolicy pages){
+	switch(pages){
+		case HugePagesTransparent:
+			return "transparent";
+		case HugePagesExplicit:
+			return "explicit";
+		default:
+			return "none";
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define PLACEMENT_MAX_NODES 64
+#define PLACEMENT_ARENA_BYTES (64L << 20)	//Arena of a pinned worker; larger points fall back to malloc()
+#define PLACEMENT_ALIGNMENT 64	//Every arena allocation starts on its own cache line
+#define HUGE_PAGE_BYTES (2L << 20)
+
+//Where the sweep workers run. Independent of the simulated NUMA machine of topology.h: this is the host.
+typedef enum {
+	PlacementNone = 0,	//Leave scheduling and memory placement to the operating system
+	PlacementCompact = 1,	//Fill the cores of one host node before moving to the next
+	PlacementScatter = 2	//Deal the workers round-robin over the host nodes
+} placementPolicy;
+
+//Pages backing the arenas.
+typedef enum {
+	HugePagesNone = 0,
+	HugePagesTransparent = 1,	//Ask for transparent huge pages with madvise()
+	HugePagesExplicit = 2	//Reserved huge pages (MAP_HUGETLB), normal pages when none are reserved
+} hugePagePolicy;
+
+//Cores and nodes of the host, read from /sys.
+typedef struct hostLayout {
+	int nodeCount;
+	int cpuCount;
+	int* cpus;	//Usable cores, grouped by node
+	int* cpuNodes;	//Node of every entry of (cpus)
+} hostLayout;
+
+//Bump allocator for the state of the simulations of one worker, bound to the worker's node.
+//Allocations are released all at once when the last live one is freed, which happens at the end of every point.
+typedef struct placementArena {
+	char* base;
+	size_t capacity;
+	size_t used;
+	long live;	//Allocations not freed yet
+	long fallbacks;	//Allocations the arena was too full for, which went to the heap
+	int node;
+	hugePagePolicy pages;
+	bool hugeBacked;	//Whether the pages asked for were obtained
+} placementArena;
+
+//Arena of the calling thread (NULL when it is not a placed worker). Threads a worker starts use the heap.
+extern _Thread_local placementArena* activeArena;
+
+bool read_host_layout(hostLayout* layout);
+void free_host_layout(hostLayout* layout);
+bool placement_slot(const hostLayout* layout,placementPolicy policy,int worker,int* cpu,int* node);
+bool place_worker(placementPolicy policy,hugePagePolicy pages,int worker);
+void release_placement(void);
+const char* placement_name(placementPolicy policy);
+const char* huge_page_name(hugePagePolicy pages);
+
+void* placed_alloc(size_t bytes,bool zeroed);
+void placed_release(void* pointer);
+
+//Allocate simulator state, from the worker's arena when it has one.
+static inline void* placed_malloc(size_t bytes){
+	return activeArena == NULL ? malloc(bytes) : placed_alloc(bytes,false);
+}
+
+static inline void* placed_calloc(size_t count,size_t size){
+	return activeArena == NULL ? calloc(count,size) : placed_alloc(count * size,true);
+}
+
+//Free memory from placed_malloc() or placed_calloc().
+static inline void placed_free(void* pointer){
+	if(activeArena == NULL){
+		free(pointer);
+	} else {
+		placed_release(pointer);
+	}
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "processor_cache.h"
+#include "placement.h"
+
+#include <string.h>
+
+//Implementation in C of the private caches that sit between the processors' request generation and the
+//arbitration of the memory modules. Every processor has its own cache of (sets) sets of (ways) ways that
+//holds line addresses. A set's ways are replaced by a bit pseudo-LRU: the bitmask of the set marks the ways
+//used recently, is cleared down to the way just used once every way is marked, and the victim of a miss is
+//the first unmarked way. Writes go through to their module and allocate their line; the caches are not kept
+//coherent, as the modelled requests carry no data.
+
+//Set up (processCount) empty caches. Zero sets sets up no caches at all.
+void setup_processor_cache(processorCache* cache,int sets,int ways,int processCount){
+	int i;
+
+	cache->sets = sets;
+	cache->ways = ways;
+	cache->stride = (ways + KERNEL_TAG_MULTIPLE - 1) / KERNEL_TAG_MULTIPLE * KERNEL_TAG_MULTIPLE;
+	cache->processCount = processCount;
+	cache->tags = NULL;
+	cache->recent = NULL;
+	cache->match = NULL;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->fills = 0;
+
+	if(sets <= 0){
+		cache->sets = 0;
+		return;
+	}
+
+	cache->tags = (uint32_t*) placed_malloc((size_t) processCount * sets * cache->stride * sizeof(uint32_t));
+	cache->recent = (uint32_t*) placed_calloc((size_t) processCount * sets,sizeof(uint32_t));
+	cache->match = tag_match_kernel();
+	for(i = 0; i < processCount * sets * cache->stride; i++){
+		cache->tags[i] = CACHE_NO_TAG;
+	}
+}
+
+bool cache_enabled(const processorCache* cache){
+	return cache->sets > 0;
+}
+
+//Mark (way) as used in the pseudo-LRU bitmask of its set.
+static inline void touch_way(processorCache* cache,uint32_t* recent,int way){
+	uint32_t all = cache->ways == 32 ? 0xffffffffU : (1U << cache->ways) - 1;
+
+	*recent |= 1U << way;
+	if(*recent == all){
+		*recent = 1U << way;
+	}
+}
+
+//Look the line (address) up in the cache of (process). A read that hits is served by the cache; every other
+//request misses and installs its line in place of the set's pseudo-LRU victim. Returns whether it hit.
+bool cache_access(processorCache* cache,int process,uint32_t address,bool write){
+	int set = (int) (address & (uint32_t) (cache->sets - 1));
+	size_t index = (size_t) process * cache->sets + set;
+	uint32_t* tags = cache->tags + index * cache->stride;
+	uint32_t* recent = cache->recent + index;
+	int way = cache->match(tags,cache->stride,address);
+
+	if(way >= 0){
+		touch_way(cache,recent,way);
+		if(!write){
+			cache->hits++;
+			return true;
+		}
+	} else {
+		uint32_t all = cache->ways == 32 ? 0xffffffffU : (1U << cache->ways) - 1;
+		way = __builtin_ctz(~(*recent) & all);
+		cache->fills += tags[way] == CACHE_NO_TAG ? 1 : 0;
+		tags[way] = address;
+		touch_way(cache,recent,way);
+	}
+
+	cache->misses++;
+	return false;
+}
+
+//Share of the requests the caches served.
+double cache_hit_rate(const processorCache* cache){
+	long requests = cache->hits + cache->misses;
+
+	return requests > 0 ? (double) cache->hits / requests : 0.0;
+}
+
+//Make (destination) hold the same lines and replacement state as (source), which has the same geometry.
+void copy_processor_cache(processorCache* destination,const processorCache* source){
+	size_t sets = (size_t) source->processCount * source->sets;
+
+	if(source->sets > 0){
+		memcpy(destination->tags,source->tags,sets * source->stride * sizeof(uint32_t));
+		memcpy(destination->recent,source->recent,sets * sizeof(uint32_t));
+	}
+	destination->hits = source->hits;
+	destination->misses = source->misses;
+	destination->fills = source->fills;
+}
+
+void free_processor_cache(processorCache* cache){
+	placed_free(cache->tags);
+	placed_free(cache->recent);
+	cache->tags = NULL;
+	cache->recent = NULL;
+	cache->sets = 0;
+}
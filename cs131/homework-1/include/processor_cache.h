@@ -0,0 +1,35 @@
+#ifndef PROCESSOR_CACHE_H
+#define PROCESSOR_CACHE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "kernels.h"
+
+#define CACHE_MAX_WAYS 32	//Ways of a set its pseudo-LRU bitmask can track
+#define CACHE_NO_TAG 0xffffffffU	//Tag of an empty way and of the padding after the last way of a set
+
+//Private set-associative caches of the processors of a simulation. The tags of a set are stored together,
+//apart from the replacement state, so a lookup compares the whole set with a few vector instructions.
+typedef struct processorCache {
+	int sets;	//Sets of every processor's cache, a power of two (0 when there are no caches)
+	int ways;
+	int stride;	//Tags stored per set: (ways) rounded up to KERNEL_TAG_MULTIPLE, the rest never match
+	int processCount;
+	uint32_t* tags;	//Line address held by every way of every set of every processor
+	uint32_t* recent;	//Pseudo-LRU bitmask of every set: the ways used since the mask was last cleared
+	tagMatchKernel match;
+	long hits;	//Requests served by the caches
+	long misses;	//Requests that went on to their module, which includes every write
+	long fills;	//Misses that installed their line in an empty way
+} processorCache;
+
+void setup_processor_cache(processorCache* cache,int sets,int ways,int processCount);
+bool cache_enabled(const processorCache* cache);
+bool cache_access(processorCache* cache,int process,uint32_t address,bool write);
+double cache_hit_rate(const processorCache* cache);
+void copy_processor_cache(processorCache* destination,const processorCache* source);
+void free_processor_cache(processorCache* cache);
+
+#endif
@@ -0,0 +1,235 @@
+#include "profiler.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+//Implementation in C of an opt-in profiler that attributes hardware performance counters
+//(read through perf_event_open) to the phases of the simulator's cycle loop.
+
+typedef struct profilerState {
+	FILE* file;
+	int fds[COUNTER_COUNT];	//perf event of every hardware counter (-1 when unavailable)
+	struct perf_event_mmap_page* pages[COUNTER_COUNT];	//Mapped event pages used for user-space reads
+
+	unsigned long long last[COUNTER_COUNT];	//Counter values at the last phase switch
+	int phase;	//Phase the counts are currently attributed to (-1 outside of a point)
+
+	phaseCounts point[PHASE_COUNT];
+	phaseCounts session[PHASE_COUNT];
+} profilerState;
+
+static profilerState* activeProfiler = NULL;
+
+static const char* phaseNames[PHASE_COUNT] = {"generation","conflict","arbitration","convergence"};
+static const char* distributionNames[2] = {"uniform","gaussian"};
+
+//Open a counter of the calling thread, counting user space only.
+static int open_counter(unsigned int type,unsigned long long config){
+	struct perf_event_attr attr;
+
+	memset(&attr,0,sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int) syscall(SYS_perf_event_open,&attr,0,-1,-1,0);
+}
+
+//Read a counter. Hardware counters are read with rdpmc from the event's mapped page when the
+//kernel allows it, which avoids a system call on every phase switch; otherwise read() is used.
+static unsigned long long read_counter(profilerState* prof,int counter){
+	unsigned long long value = 0;
+
+	if(counter == CounterNanos){
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC,&now);
+		return now.tv_sec * 1000000000ULL + now.tv_nsec;
+	}
+
+	if(prof->fds[counter] < 0){
+		return 0;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	struct perf_event_mmap_page* page = prof->pages[counter];
+	if(page != NULL && page->cap_user_rdpmc){
+		unsigned int sequence,index;
+		long long count;
+
+		//The page is updated under a sequence lock by the kernel; retry if it changed under us.
+		do {
+			sequence = page->lock;
+			__sync_synchronize();
+
+			index = page->index;
+			count = page->offset;
+			if(index != 0){
+				long long pmc = (long long) __builtin_ia32_rdpmc(index - 1);
+				int shift = 64 - page->pmc_width;
+
+				pmc = (pmc << shift) >> shift;
+				count += pmc;
+			}
+
+			__sync_synchronize();
+		} while(page->lock != sequence);
+
+		if(index != 0){
+			return (unsigned long long) count;
+		}
+	}
+#endif
+
+	if(read(prof->fds[counter],&value,sizeof(value)) != sizeof(value)){
+		return 0;
+	}
+
+	return value;
+}
+
+//Add the counts since the last switch to the current phase and restart counting.
+static void account(profilerState* prof){
+	int counter;
+
+	for(counter = 0; counter < COUNTER_COUNT; counter++){
+		unsigned long long now = read_counter(prof,counter);
+
+		if(prof->phase >= 0){
+			prof->point[prof->phase].values[counter] += now - prof->last[counter];
+		}
+		prof->last[counter] = now;
+	}
+}
+
+//Write one row of counts; unavailable counters are left empty.
+static void write_row(profilerState* prof,const char* scope,const char* dist,int processCount,int modules,int phase,phaseCounts* counts){
+	int counter;
+
+	fprintf(prof->file,"%s,%s,%d,%d,%s",scope,dist,processCount,modules,phaseNames[phase]);
+	for(counter = 0; counter < COUNTER_COUNT; counter++){
+		if(profiler_counter_available((profileCounter) counter)){
+			fprintf(prof->file,",%llu",counts->values[counter]);
+		} else {
+			fprintf(prof->file,",");
+		}
+	}
+	fprintf(prof->file,"\n");
+}
+
+//Start profiling the calling thread and write the per-point and per-session counts to (path) as CSV.
+//Returns false if the output file cannot be created. Counters the machine does not provide stay empty.
+bool profiler_open(const char* path){
+	profilerState* prof = (profilerState*) calloc(1,sizeof(profilerState));
+	int counter;
+
+	prof->file = fopen(path,"w");
+	if(prof->file == NULL){
+		free(prof);
+		return false;
+	}
+
+	prof->fds[CounterNanos] = -1;
+	prof->fds[CounterCycles] = open_counter(PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES);
+	prof->fds[CounterInstructions] = open_counter(PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS);
+	prof->fds[CounterBranchMisses] = open_counter(PERF_TYPE_HARDWARE,PERF_COUNT_HW_BRANCH_MISSES);
+	prof->fds[CounterLLCMisses] = open_counter(PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+	for(counter = 0; counter < COUNTER_COUNT; counter++){
+		prof->pages[counter] = NULL;
+
+		if(prof->fds[counter] >= 0){
+			void* page = mmap(NULL,sysconf(_SC_PAGESIZE),PROT_READ,MAP_SHARED,prof->fds[counter],0);
+			prof->pages[counter] = page == MAP_FAILED ? NULL : (struct perf_event_mmap_page*) page;
+		}
+	}
+
+	prof->phase = -1;
+	activeProfiler = prof;
+
+	fprintf(prof->file,"scope,distribution,processors,memory modules,phase,nanoseconds,cycles,instructions,branch-misses,llc-misses\n");
+	return true;
+}
+
+//Write the session totals and stop profiling.
+void profiler_close(void){
+	profilerState* prof = activeProfiler;
+	int counter,phase;
+
+	if(prof == NULL){
+		return;
+	}
+
+	for(phase = 0; phase < PHASE_COUNT; phase++){
+		write_row(prof,"session","all",0,0,phase,&(prof->session[phase]));
+	}
+
+	for(counter = 0; counter < COUNTER_COUNT; counter++){
+		if(prof->pages[counter] != NULL){
+			munmap(prof->pages[counter],sysconf(_SC_PAGESIZE));
+		}
+		if(prof->fds[counter] >= 0){
+			close(prof->fds[counter]);
+		}
+	}
+
+	fclose(prof->file);
+	free(prof);
+	activeProfiler = NULL;
+}
+
+//Check if a counter could be opened on this machine.
+bool profiler_counter_available(profileCounter counter){
+	return counter == CounterNanos || (activeProfiler != NULL && activeProfiler->fds[counter] >= 0);
+}
+
+//Reset the per-point counts at the start of a simulation.
+void profiler_begin_point(void){
+	profilerState* prof = activeProfiler;
+
+	if(prof == NULL){
+		return;
+	}
+
+	memset(prof->point,0,sizeof(prof->point));
+	prof->phase = -1;
+	account(prof);
+}
+
+//Attribute everything counted since the last switch to the previous phase and start counting (phase).
+void profiler_enter(simulatorPhase phase){
+	profilerState* prof = activeProfiler;
+
+	if(prof == NULL || prof->phase == (int) phase){
+		return;
+	}
+
+	account(prof);
+	prof->phase = phase;
+}
+
+//Finish the point: write one row per phase and add the counts to the session totals.
+void profiler_end_point(distribution dist,int processCount,int modules){
+	profilerState* prof = activeProfiler;
+	int counter,phase;
+
+	if(prof == NULL){
+		return;
+	}
+
+	account(prof);
+	prof->phase = -1;
+
+	for(phase = 0; phase < PHASE_COUNT; phase++){
+		write_row(prof,"point",distributionNames[dist],processCount,modules,phase,&(prof->point[phase]));
+
+		for(counter = 0; counter < COUNTER_COUNT; counter++){
+			prof->session[phase].values[counter] += prof->point[phase].values[counter];
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "simulator.h"
+
+//Phases of a simulator cycle the profiler attributes counts to.
+typedef enum {
+	PhaseGeneration = 0,	//Drawing the next memory module a processor requests
+	PhaseConflict = 1,	//Checking whether a processor got its module, counting waits and queueing
+	PhaseArbitration = 2,	//Modules finishing their accesses and picking the next process
+	PhaseConvergence = 3,	//Computing the average wait time and the termination test
+	PHASE_COUNT = 4
+} simulatorPhase;
+
+//Counted quantities. Elapsed time always works; the hardware counters need perf_event_open
+//permission and a PMU, and are reported as empty when they could not be opened.
+typedef enum {
+	CounterNanos = 0,
+	CounterCycles = 1,
+	CounterInstructions = 2,
+	CounterBranchMisses = 3,
+	CounterLLCMisses = 4,
+	COUNTER_COUNT = 5
+} profileCounter;
+
+typedef struct phaseCounts {
+	unsigned long long values[COUNTER_COUNT];
+} phaseCounts;
+
+bool profiler_open(const char* path);
+void profiler_close(void);
+bool profiler_counter_available(profileCounter counter);
+void profiler_begin_point(void);
+void profiler_enter(simulatorPhase phase);
+void profiler_end_point(distribution dist,int processCount,int modules);
+
+#endif
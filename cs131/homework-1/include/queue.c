@@ -38,7 +38,7 @@ void push(node** front,int data){
 	node* temp = (*front);
 	
 	if(temp == NULL){
-		temp = newNode;
+		(*front) = newNode;
 	} else {
 		while(temp->next != NULL){
 			temp = temp->next;
@@ -0,0 +1,273 @@
+#include "reference_simulator.h"
+#include "rng.h"
+
+#include <math.h>
+#include <string.h>
+
+//Implementation in C of the reference simulator: the closed-loop semantics of run_simulator() written
+//as plainly as possible, as the oracle faster engines are checked against. Every module is scanned
+//on every cycle, queues are plain arrays, and there are no hooks, so it is slow but easy to audit.
+//It draws exactly the same random numbers in the same order as run_simulator(), so both produce the
+//same grants from the same seed; given per-block streams it draws what parallel_simulate() draws instead.
+//NUMA machines, open-loop arrivals and drifting means are not covered.
+
+//State of one reference simulation.
+typedef struct referenceState {
+	int processCount;
+	int moduleCount;
+	distribution dist;
+	double sigma;
+	double writeRatio;
+	threadRandom* streams;	//Stream of every block of (blockProcessors) processors (NULL to use the caller's)
+	int blockProcessors;
+
+	//Per processor
+	int* requests;	//Module the processor currently requests
+	int* waits;	//Cycles it has waited so far
+	int* ready;	//Cycle from which it may be granted again
+	bool* writes;	//Whether its current request is a write
+	bool* queued;	//Whether it waits in its module's queue
+	int* means;	//Mean of its Gaussian requests
+
+	//Per module
+	int* readLatency;
+	int* writeLatency;
+	bool* busy;
+	int* attached;	//Processor the module serves or was reserved for (-1 for none yet)
+	int* due;	//Cycle the module's current access completes at the end of (-1 for none)
+	int* queues;	//FIFO of waiting processors, (processCount) slots per module
+	int* heads;
+	int* lengths;
+} referenceState;
+
+//Add a grant to the log of (run).
+static void log_grant(referenceRun* run,int cycle,int processor,int module){
+	if(run->grantCount == run->grantCapacity){
+		run->grantCapacity = run->grantCapacity > 0 ? 2 * run->grantCapacity : 1024;
+		run->grants = (referenceGrant*) realloc(run->grants,run->grantCapacity * sizeof(referenceGrant));
+	}
+
+	run->grants[run->grantCount].cycle = cycle;
+	run->grants[run->grantCount].processor = processor;
+	run->grants[run->grantCount].module = module;
+	run->grantCount++;
+}
+
+//A uniform number in [0, range), drawn like uniformRange().
+static int draw_uniform(int range){
+	return (int) ((unsigned int) next_random() % range);
+}
+
+//The module of a new request of (processor). Gaussian requests draw two numbers (Box-Muller).
+static int draw_request(referenceState* state,int processor){
+	if(state->dist == Uniform){
+		return draw_uniform(state->moduleCount) % state->moduleCount;
+	}
+
+	double x = (double) next_random() / RAND_MAX;
+	double y = (double) next_random() / RAND_MAX;
+	double z = state->means[processor] + (sqrt(-2 * log(x)) * cos(2 * M_PI * y) * state->sigma);
+
+	return abs((int) z % state->moduleCount);
+}
+
+//Whether the new request is a write. Sessions without writes draw nothing.
+static bool draw_write(referenceState* state){
+	return state->writeRatio > 0.0 && ((double) next_random() / RAND_MAX) < state->writeRatio;
+}
+
+//Make the stream (processor) draws from the calling thread's.
+static void use_stream(referenceState* state,int processor){
+	if(state->streams != NULL){
+		switch_thread_random(&(state->streams[processor / state->blockProcessors]));
+	}
+}
+
+static int latency_of(referenceState* state,int processor,int module){
+	return state->writes[processor] ? state->writeLatency[module] : state->readLatency[module];
+}
+
+//The module's access completes at the end of (cycle): serve the next waiting processor or become free.
+static void complete(referenceState* state,int module,int cycle){
+	if(state->lengths[module] == 0){
+		state->busy[module] = false;
+		return;
+	}
+
+	int next = state->queues[module * state->processCount + state->heads[module]];
+	int latency = latency_of(state,next,module);
+
+	state->heads[module] = (state->heads[module] + 1) % state->processCount;
+	state->lengths[module]--;
+	state->queued[next] = false;
+
+	state->attached[module] = next;
+	state->ready[next] = cycle + latency;
+
+	if(state->lengths[module] == 0 && latency <= 1){
+		state->busy[module] = false;
+	} else {
+		state->due[module] = cycle + latency;
+	}
+}
+
+//Check whether the reference covers the configuration: a flat machine with closed-loop processors
+//and fixed Gaussian means.
+bool reference_supports(const simulatorConfig* config){
+	return config->nodeCount <= 1 && config->arrivals == ArrivalsClosed && config->driftEpoch == 0 && config->hotRegions == 0;
+}
+
+//Simulate (processCount) processors and (modules) memory modules and record every grant in (run). The requests
+//are drawn from the calling thread's current random stream position, or if (streams) is not NULL, from the
+//stream of each processor's block of (blockProcessors) processors.
+void reference_simulate(const simulatorConfig* config,distribution dist,int processCount,int modules,threadRandom* streams,int blockProcessors,
+	referenceRun* run){
+	threadRandom* previous = activeRandom;
+	referenceState state;
+	int i,p,m;
+
+	memset(run,0,sizeof(referenceRun));
+	memset(&state,0,sizeof(state));
+	state.processCount = processCount;
+	state.moduleCount = modules;
+	state.dist = dist;
+	state.sigma = gaussian_sigma(config->sigmaFraction,config->sigmaModules,modules);
+	state.writeRatio = config->writeRatio;
+	state.streams = streams;
+	state.blockProcessors = blockProcessors;
+
+	state.requests = (int*) calloc(processCount,sizeof(int));
+	state.waits = (int*) calloc(processCount,sizeof(int));
+	state.ready = (int*) calloc(processCount,sizeof(int));
+	state.writes = (bool*) calloc(processCount,sizeof(bool));
+	state.queued = (bool*) calloc(processCount,sizeof(bool));
+	state.means = (int*) calloc(processCount,sizeof(int));
+	state.readLatency = (int*) malloc(modules * sizeof(int));
+	state.writeLatency = (int*) malloc(modules * sizeof(int));
+	state.busy = (bool*) calloc(modules,sizeof(bool));
+	state.attached = (int*) malloc(modules * sizeof(int));
+	state.due = (int*) malloc(modules * sizeof(int));
+	state.queues = (int*) malloc((size_t) modules * processCount * sizeof(int));
+	state.heads = (int*) calloc(modules,sizeof(int));
+	state.lengths = (int*) calloc(modules,sizeof(int));
+
+	for(m = 0; m < modules; m++){
+		state.readLatency[m] = config->readLatency;
+		state.writeLatency[m] = config->writeLatency;
+		state.attached[m] = -1;
+		state.due[m] = -1;
+	}
+	for(i = 0; i < config->overrideCount; i++){
+		if(config->overrides[i].module < modules){
+			state.readLatency[config->overrides[i].module] = config->overrides[i].readLatency;
+			state.writeLatency[config->overrides[i].module] = config->overrides[i].writeLatency;
+		}
+	}
+
+	//The first requests do not occupy their modules; a Gaussian processor draws its mean first.
+	for(p = 0; p < processCount; p++){
+		use_stream(&state,p);
+		if(dist == Gaussian){
+			state.means[p] = draw_uniform(modules);
+		}
+		state.requests[p] = draw_request(&state,p);
+		state.writes[p] = draw_write(&state);
+	}
+
+	double past = -1.0,current = -1.0,change = 1.0;
+	int cycle = 1;
+
+	while(true){
+		cycle++;
+		past = current;
+
+		for(p = 0; p < processCount; p++){
+			int module = state.requests[p];
+
+			//A processor that stalled through a multi-cycle access is granted once it ends, whoever has the module by then.
+			bool finished = state.ready[p] == cycle && latency_of(&state,p,module) > 1;
+
+			if(state.ready[p] > cycle){
+				state.waits[p]++;
+			} else if(finished || !state.busy[module] || state.attached[module] == -1 || state.attached[module] == p){
+				log_grant(run,cycle,p,module);
+
+				use_stream(&state,p);
+				module = draw_request(&state,p);
+				state.requests[p] = module;
+				state.writes[p] = draw_write(&state);
+
+				//A new request reserves its module right away, even one that is still serving another access. The
+				//access ends with the cycle (latency - 1) cycles later, and the processor is granted on the next one.
+				int latency = latency_of(&state,p,module);
+				state.attached[module] = p;
+				state.busy[module] = true;
+				state.ready[p] = cycle + latency;
+				if(state.due[module] < 0){
+					state.due[module] = cycle + latency - 1;
+				}
+			} else {
+				state.waits[p]++;
+				if(!state.queued[p]){
+					state.queues[module * processCount + (state.heads[module] + state.lengths[module]) % processCount] = p;
+					state.lengths[module]++;
+					state.queued[p] = true;
+				}
+			}
+		}
+
+		for(m = 0; m < modules; m++){
+			if(state.due[m] == cycle){
+				state.due[m] = -1;
+				complete(&state,m,cycle);
+			}
+		}
+
+		//The mean of every processor's waiting share, summed in processor order like getAverageWaitTime().
+		current = 0.0;
+		for(p = 0; p < processCount; p++){
+			current += (double) state.waits[p] / cycle;
+		}
+		current /= processCount;
+
+		if(past >= 0){
+			past = past == 0 ? 0.1 : past;
+			current = current == 0 ? 0.1 : current;
+			change = fabs(1.0 - (current / past));
+		}
+
+		if(change < CONVERGENCE_THRESHOLD){
+			break;
+		}
+	}
+
+	run->cycles = cycle;
+	run->waitTime = 0.0;
+	for(p = 0; p < processCount; p++){
+		run->waitTime += (double) state.waits[p] / cycle;
+	}
+	run->waitTime /= processCount;
+	switch_thread_random(previous);
+
+	free(state.requests);
+	free(state.waits);
+	free(state.ready);
+	free(state.writes);
+	free(state.queued);
+	free(state.means);
+	free(state.readLatency);
+	free(state.writeLatency);
+	free(state.busy);
+	free(state.attached);
+	free(state.due);
+	free(state.queues);
+	free(state.heads);
+	free(state.lengths);
+}
+
+void free_reference_run(referenceRun* run){
+	free(run->grants);
+	run->grants = NULL;
+	run->grantCount = 0;
+	run->grantCapacity = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef REFERENCE_SIMULATOR_H
+#define REFERENCE_SIMULATOR_H
+
+#include "simulator.h"
+#include "rng.h"
+
+//One grant of the reference simulation: processor (processor) got module (module) on cycle (cycle).
+typedef struct referenceGrant {
+	int cycle;
+	int processor;
+	int module;
+} referenceGrant;
+
+//Outcome of a reference simulation.
+typedef struct referenceRun {
+	referenceGrant* grants;	//Every grant, in the order the simulation makes them
+	long grantCount;
+	long grantCapacity;
+	int cycles;
+	double waitTime;
+} referenceRun;
+
+bool reference_supports(const simulatorConfig* config);
+void reference_simulate(const simulatorConfig* config,distribution dist,int processCount,int modules,threadRandom* streams,int blockProcessors,
+	referenceRun* run);
+void free_reference_run(referenceRun* run);
+
+#endif
@@ -0,0 +1,460 @@
+#include "result_cache.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//Implementation in C of a persistent cache of sweep point results, shared by every session using
+//the same directory. Results are appended to a log and found through a memory-mapped hash index.
+//Processes coordinate with flock() on the index file and threads of one process with a mutex.
+
+#define CACHE_PATH_LENGTH 4096
+
+typedef struct resultCache {
+	char logPath[CACHE_PATH_LENGTH];
+	char indexPath[CACHE_PATH_LENGTH];
+
+	pid_t owner;	//Process the descriptors below were opened by
+	int logFd;
+	int indexFd;
+	cacheIndexHeader* index;	//Mapping of the index file (NULL when not mapped)
+	size_t mappedBytes;
+
+	long hits;
+	long misses;
+	pthread_mutex_t lock;
+} resultCache;
+
+static resultCache* activeCache = NULL;
+
+//FNV-1a hash of (length) bytes, continuing from (hash).
+static uint64_t hash_bytes(uint64_t hash,const void* data,size_t length){
+	const unsigned char* bytes = (const unsigned char*) data;
+	size_t i;
+
+	for(i = 0; i < length; i++){
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+//Describe everything the result of a point depends on.
+static void make_key(cacheKey* key,const simulatorConfig* config,distribution dist,int processCount,int modules){
+	int i;
+
+	memset(key,0,sizeof(cacheKey));
+	key->modelVersion = SIMULATOR_MODEL_VERSION;
+	key->dist = (int32_t) dist;
+	key->processCount = processCount;
+	key->moduleCount = modules;
+	key->seed = config->seed;
+	key->readLatency = config->readLatency;
+	key->writeLatency = config->writeLatency;
+	key->nodeCount = config->nodeCount;
+	key->remoteLatency = config->remoteLatency;
+	key->linkBandwidth = config->linkBandwidth;
+	key->overrideCount = config->overrideCount;
+	key->writeRatio = config->writeRatio;
+	key->localRatio = config->localRatio;
+	key->arrivals = config->arrivals;
+	key->arrivalRate = config->arrivalRate;
+	key->burstCycles = config->burstCycles;
+	key->idleCycles = config->idleCycles;
+	key->thinkCycles = config->thinkCycles;
+	key->outstandingLimit = config->outstandingLimit;
+	key->sigmaDivisor = GAUSSIAN_SIGMA_DIVISOR;
+	key->sigmaFraction = config->sigmaFraction;
+	key->sigmaModules = config->sigmaModules;
+	key->driftDistance = config->driftDistance;
+	key->driftEpoch = config->driftEpoch;
+	key->hotRegions = config->hotRegions;
+	key->convergenceThreshold = CONVERGENCE_THRESHOLD;
+	key->varianceReduction = config->varianceReduction;
+	key->varianceCycles = config->varianceReduction != VarianceNone ? config->varianceCycles : 0;
+	key->modulePorts = config->modulePorts;
+	key->moduleLines = config->moduleLines;
+	key->coalesceReads = config->coalesceReads ? 1 : 0;
+	key->cacheSets = config->cacheSets;
+	key->cacheWays = config->cacheWays;
+	key->writeBuffer = config->writeBuffer;
+	key->patternHash = config->patterns.hash;
+
+	key->overrideHash = 14695981039346656037ULL;
+	for(i = 0; i < config->overrideCount; i++){
+		key->overrideHash = hash_bytes(key->overrideHash,&(config->overrides[i]),sizeof(moduleLatency));
+	}
+}
+
+//Checksum protecting a record against torn appends.
+static uint64_t record_checksum(const cacheRecord* record){
+	return hash_bytes(14695981039346656037ULL,record,offsetof(cacheRecord,checksum));
+}
+
+//Map the index file at its current size.
+static bool map_index(resultCache* cache){
+	struct stat info;
+
+	if(cache->index != NULL){
+		munmap(cache->index,cache->mappedBytes);
+		cache->index = NULL;
+	}
+
+	if(fstat(cache->indexFd,&info) < 0 || info.st_size < (off_t) sizeof(cacheIndexHeader)){
+		return false;
+	}
+
+	void* mapping = mmap(NULL,info.st_size,PROT_READ | PROT_WRITE,MAP_SHARED,cache->indexFd,0);
+	if(mapping == MAP_FAILED){
+		return false;
+	}
+
+	cache->index = (cacheIndexHeader*) mapping;
+	cache->mappedBytes = info.st_size;
+	return true;
+}
+
+//Slots following the header of the mapped index.
+static cacheSlot* index_slots(resultCache* cache){
+	return (cacheSlot*) (cache->index + 1);
+}
+
+//Resize the index file to (capacity) empty slots covering none of the log. Needs the exclusive lock.
+static bool reset_index(resultCache* cache,uint64_t capacity){
+	size_t bytes = sizeof(cacheIndexHeader) + capacity * sizeof(cacheSlot);
+
+	if(ftruncate(cache->indexFd,0) < 0 || ftruncate(cache->indexFd,bytes) < 0 || !map_index(cache)){
+		return false;
+	}
+
+	cache->index->version = CACHE_VERSION;
+	cache->index->capacity = capacity;
+	cache->index->count = 0;
+	cache->index->indexedBytes = 0;
+	cache->index->magic = CACHE_MAGIC;
+	return true;
+}
+
+//Make sure the mapping matches the index file, which another process may have grown or rebuilt.
+//Returns false if the index is unusable and has to be rebuilt.
+static bool refresh_index(resultCache* cache){
+	if(cache->index == NULL || cache->index->magic != CACHE_MAGIC ||
+		sizeof(cacheIndexHeader) + cache->index->capacity * sizeof(cacheSlot) != cache->mappedBytes){
+		if(!map_index(cache)){
+			return false;
+		}
+	}
+
+	return cache->index->magic == CACHE_MAGIC && cache->index->version == CACHE_VERSION &&
+		sizeof(cacheIndexHeader) + cache->index->capacity * sizeof(cacheSlot) == cache->mappedBytes;
+}
+
+//Find the slot of (hash) with a record whose key equals (key), or the empty slot ending its probe sequence.
+//The matching record is read into (record) when it is found.
+static cacheSlot* find_slot(resultCache* cache,uint64_t hash,const cacheKey* key,cacheRecord* record,bool* found){
+	cacheSlot* slots = index_slots(cache);
+	uint64_t mask = cache->index->capacity - 1;
+	uint64_t position = hash & mask;
+
+	*found = false;
+
+	while(slots[position].offset != 0){
+		if(slots[position].hash == hash &&
+			pread(cache->logFd,record,sizeof(cacheRecord),slots[position].offset - 1) == sizeof(cacheRecord) &&
+			memcmp(&(record->key),key,sizeof(cacheKey)) == 0){
+			*found = true;
+			break;
+		}
+		position = (position + 1) & mask;
+	}
+
+	return &(slots[position]);
+}
+
+//Add the record at (offset) of the log to the index. Needs the exclusive lock.
+static void insert_slot(resultCache* cache,uint64_t hash,uint64_t offset){
+	cacheSlot* slots = index_slots(cache);
+	uint64_t mask = cache->index->capacity - 1;
+	uint64_t position = hash & mask;
+
+	while(slots[position].offset != 0){
+		position = (position + 1) & mask;
+	}
+
+	slots[position].hash = hash;
+	slots[position].offset = offset + 1;
+	cache->index->count++;
+}
+
+//Double the index once it is half full. Needs the exclusive lock.
+static bool grow_index(resultCache* cache){
+	uint64_t capacity = cache->index->capacity;
+	uint64_t indexedBytes = cache->index->indexedBytes;
+	cacheSlot* saved = (cacheSlot*) malloc(capacity * sizeof(cacheSlot));
+	uint64_t i;
+
+	memcpy(saved,index_slots(cache),capacity * sizeof(cacheSlot));
+
+	if(!reset_index(cache,capacity * 2)){
+		free(saved);
+		return false;
+	}
+
+	for(i = 0; i < capacity; i++){
+		if(saved[i].offset != 0){
+			insert_slot(cache,saved[i].hash,saved[i].offset - 1);
+		}
+	}
+
+	cache->index->indexedBytes = indexedBytes;
+	free(saved);
+	return true;
+}
+
+//Move a log written by cache version (version) aside to "results.log.v<version>" and start a new, empty one,
+//so that the session runs as with a cold cache. Needs the exclusive lock.
+static bool rotate_log(resultCache* cache,uint32_t version){
+	char oldPath[CACHE_PATH_LENGTH + 16];
+
+	snprintf(oldPath,sizeof(oldPath),"%s.v%u",cache->logPath,version);
+	if(rename(cache->logPath,oldPath) < 0){
+		return false;
+	}
+	fprintf(stderr,"Cache log %s was written by cache version %u; moved it to %s\n",cache->logPath,version,oldPath);
+
+	close(cache->logFd);
+	cache->logFd = open(cache->logPath,O_RDWR | O_CREAT | O_APPEND,0644);
+
+	return cache->logFd >= 0 && reset_index(cache,CACHE_INITIAL_SLOTS);
+}
+
+//Index the records other processes appended since the index was last updated, and cut off
+//a torn record left by a writer that crashed. Needs the exclusive lock.
+static bool catch_up(resultCache* cache){
+	struct stat info;
+	cacheRecord record;
+
+	if(!refresh_index(cache) && !reset_index(cache,CACHE_INITIAL_SLOTS)){
+		return false;
+	}
+
+	if(fstat(cache->logFd,&info) < 0){
+		return false;
+	}
+
+	uint64_t offset = cache->index->indexedBytes;
+	while(offset + sizeof(cacheRecord) <= (uint64_t) info.st_size){
+		if(pread(cache->logFd,&record,sizeof(record),offset) != sizeof(record)){
+			return false;
+		}
+
+		//None of the records of a log written by another version of the cache can be used.
+		if(record.magic == CACHE_MAGIC && record.version != CACHE_VERSION){
+			return rotate_log(cache,record.version);
+		}
+
+		if(record.magic != CACHE_MAGIC || record.checksum != record_checksum(&record)){
+			break;
+		}
+
+		if((cache->index->count + 1) * 2 > cache->index->capacity && !grow_index(cache)){
+			return false;
+		}
+
+		insert_slot(cache,record.hash,offset);
+		offset += sizeof(cacheRecord);
+		cache->index->indexedBytes = offset;
+	}
+
+	if(offset < (uint64_t) info.st_size && ftruncate(cache->logFd,offset) < 0){
+		return false;
+	}
+
+	return true;
+}
+
+//Open the cache files of the calling process. A forked worker shares its parent's descriptors,
+//and flock() does not exclude processes sharing one, so every process opens its own.
+static bool attach(resultCache* cache){
+	if(cache->owner == getpid()){
+		return true;
+	}
+
+	if(cache->index != NULL){
+		munmap(cache->index,cache->mappedBytes);
+		cache->index = NULL;
+	}
+	if(cache->logFd >= 0){
+		close(cache->logFd);
+	}
+	if(cache->indexFd >= 0){
+		close(cache->indexFd);
+	}
+
+	cache->logFd = open(cache->logPath,O_RDWR | O_CREAT | O_APPEND,0644);
+	cache->indexFd = open(cache->indexPath,O_RDWR | O_CREAT,0644);
+	cache->owner = getpid();
+
+	return cache->logFd >= 0 && cache->indexFd >= 0;
+}
+
+//Take the cache for the calling thread: the mutex, then the file lock of the given kind.
+static bool lock_cache(resultCache* cache,int operation){
+	pthread_mutex_lock(&(cache->lock));
+
+	if(!attach(cache) || flock(cache->indexFd,operation) < 0){
+		pthread_mutex_unlock(&(cache->lock));
+		return false;
+	}
+
+	return true;
+}
+
+static void unlock_cache(resultCache* cache){
+	flock(cache->indexFd,LOCK_UN);
+	pthread_mutex_unlock(&(cache->lock));
+}
+
+//Use the cache stored in (directory), creating it if needed. Only sessions with per-point seeds
+//are cached, since other points depend on the random numbers used before them.
+//Returns false if the cache files could not be created.
+bool cache_open(const char* directory){
+	resultCache* cache = (resultCache*) calloc(1,sizeof(resultCache));
+
+	mkdir(directory,0755);
+	snprintf(cache->logPath,CACHE_PATH_LENGTH,"%s/results.log",directory);
+	snprintf(cache->indexPath,CACHE_PATH_LENGTH,"%s/results.idx",directory);
+	cache->logFd = -1;
+	cache->indexFd = -1;
+	cache->owner = 0;
+	pthread_mutex_init(&(cache->lock),NULL);
+
+	//Bring the index up to date with the log (or build it) once at the start.
+	bool ready = lock_cache(cache,LOCK_EX);
+	if(ready){
+		ready = catch_up(cache);
+		unlock_cache(cache);
+	}
+
+	if(!ready){
+		if(cache->index != NULL){
+			munmap(cache->index,cache->mappedBytes);
+		}
+		if(cache->logFd >= 0){
+			close(cache->logFd);
+		}
+		if(cache->indexFd >= 0){
+			close(cache->indexFd);
+		}
+		pthread_mutex_destroy(&(cache->lock));
+		free(cache);
+		return false;
+	}
+
+	activeCache = cache;
+	return true;
+}
+
+//Stop using the cache. Everything stored is already in the files.
+void cache_close(void){
+	resultCache* cache = activeCache;
+
+	if(cache == NULL){
+		return;
+	}
+
+	if(cache->index != NULL){
+		munmap(cache->index,cache->mappedBytes);
+	}
+	close(cache->logFd);
+	close(cache->indexFd);
+	pthread_mutex_destroy(&(cache->lock));
+	free(cache);
+	activeCache = NULL;
+}
+
+//Look a point up in the cache. Returns true and fills (result) if it was computed before.
+bool cache_lookup(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* result){
+	resultCache* cache = activeCache;
+	cacheKey key;
+	cacheRecord record;
+	bool found = false;
+
+	if(cache == NULL || !config->seedPerPoint){
+		return false;
+	}
+
+	make_key(&key,config,dist,processCount,modules);
+	uint64_t hash = hash_bytes(14695981039346656037ULL,&key,sizeof(key));
+
+	if(!lock_cache(cache,LOCK_SH)){
+		return false;
+	}
+
+	//Records appended since the index was last caught up are found by the next store instead.
+	if(refresh_index(cache)){
+		find_slot(cache,hash,&key,&record,&found);
+	}
+
+	if(found){
+		*result = record.result;
+		cache->hits++;
+	} else {
+		cache->misses++;
+	}
+
+	unlock_cache(cache);
+	return found;
+}
+
+//Append the result of a point to the cache unless another writer stored it first.
+void cache_store(const simulatorConfig* config,distribution dist,int processCount,int modules,const simulationResult* result){
+	resultCache* cache = activeCache;
+	cacheRecord record,existing;
+	bool found;
+
+	if(cache == NULL || !config->seedPerPoint){
+		return;
+	}
+
+	memset(&record,0,sizeof(record));
+	record.magic = CACHE_MAGIC;
+	record.version = CACHE_VERSION;
+	make_key(&(record.key),config,dist,processCount,modules);
+	record.hash = hash_bytes(14695981039346656037ULL,&(record.key),sizeof(cacheKey));
+	memcpy(&(record.result),result,sizeof(simulationResult));
+	record.checksum = record_checksum(&record);
+
+	if(!lock_cache(cache,LOCK_EX)){
+		return;
+	}
+
+	if(catch_up(cache)){
+		find_slot(cache,record.hash,&(record.key),&existing,&found);
+
+		//The log is fully indexed, so its end is where the record goes.
+		if(!found && ((cache->index->count + 1) * 2 <= cache->index->capacity || grow_index(cache))){
+			uint64_t offset = cache->index->indexedBytes;
+
+			if(write(cache->logFd,&record,sizeof(record)) == sizeof(record)){
+				insert_slot(cache,record.hash,offset);
+				cache->index->indexedBytes = offset + sizeof(record);
+			}
+		}
+	}
+
+	unlock_cache(cache);
+}
+
+//Points of this process answered by the cache and points that had to be simulated.
+void cache_counts(long* hits,long* misses){
+	*hits = activeCache != NULL ? activeCache->hits : 0;
+	*misses = activeCache != NULL ? activeCache->misses : 0;
+}
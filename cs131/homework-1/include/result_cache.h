@@ -0,0 +1,84 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "simulator.h"
+
+#define CACHE_MAGIC 0x4843534dU	//"MSCH"
+#define CACHE_VERSION 11
+#define CACHE_INITIAL_SLOTS 4096	//Slots of a new index; it doubles whenever it is half full
+
+//Everything a point's result depends on. Two points with equal keys have equal results.
+typedef struct cacheKey {
+	uint32_t modelVersion;	//SIMULATOR_MODEL_VERSION of the engine that computed the result
+	int32_t dist;
+	int32_t processCount;
+	int32_t moduleCount;
+	int32_t seed;	//Session seed the point's own seed is derived from
+	int32_t readLatency;
+	int32_t writeLatency;
+	int32_t nodeCount;
+	int32_t remoteLatency;
+	int32_t linkBandwidth;
+	int32_t overrideCount;
+	int32_t arrivals;
+	uint64_t overrideHash;	//Hash of the per-module latency overrides, in order
+	double writeRatio;
+	double localRatio;
+	double arrivalRate;
+	int32_t burstCycles;
+	int32_t idleCycles;
+	int32_t thinkCycles;
+	int32_t outstandingLimit;
+	double sigmaDivisor;
+	double sigmaFraction;
+	double sigmaModules;
+	double driftDistance;
+	int32_t driftEpoch;
+	int32_t hotRegions;
+	double convergenceThreshold;
+	int32_t varianceReduction;
+	int32_t varianceCycles;
+	int32_t modulePorts;
+	int32_t moduleLines;
+	int32_t coalesceReads;
+	int32_t cacheSets;
+	int32_t cacheWays;
+	int32_t writeBuffer;
+	uint32_t patternHash;
+} cacheKey;
+
+//One entry of the append-only log. The log alone holds the cache; the index can always be rebuilt from it.
+typedef struct cacheRecord {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t hash;	//Hash of (key)
+	cacheKey key;
+	simulationResult result;
+	uint64_t checksum;	//Hash of all the bytes above, to detect a record torn by a crash
+} cacheRecord;
+
+//Slot of the index: (offset) is 1 + the record's position in the log, 0 for an empty slot.
+typedef struct cacheSlot {
+	uint64_t hash;
+	uint64_t offset;
+} cacheSlot;
+
+//Start of the memory-mapped index file, followed by (capacity) slots.
+typedef struct cacheIndexHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t capacity;
+	uint64_t count;
+	uint64_t indexedBytes;	//Length of the log prefix the index covers
+} cacheIndexHeader;
+
+bool cache_open(const char* directory);
+void cache_close(void);
+bool cache_lookup(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* result);
+void cache_store(const simulatorConfig* config,distribution dist,int processCount,int modules,const simulationResult* result);
+void cache_counts(long* hits,long* misses);
+
+#endif
@@ -0,0 +1,89 @@
+#include "result_ring.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+//Implementation in C of a lock-free result ring shared between forked worker processes and the coordinator.
+
+//Size of the shared mapping holding a ring of (capacity) slots.
+static size_t ring_bytes(long capacity){
+	return sizeof(resultRing) + capacity * sizeof(ringSlot);
+}
+
+//Create a ring in an anonymous shared mapping. The ring must be created before the workers
+//are forked so that every process maps the same pages. (capacity) is rounded up to a power of two.
+resultRing* create_result_ring(long capacity){
+	long size = 2;
+	long i;
+
+	while(size < capacity){
+		size <<= 1;
+	}
+
+	resultRing* ring = (resultRing*) mmap(NULL,ring_bytes(size),PROT_READ | PROT_WRITE,MAP_SHARED | MAP_ANONYMOUS,-1,0);
+	if(ring == MAP_FAILED){
+		return NULL;
+	}
+
+	atomic_init(&(ring->tail),0);
+	ring->head = 0;
+	ring->capacity = size;
+
+	//Slot (i) is free for the producer that claims position (i).
+	for(i = 0; i < size; i++){
+		atomic_init(&(ring->slots[i].sequence),i);
+	}
+
+	return ring;
+}
+
+//Publish a record. Called concurrently by any number of worker processes.
+//When the ring is full the producer yields until the coordinator has drained a slot.
+void ring_push(resultRing* ring,const ringRecord* record){
+	long position = atomic_load_explicit(&(ring->tail),memory_order_relaxed);
+
+	while(true){
+		ringSlot* slot = &(ring->slots[position & (ring->capacity - 1)]);
+		long sequence = atomic_load_explicit(&(slot->sequence),memory_order_acquire);
+
+		if(sequence == position){
+			//The slot is free for this position: try to claim it.
+			if(atomic_compare_exchange_weak_explicit(&(ring->tail),&position,position + 1,memory_order_relaxed,memory_order_relaxed)){
+				slot->record = *record;
+				atomic_store_explicit(&(slot->sequence),position + 1,memory_order_release);
+				return;
+			}
+		} else if(sequence < position){
+			//The consumer has not freed this slot yet: the ring is full.
+			sched_yield();
+			position = atomic_load_explicit(&(ring->tail),memory_order_relaxed);
+		} else {
+			//Another producer claimed the position first.
+			position = atomic_load_explicit(&(ring->tail),memory_order_relaxed);
+		}
+	}
+}
+
+//Take the oldest published record out of the ring. Only the coordinator calls this.
+//Returns false when no complete record is available.
+bool ring_pop(resultRing* ring,ringRecord* record){
+	ringSlot* slot = &(ring->slots[ring->head & (ring->capacity - 1)]);
+	long sequence = atomic_load_explicit(&(slot->sequence),memory_order_acquire);
+
+	if(sequence != ring->head + 1){
+		return false;
+	}
+
+	*record = slot->record;
+
+	//Hand the slot to the producer that will claim it one lap later.
+	atomic_store_explicit(&(slot->sequence),ring->head + ring->capacity,memory_order_release);
+	ring->head++;
+
+	return true;
+}
+
+//Unmap the ring.
+void destroy_result_ring(resultRing* ring){
+	munmap(ring,ring_bytes(ring->capacity));
+}
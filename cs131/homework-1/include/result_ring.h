@@ -0,0 +1,37 @@
+#ifndef RESULT_RING_H
+#define RESULT_RING_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "simulator.h"
+
+//One finished sweep point as it travels from a worker process to the coordinator.
+typedef struct ringRecord {
+	int point;	//Index of the point in the session's grid
+	int worker;
+	simulationResult result;
+} ringRecord;
+
+typedef struct ringSlot {
+	atomic_long sequence;	//Position the slot is ready for (written last by a producer, read first by the consumer)
+	ringRecord record;
+} ringSlot;
+
+//Bounded lock-free multi-producer single-consumer ring living in a shared memory mapping.
+//Producers claim positions with a compare-and-swap on (tail); each slot's sequence number
+//tells the consumer when the record in it has been completely written.
+typedef struct resultRing {
+	atomic_long tail;	//Next position handed to a producer
+	long head;	//Next position read by the consumer (only touched by the consumer)
+	long capacity;	//Power of two
+	ringSlot slots[];
+} resultRing;
+
+resultRing* create_result_ring(long capacity);
+void ring_push(resultRing* ring,const ringRecord* record);
+bool ring_pop(resultRing* ring,ringRecord* record);
+void destroy_result_ring(resultRing* ring);
+
+#endif
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE	//O_DIRECT
+#include "result_writer.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+//Implementation in C of the log writer thread. Rows are copied into batches on the producer's side;
+//the writer thread gathers the pending batches of a stream into one writev(), so a whole sweep is
+//written with a few large system calls off the thread that simulates.
+
+//Take a batch to fill, reusing a written one when there is one.
+static writerBatch* take_batch(resultWriter* writer,int stream){
+	writerBatch* batch;
+
+	pthread_mutex_lock(&(writer->lock));
+	batch = writer->spare;
+	if(batch != NULL){
+		writer->spare = batch->next;
+	}
+	pthread_mutex_unlock(&(writer->lock));
+
+	if(batch == NULL){
+		batch = (writerBatch*) malloc(sizeof(writerBatch));
+		if(batch == NULL){
+			return NULL;
+		}
+		if(posix_memalign((void**) &(batch->data),WRITER_ALIGNMENT,WRITER_BATCH_BYTES) != 0){
+			free(batch);
+			return NULL;
+		}
+	}
+
+	batch->next = NULL;
+	batch->stream = stream;
+	batch->length = 0;
+	return batch;
+}
+
+//Hand a batch over to the writer thread. Batches are numbered in the order they are handed over.
+static void hand_over(resultWriter* writer,writerBatch* batch){
+	batch->sequence = writer->nextSequence++;
+
+	pthread_mutex_lock(&(writer->lock));
+	if(writer->pendingTail == NULL){
+		writer->pendingHead = batch;
+	} else {
+		writer->pendingTail->next = batch;
+	}
+	writer->pendingTail = batch;
+	pthread_cond_signal(&(writer->pending));
+	pthread_mutex_unlock(&(writer->lock));
+}
+
+//Write (count) buffers to (fd), continuing after short writes.
+static bool write_all(int fd,struct iovec* vectors,int count){
+	while(count > 0){
+		ssize_t done = writev(fd,vectors,count);
+
+		if(done < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			return false;
+		}
+
+		while(count > 0 && (size_t) done >= vectors->iov_len){
+			done -= vectors->iov_len;
+			vectors++;
+			count--;
+		}
+		if(count > 0){
+			vectors->iov_base = (char*) vectors->iov_base + done;
+			vectors->iov_len -= done;
+		}
+	}
+
+	return true;
+}
+
+//Write a run of batches of one stream, in sequence order, with as few writev() calls as possible.
+//Returns the first batch of the list that was not written.
+static writerBatch* write_run(resultWriter* writer,writerBatch* batch){
+	struct iovec vectors[WRITER_MAX_IOVECS];
+	int stream = batch->stream;
+	int count = 0;
+
+	while(batch != NULL && batch->stream == stream && count < WRITER_MAX_IOVECS){
+		//O_DIRECT only takes whole blocks; the last, partial batch of a stream is written through the page cache.
+		if(writer->direct[stream] && batch->length % WRITER_ALIGNMENT != 0){
+			if(count > 0){
+				break;
+			}
+			fcntl(writer->fds[stream],F_SETFL,fcntl(writer->fds[stream],F_GETFL) & ~O_DIRECT);
+			writer->direct[stream] = false;
+		}
+
+		if(batch->sequence != writer->written){
+			writer->failed = true;
+		}
+		writer->written++;
+
+		vectors[count].iov_base = batch->data;
+		vectors[count].iov_len = batch->length;
+		count++;
+		batch = batch->next;
+	}
+
+	if(!write_all(writer->fds[stream],vectors,count) ||
+		(writer->sync == WriterSyncData && fdatasync(writer->fds[stream]) != 0)){
+		writer->failed = true;
+	}
+
+	return batch;
+}
+
+//Body of the writer thread: write whatever is pending until the writer is closed and drained.
+static void* writer_main(void* argument){
+	resultWriter* writer = (resultWriter*) argument;
+
+	pthread_mutex_lock(&(writer->lock));
+	while(true){
+		while(writer->pendingHead == NULL && !writer->closing){
+			pthread_cond_wait(&(writer->pending),&(writer->lock));
+		}
+
+		writerBatch* batches = writer->pendingHead;
+		writer->pendingHead = NULL;
+		writer->pendingTail = NULL;
+		if(batches == NULL){
+			break;
+		}
+		pthread_mutex_unlock(&(writer->lock));
+
+		writerBatch* batch = batches;
+		while(batch != NULL){
+			batch = write_run(writer,batch);
+		}
+
+		//Return the written batches for the producer to fill again.
+		pthread_mutex_lock(&(writer->lock));
+		for(batch = batches; batch->next != NULL; batch = batch->next);
+		batch->next = writer->spare;
+		writer->spare = batches;
+	}
+	pthread_mutex_unlock(&(writer->lock));
+
+	return NULL;
+}
+
+//Create or truncate the files at (paths) and start the thread writing them.
+//Returns false if a file could not be opened or the thread could not be started.
+bool writer_open(resultWriter* writer,const char** paths,int streamCount,writerSync sync){
+	int i;
+
+	memset(writer,0,sizeof(resultWriter));
+	writer->streamCount = streamCount;
+	writer->sync = sync;
+
+	pthread_mutex_init(&(writer->lock),NULL);
+	pthread_cond_init(&(writer->pending),NULL);
+
+	for(i = 0; i < streamCount; i++){
+		writer->fds[i] = -1;
+	}
+
+	for(i = 0; i < streamCount; i++){
+		if(sync == WriterSyncDirect){
+			writer->fds[i] = open(paths[i],O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT,0644);
+			writer->direct[i] = writer->fds[i] >= 0;
+		}
+		//Some file systems (tmpfs for one) refuse O_DIRECT.
+		if(writer->fds[i] < 0){
+			writer->fds[i] = open(paths[i],O_WRONLY | O_CREAT | O_TRUNC,0644);
+		}
+		writer->filling[i] = writer->fds[i] >= 0 ? take_batch(writer,i) : NULL;
+		if(writer->filling[i] == NULL){
+			writer->exhausted = true;
+		}
+	}
+
+	if(writer->exhausted || pthread_create(&(writer->thread),NULL,writer_main,writer) != 0){
+		for(i = 0; i < streamCount; i++){
+			free(writer->filling[i] != NULL ? writer->filling[i]->data : NULL);
+			free(writer->filling[i]);
+			if(writer->fds[i] >= 0){
+				close(writer->fds[i]);
+			}
+		}
+		pthread_mutex_destroy(&(writer->lock));
+		pthread_cond_destroy(&(writer->pending));
+		return false;
+	}
+
+	return true;
+}
+
+//Append (length) bytes of (text) to stream (stream). Only copies; the writer thread does the I/O.
+void writer_put(resultWriter* writer,int stream,const char* text,size_t length){
+	while(length > 0){
+		writerBatch* batch = writer->filling[stream];
+		size_t room = WRITER_BATCH_BYTES - batch->length;
+		size_t part = length < room ? length : room;
+
+		memcpy(batch->data + batch->length,text,part);
+		batch->length += part;
+		text += part;
+		length -= part;
+
+		//Batches are handed over only when completely full, so that O_DIRECT can write them as they are.
+		if(batch->length == WRITER_BATCH_BYTES){
+			writerBatch* next = take_batch(writer,stream);
+
+			if(next == NULL){
+				writer->exhausted = true;
+				batch->length = 0;
+				return;
+			}
+			hand_over(writer,batch);
+			writer->filling[stream] = next;
+		}
+	}
+}
+
+//Hand over the partly filled batches, wait for the writer thread to write everything and close the files.
+//Returns false if anything could not be written.
+bool writer_close(resultWriter* writer){
+	bool written;
+	int i;
+
+	for(i = 0; i < writer->streamCount; i++){
+		if(writer->filling[i]->length > 0){
+			hand_over(writer,writer->filling[i]);
+		} else {
+			free(writer->filling[i]->data);
+			free(writer->filling[i]);
+		}
+		writer->filling[i] = NULL;
+	}
+
+	pthread_mutex_lock(&(writer->lock));
+	writer->closing = true;
+	pthread_cond_signal(&(writer->pending));
+	pthread_mutex_unlock(&(writer->lock));
+	pthread_join(writer->thread,NULL);
+
+	written = !writer->failed && !writer->exhausted;
+	for(i = 0; i < writer->streamCount; i++){
+		if((writer->sync != WriterSyncNone && fdatasync(writer->fds[i]) != 0) || close(writer->fds[i]) != 0){
+			written = false;
+		}
+	}
+
+	while(writer->spare != NULL){
+		writerBatch* batch = writer->spare;
+		writer->spare = batch->next;
+		free(batch->data);
+		free(batch);
+	}
+
+	pthread_mutex_destroy(&(writer->lock));
+	pthread_cond_destroy(&(writer->pending));
+
+	return written;
+}
@@ -0,0 +1,59 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define WRITER_BATCH_BYTES 65536	//Rows are handed to the writer thread in batches of this size
+#define WRITER_ALIGNMENT 4096	//Alignment of batch buffers, so that full batches can be written with O_DIRECT
+#define WRITER_MAX_STREAMS 2	//Files one writer serves (the uniform and gaussian logs)
+#define WRITER_MAX_IOVECS 64	//Batches gathered into a single writev()
+
+//How hard the writer thread pushes the logs to the disk.
+typedef enum {
+	WriterSyncNone = 0,	//Leave the data in the page cache
+	WriterSyncData = 1,	//fdatasync() after every writev(), so a crashed session keeps its finished points
+	WriterSyncDirect = 2	//O_DIRECT: full batches bypass the page cache (falls back to buffered writes where unsupported)
+} writerSync;
+
+//Fixed-size piece of one stream's output.
+typedef struct writerBatch {
+	struct writerBatch* next;
+	long sequence;	//Order the batch was handed over in; the writer thread writes batches in this order
+	int stream;
+	size_t length;
+	char* data;	//WRITER_BATCH_BYTES bytes aligned to WRITER_ALIGNMENT
+} writerBatch;
+
+//Writer thread draining the log files of a session.
+//The producer (the thread running the sweep) fills one batch per stream. Full batches move to the
+//pending list and the writer thread recycles them once written. Steady state this double buffers
+//every stream. When the writer falls behind, the producer allocates another batch rather than waiting,
+//so it never blocks on I/O.
+typedef struct resultWriter {
+	int fds[WRITER_MAX_STREAMS];
+	bool direct[WRITER_MAX_STREAMS];	//Whether the file was opened with O_DIRECT
+	int streamCount;
+	writerSync sync;
+
+	writerBatch* filling[WRITER_MAX_STREAMS];	//Batch each stream appends to (producer only)
+	long nextSequence;	//Sequence of the next batch handed over (producer only)
+	bool exhausted;	//A file could not be opened or a batch allocated; rows were lost (producer only)
+	long written;	//Sequence of the next batch to write (writer thread only)
+	bool failed;	//A write failed or batches arrived out of order (writer thread only)
+
+	pthread_t thread;
+	pthread_mutex_t lock;	//Protects the lists and flags below; never held during I/O
+	pthread_cond_t pending;
+	writerBatch* pendingHead;
+	writerBatch* pendingTail;
+	writerBatch* spare;	//Written batches ready to be filled again
+	bool closing;
+} resultWriter;
+
+bool writer_open(resultWriter* writer,const char** paths,int streamCount,writerSync sync);
+void writer_put(resultWriter* writer,int stream,const char* text,size_t length);
+bool writer_close(resultWriter* writer);
+
+#endif
@@ -0,0 +1,170 @@
+#include "rng.h"
+
+#include <string.h>
+
+//Implementation in C of the random streams of the simulator. The C library's random() uses the
+//sequence r[i] = r[i - 31] + r[i - 3] (mod 2^32) and returns r[i] >> 1; reimplementing it lets every
+//thread own a stream, and lets whole blocks be generated by the vector kernels without a lock per call.
+
+#define RANDOM_SEPARATION 3	//Distance of the second term of the sequence
+#define RANDOM_DISCARDED 310	//Values srandom() throws away after seeding
+#define RANDOM_STATE_TAG 0x474e524dU	//"MRNG", marks a saved stream position
+
+static threadRandom processRandom = {{0},RANDOM_UNSEEDED,0};
+_Thread_local threadRandom* activeRandom = &processRandom;
+
+//Start (stream) at the beginning of the sequence srandom(seed) produces.
+static void seed_stream(threadRandom* stream,unsigned int seed){
+	uint32_t sequence[RANDOM_DEGREE + RANDOM_SEPARATION + RANDOM_DISCARDED];
+	int32_t word = seed == 0 ? 1 : (int32_t) seed;
+	int i;
+
+	//The first 31 values come from a Park-Miller generator, computed as the C library does
+	//with Schrage's method so that it never overflows.
+	sequence[0] = (uint32_t) word;
+	for(i = 1; i < RANDOM_DEGREE; i++){
+		long high = word / 127773;
+		long low = word % 127773;
+
+		word = (int32_t) (16807 * low - 2836 * high);
+		if(word < 0){
+			word += 2147483647;
+		}
+		sequence[i] = (uint32_t) word;
+	}
+
+	//The C library starts with its two positions 3 apart in the 31 values, which is the same as
+	//repeating the first three values; then it throws away the first 310 outputs.
+	for(i = RANDOM_DEGREE; i < RANDOM_DEGREE + RANDOM_SEPARATION; i++){
+		sequence[i] = sequence[i - RANDOM_DEGREE];
+	}
+	for(i = RANDOM_DEGREE + RANDOM_SEPARATION; i < RANDOM_DEGREE + RANDOM_SEPARATION + RANDOM_DISCARDED; i++){
+		sequence[i] = sequence[i - RANDOM_DEGREE] + sequence[i - RANDOM_SEPARATION];
+	}
+
+	//The last values become the history the first block is computed from.
+	memcpy(stream->values + RANDOM_BLOCK,sequence + RANDOM_DEGREE + RANDOM_SEPARATION + RANDOM_DISCARDED - KERNEL_HISTORY,KERNEL_HISTORY * sizeof(uint32_t));
+	stream->position = KERNEL_HISTORY + RANDOM_BLOCK;
+}
+
+//Generate the next block of (stream) once the current one is used up.
+void refill_random(threadRandom* stream){
+	if(stream->position == RANDOM_UNSEEDED){
+		seed_stream(stream,1);
+	}
+
+	//The end of the finished block is the history of the next one.
+	memmove(stream->values,stream->values + RANDOM_BLOCK,KERNEL_HISTORY * sizeof(uint32_t));
+	fill_random_values(stream->values + KERNEL_HISTORY,RANDOM_BLOCK);
+	stream->position = KERNEL_HISTORY;
+}
+
+//Make (generator) the calling thread's stream, or return to the process-wide stream if it is NULL.
+//The generator is seeded with 1 like random() and the previously active stream is returned.
+threadRandom* use_thread_random(threadRandom* generator){
+	threadRandom* previous = activeRandom;
+
+	if(generator != NULL){
+		memset(generator,0,sizeof(threadRandom));
+		generator->position = RANDOM_UNSEEDED;
+		activeRandom = generator;
+	} else {
+		activeRandom = &processRandom;
+	}
+
+	return previous;
+}
+
+//Make the already seeded (stream) the calling thread's stream without resetting it, and return the
+//previously active one. Lets a thread take turns drawing from several streams that keep their positions.
+threadRandom* switch_thread_random(threadRandom* stream){
+	threadRandom* previous = activeRandom;
+
+	activeRandom = stream != NULL ? stream : &processRandom;
+	return previous;
+}
+
+//Seed the calling thread's stream (the equivalent of srand()).
+void seed_random(unsigned int seed){
+	seed_stream(activeRandom,seed);
+}
+
+//Hand out the antithetic values RAND_MAX - x of the calling thread's stream instead of its values x, or
+//return to the values themselves. The position is unaffected, so a stream can be replayed mirrored.
+void mirror_random(bool mirrored){
+	activeRandom->mirror = mirrored ? RAND_MAX : 0;
+}
+
+//Copy the position of the calling thread's stream into (snapshot).
+//Passing the copy to restore_random_state() later continues the stream from this exact point.
+void save_random_state(char* snapshot){
+	threadRandom* stream = activeRandom;
+	uint32_t tag = RANDOM_STATE_TAG;
+
+	if(stream->position == RANDOM_UNSEEDED){
+		seed_stream(stream,1);
+	}
+
+	//The last 31 values handed out determine everything that follows.
+	memset(snapshot,0,RANDOM_STATE_BYTES);
+	memcpy(snapshot,&tag,sizeof(tag));
+	memcpy(snapshot + sizeof(tag),stream->values + stream->position - RANDOM_DEGREE,RANDOM_DEGREE * sizeof(uint32_t));
+}
+
+//Continue the calling thread's stream from a position saved by save_random_state().
+void restore_random_state(const char* snapshot){
+	threadRandom* stream = activeRandom;
+	uint32_t* history = stream->values + RANDOM_BLOCK;
+	int i;
+
+	memcpy(history + KERNEL_HISTORY - RANDOM_DEGREE,snapshot + sizeof(uint32_t),RANDOM_DEGREE * sizeof(uint32_t));
+
+	//The kernels look further back than 31 values; run the sequence backwards to recover them.
+	for(i = KERNEL_HISTORY - RANDOM_DEGREE - 1; i >= 0; i--){
+		history[i] = history[i + RANDOM_DEGREE] - history[i + RANDOM_DEGREE - RANDOM_SEPARATION];
+	}
+
+	stream->position = KERNEL_HISTORY + RANDOM_BLOCK;
+}
+
+//Compare the streams with the C library's random_r() for a few seeds.
+//Returns the number of seeds whose sequences differ.
+int random_self_test(FILE* out){
+	const unsigned int seeds[] = {0,1,2,12345,2147483647U,4294967295U};
+	const int draws = 100000;
+	int failures = 0;
+	unsigned int s;
+	int i;
+
+	for(s = 0; s < sizeof(seeds) / sizeof(seeds[0]); s++){
+		struct random_data reference;
+		char referenceState[RANDOM_STATE_BYTES];
+		threadRandom stream;
+		threadRandom* previous = use_thread_random(&stream);
+		bool same = true;
+
+		memset(&reference,0,sizeof(reference));
+		initstate_r(seeds[s],referenceState,sizeof(referenceState),&reference);
+		seed_random(seeds[s]);
+
+		for(i = 0; i < draws && same; i++){
+			int32_t expected;
+
+			random_r(&reference,&expected);
+			same = next_random() == expected;
+
+			//Saving and restoring in the middle of a block must not change the sequence.
+			if(i == draws / 2){
+				char snapshot[RANDOM_STATE_BYTES];
+				save_random_state(snapshot);
+				restore_random_state(snapshot);
+			}
+		}
+
+		use_thread_random(previous);
+		fprintf(out,"  seed %-10u %s\n",seeds[s],same ? "ok" : "MISMATCH");
+		failures += same ? 0 : 1;
+	}
+
+	return failures;
+}
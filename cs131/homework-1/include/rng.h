@@ -0,0 +1,48 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "kernels.h"
+
+#define RANDOM_STATE_BYTES 128	//Size of a saved stream position
+#define RANDOM_DEGREE 31	//Values of the sequence the next one depends on
+#define RANDOM_BLOCK 256	//Values generated at a time
+#define RANDOM_UNSEEDED -1	//Position of a stream that is seeded with 1 on first use, like random()
+
+//Random stream producing the same sequence as srandom()/random() of the C library (its default
+//additive feedback generator) for the same seed. Values are generated a block at a time by the
+//fastest kernel variant the processor has and handed out one by one.
+typedef struct threadRandom {
+	uint32_t values[KERNEL_HISTORY + RANDOM_BLOCK];	//End of the previous block, then the current block
+	int position;	//Next value of (values) to hand out
+	uint32_t mirror;	//XORed into every value handed out; RAND_MAX turns each value x into RAND_MAX - x
+} threadRandom;
+
+//Stream of the calling thread: the process-wide stream unless the thread installed its own.
+extern _Thread_local threadRandom* activeRandom;
+
+void refill_random(threadRandom* stream);
+threadRandom* use_thread_random(threadRandom* generator);
+threadRandom* switch_thread_random(threadRandom* stream);
+void seed_random(unsigned int seed);
+void mirror_random(bool mirrored);
+void save_random_state(char* snapshot);
+void restore_random_state(const char* snapshot);
+int random_self_test(FILE* out);
+
+//Next number of the calling thread's stream, in the range of random().
+static inline long next_random(void){
+	threadRandom* stream = activeRandom;
+
+	if((unsigned int) stream->position >= KERNEL_HISTORY + RANDOM_BLOCK){
+		refill_random(stream);
+	}
+
+	return (stream->values[stream->position++] >> 1) ^ stream->mirror;
+}
+
+#endif
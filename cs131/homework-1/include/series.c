@@ -0,0 +1,257 @@
+#include "series.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//Implementation in C of the per-module utilization and queue depth recorder. The simulator reports
+//when a module's state changes; the recorder integrates the state over time in columnar per-module
+//counters and closes a window every SERIES_WINDOW_CYCLES cycles. Only SERIES_SAMPLES windows are kept,
+//chosen by reservoir sampling, so the memory used does not depend on how long the point runs.
+
+#define SERIES_SAMPLING_SEED 0x9e3779b97f4a7c15ULL
+
+typedef struct seriesRecorder {
+	int dist;
+	int processCount;
+	int moduleCount;
+
+	//Current state of every module and the cycle it was last accounted up to.
+	uint8_t* busy;
+	uint16_t* depth;
+	int32_t* accounted;
+
+	//Integrals of the open window.
+	uint32_t* windowBusy;
+	uint32_t* windowDepth;
+
+	//Integrals of the whole point.
+	uint32_t* busyCycles;
+	uint64_t* depthCycles;
+
+	//Kept windows (the reservoir).
+	uint32_t* windows;
+	uint8_t* utilization;
+	uint16_t* meanDepth;
+	uint32_t samples;
+	uint32_t windowCount;	//Windows closed so far
+	uint64_t sampling;	//State of the generator choosing kept windows; the simulation's stream is not used
+} seriesRecorder;
+
+_Thread_local seriesRecorder* activeSeries = NULL;
+
+//Account the state of (module) from the cycle it was last accounted up to until (cycle).
+static void accumulate(seriesRecorder* series,int module,int cycle){
+	uint32_t elapsed = (uint32_t) (cycle - series->accounted[module]);
+
+	series->windowBusy[module] += series->busy[module] * elapsed;
+	series->windowDepth[module] += series->depth[module] * elapsed;
+	series->accounted[module] = cycle;
+}
+
+//Next value of the xorshift generator that picks the windows to keep.
+static uint64_t next_sample(seriesRecorder* series){
+	series->sampling ^= series->sampling << 13;
+	series->sampling ^= series->sampling >> 7;
+	series->sampling ^= series->sampling << 17;
+	return series->sampling;
+}
+
+//Start recording the modules of the calling thread's next simulation.
+//Returns false if the counters could not be allocated.
+bool series_open(int dist,int processCount,int modules){
+	seriesRecorder* series = (seriesRecorder*) calloc(1,sizeof(seriesRecorder));
+
+	if(series == NULL){
+		return false;
+	}
+
+	series->dist = dist;
+	series->processCount = processCount;
+	series->moduleCount = modules;
+	series->sampling = SERIES_SAMPLING_SEED;
+
+	series->busy = (uint8_t*) calloc(modules,sizeof(uint8_t));
+	series->depth = (uint16_t*) calloc(modules,sizeof(uint16_t));
+	series->accounted = (int32_t*) calloc(modules,sizeof(int32_t));
+	series->windowBusy = (uint32_t*) calloc(modules,sizeof(uint32_t));
+	series->windowDepth = (uint32_t*) calloc(modules,sizeof(uint32_t));
+	series->busyCycles = (uint32_t*) calloc(modules,sizeof(uint32_t));
+	series->depthCycles = (uint64_t*) calloc(modules,sizeof(uint64_t));
+	series->windows = (uint32_t*) calloc(SERIES_SAMPLES,sizeof(uint32_t));
+	series->utilization = (uint8_t*) calloc((size_t) SERIES_SAMPLES * modules,sizeof(uint8_t));
+	series->meanDepth = (uint16_t*) calloc((size_t) SERIES_SAMPLES * modules,sizeof(uint16_t));
+
+	activeSeries = series;
+
+	if(series->busy == NULL || series->depth == NULL || series->accounted == NULL || series->windowBusy == NULL ||
+		series->windowDepth == NULL || series->busyCycles == NULL || series->depthCycles == NULL ||
+		series->windows == NULL || series->utilization == NULL || series->meanDepth == NULL){
+		series_close(NULL,0,0.0);
+		return false;
+	}
+
+	return true;
+}
+
+//Check if the calling thread is recording a series.
+bool series_active(void){
+	return activeSeries != NULL;
+}
+
+void series_set_busy(int cycle,int module,bool busy){
+	seriesRecorder* series = activeSeries;
+
+	if(series->busy[module] != busy){
+		accumulate(series,module,cycle);
+		series->busy[module] = busy;
+	}
+}
+
+void series_set_depth(int cycle,int module,int depth){
+	seriesRecorder* series = activeSeries;
+
+	accumulate(series,module,cycle);
+	series->depth[module] = depth > 0xffff ? 0xffff : (uint16_t) depth;
+}
+
+//Close the window that ends before cycle (cycle), which is (length) cycles long, and decide if it is kept.
+static void close_window(seriesRecorder* series,int cycle,int length){
+	uint64_t slot = series->windowCount;
+	int i;
+
+	//Reservoir sampling: window n replaces a random kept window with probability SERIES_SAMPLES / (n + 1).
+	if(slot >= SERIES_SAMPLES){
+		slot = next_sample(series) % (series->windowCount + 1);
+	}
+
+	for(i = 0; i < series->moduleCount; i++){
+		accumulate(series,i,cycle);
+
+		if(slot < SERIES_SAMPLES){
+			uint64_t depth = (uint64_t) series->windowDepth[i] * SERIES_DEPTH_SCALE / length;
+
+			series->utilization[slot * series->moduleCount + i] = (uint8_t) (series->windowBusy[i] * 255 / length);
+			series->meanDepth[slot * series->moduleCount + i] = depth > 0xffff ? 0xffff : (uint16_t) depth;
+		}
+
+		series->busyCycles[i] += series->windowBusy[i];
+		series->depthCycles[i] += series->windowDepth[i];
+		series->windowBusy[i] = 0;
+		series->windowDepth[i] = 0;
+	}
+
+	if(slot < SERIES_SAMPLES){
+		series->windows[slot] = series->windowCount;
+		if(series->samples < SERIES_SAMPLES){
+			series->samples++;
+		}
+	}
+
+	series->windowCount++;
+}
+
+//Close the window that ends before cycle (cycle).
+void series_end_window(int cycle){
+	close_window(activeSeries,cycle,SERIES_WINDOW_CYCLES);
+}
+
+//Write one column of (count) elements of (size) bytes, in the order given by (order) when it is not NULL.
+static bool write_column(FILE* file,const void* column,size_t size,size_t count,const uint32_t* order,uint32_t rows){
+	const char* bytes = (const char*) column;
+	uint32_t row;
+
+	if(order == NULL){
+		return fwrite(column,size,count,file) == count;
+	}
+
+	for(row = 0; row < rows; row++){
+		if(fwrite(bytes + (size_t) order[row] * size * count,size,count,file) != count){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Sort the kept windows by time: (order) receives their slots, ordered by window index.
+static void sort_samples(seriesRecorder* series,uint32_t* order){
+	uint32_t i,j;
+
+	//Insertion sort: at most SERIES_SAMPLES entries, and usually already in order.
+	for(i = 0; i < series->samples; i++){
+		uint32_t slot = i;
+
+		for(j = i; j > 0 && series->windows[order[j - 1]] > series->windows[slot]; j--){
+			order[j] = order[j - 1];
+		}
+		order[j] = slot;
+	}
+}
+
+//Stop recording after (cycles) cycles and write the series to (path) (nothing is written if it is NULL).
+//Returns false if the file could not be written.
+bool series_close(const char* path,int cycles,double waitTime){
+	seriesRecorder* series = activeSeries;
+	uint32_t order[SERIES_SAMPLES];
+	uint32_t windows[SERIES_SAMPLES];
+	seriesHeader header;
+	bool written = true;
+	uint32_t i;
+
+	if(series == NULL){
+		return false;
+	}
+
+	if(path != NULL){
+		//The last window is usually partial; cycles run from 1, so it ends after cycle (cycles).
+		int end = cycles + 1;
+		int start = (end / SERIES_WINDOW_CYCLES) * SERIES_WINDOW_CYCLES;
+		if(end > start){
+			close_window(series,end,end - start);
+		}
+
+		sort_samples(series,order);
+		for(i = 0; i < series->samples; i++){
+			windows[i] = series->windows[order[i]];
+		}
+
+		memset(&header,0,sizeof(header));
+		header.magic = SERIES_MAGIC;
+		header.version = SERIES_VERSION;
+		header.dist = series->dist;
+		header.processCount = series->processCount;
+		header.moduleCount = series->moduleCount;
+		header.windowCycles = SERIES_WINDOW_CYCLES;
+		header.samples = series->samples;
+		header.windowCount = series->windowCount;
+		header.cycles = (uint32_t) cycles;
+		header.waitTime = waitTime;
+
+		FILE* file = fopen(path,"wb");
+		written = file != NULL &&
+			fwrite(&header,sizeof(header),1,file) == 1 &&
+			write_column(file,windows,sizeof(uint32_t),series->samples,NULL,0) &&
+			write_column(file,series->utilization,sizeof(uint8_t),series->moduleCount,order,series->samples) &&
+			write_column(file,series->meanDepth,sizeof(uint16_t),series->moduleCount,order,series->samples) &&
+			write_column(file,series->busyCycles,sizeof(uint32_t),series->moduleCount,NULL,0) &&
+			write_column(file,series->depthCycles,sizeof(uint64_t),series->moduleCount,NULL,0);
+		if(file != NULL && fclose(file) != 0){
+			written = false;
+		}
+	}
+
+	free(series->busy);
+	free(series->depth);
+	free(series->accounted);
+	free(series->windowBusy);
+	free(series->windowDepth);
+	free(series->busyCycles);
+	free(series->depthCycles);
+	free(series->windows);
+	free(series->utilization);
+	free(series->meanDepth);
+	free(series);
+	activeSeries = NULL;
+
+	return written;
+}
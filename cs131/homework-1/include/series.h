@@ -0,0 +1,66 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SERIES_MAGIC 0x5245534dU	//"MSER"
+#define SERIES_VERSION 1
+#define SERIES_WINDOW_CYCLES 64	//Cycles aggregated into one sample of every module
+#define SERIES_SAMPLES 256	//Windows kept per point; longer runs keep a uniform random subset
+#define SERIES_DEPTH_SCALE 256	//Mean queue depths are stored in fixed point with this many steps per process
+
+//Start of a series file. It is followed by the columns
+//	uint32_t windows[samples]	index of each kept window (its first cycle is index * windowCycles)
+//	uint8_t utilization[samples][moduleCount]	busy cycles of the window scaled to 0 .. 255
+//	uint16_t depth[samples][moduleCount]	mean queue length of the window times SERIES_DEPTH_SCALE (saturating)
+//	uint32_t busyCycles[moduleCount]	busy cycles of the whole point
+//	uint64_t depthCycles[moduleCount]	queue length summed over every cycle of the point
+typedef struct seriesHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t dist;
+	int32_t processCount;
+	int32_t moduleCount;
+	uint32_t windowCycles;
+	uint32_t samples;	//Windows stored in the file
+	uint32_t windowCount;	//Windows the point ran for
+	uint32_t cycles;
+	double waitTime;
+} seriesHeader;
+
+//Recorder of the calling thread (NULL when it is not recording a series).
+extern _Thread_local struct seriesRecorder* activeSeries;
+
+bool series_open(int dist,int processCount,int modules);
+bool series_active(void);
+void series_set_busy(int cycle,int module,bool busy);
+void series_set_depth(int cycle,int module,int depth);
+void series_end_window(int cycle);
+bool series_close(const char* path,int cycles,double waitTime);
+
+//Per-event hooks. Kept inline so that a simulation without a series only pays for the check.
+
+//Module (module) becomes busy or available from cycle (cycle) on.
+static inline void series_busy(int cycle,int module,bool busy){
+	if(activeSeries != NULL){
+		series_set_busy(cycle,module,busy);
+	}
+}
+
+//The waiting queue of (module) holds (depth) processes from cycle (cycle) on.
+static inline void series_depth(int cycle,int module,int depth){
+	if(activeSeries != NULL){
+		series_set_depth(cycle,module,depth);
+	}
+}
+
+//Called once per simulated cycle, after cycle (cycle) is complete.
+static inline void series_cycle(int cycle){
+	if(activeSeries != NULL && (cycle + 1) % SERIES_WINDOW_CYCLES == 0){
+		series_end_window(cycle + 1);
+	}
+}
+
+#endif
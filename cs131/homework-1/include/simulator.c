@@ -1,205 +1,1302 @@
 #include "simulator.h"
 #include "queue.h"
+#include "stats.h"
+#include "profiler.h"
+#include "trace.h"
+#include "rng.h"
+#include "result_cache.h"
+#include "analytic_model.h"
+#include "series.h"
 
 #include <math.h>
+#include <string.h>
 
 
 //Generate a random number between a fixed range [Minumum,Maximum]
 int uniformRange(int min,int max){
 	int delta = max - min;
-	unsigned int num = (rand() % delta) + min;
+	unsigned int num = (next_random() % delta) + min;
 	return num;
 }
 
 //Generate a random gaussian number with a 
 static double randGauss(double mean,double sigma){
-	double x = (double) random() / RAND_MAX;
-	double y = (double) random() / RAND_MAX;
+	double x = (double) next_random() / RAND_MAX;
+	double y = (double) next_random() / RAND_MAX;
 
 	double z = mean + (sqrt(-2 * log(x)) * cos(2 * M_PI * y) * sigma);
 	return z;
 }
 
+//Module of a request drawn uniformly from (modules) memory modules.
+int uniform_request(int modules){
+	return uniformRange(0,modules) % modules;
+}
+
+//Module of a request drawn from a Gaussian around (mean) with deviation (sigma), folded into the (modules) modules.
+int gaussian_request(double mean,double sigma,int modules){
+	return abs((int) (randGauss(mean,sigma)) % modules);
+}
+
 //Initialize a memory queue data structure for holding
 //the processors that are still waiting to access the resource.
 void init_queue(memoryQueue* memQueue){
-	memQueue->attachedProcess = -1;
-	memQueue->queue = NULL;
+	memQueue->head = -1;
+	memQueue->tail = -1;
+	memQueue->length = 0;
+	memQueue->nextPort = 0;
 }
 
 //Method for adding a process to a memory module's waiting queue.
 //Is FIFO or first-come first-served meaning an incoming process must first 
 //wait for the processes that were there waiting before it to access the memory
-//module.
-void pushMemQueue(memoryQueue* memQueue,int process){
-	if(memQueue->queue == NULL){
-		node* insertionNode = createNode(process);
-		memQueue->queue = insertionNode;
+//module. The process is linked behind the last one, so pushing takes constant time.
+void pushMemQueue(simulator* sim,int module,int process){
+	memoryQueue* memQueue = &(sim->queues[module]);
+
+	sim->nextWaiting[process] = -1;
+	if(memQueue->tail == -1){
+		memQueue->head = process;
 	} else {
-		push(&(memQueue->queue),process);
+		sim->nextWaiting[memQueue->tail] = process;
 	}
+	memQueue->tail = process;
+	memQueue->length++;
+	sim->queued[process] = true;
+}
+
+//Remove and return the process at the front of a memory module's waiting queue, which must not be empty.
+int popMemQueue(simulator* sim,int module){
+	memoryQueue* memQueue = &(sim->queues[module]);
+	int process = memQueue->head;
+
+	memQueue->head = sim->nextWaiting[process];
+	if(memQueue->head == -1){
+		memQueue->tail = -1;
+	}
+	memQueue->length--;
+	sim->queued[process] = false;
+
+	return process;
 }
 
 //A way to check if a memory module can give access to a certain process
-bool check_availability(int process,memoryQueue* memQueue){
-	//A memory module can give access to a processed if its wait queue is empty, the memory queue has just been
-	//initialized or if the memoryQueue was scheduled to service that process beforehand.
-	if(memQueue == NULL || memQueue->attachedProcess == -1 || memQueue->attachedProcess == process){
+bool check_availability(simulator* sim,int process,int module){
+	const int* holders = &(sim->holders[module * sim->ports]);
+	int k;
+
+	//A memory module can give access to a process if it is available, or if one of its ports
+	//was handed to that process beforehand.
+	if(sim->memories[module] == 0){
 		return true;
-	} 
+	}
+	for(k = 0; k < sim->ports; k++){
+		if(holders[k] == process){
+			return true;
+		}
+	}
+
+	//A coalesced read is served by the access of the read it was merged into.
+	return sim->merged != NULL && sim->merged[process] == module;
+}
+
+//Fill a session configuration with the defaults of the original model:
+//every memory access keeps its module busy for a single cycle and all requests are reads.
+void default_config(simulatorConfig* config){
+	config->readLatency = DEFAULT_SERVICE_LATENCY;
+	config->writeLatency = DEFAULT_SERVICE_LATENCY;
+	config->writeRatio = 0.0;
+	config->modulePorts = DEFAULT_MODULE_PORTS;
+	config->moduleLines = 0;
+	config->coalesceReads = false;
+	config->cacheSets = 0;
+	config->cacheWays = 0;
+	config->writeBuffer = 0;
+
+	config->overrides = NULL;
+	config->overrideCount = 0;
+	init_patterns(&(config->patterns));
+
+	config->nodeCount = 1;
+	config->remoteLatency = 0;
+	config->linkBandwidth = 0;
+	config->localRatio = 0.0;
+
+	config->seed = 1;
+	config->seedPerPoint = false;
+
+	config->tracePath = NULL;
+	config->traceProcessors = 0;
+	config->traceModules = 0;
+	config->traceDist = Uniform;
+
+	config->seriesPath = NULL;
+	config->seriesProcessors = 0;
+	config->seriesModules = 0;
+	config->seriesDist = Uniform;
+
+	config->arrivals = ArrivalsClosed;
+	config->arrivalRate = 0.0;
+	config->burstCycles = 0;
+	config->idleCycles = 0;
+	config->thinkCycles = 0;
+	config->outstandingLimit = 0;
+
+	config->sigmaFraction = 0.0;
+	config->sigmaModules = 0.0;
+	config->driftEpoch = 0;
+	config->driftDistance = 0.0;
+	config->hotRegions = 0;
+
+	config->modelTolerance = 0.0;
+	config->logSync = WriterSyncNone;
+	config->placement = PlacementNone;
+	config->hugePages = HugePagesNone;
+	config->varianceReduction = VarianceNone;
+	config->varianceCycles = VARIANCE_DEFAULT_CYCLES;
+	config->varianceReport = NULL;
+}
+
+//Read per-module service latencies from a CSV file with rows of the form
+//"module,read latency,write latency". Lines that do not parse (headers, comments) are skipped.
+//Returns the number of overrides loaded or -1 if the file could not be opened.
+int load_latency_overrides(simulatorConfig* config,const char* path){
+	char line[256];
+	int capacity = config->overrideCount;
+	FILE* file = fopen(path,"r");
+
+	if(file == NULL){
+		return -1;
+	}
+
+	while(fgets(line,sizeof(line),file) != NULL){
+		moduleLatency entry;
+
+		if(sscanf(line,"%d,%d,%d",&(entry.module),&(entry.readLatency),&(entry.writeLatency)) != 3){
+			continue;
+		}
+
+		if(entry.module < 0 || entry.readLatency < 1 || entry.writeLatency < 1){
+			continue;
+		}
+
+		//Grow the override array geometrically as entries are read.
+		if(config->overrideCount == capacity){
+			capacity = capacity == 0 ? 16 : capacity * 2;
+			config->overrides = (moduleLatency*) realloc(config->overrides,capacity * sizeof(moduleLatency));
+		}
+
+		config->overrides[config->overrideCount++] = entry;
+	}
+
+	fclose(file);
+	return config->overrideCount;
+}
+
+//Release the per-module overrides held by a session configuration.
+void free_config(simulatorConfig* config){
+	free(config->overrides);
+	config->overrides = NULL;
+	config->overrideCount = 0;
+	free_patterns(&(config->patterns));
+
+	config->nodeCount = 1;
+	config->remoteLatency = 0;
+	config->linkBandwidth = 0;
+	config->localRatio = 0.0;
+
+	config->seed = 1;
+	config->seedPerPoint = false;
+
+	config->tracePath = NULL;
+	config->traceProcessors = 0;
+	config->traceModules = 0;
+	config->traceDist = Uniform;
+
+	config->seriesPath = NULL;
+	config->seriesProcessors = 0;
+	config->seriesModules = 0;
+	config->seriesDist = Uniform;
+
+	config->arrivals = ArrivalsClosed;
+	config->arrivalRate = 0.0;
+	config->burstCycles = 0;
+	config->idleCycles = 0;
+	config->thinkCycles = 0;
+	config->outstandingLimit = 0;
+
+	config->sigmaFraction = 0.0;
+	config->sigmaModules = 0.0;
+	config->driftEpoch = 0;
+	config->driftDistance = 0.0;
+	config->hotRegions = 0;
+
+	config->modelTolerance = 0.0;
+	config->logSync = WriterSyncNone;
+	config->varianceReport = NULL;
+}
+
+//Check that (config) holds valid values and only combines features the simulator supports, for a session
+//spread over (workers) worker processes (0 for a serial session or a libmemsim engine).
+//Returns false, after explaining why on stderr, if it does not.
+bool validate_config(const simulatorConfig* config,int workers){
+	if(config->readLatency < 1 || config->writeLatency < 1){
+		fprintf(stderr,"Service latencies must be at least one cycle\n");
+		return false;
+	}
+
+	if(config->writeRatio < 0.0 || config->writeRatio > 1.0 || config->localRatio < 0.0 || config->localRatio > 1.0){
+		fprintf(stderr,"Write and local ratios must lie in [0, 1]\n");
+		return false;
+	}
+
+	if(config->modulePorts < 1 || config->modulePorts > MAX_MODULE_PORTS || config->moduleLines < 0 || config->moduleLines > MAX_MODULE_LINES){
+		fprintf(stderr,"Modules need 1 to %d ports and at most %d lines\n",MAX_MODULE_PORTS,MAX_MODULE_LINES);
+		return false;
+	}
+
+	if(config->cacheSets < 0 || (config->cacheSets & (config->cacheSets - 1)) != 0 ||
+		(config->cacheSets > 0 && (config->cacheWays < 1 || config->cacheWays > CACHE_MAX_WAYS))){
+		fprintf(stderr,"Private caches need a power of two sets and 1 to %d ways\n",CACHE_MAX_WAYS);
+		return false;
+	}
+
+	if(config->writeBuffer < 0 || config->writeBuffer > MAX_WRITE_BUFFER){
+		fprintf(stderr,"Write buffers hold 0 to %d writes\n",MAX_WRITE_BUFFER);
+		return false;
+	}
+
+	if(config->nodeCount < 1 || config->remoteLatency < 0 || config->linkBandwidth < 0){
+		fprintf(stderr,"Node count must be positive and remote latency and link bandwidth non-negative\n");
+		return false;
+	}
+
+	//Which points are simulated depends on the simulated neighbours, so pruning needs a serial session.
+	if(config->modelTolerance < 0.0 || (config->modelTolerance > 0.0 && workers > 0)){
+		fprintf(stderr,"--model-tolerance must be positive and cannot be combined with --workers\n");
+		return false;
+	}
+
+	if(config->sigmaFraction < 0.0 || config->sigmaModules < 0.0 || config->driftEpoch < 0 || config->driftDistance < 0.0 || config->hotRegions < 0){
+		fprintf(stderr,"Sigma, drift and hot regions cannot be negative\n");
+		return false;
+	}
+
+	if(!arrivals_valid(config->arrivals,config->arrivalRate,config->burstCycles,config->idleCycles) || config->thinkCycles < 0 || config->outstandingLimit < 0){
+		fprintf(stderr,"Open-loop arrivals need a rate in (0, 1], also during on periods, and non-negative think time and limit\n");
+		return false;
+	}
+
+	//The analytical model describes the closed loop of single-ported modules only.
+	if(config->modelTolerance > 0.0 && config->arrivals != ArrivalsClosed){
+		fprintf(stderr,"--model-tolerance cannot be combined with open-loop arrivals\n");
+		return false;
+	}
+	if(config->modelTolerance > 0.0 && (config->modulePorts > 1 || config->coalesceReads || config->cacheSets > 0 || config->writeBuffer > 0)){
+		fprintf(stderr,"--model-tolerance cannot be combined with --ports, --coalesce, --private-cache or --write-buffer\n");
+		return false;
+	}
+
+	//Requests reach the caches from the closed loop only.
+	if(config->cacheSets > 0 && config->arrivals != ArrivalsClosed){
+		fprintf(stderr,"--private-cache cannot be combined with open-loop arrivals\n");
+		return false;
+	}
+
+	//The agents draining the write buffers run in the closed loop, and do not reserve the inter-node link.
+	if(config->writeBuffer > 0 && (config->arrivals != ArrivalsClosed || config->linkBandwidth > 0)){
+		fprintf(stderr,"--write-buffer cannot be combined with open-loop arrivals or --link-bandwidth\n");
+		return false;
+	}
+
+	//Programs run in the closed loop and decide which requests are writes; the model and the variance
+	//reduction assume requests drawn from the distribution.
+	if(config->patterns.programCount > 0 && (config->arrivals != ArrivalsClosed || config->writeRatio > 0.0 ||
+		config->modelTolerance > 0.0 || config->varianceReduction != VarianceNone)){
+		fprintf(stderr,"--pattern cannot be combined with open-loop arrivals, --write-ratio, --model-tolerance or --variance-reduction\n");
+		return false;
+	}
+
+	//A variance-reduced point is several closed-loop simulations, and its summary compares neighbouring points.
+	if(config->varianceCycles < 1){
+		fprintf(stderr,"--variance-cycles must be positive\n");
+		return false;
+	}
+	if(config->varianceReduction != VarianceNone && (config->arrivals != ArrivalsClosed || workers > 0 || config->tracePath != NULL || config->seriesPath != NULL)){
+		fprintf(stderr,"--variance-reduction cannot be combined with open-loop arrivals, --workers, --trace or --series\n");
+		return false;
+	}
+
+	if((config->tracePath == NULL) != (config->traceProcessors == 0)){
+		fprintf(stderr,"--trace and --trace-point must be given together\n");
+		return false;
+	}
+
+	if((config->seriesPath == NULL) != (config->seriesProcessors == 0)){
+		fprintf(stderr,"--series and --series-point must be given together\n");
+		return false;
+	}
 
-	return false;
+	return true;
+}
+
+//Number of cycles a memory module stays busy for a read or a write request.
+int service_latency(simulator* sim,int module,bool write){
+	return write ? sim->writeLatency[module] : sim->readLatency[module];
 }
 
 //A simulator cycle will be used to calculate the average wait time 
 //for a system with (k) processors and (m) memory modules.
 
 //We use and initialize a simulator struct (defined in 'simulator.h')
-// to do this.
-void setup_simulator(simulator* sim,int processCount, int modules){
+// to do this. A NULL configuration uses the defaults from default_config().
+void setup_simulator(simulator* sim,int processCount, int modules,const simulatorConfig* config){
+	simulatorConfig defaults;
+
+	if(config == NULL){
+		default_config(&defaults);
+		config = &defaults;
+	}
+
 	//Set the simulator's processor count and number of memory modules.
 	sim->processCount = processCount;
 	sim->moduleCount = modules;
+	sim->writeRatio = config->writeRatio;
+
+	//Every processor with a write buffer has an agent draining it, which requests modules like a processor
+	//and so has an entry after the processors' in the per-process arrays.
+	sim->agentCount = config->writeBuffer > 0 ? 2 * processCount : processCount;
+	int agents = sim->agentCount;
 
 	//Allocate an array for storing each processor's current access request 
-	sim->processes = (int*) malloc(processCount * sizeof(int));
+	sim->processes = (int*) placed_malloc(agents * sizeof(int));
 
 	//Allocate an array for storing each processor's total amount of cycles it has had
 	//to wait in the simulation
-	sim->waitTimes = (int*) malloc(processCount * sizeof(int));
+	sim->waitTimes = (int*) placed_malloc(agents * sizeof(int));
 
 	//Allocate an array for storing each processor's priority in case of concurrent access clashes.
-	sim->priorities = (int*) malloc(processCount * sizeof(int));
+	sim->priorities = (int*) placed_malloc(agents * sizeof(int));
 
 	//Allocate an array of memory modules and its corresponding waiting queues
-	sim->memories = (int*) malloc(modules * sizeof(int));	//Used to indicate (with 0 or 1) if the memory module is currently available
-	sim->queues = (memoryQueue*) calloc(modules,sizeof(memoryQueue)); //Used for prioritizing processors that have been waiting longer to access a memory module.
+	sim->memories = (int*) placed_malloc(modules * sizeof(int));	//Used to indicate (with 0 or 1) if the memory module is currently available
+	sim->queues = (memoryQueue*) placed_calloc(modules,sizeof(memoryQueue)); //Used for prioritizing processors that have been waiting longer to access a memory module.
+
+	//Allocate the per-processor request type and the cycle each processor's current access finishes on
+	sim->writes = (bool*) placed_malloc(agents * sizeof(bool));
+	sim->readyCycles = (int*) placed_malloc(agents * sizeof(int));
+	sim->issuedWaits = (int*) placed_malloc(agents * sizeof(int));
+
+	//Allocate the holders of every module's ports and the links of the processes waiting in the modules' queues
+	sim->ports = config->modulePorts;
+	sim->holders = (int*) placed_malloc(modules * sim->ports * sizeof(int));
+	sim->nextWaiting = (int*) placed_malloc(agents * sizeof(int));
+	sim->queued = (bool*) placed_malloc(agents * sizeof(bool));
+
+	//Allocate the per-module service latencies
+	sim->readLatency = (int*) placed_malloc(modules * sizeof(int));
+	sim->writeLatency = (int*) placed_malloc(modules * sizeof(int));
+	sim->fired = (int*) placed_malloc(modules * sizeof(int));
 
 	int i;
-	for(i = 0; i < processCount; i++){
+	for(i = 0; i < agents; i++){
 		sim->processes[i] = -1;
 		sim->waitTimes[i] = 0; //All processes start out having never waited for access to a memory resource
 		sim->priorities[i] = i;//Have the priorities simply be the processor's index in the processor array
+		sim->writes[i] = false;
+		sim->readyCycles[i] = 0;
+		sim->issuedWaits[i] = 0;
+		sim->nextWaiting[i] = -1;
+		sim->queued[i] = false;
+	}
+
+	for(i = 0; i < modules * sim->ports; i++){
+		sim->holders[i] = -1;	//No port has been handed to a process yet
+	}
+
+	//Requests address a line of their module when reads of the same line are coalesced or cached.
+	sim->lineCount = config->moduleLines > 0 ? config->moduleLines : DEFAULT_MODULE_LINES;
+	sim->lines = NULL;
+	sim->merged = NULL;
+	if(config->coalesceReads || config->cacheSets > 0){
+		sim->lines = (int*) placed_calloc(agents,sizeof(int));
+	}
+	if(config->coalesceReads){
+		sim->merged = (int*) placed_malloc(agents * sizeof(int));
+		for(i = 0; i < agents; i++){
+			sim->merged[i] = -1;
+		}
 	}
 
+	//Private caches filter the requests before they reach the modules.
+	setup_processor_cache(&(sim->cache),config->cacheSets,config->cacheWays,processCount);
+	sim->hitting = NULL;
+	sim->missWaits = 0;
+	sim->missGrants = 0;
+	if(cache_enabled(&(sim->cache))){
+		sim->hitting = (bool*) placed_calloc(processCount,sizeof(bool));
+	}
+
+	//Write buffers let processors move on while their writes drain.
+	setup_write_buffers(&(sim->buffers),config->writeBuffer,processCount);
+
+	//Access pattern programs pick the processors' requests in place of the distribution.
+	setup_pattern_vm(&(sim->vm),&(config->patterns),processCount,modules);
+
 	for(i = 0; i < modules; i++){
 		sim->memories[i] = 0;//All memory modules begin as available
 		init_queue(&(sim->queues[i]));//Initialize the pointers for their waiting queues.
+		sim->readLatency[i] = config->readLatency;
+		sim->writeLatency[i] = config->writeLatency;
 	}	
+
+	//Apply the per-module overrides that fall inside this configuration's module range
+	for(i = 0; i < config->overrideCount; i++){
+		if(config->overrides[i].module < modules){
+			sim->readLatency[config->overrides[i].module] = config->overrides[i].readLatency;
+			sim->writeLatency[config->overrides[i].module] = config->overrides[i].writeLatency;
+		}
+	}
+
+	sim->maxLatency = 1;
+	for(i = 0; i < modules; i++){
+		if(sim->readLatency[i] > sim->maxLatency){
+			sim->maxLatency = sim->readLatency[i];
+		}
+		if(sim->writeLatency[i] > sim->maxLatency){
+			sim->maxLatency = sim->writeLatency[i];
+		}
+	}
+
+	//Split processors and modules into NUMA nodes (a single node keeps the flat machine).
+	setup_topology(&(sim->topo),config->nodeCount,processCount,modules,config->remoteLatency,config->linkBandwidth,config->localRatio);
+
+	//Completion events are never scheduled more than one (remote) service time ahead.
+	init_wheel(&(sim->wheel),modules,sim->maxLatency + config->remoteLatency);
+
+	//Gaussian requests are placed around means kept by the locality engine.
+	setup_locality(&(sim->locality),gaussian_sigma(config->sigmaFraction,config->sigmaModules,modules),
+		config->driftEpoch,config->driftDistance,config->hotRegions,processCount,modules);
+
+	//Open-loop processors queue the requests that arrive while they are busy.
+	setup_arrivals(&(sim->arrivals),config->arrivals,config->arrivalRate,config->burstCycles,config->idleCycles,processCount);
+	sim->thinkCycles = config->thinkCycles;
+	sim->outstandingLimit = config->outstandingLimit;
+	sim->backlogs = NULL;
+	sim->thinkUntil = NULL;
+	if(config->arrivals != ArrivalsClosed){
+		sim->backlogs = (int*) placed_calloc(processCount,sizeof(int));
+		sim->thinkUntil = (int*) placed_calloc(processCount,sizeof(int));
+	}
+
+	//Simulations run on the caller's stream until they converge unless a variance-reduced point says otherwise.
+	sim->streams = NULL;
+	sim->scaledDraws = false;
+	sim->cycleLimit = 0;
+	sim->warmCycle = 0;
+	sim->warmFills = 0;
+	sim->warmPeak = 0;
+	sim->batches = NULL;
+	sim->control = NULL;
+	sim->waitCounts = NULL;
+	sim->waitCountSize = 0;
 }
 
-void run_simulator(simulator* sim,distribution dist,FILE* file){
-	int i,process_idx,k,sample;
+//Decide whether the next request of a processor is a write.
+//No random number is drawn when the session only issues reads, which keeps the
+//request stream identical to the single-cycle read-only model.
+static bool next_request_is_write(simulator* sim){
+	if(sim->writeRatio <= 0.0){
+		return false;
+	}
 
-	//Each processor will have its own local mean if it generates memory access requests 
-	//using a Gaussian distribution.
+	return ((double) next_random() / RAND_MAX) < sim->writeRatio;
+}
 
-	//The means for each processor will stay the same during the whole simulation
-	// as a way to simulate locality of reference for memory access.
-	int* processorMeans = (int*) malloc(sim->processCount * sizeof(int));
+//Processor an agent works for: the processor itself, or the one whose write buffer the agent drains.
+static inline int agent_processor(simulator* sim,int agent){
+	return agent < sim->processCount ? agent : agent - sim->processCount;
+}
 
-	//In the case that the simulation wants to generate memory module requests with
-	//a Gaussian distribution.
-	//The sigma will be the number of memory modules divided by 5.0.
-	double sigma = (double) (sim->moduleCount) / 3.0;
+//Number of cycles an access by (process) occupies (module): the module's service time plus
+//the interconnect latency when the module belongs to another NUMA node than the processor's.
+static int access_latency(simulator* sim,int process,int module){
+	int latency = service_latency(sim,module,sim->writes[process]);
+
+	if(is_remote(&(sim->topo),agent_processor(sim,process),module)){
+		latency += sim->topo.remoteLatency;
+	}
+
+	return latency;
+}
+
+//Count a cycle of waiting for a processor, split into local and remote wait on NUMA machines.
+//The waits of the agents draining write buffers are not the processors', so they are not split.
+static void add_wait(simulator* sim,int process){
+	sim->waitTimes[process]++;
+	if(process < sim->processCount){
+		record_topology_wait(&(sim->topo),process,sim->processes[process]);
+	}
+}
+
+//Hand a port of (module) to (process): a free one, or else the next one in turn, whose holder loses it.
+//A single-ported module is simply handed from process to process.
+static inline void hand_port(simulator* sim,int process,int module){
+	int* holders = &(sim->holders[module * sim->ports]);
+	memoryQueue* memQueue = &(sim->queues[module]);
+	int k;
+
+	for(k = 0; k < sim->ports; k++){
+		if(holders[k] == -1){
+			holders[k] = process;
+			return;
+		}
+	}
+
+	holders[memQueue->nextPort] = process;
+	memQueue->nextPort = memQueue->nextPort + 1 < sim->ports ? memQueue->nextPort + 1 : 0;
+}
+
+//Free the port of (module) that (process) held until it was granted, for the next process handed the module.
+static inline void release_port(simulator* sim,int process,int module){
+	int* holders = &(sim->holders[module * sim->ports]);
+	int k;
+
+	for(k = 0; k < sim->ports; k++){
+		if(holders[k] == process){
+			holders[k] = -1;
+			break;
+		}
+	}
+
+	if(sim->merged != NULL){
+		sim->merged[process] = -1;
+	}
+}
+
+//Draw the line of the new request of (process) when requests address lines.
+static inline void draw_line(simulator* sim,int process){
+	if(sim->lines != NULL){
+		sim->lines[process] = uniformRange(0,sim->lineCount);
+	}
+}
+
+//Look the new request of (process) up in its private cache. A read that hits is served by the cache, and
+//granted on the next cycle without reaching its module. Returns whether it hit.
+static inline bool lookup_request(simulator* sim,int process){
+	if(sim->hitting == NULL){
+		return false;
+	}
+
+	uint32_t address = (uint32_t) sim->processes[process] * (uint32_t) sim->lineCount + (uint32_t) sim->lines[process];
+	sim->hitting[process] = cache_access(&(sim->cache),process,address,sim->writes[process]);
+	return sim->hitting[process];
+}
+
+//Attach a processor to a memory module that has just been requested by it and mark the module busy
+//for the service time of the request. The module's release is scheduled on the timing wheel.
+static void start_service(simulator* sim,int process,int module,int cycle){
+	int latency = access_latency(sim,process,module);
+
+	hand_port(sim,process,module);
+	sim->memories[module] = 1;
+	series_busy(cycle,module,true);
+
+	//The access takes the module from this cycle on, and the processor is granted again on the cycle after its last.
+	sim->readyCycles[process] = cycle + latency;
+
+	if(!wheel_pending(&(sim->wheel),module)){
+		wheel_schedule(&(sim->wheel),module,cycle + latency - 1);
+	}
+}
+
+//Whether the multi-cycle access of (process) ended on the previous cycle. The processor stalled through it, so it
+//is granted on (cycle) even if the module has been handed on since; a single-cycle access still needs the module
+//free or its own, as in the original model.
+static inline bool access_finished(simulator* sim,int process,int module,int cycle){
+	return sim->readyCycles[process] == cycle && access_latency(sim,process,module) > 1;
+}
+
+//Whether the current request of (process) is a write its buffer takes over instead of the processor waiting for it.
+static inline bool buffers_writes(simulator* sim,int process){
+	return sim->buffers.capacity > 0 && sim->writes[process];
+}
+
+//Move the write of (process) into its write buffer, and have the agent draining the buffer request the
+//write's module at once when it was idle. Returns false, leaving the write with the processor, when the buffer is full.
+static bool buffer_write(simulator* sim,int process,int cycle){
+	int module = sim->processes[process];
+	int drainer = sim->processCount + process;
+
+	if(!push_write(&(sim->buffers),process,module)){
+		return false;
+	}
+
+	if(sim->processes[drainer] < 0){
+		sim->processes[drainer] = module;
+		sim->writes[drainer] = true;
+		sim->issuedWaits[drainer] = sim->waitTimes[drainer];
+		trace_event(cycle,drainer,module,TraceRequest,0);
+		start_service(sim,drainer,module,cycle);
+	}
+
+	return true;
+}
+
+//Keep (module) busy for the rest of (cycle) after an agent that goes idle was granted it, the way the next
+//request of a granted processor reserves its module at once. Otherwise every agent granted on the cycle would
+//find the module free, and writes to one module would never wait for each other. The module is released, or
+//handed to its queue, at the end of the cycle.
+static void hold_module(simulator* sim,int module,int cycle){
+	if(sim->memories[module] == 0){
+		sim->memories[module] = 1;
+		series_busy(cycle,module,true);
+		wheel_schedule(&(sim->wheel),module,cycle);
+	}
+}
+
+//Simulate cycle (cycle) of the agent draining the write buffer of (process). The oldest buffered write waits
+//for its module like a processor's request and leaves the buffer once granted; the agent then requests the
+//module of the next one. Its waits are not part of the processors' wait time.
+static void drain_write(simulator* sim,int process,int cycle){
+	int drainer = sim->processCount + process;
+	int module = sim->processes[drainer];
+
+	if(module < 0){
+		return;
+	}
+
+	if(sim->readyCycles[drainer] > cycle){
+		add_wait(sim,drainer);
+		trace_event(cycle,drainer,module,TraceStall,0);
+		return;
+	}
+
+	if(access_finished(sim,drainer,module,cycle) || check_availability(sim,drainer,module)){
+		int granted = module;
+
+		trace_event(cycle,drainer,module,TraceGrant,sim->queues[module].length);
+		release_port(sim,drainer,module);
+		pop_write(&(sim->buffers),process);
+
+		module = oldest_write(&(sim->buffers),process);
+		sim->processes[drainer] = module;
+		if(module >= 0){
+			sim->issuedWaits[drainer] = sim->waitTimes[drainer];
+			trace_event(cycle,drainer,module,TraceRequest,0);
+			start_service(sim,drainer,module,cycle);
+		} else {
+			hold_module(sim,granted,cycle);
+		}
+	} else {
+		add_wait(sim,drainer);
+		if(!sim->queued[drainer]){
+			pushMemQueue(sim,module,drainer);
+			series_depth(cycle,module,sim->queues[module].length);
+		}
+		trace_event(cycle,drainer,module,TraceWait,sim->queues[module].length);
+	}
+}
+
+//Serve every read queued at (module) for the same line as (reader)'s read together with it. The merged reads
+//do not take a port; they are granted once their own access time has passed, like the processes handed a port.
+//Returns the longest access among them.
+static int merge_reads(simulator* sim,int module,int reader,int cycle){
+	memoryQueue* memQueue = &(sim->queues[module]);
+	int previous = -1;
+	int process = memQueue->head;
+	int longest = 0;
+
+	while(process != -1){
+		int following = sim->nextWaiting[process];
+
+		if(!sim->writes[process] && sim->lines[process] == sim->lines[reader]){
+			int latency = access_latency(sim,process,module);
+
+			//Unlink the read from the queue.
+			if(previous == -1){
+				memQueue->head = following;
+			} else {
+				sim->nextWaiting[previous] = following;
+			}
+			if(memQueue->tail == process){
+				memQueue->tail = previous;
+			}
+			memQueue->length--;
+			sim->queued[process] = false;
+
+			sim->merged[process] = module;
+			sim->readyCycles[process] = cycle + latency;
+			longest = latency > longest ? latency : longest;
+			trace_event(cycle,process,module,TraceComplete,memQueue->length);
+		} else {
+			previous = process;
+		}
+
+		process = following;
+	}
+
+	return longest;
+}
+
+//Handle the completion of the access a memory module has been servicing at the end of cycle (cycle).
+//The module hands its free ports to the processes at the front of its waiting queue (at least the next
+//port in turn to the first one), or becomes available when none waits.
+static void complete_service(simulator* sim,int module,int cycle){
+	memoryQueue* memQueue = &(sim->queues[module]);
+	const int* holders = &(sim->holders[module * sim->ports]);
+	int longest = 0;
+	int freePorts = 0;
+	int k;
+
+	if(memQueue->head == -1){
+		sim->memories[module] = 0;
+		series_busy(cycle + 1,module,false);
+		trace_event(cycle,-1,module,TraceComplete,0);
+		return;
+	}
+
+	for(k = 0; k < sim->ports; k++){
+		freePorts += holders[k] == -1 ? 1 : 0;
+	}
+
+	//Get process id / index of the processes at the front of the module's wait queue
+	//and assign the module to them for the following cycles.
+	do {
+		int nextProcess = popMemQueue(sim,module);
+		int latency = access_latency(sim,nextProcess,module);
+		series_depth(cycle + 1,module,memQueue->length);
+		trace_event(cycle,nextProcess,module,TraceComplete,memQueue->length);
+
+		hand_port(sim,nextProcess,module);
+		sim->readyCycles[nextProcess] = cycle + latency;
+		longest = latency > longest ? latency : longest;
+
+		//Queued reads of the line the process reads are served along with it.
+		if(sim->merged != NULL && !sim->writes[nextProcess]){
+			latency = merge_reads(sim,module,nextProcess,cycle);
+			longest = latency > longest ? latency : longest;
+			series_depth(cycle + 1,module,memQueue->length);
+		}
+	} while(--freePorts > 0 && memQueue->head != -1);
+
+	if(memQueue->head == -1 && longest <= 1){
+		//Single-cycle accesses that drain the queue release the module right away.
+		sim->memories[module] = 0;
+		series_busy(cycle + 1,module,false);
+	} else {
+		wheel_schedule(&(sim->wheel),module,cycle + longest);
+	}
+}
+
+//Keep the outcome of a simulation that ran for (cycles) cycles in the simulator for callers that do not write a log.
+static void finish_result(simulator* sim,int cycles){
+	sim->result.processCount = sim->processCount;
+	sim->result.moduleCount = sim->moduleCount;
+	sim->result.cycles = cycles;
+	sim->result.waitTime = getAverageWaitTime(sim,cycles);
+
+	//NUMA machines also report which part of the wait was spent on local and on remote modules.
+	sim->result.numa = topology_enabled(&(sim->topo));
+	sim->result.localWait = 0.0;
+	sim->result.remoteWait = 0.0;
+	if(sim->result.numa){
+		topology_wait_times(&(sim->topo),cycles,&(sim->result.localWait),&(sim->result.remoteWait));
+	}
+
+	sim->result.openLoop = false;
+	sim->result.offeredLoad = 0.0;
+	sim->result.throughput = 0.0;
+	sim->result.requestWait = 0.0;
+	sim->result.dropped = 0.0;
+
+	sim->result.cached = cache_enabled(&(sim->cache));
+	sim->result.hitRate = cache_hit_rate(&(sim->cache));
+	sim->result.missWait = sim->missGrants > 0 ? (double) sim->missWaits / sim->missGrants : 0.0;
+
+	//With write buffers the wait is split into the part spent on reads (and on writes being serviced)
+	//and the part spent waiting for room in a full buffer, with the normalization of getAverageWaitTime().
+	sim->result.buffered = sim->buffers.capacity > 0;
+	sim->result.readStall = 0.0;
+	sim->result.writeStall = 0.0;
+	if(sim->result.buffered){
+		sim->result.writeStall = (double) sim->buffers.writeStalls / ((double) cycles * sim->processCount);
+		sim->result.readStall = sim->result.waitTime - sim->result.writeStall;
+	}
+
+	sim->result.modeled = false;
+	sim->result.modelWait = 0.0;
+	sim->result.estimated = false;
+}
+
+//Count the wait of the request (process) was just granted in the histogram of request waits.
+static inline void count_request_wait(simulator* sim,int process){
+	int wait = sim->waitTimes[process] - sim->issuedWaits[process];
+
+	sim->waitCounts[wait < sim->waitCountSize ? wait : sim->waitCountSize - 1]++;
+}
+
+//Draw a uniformly distributed module for a request.
+static inline int uniform_module(simulator* sim){
+	return sim->scaledDraws ? scaled_draw(sim->moduleCount) : uniform_request(sim->moduleCount);
+}
+
+//Take the following random numbers from the stream of (process) when every processor has its own.
+static inline void processor_stream(simulator* sim,int process){
+	if(sim->streams != NULL){
+		switch_thread_random(&(sim->streams[process]));
+	}
+}
+
+//Draw the module of the next request of (process). Gaussian requests fall around the processor's current mean.
+static int draw_module(simulator* sim,distribution dist,int process){
+	if(dist == Gaussian){
+		return gaussian_request(sim->locality.means[process],sim->locality.sigma,sim->moduleCount);
+	}
+
+	return uniform_module(sim);
+}
+
+//Point an access pattern program's draw instruction draws for.
+typedef struct patternContext {
+	simulator* sim;
+	distribution dist;
+} patternContext;
+
+static int pattern_draw(void* context,int process){
+	patternContext* pattern = (patternContext*) context;
+
+	return draw_module(pattern->sim,pattern->dist,process);
+}
+
+//Run the access pattern program of (process) up to its next request and return the module it requests.
+//The program also decides whether the request is a write.
+static inline int pattern_request(simulator* sim,distribution dist,int process,bool* write){
+	patternContext context = {sim,dist};
+
+	return pattern_next(&(sim->vm),process,write,pattern_draw,&context);
+}
+
+//Open-loop variant of run_simulator(): requests arrive at every processor on their own schedule and queue
+//at the processor while it is busy, so a processor can be idle, or hold several requests.
+//A point ends once the mean wait of a request settles, or after OPEN_LOOP_MAX_CYCLES when it never does.
+static void run_open_loop(simulator* sim,distribution dist,FILE* file){
+	long arrived = 0,dropped = 0,granted = 0;
+	long outstandingCycles = 0;	//Requests held by the processors, summed over the cycles
+	double pastWait = -1.0;
+	int publishedCycles = 0;
+	int i,p,k;
+
+	profiler_begin_point();
+	profiler_enter(PhaseGeneration);
+
+	//Processors start idle; their Gaussian means are placed like in the closed loop.
+	locality_begin(&(sim->locality),dist == Gaussian);
+	for(p = 0; p < sim->processCount; p++){
+		if(dist == Gaussian){
+			locality_assign(&(sim->locality),p);
+		}
+		sim->processes[p] = -1;
+	}
+
+	for(i = 1; i <= OPEN_LOOP_MAX_CYCLES; i++){
+		locality_cycle(&(sim->locality),i);
+		profiler_enter(PhaseConflict);
+		for(p = 0; p < sim->processCount; p++){
+			int module = sim->processes[p];
+			bool issuing = module < 0;
+
+			if(arrival_due(&(sim->arrivals),p,i)){
+				arrived++;
+				if(sim->outstandingLimit > 0 && sim->backlogs[p] + (module < 0 ? 0 : 1) >= sim->outstandingLimit){
+					dropped++;
+				} else {
+					sim->backlogs[p]++;
+				}
+			}
+
+			if(module >= 0 && sim->readyCycles[p] > i){
+				//The processor's access is still being serviced by a multi-cycle module.
+				add_wait(sim,p);
+				trace_event(i,p,module,TraceStall,0);
+			} else if(module >= 0 && (access_finished(sim,p,module,i) || check_availability(sim,p,module))){
+				if(is_remote(&(sim->topo),p,module) && !acquire_link(&(sim->topo),i)){
+					add_wait(sim,p);
+					trace_event(i,p,module,TraceWait,sim->queues[module].length);
+				} else {
+					record_topology_grant(&(sim->topo),p,module);
+					trace_event(i,p,module,TraceGrant,sim->queues[module].length);
+					release_port(sim,p,module);
+					sim->processes[p] = -1;
+					sim->thinkUntil[p] = i + sim->thinkCycles;
+					granted++;
+					issuing = true;
+				}
+			} else if(module >= 0){
+				add_wait(sim,p);
+				if(!sim->queued[p]){
+					pushMemQueue(sim,module,p);
+					series_depth(i,module,sim->queues[module].length);
+				}
+				trace_event(i,p,module,TraceWait,sim->queues[module].length);
+			}
+
+			//An idle processor issues its oldest waiting request, on the cycle of its last grant when it does not think.
+			if(issuing && sim->backlogs[p] > 0 && i >= sim->thinkUntil[p]){
+				profiler_enter(PhaseGeneration);
+				sim->backlogs[p]--;
+				module = localize_request(&(sim->topo),p,draw_module(sim,dist,p));
+				sim->processes[p] = module;
+				sim->writes[p] = next_request_is_write(sim);
+				draw_line(sim,p);
+				profiler_enter(PhaseConflict);
+				trace_event(i,p,module,TraceRequest,0);
+				start_service(sim,p,module,i);
+			}
+
+			outstandingCycles += sim->backlogs[p] + (sim->processes[p] < 0 ? 0 : 1);
+		}
+
+		profiler_enter(PhaseArbitration);
+		int firedCount = wheel_advance(&(sim->wheel),i,sim->fired);
+		for(k = 0; k < firedCount; k++){
+			complete_service(sim,sim->fired[k],i);
+		}
+		series_cycle(i);
+
+		if((i & (STATS_CYCLE_BATCH - 1)) == 0){
+			stats_add_cycles(i - publishedCycles);
+			publishedCycles = i;
+		}
+
+		//By Little's law the mean time a request spends at its processor is the number of requests
+		//held on average divided by the rate they are granted at.
+		profiler_enter(PhaseConvergence);
+		if(i % OPEN_LOOP_BATCH_CYCLES == 0 && granted > 0){
+			double wait = (double) outstandingCycles / granted;
+
+			if(pastWait > 0.0 && fabs(1.0 - wait / pastWait) < OPEN_LOOP_TOLERANCE){
+				break;
+			}
+			pastWait = wait;
+		}
+	}
+
+	i = i > OPEN_LOOP_MAX_CYCLES ? OPEN_LOOP_MAX_CYCLES : i;
+	stats_add_cycles(i - publishedCycles);
+	profiler_end_point(dist,sim->processCount,sim->moduleCount);
+
+	finish_result(sim,i);
+	sim->result.openLoop = true;
+	sim->result.offeredLoad = (double) arrived / ((double) i * sim->moduleCount);
+	sim->result.throughput = (double) granted / ((double) i * sim->moduleCount);
+	sim->result.requestWait = granted > 0 ? (double) outstandingCycles / granted - 1.0 : 0.0;
+	sim->result.dropped = arrived > 0 ? (double) dropped / arrived : 0.0;
+
+	if(file != NULL){
+		write_result(file,&(sim->result));
+	}
+}
+
+//Whether the caches and write buffers of (sim), which start out empty, are still filling up on (cycle).
+//They count as warm once they have gone without filling an empty way or holding more writes than ever
+//before for as many cycles as it took them to get there; until then the wait they cause is still falling
+//or rising, and a wait that barely moves between two cycles has not converged.
+static bool still_warming(simulator* sim,int cycle){
+	if(sim->cache.fills != sim->warmFills || sim->buffers.peak != sim->warmPeak){
+		sim->warmCycle = cycle;
+		sim->warmFills = sim->cache.fills;
+		sim->warmPeak = sim->buffers.peak;
+	}
+
+	return sim->warmCycle > cycle / 2;
+}
+
+//Draw the first request of every processor of a closed-loop simulation, issued on cycle 1.
+static void begin_closed_loop(simulator* sim,distribution dist){
+	int i;
+	int sample = 0;
 
 	//Create the first batch of memory requests
 	for(i = 0; i < sim->processCount; i++){
-		if(dist == Uniform){
+		bool write = false;
+
+		processor_stream(sim,i);
+		if(sim->vm.set != NULL){
+			//A program picks the request; the Gaussian means are still placed for its draw instruction.
+			if(dist == Gaussian){
+				locality_assign(&(sim->locality),i);
+			}
+			sample = pattern_request(sim,dist,i,&write);
+		} else if(dist == Uniform){
 			//If the distribution needs to be uniform for access requests
 			//generate them using a Uniform distribution.
-			sample = uniformRange(0,sim->moduleCount) % sim->moduleCount;
+			sample = uniform_module(sim);
 		} else if(dist == Gaussian){
 			//If the distribution needs to be gaussian for access requests
 			//generate them using a Gaussian distribution.
 			
 			//The mean for the processor is selected using a uniform distribution
-			int mean = uniformRange(0,sim->moduleCount);
+			//(or taken from its hot region) and stored by the engine for later request cycles.
+			int mean = locality_assign(&(sim->locality),i);
 
 			//The gaussian number representing the access requests will be generated
-			//with the recently created mean and previously defined sigma (variance).
-			sample = abs((int) (randGauss(mean,sigma)) % sim->moduleCount);
-
-			//Store the mean for the corresponding processor for later use in later request cycles.
-			processorMeans[i] = mean;
+			//with the recently created mean and the engine's sigma (deviation).
+			sample = gaussian_request(mean,sim->locality.sigma,sim->moduleCount);
 		}
 
 		//Assign the memory module to the processor
-		sim->processes[i] = sample;
+		if(sim->control != NULL){
+			control_request(sim->control,-1,sample,sim->moduleCount);
+		}
+		sim->processes[i] = localize_request(&(sim->topo),i,sample);
+		sim->writes[i] = sim->vm.set != NULL ? write : next_request_is_write(sim);
+		draw_line(sim,i);
+		lookup_request(sim,i);
+		trace_event(1,i,sim->processes[i],TraceRequest,0);
 	}
+}
 
+//Simulate cycle (i) of a closed-loop simulation: grant or queue every processor's request and complete
+//the accesses that end on the cycle.
+static inline void closed_loop_cycle(simulator* sim,distribution dist,int i){
+	int process_idx,k;
+	int sample = 0;
 
-	//Initializers for checking the simulation termination condition
-	// (when the past average is different from the current wait time average by less than 0.02%)
-	double pastAverage = -1.0;
-	double currentAverage = -1.0;
-	double percentDiff = 1.0;
-	i = 1;
-
-	//Simulate access requests until the past waiting average differs from the current by less than 0.02%
-	while(i++){
-		//Set past average to the last cycle's current average
-		pastAverage = currentAverage;
+	//Move the processors' means if a new epoch starts on this cycle.
+	processor_stream(sim,sim->processCount);
+	locality_cycle(&(sim->locality),i);
 
-		//Check if each processor got access to the memory module it request
+	//The write buffers drain before the processors run, so a write an agent requests on a cycle is granted
+	//on the next one at the earliest, like a processor's request.
+	profiler_enter(PhaseConflict);
+	if(sim->buffers.capacity > 0){
 		for(process_idx = 0; process_idx < sim->processCount; process_idx++){
+			drain_write(sim,process_idx,i);
+		}
+	}
 
-			//If the memory module the process accessed was available (==0) and is available (meaning its wait queue) is empty
-			//then the process got access to the memory module and can generate another access request.
-			if(sim->memories[sim->processes[process_idx]] == 0 || check_availability(process_idx,&(sim->queues[sim->processes[process_idx]]))){
-				//Generate a new memory module to request from using either a Uniform or Gaussian distribution.
-				if(dist == Uniform){
-					sample = uniformRange(0,sim->moduleCount) % sim->moduleCount;
-				} else if(dist == Gaussian){
-					sample = abs((int) (randGauss(processorMeans[process_idx],sigma)) % sim->moduleCount);
-				}
+	//Check if each processor got access to the memory module it request
+	for(process_idx = 0; process_idx < sim->processCount; process_idx++){
+
+		//A processor whose access is still being serviced by a multi-cycle module keeps waiting.
+		//The occupancy counts towards its wait time.
+		if(sim->readyCycles[process_idx] > i){
+			add_wait(sim,process_idx);
+			trace_event(i,process_idx,sim->processes[process_idx],TraceStall,0);
+			continue;
+		}
 
-				//Assign the memory module to that process
-				sim->processes[process_idx] = sample;
+		//A request the processor's private cache served is granted without going to its module.
+		bool hit = sim->hitting != NULL && sim->hitting[process_idx];
 
-				//Indicate that the memory module's currently attached process is the newly assigned process
-				sim->queues[sample].attachedProcess = process_idx;
+		//A write goes into the processor's write buffer, and only stalls the processor while the buffer is full.
+		bool buffered = !hit && buffers_writes(sim,process_idx);
+		if(buffered && !buffer_write(sim,process_idx,i)){
+			add_wait(sim,process_idx);
+			sim->buffers.writeStalls++;
+			trace_event(i,process_idx,sim->processes[process_idx],TraceBufferFull,sim->buffers.capacity);
+			continue;
+		}
 
-				//Indicate that the memory module is now in use
-				sim->memories[sample] = 1;
+		//If the memory module the process accessed was available (==0) and is available (meaning its wait queue) is empty
+		//then the process got access to the memory module and can generate another access request.
+		if(hit || buffered || access_finished(sim,process_idx,sim->processes[process_idx],i) ||
+			check_availability(sim,process_idx,sim->processes[process_idx])){
+			if(hit){
+				trace_event(i,process_idx,sim->processes[process_idx],TraceHit,0);
+			} else if(buffered){
+				trace_event(i,process_idx,sim->processes[process_idx],TraceBuffer,sim->buffers.counts[process_idx]);
 			} else {
+				//An access to another node's module also needs a slot on the shared inter-node link.
+				//Without one the processor keeps its module and retries on the next cycle.
+				if(is_remote(&(sim->topo),process_idx,sim->processes[process_idx]) && !acquire_link(&(sim->topo),i)){
+					add_wait(sim,process_idx);
+					trace_event(i,process_idx,sim->processes[process_idx],TraceWait,sim->queues[sim->processes[process_idx]].length);
+					continue;
+				}
+				record_topology_grant(&(sim->topo),process_idx,sim->processes[process_idx]);
+				trace_event(i,process_idx,sim->processes[process_idx],TraceGrant,sim->queues[sim->processes[process_idx]].length);
+				release_port(sim,process_idx,sim->processes[process_idx]);
+
+				//With private caches only the misses reach the modules, so their wait is the contention left.
+				if(sim->hitting != NULL){
+					sim->missWaits += sim->waitTimes[process_idx] - sim->issuedWaits[process_idx];
+					sim->missGrants++;
+				}
+			}
+			if(sim->waitCounts != NULL){
+				count_request_wait(sim,process_idx);
+			}
 
-				//In the case that the memory module is not available to the process
-				//then the memory module must now wait, thus adding to the total amount of times
-				//the process has had to wait for access to resources.
-				sim->waitTimes[process_idx]++;
+			//Generate a new memory module to request from using either a Uniform or Gaussian distribution.
+			profiler_enter(PhaseGeneration);
+			processor_stream(sim,process_idx);
+			bool write = false;
+			if(sim->vm.set != NULL){
+				sample = pattern_request(sim,dist,process_idx,&write);
+			} else if(dist == Uniform){
+				sample = uniform_module(sim);
+			} else if(dist == Gaussian){
+				sample = gaussian_request(sim->locality.means[process_idx],sim->locality.sigma,sim->moduleCount);
+			}
 
-				//Add the process to the memory module's waiting queue if it is not already in there.
-				if(!contains(&(sim->queues[sim->processes[process_idx]].queue),process_idx)){
-					pushMemQueue(&(sim->queues[sim->processes[process_idx]]),process_idx);
-				}
+			//Assign the memory module to that process
+			if(sim->control != NULL){
+				control_request(sim->control,sim->processes[process_idx],sample,sim->moduleCount);
+			}
+			sample = localize_request(&(sim->topo),process_idx,sample);
+			sim->processes[process_idx] = sample;
+			sim->issuedWaits[process_idx] = sim->waitTimes[process_idx];
+			sim->writes[process_idx] = sim->vm.set != NULL ? write : next_request_is_write(sim);
+			draw_line(sim,process_idx);
+			profiler_enter(PhaseConflict);
+			trace_event(i,process_idx,sample,TraceRequest,0);
+
+			//Indicate that the memory module's currently attached process is the newly assigned process
+			//and that the memory module is now in use for the request's service time.
+			//A request its private cache serves, or a write its buffer will take, leaves the module alone.
+			if(!lookup_request(sim,process_idx) && !buffers_writes(sim,process_idx)){
+				start_service(sim,process_idx,sample,i);
 			}
+		} else {
+
+			//In the case that the memory module is not available to the process
+			//then the memory module must now wait, thus adding to the total amount of times
+			//the process has had to wait for access to resources.
+			add_wait(sim,process_idx);
+
+			//Add the process to the memory module's waiting queue if it is not already in there.
+			if(!sim->queued[process_idx]){
+				pushMemQueue(sim,sim->processes[process_idx],process_idx);
+				series_depth(i,sim->processes[process_idx],sim->queues[sim->processes[process_idx]].length);
+			}
+			trace_event(i,process_idx,sim->processes[process_idx],TraceWait,sim->queues[sim->processes[process_idx]].length);
 		}
+	}
 
-		//Each cycle, each memory module must determine which process it should give access to next.
-		//Usually this goes to the process at the front of its waiting queue.
+	//Each memory module whose access completes this cycle must determine which process it should give access to next.
+	//Usually this goes to the process at the front of its waiting queue.
 
-		//The assignment is done by setting the 'attachedProcess' field to the process number (or index)
-		//In the case that the memory module's wait queue is empty, simply choose the process with the lower
-		// wait queue.
+	//The assignment is done by handing the module's ports to the process numbers (or indices)
+	//In the case that the memory module's wait queue is empty, the module is marked as immediately
+	//available to processes that may request it in the next cycle.
 
-		for(k = 0; k < sim->moduleCount; k++){
-			if(sim->queues[k].queue != NULL){
-				//Get process id / index of the process at the front of the process's wait queue.
-				//and assign to the current memory module.
-				int nextProcess = pop(&(sim->queues[k].queue));
-				sim->queues[k].attachedProcess = nextProcess;
-			}
+	//Only the modules with an event on the timing wheel are visited, so the cost of a cycle
+	//depends on the number of completions rather than on the number of modules.
+	profiler_enter(PhaseArbitration);
+	int firedCount = wheel_advance(&(sim->wheel),i,sim->fired);
+	for(k = 0; k < firedCount; k++){
+		complete_service(sim,sim->fired[k],i);
+	}
+	series_cycle(i);
+}
 
-			//If the wait queue is empty, mark the memory module as immediately available to process that may 
-			//request it in the next cycle
-			if(empty(&(sim->queues[k].queue))){
-				sim->memories[k] = 0;
-			} 
-		}
+//Make (destination) continue exactly where (source) is. Both must have been set up by setup_simulator() with
+//the same processor count, module count and configuration, and (destination) keeps its own allocations, so
+//taking a snapshot costs a copy of the state arrays.
+//The caller's random stream is not part of the snapshot.
+void copy_simulator(simulator* destination,const simulator* source){
+	int processCount = source->agentCount;
+	int modules = source->moduleCount;
+
+	memcpy(destination->processes,source->processes,processCount * sizeof(int));
+	memcpy(destination->waitTimes,source->waitTimes,processCount * sizeof(int));
+	memcpy(destination->writes,source->writes,processCount * sizeof(bool));
+	memcpy(destination->readyCycles,source->readyCycles,processCount * sizeof(int));
+	memcpy(destination->issuedWaits,source->issuedWaits,processCount * sizeof(int));
+	memcpy(destination->memories,source->memories,modules * sizeof(int));
+	memcpy(destination->queues,source->queues,modules * sizeof(memoryQueue));
+	memcpy(destination->holders,source->holders,modules * source->ports * sizeof(int));
+	memcpy(destination->nextWaiting,source->nextWaiting,processCount * sizeof(int));
+	memcpy(destination->queued,source->queued,processCount * sizeof(bool));
+	if(source->lines != NULL){
+		memcpy(destination->lines,source->lines,processCount * sizeof(int));
+	}
+	if(source->merged != NULL){
+		memcpy(destination->merged,source->merged,processCount * sizeof(int));
+	}
+	if(source->hitting != NULL){
+		memcpy(destination->hitting,source->hitting,source->processCount * sizeof(bool));
+		copy_processor_cache(&(destination->cache),&(source->cache));
+	}
+	destination->missWaits = source->missWaits;
+	destination->missGrants = source->missGrants;
+	copy_write_buffers(&(destination->buffers),&(source->buffers));
+	destination->warmCycle = source->warmCycle;
+	destination->warmFills = source->warmFills;
+	destination->warmPeak = source->warmPeak;
+	copy_pattern_vm(&(destination->vm),&(source->vm));
+
+	copy_wheel(&(destination->wheel),&(source->wheel));
+	copy_topology(&(destination->topo),&(source->topo));
+	copy_locality(&(destination->locality),&(source->locality));
+}
+
+//Start a closed-loop simulation that the caller advances one cycle at a time with step_simulator(),
+//for callers that look at the state between cycles. The first cycle to step is 2.
+void start_simulator(simulator* sim,distribution dist){
+	locality_begin(&(sim->locality),dist == Gaussian);
+	begin_closed_loop(sim,dist);
+}
+
+//Simulate cycle (cycle) of a simulation started with start_simulator().
+void step_simulator(simulator* sim,distribution dist,int cycle){
+	closed_loop_cycle(sim,dist,cycle);
+}
+
+void run_simulator(simulator* sim,distribution dist,FILE* file){
+	int i;
+	threadRandom* callerRandom = activeRandom;
+
+	if(sim->arrivals.process != ArrivalsClosed){
+		run_open_loop(sim,dist,file);
+		return;
+	}
+
+	//Each processor will have its own local mean if it generates memory access requests 
+	//using a Gaussian distribution.
+
+	//The means for each processor are kept by the locality engine as a way to simulate locality
+	//of reference for memory access. They stay the same during the whole simulation unless the
+	//engine is set to drift them every epoch, and processors share them when it has hot regions.
+
+	//In the case that the simulation wants to generate memory module requests with
+	//a Gaussian distribution, the sigma is set by the engine as well.
+	//By default it will be the number of memory modules divided by GAUSSIAN_SIGMA_DIVISOR (3.0).
+	locality_begin(&(sim->locality),dist == Gaussian);
+
+	//The opt-in profiler attributes counts to the phases entered below; it does nothing when disabled.
+	profiler_begin_point();
+	profiler_enter(PhaseGeneration);
+
+	//Create the first batch of memory requests
+	begin_closed_loop(sim,dist);
+
+	//Initializers for checking the simulation termination condition
+	// (when the past average is different from the current wait time average by less than 0.02%)
+	double pastAverage = -1.0;
+	double currentAverage = -1.0;
+	double percentDiff = 1.0;
+	int publishedCycles = 1;
+	i = 1;
+
+	//Simulate access requests until the past waiting average differs from the current by less than 0.02%
+	while(i++){
+		//Set past average to the last cycle's current average
+		pastAverage = currentAverage;
+
+		closed_loop_cycle(sim,dist,i);
 
 		//Calculate the average waiting time for all processors to access a memory module.
+		profiler_enter(PhaseConvergence);
 		currentAverage = getAverageWaitTime(sim,i);
+		if(sim->batches != NULL){
+			record_batch(sim->batches,i,currentAverage);
+		}
+		if(sim->control != NULL){
+			record_batch(&(sim->control->batches),i,sim->control->sum / i);
+		}
 
 		if(pastAverage >= 0){
 			//This ternary operations are simply to prevent the case of when the past 
@@ -211,20 +1308,35 @@ void run_simulator(simulator* sim,distribution dist,FILE* file){
 			percentDiff = fabs(1.0 - (currentAverage / pastAverage));
 		}
 
+		//Publish the progress of long simulations in batches to keep the live statistics cheap.
+		if((i & (STATS_CYCLE_BATCH - 1)) == 0){
+			stats_add_cycles(i - publishedCycles);
+			publishedCycles = i;
+		}
+
 		//Terminate when the wait times hit an asymptote or a point where they do not change anymore
-		//A difference in values of < 0.02%
+		//A difference in values of < 0.02%, once the caches and write buffers have filled up.
+		//Simulations that are combined with another run exactly as long as it instead.
+		bool warming = still_warming(sim,i);
 
-		if(percentDiff < 0.0002){
+		if(sim->cycleLimit > 0 ? i >= sim->cycleLimit : percentDiff < CONVERGENCE_THRESHOLD && !warming){
 			break;
 		}
 	}
 
+	if(sim->streams != NULL){
+		switch_thread_random(callerRandom);
+	}
+	stats_add_cycles(i - publishedCycles);
+	profiler_end_point(dist,sim->processCount,sim->moduleCount);
+
+	finish_result(sim,i);
+
 	//Write all the data in CSV row format so an outside library (in this case Python's Matplotlib)
 	//can use it as a data source for a line graph
-	fprintf(file, "%d,%d,%f\n",sim->processCount,sim->moduleCount,getAverageWaitTime(sim,i));
-
-	//Free array for processor means
-	free(processorMeans);
+	if(file != NULL){
+		write_result(file,&(sim->result));
+	}
 }
 
 
@@ -232,22 +1344,38 @@ void run_simulator(simulator* sim,distribution dist,FILE* file){
 //to prevent memory leaks. This function simply releases all the memory that would be
 //stored in a our simulator object (struct).
 void free_simulator(simulator* sim){
-	int i;
-
 	//Free the arrays for the processors, wait times, and priorities
-	free(sim->processes);
-	free(sim->waitTimes);
-	free(sim->priorities);
+	placed_free(sim->processes);
+	placed_free(sim->waitTimes);
+	placed_free(sim->priorities);
 	
-	//Free the memory allocated to each node in the memory's wait queue
-	for(i = 0; i < sim->moduleCount; i++){
-		destroyQueue(&(sim->queues[i].queue));
-	}
-
 	//Free the arrays for the memory modules and the memory's modules
-	//corresponding wait queues.
-	free(sim->memories);
-	free(sim->queues);
+	//corresponding wait queues and ports.
+	placed_free(sim->memories);
+	placed_free(sim->queues);
+	placed_free(sim->holders);
+	placed_free(sim->nextWaiting);
+	placed_free(sim->queued);
+	placed_free(sim->lines);
+	placed_free(sim->merged);
+	placed_free(sim->hitting);
+	free_processor_cache(&(sim->cache));
+	free_write_buffers(&(sim->buffers));
+	free_pattern_vm(&(sim->vm));
+
+	//Free the request types, service latencies and completion events.
+	placed_free(sim->writes);
+	placed_free(sim->readyCycles);
+	placed_free(sim->issuedWaits);
+	placed_free(sim->readLatency);
+	placed_free(sim->writeLatency);
+	placed_free(sim->fired);
+	free_wheel(&(sim->wheel));
+	free_topology(&(sim->topo));
+	free_arrivals(&(sim->arrivals));
+	free_locality(&(sim->locality));
+	placed_free(sim->backlogs);
+	placed_free(sim->thinkUntil);
 }
 
 //Way to calculate the average wait time for (N) processes given
@@ -266,65 +1394,504 @@ double getAverageWaitTime(simulator* sim,int requests){
 }
 
 
-//This will run the whole simulation session for different processor configurations (defined in parameter 'processorConfigs')
-//It will run simulation cycles from configurations of 1 to (modules) memory modules.
+//Format the column names of a log file into (row) and return their length.
+//NUMA sessions add the local and remote parts of the wait time.
+static int format_log_header(char* row,const simulatorConfig* config){
+	int length = sprintf(row,"processors,memory modules,wait-times");
 
-//It will write the data into log files (*.csv files) for future reference that can be used by outside libraries to create plots
-void run_session(int* processorConfigs,int configSize,int modules,const char* uniformLogs,const char* gaussianLogs){
-	int i,moduleCount;
+	if(config->nodeCount > 1){
+		length += sprintf(row + length,",local wait-times,remote wait-times");
+	}
+	if(config->arrivals != ArrivalsClosed){
+		length += sprintf(row + length,",offered load,throughput,request wait,dropped");
+	}
+	if(config->cacheSets > 0){
+		length += sprintf(row + length,",hit rate,miss wait");
+	}
+	if(config->writeBuffer > 0){
+		length += sprintf(row + length,",read stall,write stall");
+	}
+	if(config->modelTolerance > 0.0){
+		length += sprintf(row + length,",model wait-times,estimated");
+	}
+	length += sprintf(row + length,"\n");
 
-	//Run with both Uniform and Gaussian distributions
-	distribution uniform = Uniform;
-	distribution gaussian = Gaussian;
+	return length;
+}
 
-	FILE* uniformFile;
+//Format one simulation result as a row of a log file into (row) and return its length.
+static int format_result(char* row,const simulationResult* result){
+	int length = sprintf(row,"%d,%d,%f",result->processCount,result->moduleCount,result->waitTime);
 
-	//Open log file for writing.
-	//This file will be used for storing results from simulations where the distribution of 
-	//memory module access requests is Uniform.
-	uniformFile = fopen(uniformLogs,"w");
-	fprintf(uniformFile,"processors,memory modules,wait-times\n");
+	if(result->numa){
+		length += sprintf(row + length,",%f,%f",result->localWait,result->remoteWait);
+	}
+	if(result->openLoop){
+		length += sprintf(row + length,",%f,%f,%f,%f",result->offeredLoad,result->throughput,result->requestWait,result->dropped);
+	}
+	if(result->cached){
+		length += sprintf(row + length,",%f,%f",result->hitRate,result->missWait);
+	}
+	if(result->buffered){
+		length += sprintf(row + length,",%f,%f",result->readStall,result->writeStall);
+	}
+	if(result->modeled){
+		length += sprintf(row + length,",%f,%d",result->modelWait,result->estimated ? 1 : 0);
+	}
+	length += sprintf(row + length,"\n");
 
-	//Run one simulation cycle each for each processor and memory module configuration
-	for(i = 0; i < configSize;i++){
-		for(moduleCount = 1;moduleCount < modules + 1;moduleCount++){
+	return length;
+}
+
+//Write the column names of a log file.
+void write_log_header(FILE* file,const simulatorConfig* config){
+	char row[LOG_ROW_LENGTH];
+
+	fwrite(row,1,format_log_header(row,config),file);
+}
+
+//Write one simulation result as a row of a log file.
+void write_result(FILE* file,const simulationResult* result){
+	char row[LOG_ROW_LENGTH];
+
+	fwrite(row,1,format_result(row,result),file);
+}
+
+//Queue the column names of the log written as stream (stream) of (writer).
+void put_log_header(resultWriter* writer,int stream,const simulatorConfig* config){
+	char row[LOG_ROW_LENGTH];
+
+	writer_put(writer,stream,row,format_log_header(row,config));
+}
+
+//Queue one simulation result as a row of the log written as stream (stream) of (writer).
+void put_result(resultWriter* writer,int stream,const simulationResult* result){
+	char row[LOG_ROW_LENGTH];
+
+	writer_put(writer,stream,row,format_result(row,result));
+}
+
+//Derive the seed of a single sweep point from the session seed.
+//Every point then has its own random stream, independent of the order points are simulated in.
+unsigned int point_seed(int seed,distribution dist,int processCount,int modules){
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned int fields[4];
+	int i;
+
+	fields[0] = (unsigned int) seed;
+	fields[1] = (unsigned int) dist;
+	fields[2] = (unsigned int) processCount;
+	fields[3] = (unsigned int) modules;
+
+	//FNV-1a over the fields, folded to 32 bits.
+	for(i = 0; i < 4; i++){
+		hash ^= fields[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return (unsigned int) (hash ^ (hash >> 32));
+}
+
+//Describe a point and the parameters it is simulated with in the header of its trace.
+//Must be called right before the point is simulated, since it captures the random() state.
+void fill_trace_header(traceHeader* header,const simulatorConfig* config,unsigned int seed,distribution dist,int processCount,int modules){
+	memset(header,0,sizeof(traceHeader));
+	header->magic = TRACE_MAGIC;
+	header->version = TRACE_VERSION;
+	header->seed = seed;
+	header->dist = (int32_t) dist;
+	header->processCount = processCount;
+	header->moduleCount = modules;
+	header->readLatency = config->readLatency;
+	header->writeLatency = config->writeLatency;
+	header->writeRatio = config->writeRatio;
+	header->nodeCount = config->nodeCount;
+	header->remoteLatency = config->remoteLatency;
+	header->linkBandwidth = config->linkBandwidth;
+	header->overrideCount = config->overrideCount;
+	header->localRatio = config->localRatio;
+	header->arrivals = config->arrivals;
+	header->burstCycles = config->burstCycles;
+	header->idleCycles = config->idleCycles;
+	header->thinkCycles = config->thinkCycles;
+	header->outstandingLimit = config->outstandingLimit;
+	header->arrivalRate = config->arrivalRate;
+	header->driftEpoch = config->driftEpoch;
+	header->hotRegions = config->hotRegions;
+	header->sigmaFraction = config->sigmaFraction;
+	header->sigmaModules = config->sigmaModules;
+	header->driftDistance = config->driftDistance;
+	header->modulePorts = config->modulePorts;
+	header->moduleLines = config->moduleLines;
+	header->coalesceReads = config->coalesceReads ? 1 : 0;
+	header->cacheSets = config->cacheSets;
+	header->cacheWays = config->cacheWays;
+	header->writeBuffer = config->writeBuffer;
+	header->patternHash = config->patterns.hash;
+	save_random_state(header->randomState);
+}
+
+//Run one of the simulations of a variance-reduced point for (cycles) cycles, recording its batch means in (batches)
+//and, when (control) is not NULL, its control variate there. With (common) random numbers it draws from fresh
+//streams of its own, otherwise from the caller's stream. (mirrored) runs it on the antithetic draws.
+static void simulate_replica(const simulatorConfig* config,distribution dist,int processCount,int modules,bool common,bool mirrored,
+	int cycles,batchMeans* batches,requestControl* control,simulationResult* result){
+	simulator sim;
+	threadRandom* streams = common ? open_common_streams((unsigned int) config->seed,processCount) : NULL;
+
+	setup_simulator(&sim,processCount,modules,config);
+	sim.streams = streams;
+	sim.scaledDraws = common;
+	sim.locality.scaledDraws = common;
+	sim.cycleLimit = cycles;
+	sim.batches = batches;
+	sim.control = control;
+
+	if(common){
+		mirror_common_streams(streams,processCount,mirrored);
+	} else {
+		mirror_random(mirrored);
+	}
+	run_simulator(&sim,dist,NULL);
+	if(!common){
+		mirror_random(false);
+	}
+
+	*result = sim.result;
+	free_simulator(&sim);
+	close_common_streams(streams);
+}
+
+//Simulate a point twice more, plainly and each with its own seed, for the (config)'s summary to compare the
+//variance reduction with. The caller's stream is left alone.
+static void probe_point(const simulatorConfig* config,distribution dist,int processCount,int modules){
+	threadRandom stream;
+	threadRandom* previous = use_thread_random(&stream);
+	simulationResult results[2];
+	batchMeans batches;
+	int i;
+
+	for(i = 0; i < 2; i++){
+		seed_random(point_seed(config->seed,dist,processCount,-1 - modules - i * DEFAULT_MAX_MEMORY_MODULES));
+		init_batches(&batches);
+		simulate_replica(config,dist,processCount,modules,false,false,config->varianceCycles,&batches,NULL,&(results[i]));
+		free_batches(&batches);
+	}
+	switch_thread_random(previous);
+
+	account_probe(config->varianceReport,dist,results[0].waitTime,results[1].waitTime);
+}
+
+//Whether the antithetic draws of a point only relabel its modules. They turn a module into its mirror image,
+//which uniform requests to modules that are all alike cannot tell apart, so its replica would repeat it exactly.
+static bool mirror_symmetric(const simulatorConfig* config,distribution dist){
+	return dist == Uniform && config->overrideCount == 0 && config->nodeCount == 1;
+}
+
+//Simulate a point with the variance reduction of the session. Every simulation of the point (the first one
+//and its antithetic replica) runs for the session's variance cycles, so that their batches line up and so that
+//neighbouring points with common random numbers stay in step until the end.
+//Without common random numbers the replica starts from the caller's stream where the first simulation did,
+//and the stream is left where the first one left it, as if the point had been simulated once.
+//The control needs requests that are uniform over all the modules, which requests kept on the local node are not.
+static void simulate_reduced(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* result){
+	int modes = config->varianceReduction;
+	bool common = (modes & VarianceCommon) != 0;
+	bool controlled = (modes & VarianceControl) != 0 && dist == Uniform && (config->nodeCount == 1 || config->localRatio == 0.0);
+	int replicas = (modes & VarianceAntithetic) != 0 && !mirror_symmetric(config,dist) ? 2 : 1;
+	char start[RANDOM_STATE_BYTES],end[RANDOM_STATE_BYTES];
+	batchMeans targets[2],controlBatches[2];
+	requestControl controls[2];
+	double targetWaits[2],controlMeans[2];
+	double localWait = 0.0,remoteWait = 0.0;
+	varianceEstimate estimate;
+	int r;
+
+	if(!common){
+		save_random_state(start);
+	}
+
+	for(r = 0; r < replicas; r++){
+		simulationResult replica;
 
+		init_batches(&(targets[r]));
+		if(controlled){
+			setup_request_control(&(controls[r]),modules);
+		}
+		if(!common && r > 0){
+			restore_random_state(start);
+		}
+		simulate_replica(config,dist,processCount,modules,common,r == 1,config->varianceCycles,&(targets[r]),controlled ? &(controls[r]) : NULL,&replica);
+
+		targetWaits[r] = replica.waitTime;
+		localWait += replica.localWait / replicas;
+		remoteWait += replica.remoteWait / replicas;
+		if(controlled){
+			controlBatches[r] = controls[r].batches;
+			controlMeans[r] = controls[r].sum / replica.cycles;
+		}
+
+		if(r == 0){
+			*result = replica;
+			if(!common){
+				save_random_state(end);
+			}
+		}
+	}
+
+	if(!common){
+		restore_random_state(end);
+	}
+
+	combine_replicas(targets,targetWaits,controlled ? controlBatches : NULL,controlMeans,replicas,&estimate);
+	if(config->varianceReport != NULL){
+		if(modules % VARIANCE_PROBE_SPACING == 0){
+			probe_point(config,dist,processCount,modules);
+		}
+		account_variance(config->varianceReport,dist,processCount,modules,&estimate);
+	}
+
+	//The local and remote parts of the wait are the replicas' averages.
+	result->waitTime = estimate.wait;
+	result->localWait = localWait;
+	result->remoteWait = remoteWait;
+
+	for(r = 0; r < replicas; r++){
+		free_batches(&(targets[r]));
+		if(controlled){
+			free_request_control(&(controls[r]));
+		}
+	}
+}
+
+//Set up, run and free the simulation of one sweep point and store its outcome in (result).
+void simulate_point(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* result){
+	simulator sim;
+	long started = stats_now();
+	unsigned int seed = point_seed(config->seed,dist,processCount,modules);
+	bool traced = config->tracePath != NULL && config->traceProcessors == processCount && config->traceModules == modules && config->traceDist == dist;
+	bool sampled = config->seriesPath != NULL && config->seriesProcessors == processCount && config->seriesModules == modules && config->seriesDist == dist;
+
+	stats_point_started(processCount,modules,dist);
+
+	//A point computed by an earlier session with the same parameters is not simulated again.
+	//Traced and sampled points always run, since the trace or series is what the caller asked for.
+	if(!traced && !sampled && cache_lookup(config,dist,processCount,modules,result)){
+		stats_point_finished(stats_now() - started);
+		return;
+	}
+
+	if(config->seedPerPoint){
+		seed_random(seed);
+	}
+
+	if(traced){
+		traceHeader header;
+		fill_trace_header(&header,config,config->seedPerPoint ? seed : (unsigned int) config->seed,dist,processCount,modules);
+		if(!trace_open(config->tracePath,&header)){
+			fprintf(stderr,"Could not record trace %s\n",config->tracePath);
+		}
+	}
+
+	if(sampled && !series_open(dist,processCount,modules)){
+		fprintf(stderr,"Could not record module series of point %d,%d\n",processCount,modules);
+	}
+
+	if(config->varianceReduction != VarianceNone){
+		simulate_reduced(config,dist,processCount,modules,result);
+	} else {
+		setup_simulator(&sim,processCount,modules,config);
+		run_simulator(&sim,dist,NULL);
+		*result = sim.result;
+		free_simulator(&sim);
+	}
+
+	if(sampled && series_active() && !series_close(config->seriesPath,result->cycles,result->waitTime)){
+		fprintf(stderr,"Could not write module series %s\n",config->seriesPath);
+	}
+
+	if(traced && trace_active() && !trace_close(result->cycles,result->waitTime)){
+		fprintf(stderr,"Could not write trace %s\n",config->tracePath);
+	}
+
+	cache_store(config,dist,processCount,modules,result);
+
+	stats_point_finished(stats_now() - started);
+}
+
+//Simulate the point (modules) of a pruned row in place of its estimate, keeping the estimate beside it.
+static void simulate_anchor(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* results,modelDeviation* deviation){
+	double estimate = results[modules].modelWait;
+
+	simulate_point(config,dist,processCount,modules,&(results[modules]));
+	results[modules].modeled = true;
+	results[modules].modelWait = estimate;
+	results[modules].estimated = false;
+	record_deviation(deviation,estimate,results[modules].waitTime);
+	deviation->estimated--;
+}
+
+//Decide the points strictly between the simulated points (low) and (high) of a pruned row.
+//When the estimate is within tolerance at both ends it is kept for the whole interval; otherwise
+//the middle point is simulated and both halves are decided the same way.
+static void refine_interval(const simulatorConfig* config,distribution dist,int processCount,int low,int high,simulationResult* results,modelDeviation* deviation){
+	int middle = low + (high - low) / 2;
+
+	if(high - low < 2){
+		return;
+	}
+
+	if(fabs(results[low].modelWait - results[low].waitTime) <= config->modelTolerance &&
+		fabs(results[high].modelWait - results[high].waitTime) <= config->modelTolerance){
+		return;
+	}
+
+	simulate_anchor(config,dist,processCount,middle,results,deviation);
+	refine_interval(config,dist,processCount,low,middle,results,deviation);
+	refine_interval(config,dist,processCount,middle,high,results,deviation);
+}
+
+//Compute every module count of one processor configuration and queue them as rows of (writer).
+//The session's writer has one stream per distribution, indexed by the distribution.
+//With a model tolerance, points are estimated first; every MODEL_ANCHOR_SPACING-th point (and the traced
+//point) is simulated and the estimate is only kept between simulated points where it was close enough.
+static void sweep_row(resultWriter* writer,const simulatorConfig* config,distribution dist,int processCount,int modules,modelDeviation* deviation){
+	int moduleCount,low,high;
+
+	if(config->modelTolerance <= 0.0){
+		for(moduleCount = 1;moduleCount < modules + 1;moduleCount++){
 
 			//Setup run, and free a simulation cycle and write the data to the data files.
-			simulator sim;
-			setup_simulator(&sim,processorConfigs[i],moduleCount);
+			simulationResult result;
+			simulate_point(config,dist,processCount,moduleCount,&result);
+			put_result(writer,dist,&result);
+		}
+		return;
+	}
 
-			run_simulator(&sim,uniform,uniformFile);
+	simulationResult* results = (simulationResult*) malloc((modules + 1) * sizeof(simulationResult));
+
+	//Estimates are cheap, so every point gets one; they are reported beside the simulated points too.
+	long started = stats_now();
+	for(moduleCount = 1;moduleCount < modules + 1;moduleCount++){
+		estimate_point(config,dist,processCount,moduleCount,&(results[moduleCount]));
+		deviation->estimated++;
+	}
+	long estimateTime = (stats_now() - started) / modules;
 
-			free_simulator(&sim);
+	for(low = 1; low < modules; low = high){
+		high = low + MODEL_ANCHOR_SPACING < modules ? low + MODEL_ANCHOR_SPACING : modules;
+
+		if(low == 1){
+			simulate_anchor(config,dist,processCount,low,results,deviation);
 		}
+		simulate_anchor(config,dist,processCount,high,results,deviation);
+
+		refine_interval(config,dist,processCount,low,high,results,deviation);
 	}
 
-	//Close file.
-	fclose(uniformFile);
+	if(modules == 1){
+		simulate_anchor(config,dist,processCount,1,results,deviation);
+	}
 
-	FILE* gaussianFile;
+	//Traced and sampled points are always simulated, since the trace or series is what the caller asked for.
+	if(config->tracePath != NULL && config->traceDist == dist && config->traceProcessors == processCount &&
+		config->traceModules <= modules && results[config->traceModules].estimated){
+		simulate_anchor(config,dist,processCount,config->traceModules,results,deviation);
+	}
+	if(config->seriesPath != NULL && config->seriesDist == dist && config->seriesProcessors == processCount &&
+		config->seriesModules <= modules && results[config->seriesModules].estimated){
+		simulate_anchor(config,dist,processCount,config->seriesModules,results,deviation);
+	}
 
-	//This file will be used for storing results from simulations where the distribution of 
-	//memory module access requests is Uniform.
-	gaussianFile = fopen(gaussianLogs,"w");
-	fprintf(gaussianFile, "processors,memory modules,wait-times\n");
+	//Simulated points were counted by simulate_point(); the estimated ones are published as they are written.
+	for(moduleCount = 1;moduleCount < modules + 1;moduleCount++){
+		if(results[moduleCount].estimated){
+			stats_point_started(processCount,moduleCount,dist);
+			stats_point_finished(estimateTime);
+		}
+		put_result(writer,dist,&(results[moduleCount]));
+	}
+
+	free(results);
+}
+
+//Print how far the estimates of a pruned sweep were from the simulated points.
+static void report_deviation(const char* name,const modelDeviation* deviation){
+	printf("Model (%s): %ld points simulated, %ld estimated; estimates were off by %f on average and %f at most\n",name,
+		deviation->simulated,deviation->estimated,deviation->simulated > 0 ? deviation->totalDeviation / deviation->simulated : 0.0,deviation->maxDeviation);
+}
+
+//This will run the whole simulation session for different processor configurations (defined in parameter 'processorConfigs')
+//It will run simulation cycles from configurations of 1 to (modules) memory modules.
+
+//It will write the data into log files (*.csv files) for future reference that can be used by outside libraries to create plots
+void run_session(int* processorConfigs,int configSize,int modules,const char* uniformLogs,const char* gaussianLogs,const simulatorConfig* config){
+	int i;
+	simulatorConfig defaults,session;
+	modelDeviation uniformDeviation,gaussianDeviation;
+	varianceSummary summary;
+
+	if(config == NULL){
+		default_config(&defaults);
+		config = &defaults;
+	}
+
+	//The session's variance-reduced points are added to a summary of its own.
+	session = *config;
+	session.varianceReport = &summary;
+	config = &session;
+
+	//Both distributions are run for every processor configuration and module count.
+	stats_begin_session(2L * configSize * modules,1);
+	stats_set_worker(0);
+	init_deviation(&uniformDeviation);
+	init_deviation(&gaussianDeviation);
+	begin_variance_summary(&summary);
+
+	//Run with both Uniform and Gaussian distributions
+	distribution uniform = Uniform;
+	distribution gaussian = Gaussian;
+
+	//Open both log files for writing.
+	//The first will be used for storing results from simulations where the distribution of
+	//memory module access requests is Uniform, the second for Gaussian requests.
+	//Rows are written by a writer thread so the simulation never waits for the disk.
+	resultWriter writer;
+	const char* paths[2] = {uniformLogs,gaussianLogs};
+	if(!writer_open(&writer,paths,2,config->logSync)){
+		fprintf(stderr,"Could not open the logs %s and %s\n",uniformLogs,gaussianLogs);
+		stats_end_session();
+		return;
+	}
+	put_log_header(&writer,uniform,config);
+	put_log_header(&writer,gaussian,config);
 
 	//Run one simulation cycle each for each processor and memory module configuration
 	for(i = 0; i < configSize;i++){
-		for(moduleCount = 1;moduleCount < modules + 1;moduleCount++){
+		sweep_row(&writer,config,uniform,processorConfigs[i],modules,&uniformDeviation);
+	}
 
-			//Setup run, and free a simulation cycle and write the data to the data files for gaussian distributions.
-			simulator sim;
-			setup_simulator(&sim,processorConfigs[i],moduleCount);
+	//Run one simulation cycle each for each processor and memory module configuration
+	for(i = 0; i < configSize;i++){
 
-			run_simulator(&sim,gaussian,gaussianFile);
+		//Setup run, and free a simulation cycle and write the data to the data files for gaussian distributions.
+		sweep_row(&writer,config,gaussian,processorConfigs[i],modules,&gaussianDeviation);
+	}
 
-			free_simulator(&sim);
-		}
+	//Wait for the writer thread to finish and close the files.
+	if(!writer_close(&writer)){
+		fprintf(stderr,"Could not write the logs %s and %s\n",uniformLogs,gaussianLogs);
+	}
+
+	if(config->modelTolerance > 0.0){
+		report_deviation("uniform",&uniformDeviation);
+		report_deviation("gaussian",&gaussianDeviation);
+	}
+	if(config->varianceReduction != VarianceNone){
+		report_variance(stdout,&summary,config->varianceReduction,config->varianceCycles);
 	}
 
-	//Close file.
-	fclose(gaussianFile);
+	stats_end_session();
 }
 
@@ -4,20 +4,144 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "queue.h"
+#include "timing_wheel.h"
+#include "topology.h"
+#include "arrivals.h"
+#include "locality.h"
+#include "trace.h"
+#include "result_writer.h"
+#include "placement.h"
+#include "variance.h"
+#include "processor_cache.h"
+#include "write_buffer.h"
+#include "pattern_vm.h"
 
 #define DEFAULT_MAX_MEMORY_MODULES 2048
 #define PROCESSOR_CONFIGURATION_COUNT 6
+#define DEFAULT_SERVICE_LATENCY 1
+#define DEFAULT_MODULE_PORTS 1
+#define MAX_MODULE_PORTS 16
+#define DEFAULT_MODULE_LINES 64	//Lines of a module requests address when they need a line but none was given
+#define MAX_MODULE_LINES (1 << 20)
+
+//Rules of the model that decide a point's result. Bump the model version whenever a change
+//to the simulator alters the result of an existing configuration, so cached results are not reused.
+#define SIMULATOR_MODEL_VERSION 1
+#define GAUSSIAN_SIGMA_DIVISOR 3.0	//By default the sigma of the Gaussian requests is the module count divided by this
+#define CONVERGENCE_THRESHOLD 0.0002	//A point ends when the average wait changes by less than this fraction
+#define OPEN_LOOP_BATCH_CYCLES 1024	//Open-loop points check their request wait this often
+#define OPEN_LOOP_TOLERANCE 0.01	//and end when it changed by less than this fraction over a batch
+#define OPEN_LOOP_MAX_CYCLES (1 << 18)	//Overloaded open-loop points never settle; they end here
+#define LOG_ROW_LENGTH 4096	//Longest row of a log file (every %f column fits in a few hundred characters)
 
 typedef enum  {
 	Uniform = 0,
 	Gaussian = 1
 } distribution;
 
+//Waiting queue of a memory module. The processes waiting are linked through the simulator's (nextWaiting),
+//which works because a process waits for a single module at a time.
 typedef struct memoryQueue {
-	int attachedProcess;
-	node* queue;
+	int head;	//First process waiting for the module (-1 when none waits)
+	int tail;	//Last process waiting for it
+	int length;	//Number of processes waiting in the queue
+	int nextPort;	//Port taken over when the module is handed to a process while all of its ports are held
 } memoryQueue;
 
+//Service latency override for a single memory module (e.g. a slower bank)
+typedef struct moduleLatency {
+	int module;
+	int readLatency;
+	int writeLatency;
+} moduleLatency;
+
+//Parameters shared by every simulation of a session.
+typedef struct simulatorConfig {
+	int readLatency;	//Cycles a memory module stays busy servicing a read
+	int writeLatency;	//Cycles a memory module stays busy servicing a write
+	double writeRatio;	//Fraction of generated requests that are writes
+	int modulePorts;	//Requests a memory module serves at once
+	int moduleLines;	//Lines of a module a request addresses when reads are coalesced or cached (0 = DEFAULT_MODULE_LINES)
+	bool coalesceReads;	//Serve the reads queued at a module for the same line together
+	int cacheSets;	//Sets of every processor's private cache, a power of two (0 = no caches)
+	int cacheWays;	//Ways of every set of the private caches
+	int writeBuffer;	//Writes each processor's buffer holds while they drain to their modules (0 = writes stall like reads)
+
+	moduleLatency* overrides;	//Per-module latencies that replace the defaults above
+	int overrideCount;
+
+	patternSet patterns;	//Access pattern programs the processors pick their requests with (none = draws from the distribution)
+
+	int nodeCount;	//NUMA nodes the processors and modules are split into (1 = flat machine)
+	int remoteLatency;	//Extra cycles of an access to another node's module
+	int linkBandwidth;	//Remote accesses the inter-node link carries per cycle (0 = unlimited)
+	double localRatio;	//Probability a request is redirected to the processor's local module pool
+
+	int seed;	//Seed of the random number generator for the session
+	bool seedPerPoint;	//Reseed before every sweep point so points can be computed in any order or process
+
+	const char* tracePath;	//Binary event trace of one point (NULL disables tracing)
+	int traceProcessors;	//Point to trace
+	int traceModules;
+	distribution traceDist;
+
+	const char* seriesPath;	//Per-module utilization and queue depth series of one point (NULL disables it)
+	int seriesProcessors;	//Point to record
+	int seriesModules;
+	distribution seriesDist;
+
+	arrivalProcess arrivals;	//Closed loop (the original model), or how open-loop requests arrive
+	double arrivalRate;	//Mean requests per cycle of each open-loop processor
+	int burstCycles;	//Mean length of the on periods of on-off arrivals
+	int idleCycles;	//Mean length of the off periods
+	int thinkCycles;	//Cycles an open-loop processor pauses after a grant before issuing its next request
+	int outstandingLimit;	//Requests an open-loop processor holds at most; further arrivals are dropped (0 = unlimited)
+
+	double sigmaFraction;	//Sigma of the Gaussian requests as a fraction of the module count (0 = 1 / GAUSSIAN_SIGMA_DIVISOR)
+	double sigmaModules;	//Sigma as an absolute number of modules; overrides (sigmaFraction) when set
+	int driftEpoch;	//Cycles between drifts of the processors' Gaussian means (0 = fixed means)
+	double driftDistance;	//Largest move of a mean per epoch as a fraction of the modules (1 or more draws it anew)
+	int hotRegions;	//Hot regions whose means the processors share (0 = every processor has its own)
+
+	double modelTolerance;	//Largest |estimate - simulation| for which sweep points are estimated instead of simulated (0 simulates all)
+	writerSync logSync;	//How the writer thread pushes the logs of a session to the disk
+	placementPolicy placement;	//Cores the sweep workers are pinned to, and whose node holds their state
+	hugePagePolicy hugePages;	//Pages backing the workers' simulator state
+	int varianceReduction;	//varianceMode flags of the sweep points (VarianceNone simulates each point once)
+	int varianceCycles;	//Length of every simulation of a variance-reduced point, which does not wait for convergence
+	varianceSummary* varianceReport;	//Summary the variance-reduced points are added to (NULL keeps none); run_session points it at its own
+} simulatorConfig;
+
+//Outcome of simulating one (processors, memory modules) point.
+typedef struct simulationResult {
+	int processCount;
+	int moduleCount;
+	int cycles;
+	double waitTime;
+
+	bool numa;	//Whether the local and remote parts below are meaningful
+	double localWait;
+	double remoteWait;
+
+	bool openLoop;	//Whether the open-loop measurements below are meaningful
+	double offeredLoad;	//Requests arriving per module per cycle
+	double throughput;	//Requests granted per module per cycle
+	double requestWait;	//Mean cycles from a request's arrival to its grant, beyond the one it takes uncontended
+	double dropped;	//Share of arrivals refused because the processor's outstanding limit was reached
+
+	bool cached;	//Whether the private cache measurements below are meaningful
+	double hitRate;	//Share of the requests served by the processors' caches
+	double missWait;	//Mean cycles a request that missed waited for its module
+
+	bool buffered;	//Whether the read and write stalls below are meaningful
+	double readStall;	//Part of the wait time processors spent on their reads
+	double writeStall;	//Part of the wait time processors spent waiting for room in their full write buffer
+
+	bool modeled;	//Whether the analytical model columns below are meaningful
+	double modelWait;	//Wait time predicted by estimate_point()
+	bool estimated;	//Whether (waitTime) is the prediction rather than a simulation
+} simulationResult;
+
 typedef struct simulator {
 	int* processes;
 	int* waitTimes;
@@ -25,23 +149,86 @@ typedef struct simulator {
 	int* memories;
 	memoryQueue* queues;
 
+	bool* writes;	//Whether each processor's current request is a write
+	int* readyCycles;	//Cycle from which each processor's current access has been serviced
+	int* issuedWaits;	//Wait total of each processor when its current request was issued
+	int ports;	//Requests a memory module serves at once
+	int* holders;	//Process each port of every module was handed to, (ports) per module (-1 = free)
+	int* nextWaiting;	//Process queued behind each waiting process (-1 at the back of its queue)
+	bool* queued;	//Whether each process waits in the queue of its module
+	int lineCount;	//Lines of a module a request addresses
+	int* lines;	//Line of each processor's current request (NULL when requests only name a module)
+	int* merged;	//Module whose access each processor's read was merged into (-1 = none; NULL without coalescing)
+	processorCache cache;	//Private caches of the processors
+	bool* hitting;	//Whether each processor's current request is served by its cache (NULL without caches)
+	long missWaits;	//Cycles the requests that missed the caches waited, and their number
+	long missGrants;
+	writeBuffers buffers;	//Write buffers of the processors
+	patternVm vm;	//State of the processors' access pattern programs
+	int agentCount;	//Processors and the agents draining their write buffers, which follow them in the per-process arrays
+	int* readLatency;	//Busy time of each memory module for reads
+	int* writeLatency;	//Busy time of each memory module for writes
+	int maxLatency;
+	double writeRatio;
+	timingWheel wheel;	//Pending module completion events
+	int* fired;	//Scratch array receiving the modules that complete on a cycle
+	topology topo;	//Node layout and interconnect state of a NUMA machine
+	localityEngine locality;	//Means and sigma of the Gaussian requests
+	arrivalSource arrivals;	//Open-loop request generators
+	int* backlogs;	//Requests that arrived at each open-loop processor and were not issued yet
+	int* thinkUntil;	//Cycle from which each open-loop processor may issue its next request
+	int thinkCycles;
+	int outstandingLimit;
+	simulationResult result;	//Filled in by run_simulator()
+
+	threadRandom* streams;	//Own stream of every processor and one for the drift (NULL draws from the caller's stream)
+	bool scaledDraws;	//Draw modules with scaled_draw(), so that neighbouring module counts draw alike
+	int cycleLimit;	//Cycles to run for instead of until the wait converges (0 = until it converges)
+	int warmCycle;	//Last cycle the caches filled an empty way or the write buffers held more writes than ever before
+	long warmFills;	//Fills and peak of the caches and buffers at (warmCycle)
+	int warmPeak;
+	batchMeans* batches;	//Receives the mean wait of every batch of cycles (NULL = not recorded)
+	requestControl* control;	//Control variate fed by every request (NULL = none)
+	long* waitCounts;	//Granted requests by the cycles they waited, the last entry counting all longer waits (NULL = not counted)
+	int waitCountSize;
+
 	int processCount;
 	int moduleCount;
 } simulator;
 
 int uniformRange(int min, int max);
-static double randGauss(double mean,double sigma);
+int uniform_request(int modules);
+int gaussian_request(double mean,double sigma,int modules);
 
 void init_queue(memoryQueue* memQueue);
-void pushMemQueue(memoryQueue* memQueue,int process);
+void pushMemQueue(simulator* sim,int module,int process);
+int popMemQueue(simulator* sim,int module);
 
-bool check_availability(int process,memoryQueue* memQueue);
+bool check_availability(simulator* sim,int process,int module);
 
-void setup_simulator(simulator* sim,int processCount,int modules);
+void default_config(simulatorConfig* config);
+int load_latency_overrides(simulatorConfig* config,const char* path);
+void free_config(simulatorConfig* config);
+bool validate_config(const simulatorConfig* config,int workers);
+
+int service_latency(simulator* sim,int module,bool write);
+
+void setup_simulator(simulator* sim,int processCount,int modules,const simulatorConfig* config);
 void run_simulator(simulator* sim,distribution dist,FILE* file);
+void start_simulator(simulator* sim,distribution dist);
+void step_simulator(simulator* sim,distribution dist,int cycle);
+void copy_simulator(simulator* destination,const simulator* source);
 void free_simulator(simulator* sim);
 
 double getAverageWaitTime(simulator* sim,int requests);
-void run_session(int* processorConfigs,int configSize,int modules,const char* uniformLogs,const char* gaussianLogs);
+
+unsigned int point_seed(int seed,distribution dist,int processCount,int modules);
+void fill_trace_header(traceHeader* header,const simulatorConfig* config,unsigned int seed,distribution dist,int processCount,int modules);
+void simulate_point(const simulatorConfig* config,distribution dist,int processCount,int modules,simulationResult* result);
+void write_log_header(FILE* file,const simulatorConfig* config);
+void write_result(FILE* file,const simulationResult* result);
+void put_log_header(resultWriter* writer,int stream,const simulatorConfig* config);
+void put_result(resultWriter* writer,int stream,const simulationResult* result);
+void run_session(int* processorConfigs,int configSize,int modules,const char* uniformLogs,const char* gaussianLogs,const simulatorConfig* config);
 
 #endif
@@ -0,0 +1,271 @@
+#include "slo_search.h"
+#include "rng.h"
+
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+//Implementation in C of the search for the smallest module count that meets a wait-time objective.
+//The wait falls as modules are added, but every simulation of a point is noisy, so the search treats
+//run_simulator() as a noisy monotone oracle: a point is simulated with independent seeds until its
+//confidence interval lies on one side of the target. An exponential search brackets the answer and a
+//bisection narrows the bracket, both simulating (threads) module counts at a time.
+//The simulations run for a fixed number of cycles: the convergence rule of the sweep stops a point
+//whose processors have not waited yet after two cycles, which would make its replicas agree on nothing.
+
+//One module count simulated by a thread of a round.
+typedef struct sloJob {
+	const simulatorConfig* config;
+	const sloTarget* target;
+	distribution dist;
+	int processCount;
+	sloPoint* point;
+	threadRandom stream;
+	pthread_t thread;
+} sloJob;
+
+//Wait below which (percentile) percent of the requests counted in (counts) were granted.
+static double wait_percentile(const long* counts,int size,double percentile){
+	long total = 0,seen = 0;
+	int wait;
+
+	for(wait = 0; wait < size; wait++){
+		total += counts[wait];
+	}
+
+	for(wait = 0; wait < size; wait++){
+		seen += counts[wait];
+		if(seen > 0 && seen >= percentile / 100.0 * total){
+			return wait;
+		}
+	}
+
+	return size - 1;
+}
+
+//Cycles the processors of (sim) waited per request granted, the requests being counted in (counts).
+//The waits of requests still pending count too: a processor that never wins its module is granted nothing.
+static double wait_mean(const simulator* sim,const long* counts,int size){
+	long granted = 0,waited = 0;
+
+	for(int wait = 0; wait < size; wait++){
+		granted += counts[wait];
+	}
+	for(int p = 0; p < sim->processCount; p++){
+		waited += sim->waitTimes[p];
+	}
+
+	return granted > 0 ? (double) waited / granted : 0.0;
+}
+
+//Simulate the (replica)-th independent run of a point and return its metric. Replica 0 has the seed
+//--seed-per-point gives the point in a sweep.
+static double simulate_metric(const sloJob* job,int modules,int replica,long* counts){
+	simulator sim;
+	double metric;
+
+	seed_random(point_seed(job->config->seed + replica,job->dist,job->processCount,modules));
+	setup_simulator(&sim,job->processCount,modules,job->config);
+	sim.cycleLimit = job->target->cycles;
+	memset(counts,0,SLO_WAIT_COUNTS * sizeof(long));
+	sim.waitCounts = counts;
+	sim.waitCountSize = SLO_WAIT_COUNTS;
+
+	run_simulator(&sim,job->dist,NULL);
+	metric = job->target->percentile > 0.0 ? wait_percentile(counts,SLO_WAIT_COUNTS,job->target->percentile) : wait_mean(&sim,counts,SLO_WAIT_COUNTS);
+	job->point->cycles += sim.result.cycles;
+	free_simulator(&sim);
+
+	return metric;
+}
+
+//Simulate the point of (job) until it meets or misses the target with 95% confidence, or is a tie.
+static void* evaluate_point(void* argument){
+	sloJob* job = (sloJob*) argument;
+	sloPoint* point = job->point;
+	double values[SLO_MAX_REPLICAS];
+	long* counts = (long*) malloc(SLO_WAIT_COUNTS * sizeof(long));
+	int r,i;
+
+	use_thread_random(&(job->stream));
+	point->verdict = SloTie;
+	point->cycles = 0;
+	if(counts == NULL){
+		return NULL;
+	}
+
+	for(r = 0; r < SLO_MAX_REPLICAS; r++){
+		values[r] = simulate_metric(job,point->modules,r,counts);
+		point->replicas = r + 1;
+		if(point->replicas < SLO_MIN_REPLICAS){
+			continue;
+		}
+
+		double mean = 0.0,spread = 0.0;
+		for(i = 0; i <= r; i++){
+			mean += values[i] / point->replicas;
+		}
+		for(i = 0; i <= r; i++){
+			spread += (values[i] - mean) * (values[i] - mean);
+		}
+		point->mean = mean;
+		point->halfWidth = student_quantile(r) * sqrt(spread / r / point->replicas);
+
+		if(mean + point->halfWidth <= job->target->wait){
+			point->verdict = SloMeets;
+			break;
+		}
+		if(mean - point->halfWidth > job->target->wait){
+			point->verdict = SloMisses;
+			break;
+		}
+	}
+
+	free(counts);
+	return NULL;
+}
+
+//Simulate the (count) module counts of (modules), in increasing order, at the same time and move the bracket
+//(lo, hi] of (answer) with their verdicts: (hi) is the smallest count known to meet the target and (lo) the largest
+//count below it that does not. Ties count as misses, so the answer meets the target with confidence, but only
+//confident misses bound how far below the answer the true count may lie.
+static void evaluate_round(const simulatorConfig* config,const sloTarget* target,distribution dist,int processCount,
+	const int* modules,int count,int* lo,int* hi,int* missed,sloAnswer* answer){
+	sloJob jobs[SLO_MAX_THREADS];
+	sloPoint points[SLO_MAX_THREADS];
+	bool started[SLO_MAX_THREADS];
+	int i;
+
+	for(i = 0; i < count; i++){
+		memset(&(points[i]),0,sizeof(sloPoint));
+		points[i].modules = modules[i];
+		jobs[i].config = config;
+		jobs[i].target = target;
+		jobs[i].dist = dist;
+		jobs[i].processCount = processCount;
+		jobs[i].point = &(points[i]);
+		started[i] = count > 1 && pthread_create(&(jobs[i].thread),NULL,evaluate_point,&(jobs[i])) == 0;
+	}
+
+	//A point whose thread could not start is simulated by the caller, on a stream of its own like the others.
+	for(i = 0; i < count; i++){
+		if(started[i]){
+			pthread_join(jobs[i].thread,NULL);
+		} else {
+			threadRandom* previous = activeRandom;
+			evaluate_point(&(jobs[i]));
+			switch_thread_random(previous);
+		}
+
+		answer->points++;
+		answer->replicas += points[i].replicas;
+		answer->cycles += points[i].cycles;
+	}
+
+	for(i = 0; i < count; i++){
+		if(points[i].verdict == SloMeets && (*hi == 0 || points[i].modules < *hi)){
+			*hi = points[i].modules;
+			answer->point = points[i];
+		}
+	}
+	for(i = 0; i < count; i++){
+		if(points[i].verdict != SloMeets && points[i].modules > *lo && (*hi == 0 || points[i].modules < *hi)){
+			*lo = points[i].modules;
+			if(points[i].verdict == SloMisses){
+				*missed = points[i].modules;
+			}
+		}
+	}
+}
+
+//Find the smallest module count up to (maxModules) whose metric meets (target) for (processCount) processors.
+void search_modules(const simulatorConfig* config,const sloTarget* target,distribution dist,int processCount,int maxModules,sloAnswer* answer){
+	int modules[SLO_MAX_THREADS];
+	int lo = 0,hi = 0,missed = 0;
+	int next = 1;
+	int count,k;
+
+	memset(answer,0,sizeof(sloAnswer));
+
+	//Double the module count until one meets the target.
+	while(hi == 0 && next <= maxModules){
+		count = 0;
+		while(count < target->threads && next <= maxModules){
+			modules[count++] = next;
+			next = next == maxModules ? maxModules + 1 : next * 2 < maxModules ? next * 2 : maxModules;
+		}
+		evaluate_round(config,target,dist,processCount,modules,count,&lo,&hi,&missed,answer);
+	}
+
+	//Split the bracket into (count + 1) even parts and simulate the counts between them.
+	while(hi != 0 && hi - lo > 1){
+		count = hi - lo - 1 < target->threads ? hi - lo - 1 : target->threads;
+		for(k = 1; k <= count; k++){
+			modules[k - 1] = lo + (int) ((long) (hi - lo) * k / (count + 1));
+		}
+		evaluate_round(config,target,dist,processCount,modules,count,&lo,&hi,&missed,answer);
+	}
+
+	answer->modules = hi;
+	answer->lowest = missed + 1;
+}
+
+//Search the smallest module count meeting (target) for every processor configuration and both distributions,
+//and print the answers. Nothing is written to the logs.
+void run_slo_search(int* processorConfigs,int configSize,int maxModules,const simulatorConfig* config,const sloTarget* target){
+	const char* names[2] = {"uniform","gaussian"};
+	sloTarget search = *target;
+	long points = 0,replicas = 0,cycles = 0;
+	int dist,i;
+
+	if(search.threads <= 0){
+		search.threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	search.threads = search.threads < 1 ? 1 : search.threads > SLO_MAX_THREADS ? SLO_MAX_THREADS : search.threads;
+
+	if(search.percentile > 0.0){
+		printf("SLO search: smallest module count whose p%g request wait is at most %g cycles with 95%% confidence, %d counts at a time\n",
+			search.percentile,search.wait,search.threads);
+	} else {
+		printf("SLO search: smallest module count whose average request wait is at most %g cycles with 95%% confidence, %d counts at a time\n",
+			search.wait,search.threads);
+	}
+	if(config->modulePorts > 1 || config->coalesceReads){
+		printf("Modules serve %d requests at once%s\n",config->modulePorts,config->coalesceReads ? " and the queued reads of a line together" : "");
+	}
+	if(config->cacheSets > 0){
+		printf("Processors have private caches of %d sets of %d ways\n",config->cacheSets,config->cacheWays);
+	}
+	if(config->writeBuffer > 0){
+		printf("Processors buffer up to %d writes\n",config->writeBuffer);
+	}
+	if(config->patterns.programCount > 0){
+		printf("Processors pick their requests with %d access pattern program%s\n",config->patterns.programCount,config->patterns.programCount > 1 ? "s" : "");
+	}
+
+	for(dist = Uniform; dist <= Gaussian; dist++){
+		for(i = 0; i < configSize; i++){
+			sloAnswer answer;
+
+			search_modules(config,&search,(distribution) dist,processorConfigs[i],maxModules,&answer);
+			points += answer.points;
+			replicas += answer.replicas;
+			cycles += answer.cycles;
+
+			printf("  %s, %d processors: ",names[dist],processorConfigs[i]);
+			if(answer.modules == 0){
+				printf("no count up to %d modules meets the target",maxModules);
+			} else {
+				printf("%d modules (%f +- %f over %d simulations)",answer.modules,answer.point.mean,answer.point.halfWidth,answer.point.replicas);
+				if(answer.lowest < answer.modules){
+					printf(", counts from %d may also meet it within the noise",answer.lowest);
+				}
+			}
+			printf("; %d counts, %d simulations\n",answer.points,answer.replicas);
+		}
+	}
+
+	printf("Simulated %ld module counts (%ld simulations, %ld cycles) instead of the %ld points of a sweep\n",
+		points,replicas,cycles,2L * configSize * maxModules);
+}
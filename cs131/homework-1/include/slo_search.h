@@ -0,0 +1,52 @@
+#ifndef SLO_SEARCH_H
+#define SLO_SEARCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "simulator.h"
+
+#define SLO_MIN_REPLICAS 3	//Independent simulations of a point before it is compared with the target
+#define SLO_MAX_REPLICAS 12	//Simulations after which a point still within the noise of the target counts as a tie
+#define SLO_MAX_THREADS 16
+#define SLO_DEFAULT_CYCLES 8192	//Length of every simulation of the search
+#define SLO_WAIT_COUNTS 65536	//Request waits told apart by the percentile metric; longer waits share the last count
+
+//Wait-time objective of a search: the smallest module count whose metric is at most (wait), with 95% confidence.
+typedef struct sloTarget {
+	double wait;	//Target in cycles
+	double percentile;	//Percentile of the request wait to compare (0 compares the average request wait)
+	int threads;	//Points simulated at once in every round of the search
+	int cycles;	//Length of every simulation, which does not wait for the wait to converge
+} sloTarget;
+
+//Outcome of comparing one point with the target.
+typedef enum {
+	SloMeets = 0,	//Below the target with 95% confidence
+	SloMisses = 1,	//Above the target with 95% confidence
+	SloTie = 2	//Still within the noise of the target after SLO_MAX_REPLICAS simulations
+} sloVerdict;
+
+typedef struct sloPoint {
+	int modules;
+	double mean;	//Mean of the metric over the simulations
+	double halfWidth;	//Half width of its 95% confidence interval
+	int replicas;
+	long cycles;	//Cycles of all its simulations
+	sloVerdict verdict;
+} sloPoint;
+
+//Answer of the search of one processor count and distribution.
+typedef struct sloAnswer {
+	int modules;	//Smallest module count meeting the target (0 when none up to the maximum does)
+	int lowest;	//Smallest module count that may still meet it: one above the largest count that misses it
+	sloPoint point;	//Comparison of (modules)
+	int points;	//Module counts simulated
+	int replicas;	//Simulations of all of them
+	long cycles;
+} sloAnswer;
+
+void search_modules(const simulatorConfig* config,const sloTarget* target,distribution dist,int processCount,int maxModules,sloAnswer* answer);
+void run_slo_search(int* processorConfigs,int configSize,int maxModules,const simulatorConfig* config,const sloTarget* target);
+
+#endif
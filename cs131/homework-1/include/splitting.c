@@ -0,0 +1,388 @@
+#include "splitting.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+//Implementation in C of the RESTART estimator of the tail of the request wait. The trajectories are simulated
+//depth first: a trajectory that climbs over a level runs its copies to their end before it goes on, so only
+//one simulator per nesting depth is ever alive and the copies reuse it.
+
+//State shared by the trajectories of one estimate.
+typedef struct splittingRun {
+	const splittingConfig* splitting;
+	distribution dist;
+	simulator* sims;	//Trajectory of every depth: the main one, then one per nesting of copies
+	threadRandom* streams;	//Own stream of every depth
+	int levelCount;
+	int threshold;
+	int* levelOf;	//Level whose wait every wait up to the threshold is (-1 between levels)
+	int* zoneOf;	//Levels at or below every wait up to the threshold
+	int firstCycle;	//First counted cycle of the main trajectory
+	int endCycle;	//Last cycle of every trajectory
+	int batch;	//Batch of the main trajectory being simulated
+	double* hits;	//Weighted requests that reached every level, per batch
+	long* requests;	//Requests the main trajectory issued, per batch
+	double entered[SPLITTING_MAX_LEVELS + 1];	//Weighted upcrossings into every zone
+	long observed[SPLITTING_MAX_LEVELS + 1];	//Upcrossings into every zone
+	int priors[SPLITTING_MAX_LEVELS + 1];	//Split factor of every zone until enough upcrossings of the next were observed
+	unsigned long copies;	//Copies started so far, which seeds the next one
+	tailEstimate* estimate;
+} splittingRun;
+
+void default_splitting(splittingConfig* splitting){
+	splitting->threshold = 1000;
+	splitting->levelCount = 0;
+	splitting->factor = 0;
+	splitting->cycles = 1 << 20;
+	splitting->warmup = 1 << 16;
+	splitting->batches = SPLITTING_DEFAULT_BATCHES;
+	splitting->seed = 1;
+}
+
+//Seed of the (copy)-th copy of an estimate seeded with (seed).
+static unsigned int copy_seed(unsigned int seed,unsigned long copy){
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned long long fields[2] = {seed,copy};
+	int i;
+
+	for(i = 0; i < 2; i++){
+		hash ^= fields[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return (unsigned int) (hash ^ (hash >> 32));
+}
+
+//Wait of the current request of (process): the cycles it waited since it was issued (0 on the cycle it is granted).
+static inline int request_wait(const simulator* sim,int process){
+	return sim->waitTimes[process] - sim->issuedWaits[process];
+}
+
+//Add the requests of (sim) whose wait reached a level on the last cycle to (reached) and the requests granted on it
+//to (granted). Returns the zone of the state: the number of levels at or below its longest wait.
+static int scan_waits(const splittingRun* run,const simulator* sim,int* reached,int* granted){
+	int longest = 0;
+	int i;
+
+	for(i = 0; i < sim->processCount; i++){
+		int wait = request_wait(sim,i);
+
+		if(wait == 0){
+			(*granted)++;
+		} else if(wait <= run->threshold){
+			if(run->levelOf[wait] >= 0){
+				reached[run->levelOf[wait]]++;
+			}
+			if(wait > longest){
+				longest = wait;
+			}
+		} else {
+			longest = run->threshold;
+		}
+	}
+
+	return run->zoneOf[longest];
+}
+
+//Number of copies a trajectory entering (zone) turns into. The factor follows one over the measured probability of
+//climbing from the zone into the next one, which keeps the number of trajectories about even over the levels;
+//until enough of those climbs were seen it is the pilot's guess. Crossing the threshold itself is not split.
+static int split_factor(const splittingRun* run,int zone){
+	int factor;
+
+	if(zone >= run->levelCount){
+		return 1;
+	}
+	if(run->splitting->factor > 0){
+		return run->splitting->factor;
+	}
+	if(run->observed[zone + 1] < SPLITTING_MIN_OBSERVED){
+		return run->priors[zone];
+	}
+
+	factor = (int) lround(run->entered[zone] / run->entered[zone + 1]);
+	return factor < 1 ? 1 : factor > SPLITTING_MAX_FACTOR ? SPLITTING_MAX_FACTOR : factor;
+}
+
+static void run_trajectory(splittingRun* run,int depth,int born,int zone,int cycle,double* weights);
+
+//Handle trajectory (depth) climbing from zone (zone) into zone (zone + 1) on cycle (cycle): split its weight
+//and run the extra copies from the state it is in now.
+static void climb(splittingRun* run,int depth,int zone,int cycle,double* weights){
+	tailLevel* level = &(run->estimate->levels[zone]);
+	int next = zone + 1;
+	double copyWeights[SPLITTING_MAX_LEVELS + 1];
+	int factor,i;
+
+	run->entered[next] += weights[zone];
+	run->observed[next]++;
+	level->upcrossings++;
+
+	//Copies would not get to simulate a single cycle past the end.
+	factor = cycle < run->endCycle ? split_factor(run,next) : 1;
+	weights[next] = weights[zone] / factor;
+	if(factor == 1){
+		return;
+	}
+
+	level->retrials += factor - 1;
+	memcpy(copyWeights,weights,(next + 1) * sizeof(double));
+
+	for(i = 1; i < factor; i++){
+		copy_simulator(&(run->sims[depth + 1]),&(run->sims[depth]));
+		switch_thread_random(&(run->streams[depth + 1]));
+		seed_random(copy_seed(run->splitting->seed,run->copies++));
+		run_trajectory(run,depth + 1,next,next,cycle + 1,copyWeights);
+	}
+	switch_thread_random(&(run->streams[depth]));
+}
+
+//Simulate trajectory (depth), which is in zone (zone), from cycle (cycle) to the end. A copy (born) at a level ends
+//as soon as it falls back below it; the trajectory that climbed over the level accounts for what lies below.
+static void run_trajectory(splittingRun* run,int depth,int born,int zone,int cycle,double* weights){
+	simulator* sim = &(run->sims[depth]);
+	int reached[SPLITTING_MAX_LEVELS];
+	int j;
+
+	for(; cycle <= run->endCycle; cycle++){
+		int granted = 0;
+
+		memset(reached,0,run->levelCount * sizeof(int));
+		step_simulator(sim,run->dist,cycle);
+		run->estimate->simulatedCycles++;
+
+		int next = scan_waits(run,sim,reached,&granted);
+		if(next < born){
+			return;
+		}
+
+		//Only the main trajectory is a plain simulation, so only its requests are the denominator.
+		if(depth == 0){
+			run->batch = (int) ((long) (cycle - run->firstCycle) * run->splitting->batches / (run->endCycle - run->firstCycle + 1));
+			run->requests[run->batch] += granted;
+		}
+
+		//The cycle of a climb still belongs to the trajectory before it splits.
+		double weight = weights[next < zone ? next : zone];
+		for(j = 0; j < run->levelCount; j++){
+			if(reached[j] > 0){
+				run->hits[run->batch * run->levelCount + j] += reached[j] * weight;
+			}
+		}
+
+		if(next > zone){
+			climb(run,depth,zone,cycle,weights);
+		}
+		zone = next;
+	}
+}
+
+//Decay per cycle of wait of the tail of the pilot, from how many requests reached each wait:
+//the slope of its logarithm between a wait of 1 and the longest wait still reached often enough.
+static double pilot_decay(const long* reached,int threshold){
+	int longest = 0;
+	int wait;
+
+	for(wait = 1; wait <= threshold; wait++){
+		if(reached[wait] >= SPLITTING_MIN_OBSERVED){
+			longest = wait;
+		}
+	}
+
+	if(longest < 2 || reached[longest] >= reached[1]){
+		return 0.0;
+	}
+
+	return log((double) reached[1] / reached[longest]) / (longest - 1);
+}
+
+//Place the levels of (run) below the threshold and guess the split factor of each from the pilot's decay.
+static void place_levels(splittingRun* run,tailEstimate* estimate){
+	int count = run->splitting->levelCount;
+	int j,wait;
+
+	if(count == 0){
+		count = estimate->decay > 0.0 ? (int) ceil(estimate->decay * run->threshold / SPLITTING_LEVEL_DECAY) : SPLITTING_DEFAULT_LEVELS;
+	}
+	count = count > SPLITTING_MAX_LEVELS ? SPLITTING_MAX_LEVELS : count;
+	count = count > run->threshold ? run->threshold : count;
+	count = count < 1 ? 1 : count;
+
+	run->levelCount = count;
+	estimate->levelCount = count;
+
+	for(wait = 0; wait <= run->threshold; wait++){
+		run->levelOf[wait] = -1;
+	}
+	for(j = 0; j < count; j++){
+		estimate->levels[j].wait = (int) ((long) (j + 1) * run->threshold / count);
+		run->levelOf[estimate->levels[j].wait] = j;
+	}
+
+	//Zone z lies between level z - 1 and level z.
+	j = 0;
+	for(wait = 0; wait <= run->threshold; wait++){
+		if(j < count && wait >= estimate->levels[j].wait){
+			j++;
+		}
+		run->zoneOf[wait] = j;
+	}
+
+	for(j = 1; j < count; j++){
+		double factor = estimate->decay > 0.0 ? exp(estimate->decay * (estimate->levels[j].wait - estimate->levels[j - 1].wait)) : 2.0;
+		run->priors[j] = factor > SPLITTING_MAX_FACTOR ? SPLITTING_MAX_FACTOR : factor < 1.0 ? 1 : (int) lround(factor);
+	}
+}
+
+//Estimate the probability that a request of the closed-loop point (processCount, modules, dist) waits at least
+//every level up to (splitting->threshold) cycles. Returns false if the point or the options cannot be estimated.
+bool estimate_tail(const simulatorConfig* config,distribution dist,int processCount,int modules,const splittingConfig* splitting,tailEstimate* estimate){
+	splittingRun run;
+	double weights[SPLITTING_MAX_LEVELS + 1];
+	int cycle,i,j,b;
+
+	if(config->arrivals != ArrivalsClosed || splitting->threshold < 1 || splitting->levelCount < 0 || splitting->factor < 0 ||
+		splitting->warmup < 0 || splitting->batches < 2 || splitting->cycles < splitting->batches){
+		fprintf(stderr,"Splitting needs closed-loop arrivals, a positive threshold, at least 2 batches and a cycle per batch\n");
+		return false;
+	}
+
+	memset(estimate,0,sizeof(tailEstimate));
+	memset(&run,0,sizeof(run));
+	run.splitting = splitting;
+	run.dist = dist;
+	run.threshold = splitting->threshold;
+	run.levelOf = (int*) malloc((run.threshold + 1) * sizeof(int));
+	run.zoneOf = (int*) malloc((run.threshold + 1) * sizeof(int));
+	run.sims = (simulator*) malloc(SPLITTING_MAX_LEVELS * sizeof(simulator));
+	run.streams = (threadRandom*) malloc(SPLITTING_MAX_LEVELS * sizeof(threadRandom));
+	run.estimate = estimate;
+
+	threadRandom* previous = use_thread_random(&(run.streams[0]));
+	seed_random(splitting->seed);
+	setup_simulator(&(run.sims[0]),processCount,modules,config);
+	start_simulator(&(run.sims[0]),dist);
+
+	//The warm-up is also the pilot: how often requests reach every wait tells how fast the tail falls.
+	long* pilot = (long*) calloc(run.threshold + 1,sizeof(long));
+	for(cycle = 2; cycle < 2 + splitting->warmup; cycle++){
+		step_simulator(&(run.sims[0]),dist,cycle);
+
+		for(i = 0; i < processCount; i++){
+			int wait = request_wait(&(run.sims[0]),i);
+			if(wait > estimate->deepest){
+				estimate->deepest = wait;
+			}
+			if(wait > 0 && wait <= run.threshold){
+				pilot[wait]++;
+			}
+		}
+	}
+	estimate->simulatedCycles = splitting->warmup;
+	estimate->decay = pilot_decay(pilot,run.threshold);
+	free(pilot);
+
+	place_levels(&run,estimate);
+	for(j = 1; j < run.levelCount; j++){
+		setup_simulator(&(run.sims[j]),processCount,modules,config);
+	}
+
+	run.firstCycle = 2 + splitting->warmup;
+	run.endCycle = run.firstCycle + splitting->cycles - 1;
+	run.hits = (double*) calloc(splitting->batches * run.levelCount,sizeof(double));
+	run.requests = (long*) calloc(splitting->batches,sizeof(long));
+
+	//The main trajectory may already be above some levels; it has not split, so its weight is 1 everywhere.
+	int unused = 0;
+	int reached[SPLITTING_MAX_LEVELS] = {0};
+	int zone = scan_waits(&run,&(run.sims[0]),reached,&unused);
+	for(j = 0; j <= SPLITTING_MAX_LEVELS; j++){
+		weights[j] = 1.0;
+	}
+	run_trajectory(&run,0,0,zone,run.firstCycle,weights);
+	switch_thread_random(previous);
+
+	//The probability of a level is the ratio of the weighted requests that reached it to the requests issued.
+	//Its confidence interval comes from the spread of that ratio over the batches of the main trajectory.
+	estimate->cycles = splitting->cycles;
+	for(b = 0; b < splitting->batches; b++){
+		estimate->requests += run.requests[b];
+	}
+
+	double meanRequests = (double) estimate->requests / splitting->batches;
+	double quantile = student_quantile(splitting->batches - 1);
+	for(j = 0; j < run.levelCount && estimate->requests > 0; j++){
+		tailLevel* level = &(estimate->levels[j]);
+		double total = 0.0,spread = 0.0;
+
+		for(b = 0; b < splitting->batches; b++){
+			total += run.hits[b * run.levelCount + j];
+		}
+		level->probability = total / estimate->requests;
+
+		for(b = 0; b < splitting->batches; b++){
+			double residual = run.hits[b * run.levelCount + j] - level->probability * run.requests[b];
+			spread += residual * residual;
+		}
+		level->halfWidth = quantile * sqrt(spread / (splitting->batches * (splitting->batches - 1.0))) / meanRequests;
+	}
+
+	for(j = 0; j < run.levelCount; j++){
+		free_simulator(&(run.sims[j]));
+	}
+	free(run.hits);
+	free(run.requests);
+	free(run.levelOf);
+	free(run.zoneOf);
+	free(run.sims);
+	free(run.streams);
+
+	return true;
+}
+
+//Cycles a plain simulation would need to estimate the probability of the threshold as precisely as (estimate),
+//counting the requests that reach it as independent events, which flatters the plain simulation since they come
+//in bursts. Returns 0 when the threshold was not reached.
+double plain_cycles_needed(const tailEstimate* estimate){
+	const tailLevel* top = &(estimate->levels[estimate->levelCount - 1]);
+
+	if(top->probability <= 0.0 || top->halfWidth <= 0.0 || estimate->requests == 0){
+		return 0.0;
+	}
+
+	double relative = top->halfWidth / top->probability;
+	double events = (1.959964 / relative) * (1.959964 / relative);
+
+	return events / (top->probability * estimate->requests / estimate->cycles);
+}
+
+//Print the tail of (estimate) level by level, and what a plain simulation would have cost.
+void report_tail(FILE* out,const tailEstimate* estimate){
+	const tailLevel* top = &(estimate->levels[estimate->levelCount - 1]);
+	int j;
+
+	fprintf(out,"Pilot: longest wait %d cycles",estimate->deepest);
+	if(estimate->decay > 0.0){
+		fprintf(out,", tail falls by e^-1 every %.1f cycles of wait",1.0 / estimate->decay);
+	}
+	fprintf(out,"\n%ld requests over %d counted cycles of the main trajectory\n",estimate->requests,estimate->cycles);
+	fprintf(out,"%8s %14s %14s %9s %12s %10s\n","wait","P(wait >= w)","95% interval","relative","upcrossings","retrials");
+
+	for(j = 0; j < estimate->levelCount; j++){
+		const tailLevel* level = &(estimate->levels[j]);
+
+		fprintf(out,"%8d %14.6e %14.6e %8.1f%% %12ld %10ld\n",level->wait,level->probability,level->halfWidth,
+			level->probability > 0.0 ? 100.0 * level->halfWidth / level->probability : 0.0,level->upcrossings,level->retrials);
+	}
+
+	fprintf(out,"Simulated %ld cycles in all trajectories\n",estimate->simulatedCycles);
+	if(top->probability <= 0.0){
+		fprintf(out,"No request reached a wait of %d cycles; add levels or simulate longer\n",top->wait);
+		return;
+	}
+
+	double plain = plain_cycles_needed(estimate);
+	fprintf(out,"A plain simulation would need about %.3e cycles (%.1fx) for the same precision at a wait of %d\n",
+		plain,plain / estimate->simulatedCycles,top->wait);
+}
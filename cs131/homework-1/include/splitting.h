@@ -0,0 +1,55 @@
+#ifndef SPLITTING_H
+#define SPLITTING_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "simulator.h"
+#include "rng.h"
+
+#define SPLITTING_MAX_LEVELS 32
+#define SPLITTING_MAX_FACTOR 64	//Most copies an upcrossing of a level turns a trajectory into
+#define SPLITTING_DEFAULT_LEVELS 8	//Levels used when the pilot cannot measure how fast the tail decays
+#define SPLITTING_DEFAULT_BATCHES 20
+#define SPLITTING_LEVEL_DECAY 2.0	//Levels are spaced so the tail falls by e^-2 between them, the optimum of RESTART
+#define SPLITTING_MIN_OBSERVED 8	//Upcrossings of the next level needed before a split factor follows its measured probability
+
+//Rare-event estimation of one closed-loop point by multilevel splitting (RESTART). The importance of a state
+//is the longest wait of a pending request. A trajectory that climbs over a level is copied, and the copies
+//live on until they fall back below that level; every request reaching a level is counted with the weight
+//1 / (product of the split factors) of the trajectory that reached it.
+typedef struct splittingConfig {
+	int threshold;	//Wait of the rare event: a request waiting at least this many cycles
+	int levelCount;	//Levels up to and including (threshold), evenly spaced (0 = spaced by the pilot's decay)
+	int factor;	//Split factor of every level (0 = one over the measured probability of reaching the next level)
+	int cycles;	//Cycles of the main trajectory that are counted
+	int warmup;	//Cycles simulated before counting; they are also the pilot that places the levels
+	int batches;	//Batches of the main trajectory whose spread gives the confidence intervals
+	unsigned int seed;
+} splittingConfig;
+
+//Estimated probability that a request waits at least (wait) cycles.
+typedef struct tailLevel {
+	int wait;
+	double probability;
+	double halfWidth;	//Half width of the 95% confidence interval of (probability)
+	long upcrossings;	//Times a trajectory climbed over the level
+	long retrials;	//Copies those upcrossings started
+} tailLevel;
+
+typedef struct tailEstimate {
+	int levelCount;
+	tailLevel levels[SPLITTING_MAX_LEVELS];
+	long requests;	//Requests issued by the main trajectory while counting
+	int cycles;	//Cycles of the main trajectory while counting
+	long simulatedCycles;	//Cycles simulated by all trajectories, the warm-up included
+	double decay;	//Decay of the tail per cycle of wait measured by the pilot (0 when it could not be measured)
+	int deepest;	//Longest wait the pilot saw
+} tailEstimate;
+
+void default_splitting(splittingConfig* splitting);
+bool estimate_tail(const simulatorConfig* config,distribution dist,int processCount,int modules,const splittingConfig* splitting,tailEstimate* estimate);
+double plain_cycles_needed(const tailEstimate* estimate);
+void report_tail(FILE* out,const tailEstimate* estimate);
+
+#endif
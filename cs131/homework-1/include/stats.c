@@ -0,0 +1,162 @@
+#include "stats.h"
+#include "placement.h"
+
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//Implementation in C of the live statistics of a session, published in a memory-mapped stats file
+//that viewers such as memsim-top can read while the sweep runs.
+
+//Segment of the running session (NULL when statistics are disabled) and the worker this process or thread reports as.
+static statsSegment* activeStats = NULL;
+static _Thread_local int activeWorker = 0;
+
+//Current CLOCK_MONOTONIC time in nanoseconds.
+long stats_now(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+//Create (or truncate) the stats file at (path) and map it. Must be called before any worker is forked
+//so that all processes share the mapping. Returns false if the file could not be created.
+bool stats_open(const char* path){
+	int fd = open(path,O_RDWR | O_CREAT | O_TRUNC,0644);
+
+	if(fd < 0){
+		return false;
+	}
+
+	if(ftruncate(fd,sizeof(statsSegment)) < 0){
+		close(fd);
+		return false;
+	}
+
+	statsSegment* segment = (statsSegment*) mmap(NULL,sizeof(statsSegment),PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+
+	if(segment == MAP_FAILED){
+		return false;
+	}
+
+	memset(segment,0,sizeof(statsSegment));
+	segment->version = STATS_VERSION;
+	segment->size = sizeof(statsSegment);
+	segment->pid = (int32_t) getpid();
+
+	//The magic number is written last so a viewer never accepts a half initialized file.
+	atomic_thread_fence(memory_order_release);
+	segment->magic = STATS_MAGIC;
+
+	activeStats = segment;
+	return true;
+}
+
+//Unmap the stats file of the session. The file itself is kept so the final counters can be inspected.
+void stats_close(void){
+	if(activeStats != NULL){
+		munmap(activeStats,sizeof(statsSegment));
+		activeStats = NULL;
+	}
+}
+
+//Record the size of the session's grid and the number of workers computing it.
+void stats_begin_session(long totalPoints,int workers){
+	if(activeStats == NULL){
+		return;
+	}
+
+	atomic_store_explicit(&(activeStats->totalPoints),totalPoints,memory_order_relaxed);
+	atomic_store_explicit(&(activeStats->workerCount),workers < STATS_MAX_WORKERS ? workers : STATS_MAX_WORKERS,memory_order_relaxed);
+	atomic_store_explicit(&(activeStats->finished),0,memory_order_relaxed);
+	atomic_store_explicit(&(activeStats->startNanos),stats_now(),memory_order_relaxed);
+}
+
+//Mark the session as finished.
+void stats_end_session(void){
+	if(activeStats != NULL){
+		atomic_store_explicit(&(activeStats->finished),1,memory_order_relaxed);
+	}
+}
+
+//Select the worker slot the calling process or thread reports its counters in.
+void stats_set_worker(int worker){
+	activeWorker = worker % STATS_MAX_WORKERS;
+}
+
+//Publish the point the worker starts simulating.
+void stats_point_started(int processCount,int modules,distribution dist){
+	if(activeStats == NULL){
+		return;
+	}
+
+	workerStats* worker = &(activeStats->workers[activeWorker]);
+	atomic_store_explicit(&(worker->processors),processCount,memory_order_relaxed);
+	atomic_store_explicit(&(worker->modules),modules,memory_order_relaxed);
+	atomic_store_explicit(&(worker->dist),(int) dist,memory_order_relaxed);
+}
+
+//Publish the end of a point: the time it took.
+void stats_point_finished(long elapsedNanos){
+	if(activeStats == NULL){
+		return;
+	}
+
+	workerStats* worker = &(activeStats->workers[activeWorker]);
+	atomic_fetch_add_explicit(&(worker->points),1,memory_order_relaxed);
+	atomic_fetch_add_explicit(&(worker->busyNanos),elapsedNanos,memory_order_relaxed);
+	atomic_store_explicit(&(worker->processors),0,memory_order_relaxed);
+}
+
+//Add simulated cycles to the worker's counter, and publish the state of its placement arena while the simulation
+//holds its allocations. Simulations call this once every STATS_CYCLE_BATCH cycles and when they end.
+void stats_add_cycles(long cycles){
+	if(activeStats == NULL){
+		return;
+	}
+
+	workerStats* worker = &(activeStats->workers[activeWorker]);
+	atomic_fetch_add_explicit(&(worker->cycles),cycles,memory_order_relaxed);
+	if(activeArena != NULL){
+		atomic_store_explicit(&(worker->arenaBytes),(long) activeArena->used,memory_order_relaxed);
+		atomic_store_explicit(&(worker->arenaLive),activeArena->live,memory_order_relaxed);
+		atomic_store_explicit(&(worker->heapFallbacks),activeArena->fallbacks,memory_order_relaxed);
+	}
+}
+
+//Map an existing stats file read-only for a viewer. Returns NULL if the file is missing,
+//not a stats file or written by an incompatible version.
+statsSegment* stats_map(const char* path){
+	int fd = open(path,O_RDONLY);
+
+	if(fd < 0){
+		return NULL;
+	}
+
+	if(lseek(fd,0,SEEK_END) < (off_t) sizeof(statsSegment)){
+		close(fd);
+		return NULL;
+	}
+
+	statsSegment* segment = (statsSegment*) mmap(NULL,sizeof(statsSegment),PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+
+	if(segment == MAP_FAILED){
+		return NULL;
+	}
+
+	if(segment->magic != STATS_MAGIC || segment->version != STATS_VERSION || segment->size != sizeof(statsSegment)){
+		munmap(segment,sizeof(statsSegment));
+		return NULL;
+	}
+
+	return segment;
+}
+
+//Unmap a stats file mapped by stats_map().
+void stats_unmap(statsSegment* segment){
+	munmap(segment,sizeof(statsSegment));
+}
@@ -0,0 +1,57 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "simulator.h"
+
+#define STATS_MAGIC 0x4d53494dU	//"MSIM"
+#define STATS_VERSION 3
+#define STATS_MAX_WORKERS 64
+#define STATS_CYCLE_BATCH 4096	//Cycles simulated between two updates of the cycle counters
+
+//Counters of one worker (the serial session is worker 0).
+typedef struct workerStats {
+	atomic_long points;	//Sweep points finished
+	atomic_long cycles;	//Memory cycles simulated
+	atomic_long busyNanos;	//Time spent inside simulations
+	atomic_int processors;	//Point being simulated right now (0 when idle)
+	atomic_int modules;
+	atomic_int dist;
+	atomic_long arenaBytes;	//Bytes of the worker's placement arena in use, and the allocations holding them
+	atomic_long arenaLive;
+	atomic_long heapFallbacks;	//Allocations the worker's arena was too full for
+} workerStats;
+
+//Layout of the stats file. Writers only use relaxed atomic stores and increments so publishing
+//never slows the simulation down; readers check (magic), (version) and (size) before using it.
+typedef struct statsSegment {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	int32_t pid;
+
+	atomic_long startNanos;	//CLOCK_MONOTONIC time the session started
+	atomic_long totalPoints;	//Points in the session's grid
+	atomic_int workerCount;
+	atomic_int finished;
+
+	workerStats workers[STATS_MAX_WORKERS];
+} statsSegment;
+
+bool stats_open(const char* path);
+void stats_close(void);
+void stats_begin_session(long totalPoints,int workers);
+void stats_end_session(void);
+void stats_set_worker(int worker);
+void stats_point_started(int processCount,int modules,distribution dist);
+void stats_point_finished(long elapsedNanos);
+void stats_add_cycles(long cycles);
+long stats_now(void);
+
+statsSegment* stats_map(const char* path);
+void stats_unmap(statsSegment* segment);
+
+#endif
@@ -0,0 +1,96 @@
+#include "timing_wheel.h"
+#include "placement.h"
+
+#include <string.h>
+
+//Implementation in C of a hashed timing wheel used to schedule memory module completion events.
+
+//Initialize a wheel for (modules) memory modules whose events are never scheduled
+//more than (maxDelay) cycles ahead of the current cycle.
+void init_wheel(timingWheel* wheel,int modules,int maxDelay){
+	int i;
+
+	//Round the number of slots up to a power of two strictly larger than the longest delay
+	//so that an event never shares its slot with one from a later rotation of the wheel.
+	wheel->slotCount = 2;
+	while(wheel->slotCount <= maxDelay){
+		wheel->slotCount <<= 1;
+	}
+	wheel->mask = wheel->slotCount - 1;
+	wheel->moduleCount = modules;
+	wheel->pending = 0;
+
+	wheel->slots = (int*) placed_malloc(wheel->slotCount * sizeof(int));
+	wheel->next = (int*) placed_malloc(modules * sizeof(int));
+	wheel->due = (int*) placed_malloc(modules * sizeof(int));
+
+	for(i = 0; i < wheel->slotCount; i++){
+		wheel->slots[i] = -1;
+	}
+
+	for(i = 0; i < modules; i++){
+		wheel->next[i] = -1;
+		wheel->due[i] = -1;
+	}
+}
+
+//Check if a memory module already has a completion event waiting in the wheel.
+bool wheel_pending(timingWheel* wheel,int module){
+	return wheel->due[module] >= 0;
+}
+
+//Schedule the completion event of a memory module for the end of cycle (cycle).
+//A module may only have one pending event, so callers check wheel_pending() first.
+void wheel_schedule(timingWheel* wheel,int module,int cycle){
+	int slot = cycle & wheel->mask;
+
+	wheel->due[module] = cycle;
+	wheel->next[module] = wheel->slots[slot];
+	wheel->slots[slot] = module;
+	wheel->pending++;
+}
+
+//Remove every event due on cycle (cycle) from the wheel and store the fired modules in (fired).
+//Events that hash to the same slot but belong to a later rotation stay in the wheel.
+//Returns the number of modules written to (fired).
+int wheel_advance(timingWheel* wheel,int cycle,int* fired){
+	int slot = cycle & wheel->mask;
+	int cursor = wheel->slots[slot];
+	int count = 0;
+
+	//Detach the slot's list first so that handlers can safely reschedule into the same slot.
+	wheel->slots[slot] = -1;
+
+	while(cursor != -1){
+		int following = wheel->next[cursor];
+
+		if(wheel->due[cursor] == cycle){
+			wheel->due[cursor] = -1;
+			wheel->next[cursor] = -1;
+			wheel->pending--;
+			fired[count++] = cursor;
+		} else {
+			wheel->next[cursor] = wheel->slots[slot];
+			wheel->slots[slot] = cursor;
+		}
+
+		cursor = following;
+	}
+
+	return count;
+}
+
+//Copy the pending events of (source) into (destination), a wheel initialized for the same modules and delay.
+void copy_wheel(timingWheel* destination,const timingWheel* source){
+	memcpy(destination->slots,source->slots,source->slotCount * sizeof(int));
+	memcpy(destination->next,source->next,source->moduleCount * sizeof(int));
+	memcpy(destination->due,source->due,source->moduleCount * sizeof(int));
+	destination->pending = source->pending;
+}
+
+//Free all arrays used by the wheel.
+void free_wheel(timingWheel* wheel){
+	placed_free(wheel->slots);
+	placed_free(wheel->next);
+	placed_free(wheel->due);
+}
@@ -0,0 +1,28 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+//Hashed timing wheel holding at most one pending completion event per memory module.
+//Events are bucketed by (cycle & mask) so each cycle only touches the modules that
+//actually complete on it instead of scanning every module.
+typedef struct timingWheel {
+	int* slots;	//Head module of the event list of every slot (-1 when the slot is empty)
+	int* next;	//Next module in the same slot list (-1 terminates the list)
+	int* due;	//Cycle on which each module's event fires (-1 when it has no pending event)
+
+	int slotCount;
+	int mask;
+	int moduleCount;
+	int pending;	//Number of events currently stored in the wheel
+} timingWheel;
+
+void init_wheel(timingWheel* wheel,int modules,int maxDelay);
+bool wheel_pending(timingWheel* wheel,int module);
+void wheel_schedule(timingWheel* wheel,int module,int cycle);
+int wheel_advance(timingWheel* wheel,int cycle,int* fired);
+void copy_wheel(timingWheel* destination,const timingWheel* source);
+void free_wheel(timingWheel* wheel);
+
+#endif
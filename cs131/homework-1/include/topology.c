@@ -0,0 +1,158 @@
+#include "topology.h"
+#include "rng.h"
+
+#include <string.h>
+
+//Implementation in C of a two-level NUMA interconnect: processors and memory modules are grouped
+//into nodes, accesses to another node's modules take longer and share a single inter-node link.
+
+//First index of the (node)-th of (nodeCount) contiguous ranges splitting (total) items.
+static int range_start(int node,int nodeCount,int total){
+	return (int) (((long) node * total + nodeCount - 1) / nodeCount);
+}
+
+//Initialize the topology of a machine with (nodeCount) nodes.
+//A node count of 1 or less describes the flat machine of the original model and allocates nothing.
+void setup_topology(topology* topo,int nodeCount,int processCount,int modules,int remoteLatency,int linkBandwidth,double localRatio){
+	int i;
+
+	topo->nodeCount = nodeCount > 1 ? nodeCount : 1;
+	topo->processCount = processCount;
+	topo->moduleCount = modules;
+	topo->remoteLatency = remoteLatency;
+	topo->linkBandwidth = linkBandwidth;
+	topo->linkUsed = 0;
+	topo->linkCycle = -1;
+	topo->linkStalls = 0;
+	topo->localRatio = localRatio;
+	topo->nodes = NULL;
+
+	if(topo->nodeCount == 1){
+		return;
+	}
+
+	//All per-node state lives in one contiguous array so a node's counters share cache lines.
+	topo->nodes = (nodeState*) calloc(topo->nodeCount,sizeof(nodeState));
+
+	for(i = 0; i < topo->nodeCount; i++){
+		nodeState* node = &(topo->nodes[i]);
+
+		node->firstProcessor = range_start(i,topo->nodeCount,processCount);
+		node->processorCount = range_start(i + 1,topo->nodeCount,processCount) - node->firstProcessor;
+		node->firstModule = range_start(i,topo->nodeCount,modules);
+		node->moduleCount = range_start(i + 1,topo->nodeCount,modules) - node->firstModule;
+	}
+}
+
+//Check if the simulation models more than one node.
+bool topology_enabled(topology* topo){
+	return topo->nodes != NULL;
+}
+
+//Node a processor belongs to.
+int processor_node(topology* topo,int process){
+	return (int) (((long) process * topo->nodeCount) / topo->processCount);
+}
+
+//Node whose local pool a memory module belongs to.
+int module_node(topology* topo,int module){
+	return (int) (((long) module * topo->nodeCount) / topo->moduleCount);
+}
+
+//Check if an access by (process) to (module) has to cross the inter-node link.
+bool is_remote(topology* topo,int process,int module){
+	return topology_enabled(topo) && processor_node(topo,process) != module_node(topo,module);
+}
+
+//Redirect a generated request into the requesting processor's local pool with probability (localRatio).
+//The request keeps its offset so the shape of the distribution is kept inside the pool.
+int localize_request(topology* topo,int process,int module){
+	if(!topology_enabled(topo) || topo->localRatio <= 0.0){
+		return module;
+	}
+
+	nodeState* node = &(topo->nodes[processor_node(topo,process)]);
+	if(node->moduleCount == 0 || ((double) next_random() / RAND_MAX) >= topo->localRatio){
+		return module;
+	}
+
+	return node->firstModule + (module % node->moduleCount);
+}
+
+//Reserve the inter-node link for one remote access during cycle (cycle).
+//Returns false when the link has already carried its bandwidth this cycle.
+bool acquire_link(topology* topo,int cycle){
+	if(topo->linkCycle != cycle){
+		topo->linkCycle = cycle;
+		topo->linkUsed = 0;
+	}
+
+	if(topo->linkBandwidth > 0 && topo->linkUsed >= topo->linkBandwidth){
+		topo->linkStalls++;
+		return false;
+	}
+
+	topo->linkUsed++;
+	return true;
+}
+
+//Account one cycle of waiting by (process) for (module) as local or remote wait.
+void record_topology_wait(topology* topo,int process,int module){
+	if(!topology_enabled(topo)){
+		return;
+	}
+
+	nodeState* node = &(topo->nodes[processor_node(topo,process)]);
+	if(is_remote(topo,process,module)){
+		node->remoteWaits++;
+	} else {
+		node->localWaits++;
+	}
+}
+
+//Account one granted access by (process) to (module) as local or remote.
+void record_topology_grant(topology* topo,int process,int module){
+	if(!topology_enabled(topo)){
+		return;
+	}
+
+	nodeState* node = &(topo->nodes[processor_node(topo,process)]);
+	if(is_remote(topo,process,module)){
+		node->remoteGrants++;
+	} else {
+		node->localGrants++;
+	}
+}
+
+//Split the average wait time over (requests) cycles into its local and remote parts.
+//Both use the same normalization as getAverageWaitTime() so they add up to it.
+void topology_wait_times(topology* topo,int requests,double* localWait,double* remoteWait){
+	long local = 0;
+	long remote = 0;
+	int i;
+
+	for(i = 0; topology_enabled(topo) && i < topo->nodeCount; i++){
+		local += topo->nodes[i].localWaits;
+		remote += topo->nodes[i].remoteWaits;
+	}
+
+	*localWait = (double) local / requests / topo->processCount;
+	*remoteWait = (double) remote / requests / topo->processCount;
+}
+
+//Copy the counters and link state of (source) into (destination), set up for the same machine.
+void copy_topology(topology* destination,const topology* source){
+	if(source->nodes != NULL){
+		memcpy(destination->nodes,source->nodes,source->nodeCount * sizeof(nodeState));
+	}
+
+	destination->linkUsed = source->linkUsed;
+	destination->linkCycle = source->linkCycle;
+	destination->linkStalls = source->linkStalls;
+}
+
+//Free the per-node state.
+void free_topology(topology* topo){
+	free(topo->nodes);
+	topo->nodes = NULL;
+}
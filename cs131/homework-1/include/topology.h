@@ -0,0 +1,49 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+//State of one node of a NUMA machine. Processors and memory modules are split into
+//contiguous ranges, so every node's modules are also contiguous in the simulator's module arrays.
+typedef struct nodeState {
+	int firstProcessor;
+	int processorCount;
+	int firstModule;
+	int moduleCount;
+
+	long localWaits;	//Cycles this node's processors waited on modules of their own node
+	long remoteWaits;	//Cycles this node's processors waited on modules of other nodes
+	long localGrants;
+	long remoteGrants;
+} nodeState;
+
+//Hierarchical interconnect: nodes with local module pools joined by one shared inter-node link.
+typedef struct topology {
+	nodeState* nodes;	//Contiguous per-node state (NULL when the machine is flat)
+	int nodeCount;
+	int processCount;
+	int moduleCount;
+
+	int remoteLatency;	//Extra cycles an access to another node's module takes
+	int linkBandwidth;	//Remote accesses the inter-node link carries per cycle (0 = unlimited)
+	int linkUsed;	//Remote accesses that crossed the link during the current cycle
+	int linkCycle;	//Cycle (linkUsed) belongs to
+	long linkStalls;	//Cycles processors were refused the link
+	double localRatio;	//Probability a request is redirected into the requesting node's own pool
+} topology;
+
+void setup_topology(topology* topo,int nodeCount,int processCount,int modules,int remoteLatency,int linkBandwidth,double localRatio);
+bool topology_enabled(topology* topo);
+int processor_node(topology* topo,int process);
+int module_node(topology* topo,int module);
+bool is_remote(topology* topo,int process,int module);
+int localize_request(topology* topo,int process,int module);
+bool acquire_link(topology* topo,int cycle);
+void record_topology_wait(topology* topo,int process,int module);
+void record_topology_grant(topology* topo,int process,int module);
+void topology_wait_times(topology* topo,int requests,double* localWait,double* remoteWait);
+void copy_topology(topology* destination,const topology* source);
+void free_topology(topology* topo);
+
+#endif
@@ -0,0 +1,177 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//Implementation in C of the binary event recorder. The simulating thread appends records to a
+//single-producer single-consumer ring; a flusher thread writes them to the trace file in the background.
+
+#define TRACE_FLUSH_IDLE_NS 200000
+
+typedef struct traceRecorder {
+	traceRecord* ring;
+
+	//Producer and consumer positions live on separate cache lines so the threads do not share one.
+	_Alignas(64) atomic_ulong tail;	//Next record the simulation writes
+	unsigned long cachedHead;	//Producer's last view of (head)
+	_Alignas(64) atomic_ulong head;	//Next record the flusher writes to disk
+
+	atomic_bool stopping;
+	bool failed;	//Set by the flusher when the file could not be written
+	int fd;
+	pthread_t flusher;
+} traceRecorder;
+
+_Thread_local traceRecorder* activeTrace = NULL;
+
+//Write a whole buffer, retrying short writes.
+static bool write_all(int fd,const void* buffer,size_t length){
+	const char* cursor = (const char*) buffer;
+
+	while(length > 0){
+		ssize_t written = write(fd,cursor,length);
+		if(written <= 0){
+			return false;
+		}
+		cursor += written;
+		length -= written;
+	}
+
+	return true;
+}
+
+//Write every record between (head) and the current (tail) to disk.
+//Returns the number of records written.
+static unsigned long drain(traceRecorder* trace){
+	unsigned long head = atomic_load_explicit(&(trace->head),memory_order_relaxed);
+	unsigned long tail = atomic_load_explicit(&(trace->tail),memory_order_acquire);
+	unsigned long count = tail - head;
+
+	while(head != tail){
+		unsigned long offset = head & (TRACE_RING_RECORDS - 1);
+		unsigned long length = tail - head;
+
+		//Write up to the end of the ring; the wrapped part is written on the next pass.
+		if(offset + length > TRACE_RING_RECORDS){
+			length = TRACE_RING_RECORDS - offset;
+		}
+
+		if(!write_all(trace->fd,&(trace->ring[offset]),length * sizeof(traceRecord))){
+			trace->failed = true;
+		}
+
+		head += length;
+		atomic_store_explicit(&(trace->head),head,memory_order_release);
+	}
+
+	return count;
+}
+
+//Body of the flusher thread: drain the ring until the recorder is closed.
+static void* flusher_main(void* argument){
+	traceRecorder* trace = (traceRecorder*) argument;
+	struct timespec idle = {0,TRACE_FLUSH_IDLE_NS};
+
+	while(!atomic_load_explicit(&(trace->stopping),memory_order_acquire)){
+		if(drain(trace) == 0){
+			nanosleep(&idle,NULL);
+		}
+	}
+
+	drain(trace);
+	return NULL;
+}
+
+//Start recording the calling thread's events into (path), preceded by (header).
+//Returns false if the file or the flusher thread could not be created.
+bool trace_open(const char* path,const traceHeader* header){
+	traceRecorder* trace = (traceRecorder*) aligned_alloc(_Alignof(traceRecorder),sizeof(traceRecorder));
+
+	memset(trace,0,sizeof(traceRecorder));
+	trace->fd = open(path,O_WRONLY | O_CREAT | O_TRUNC,0644);
+	trace->ring = (traceRecord*) malloc(TRACE_RING_RECORDS * sizeof(traceRecord));
+
+	if(trace->fd < 0 || trace->ring == NULL || !write_all(trace->fd,header,sizeof(traceHeader))){
+		if(trace->fd >= 0){
+			close(trace->fd);
+		}
+		free(trace->ring);
+		free(trace);
+		return false;
+	}
+
+	atomic_init(&(trace->tail),0);
+	atomic_init(&(trace->head),0);
+	atomic_init(&(trace->stopping),false);
+
+	if(pthread_create(&(trace->flusher),NULL,flusher_main,trace) != 0){
+		close(trace->fd);
+		free(trace->ring);
+		free(trace);
+		return false;
+	}
+
+	activeTrace = trace;
+	return true;
+}
+
+//Check if the calling thread is recording a trace.
+bool trace_active(void){
+	return activeTrace != NULL;
+}
+
+//Append a record to the calling thread's ring. Records are never dropped: when the flusher
+//falls a whole ring behind, the simulation yields until space is available.
+void trace_push(uint32_t cycle,int processor,int module,traceEvent kind,int depth){
+	traceRecorder* trace = activeTrace;
+	unsigned long tail = atomic_load_explicit(&(trace->tail),memory_order_relaxed);
+
+	if(tail - trace->cachedHead == TRACE_RING_RECORDS){
+		while((trace->cachedHead = atomic_load_explicit(&(trace->head),memory_order_acquire)) + TRACE_RING_RECORDS == tail){
+			sched_yield();
+		}
+	}
+
+	traceRecord* record = &(trace->ring[tail & (TRACE_RING_RECORDS - 1)]);
+	record->cycle = cycle;
+	record->moduleKind = ((uint32_t) module & 0xffffffU) | ((uint32_t) kind << 24);
+	record->processor = processor < 0 ? TRACE_NO_PROCESS : (uint16_t) processor;
+	record->depth = depth > 0xffff ? 0xffff : (uint16_t) depth;
+
+	atomic_store_explicit(&(trace->tail),tail + 1,memory_order_release);
+}
+
+//Stop recording: wait for the flusher to write every record, then write the footer.
+//Returns false if any part of the trace could not be written.
+bool trace_close(int cycles,double waitTime){
+	traceRecorder* trace = activeTrace;
+	traceFooter footer;
+	bool written;
+
+	if(trace == NULL){
+		return false;
+	}
+
+	atomic_store_explicit(&(trace->stopping),true,memory_order_release);
+	pthread_join(trace->flusher,NULL);
+
+	footer.magic = TRACE_END_MAGIC;
+	footer.cycles = (uint32_t) cycles;
+	footer.records = atomic_load_explicit(&(trace->tail),memory_order_relaxed);
+	footer.waitTime = waitTime;
+
+	written = !trace->failed && write_all(trace->fd,&footer,sizeof(footer));
+	written = close(trace->fd) == 0 && written;
+
+	free(trace->ring);
+	free(trace);
+	activeTrace = NULL;
+
+	return written;
+}
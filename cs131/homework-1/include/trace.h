@@ -0,0 +1,98 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rng.h"
+
+#define TRACE_MAGIC 0x4352544dU	//"MTRC"
+#define TRACE_END_MAGIC 0x444e454dU	//"MEND"
+#define TRACE_VERSION 8
+#define TRACE_RING_RECORDS (1 << 20)	//Records buffered between the simulation and the flusher thread
+#define TRACE_NO_PROCESS 0xffff	//Processor field of a module that became available
+
+//Kinds of simulator events a trace records.
+typedef enum {
+	TraceGrant = 0,	//A processor got the module it was waiting for
+	TraceRequest = 1,	//A processor issued a request for a module
+	TraceWait = 2,	//A processor found its module busy (depth = queue length after queueing)
+	TraceStall = 3,	//A processor waited for its own multi-cycle access
+	TraceComplete = 4,	//A module finished an access (processor = next holder, depth = remaining queue)
+	TraceHit = 5,	//A processor's request was served by its private cache
+	TraceBuffer = 6,	//A processor's write went into its write buffer (depth = writes buffered)
+	TraceBufferFull = 7	//A processor waited for room in its full write buffer (depth = its capacity)
+} traceEvent;
+
+//One event packed into 12 bytes: the module index uses the low 24 bits of (moduleKind)
+//and the event kind the high 8 bits.
+typedef struct traceRecord {
+	uint32_t cycle;
+	uint32_t moduleKind;
+	uint16_t processor;
+	uint16_t depth;
+} traceRecord;
+
+//Everything needed to re-execute the traced point.
+typedef struct traceHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seed;	//Seed of the session, or of the point when it was seeded on its own
+	int32_t dist;
+	int32_t processCount;
+	int32_t moduleCount;
+	int32_t readLatency;
+	int32_t writeLatency;
+	double writeRatio;
+	int32_t nodeCount;
+	int32_t remoteLatency;
+	int32_t linkBandwidth;
+	int32_t overrideCount;	//Per-module latency overrides the point was simulated with (they are not stored)
+	double localRatio;
+	int32_t arrivals;	//Arrival process and parameters of open-loop points
+	int32_t burstCycles;
+	int32_t idleCycles;
+	int32_t thinkCycles;
+	int32_t outstandingLimit;
+	int32_t reserved;
+	double arrivalRate;
+	int32_t driftEpoch;	//Locality model of Gaussian points
+	int32_t hotRegions;
+	double sigmaFraction;
+	double sigmaModules;
+	double driftDistance;
+	int32_t modulePorts;	//Ports and lines of the modules, and the processors' private caches
+	int32_t moduleLines;
+	int32_t coalesceReads;
+	int32_t cacheSets;
+	int32_t cacheWays;
+	int32_t writeBuffer;	//Writes each processor's buffer holds
+	uint32_t patternHash;	//Hash of the access pattern programs the point was simulated with (0 = none; they are not stored)
+	char randomState[RANDOM_STATE_BYTES];	//Random stream position when the point started (see save_random_state)
+} traceHeader;
+
+//Written after the last record.
+typedef struct traceFooter {
+	uint32_t magic;
+	uint32_t cycles;
+	uint64_t records;
+	double waitTime;
+} traceFooter;
+
+//Recorder of the calling thread (NULL when it is not tracing).
+extern _Thread_local struct traceRecorder* activeTrace;
+
+bool trace_open(const char* path,const traceHeader* header);
+bool trace_active(void);
+void trace_push(uint32_t cycle,int processor,int module,traceEvent kind,int depth);
+bool trace_close(int cycles,double waitTime);
+
+//Record one event. Kept inline so that a simulation that is not traced only pays for the check.
+static inline void trace_event(uint32_t cycle,int processor,int module,traceEvent kind,int depth){
+	if(activeTrace != NULL){
+		trace_push(cycle,processor,module,kind,depth);
+	}
+}
+
+#endif
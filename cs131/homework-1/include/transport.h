@@ -0,0 +1,60 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "simulator.h"
+#include "result_ring.h"
+
+//The grid of a session: every distribution, processor configuration and module count run_session() covers.
+//Point (row, m) is simulated with distribution (row / configSize) and processorConfigs[row % configSize].
+typedef struct sweepPlan {
+	const simulatorConfig* config;
+	int* processorConfigs;
+	int configSize;
+	int modules;
+} sweepPlan;
+
+//A contiguous range [firstModule, endModule) of module counts of one row of the grid.
+typedef struct sweepChunk {
+	int row;
+	int firstModule;
+	int endModule;
+} sweepChunk;
+
+typedef enum {
+	WorkerReady = 0,	//A worker connected or finished its chunk and wants more work
+	PointFinished = 1,	//A worker published the result of one point
+	WorkerLost = 2	//A worker went away without finishing its chunk
+} sweepEventType;
+
+typedef struct sweepEvent {
+	sweepEventType type;
+	int worker;
+	ringRecord record;	//Only set for PointFinished
+} sweepEvent;
+
+//A way of running sweep workers and talking to them. The coordinator only uses these operations,
+//so backends that reach workers on other hosts can be plugged in next to the local one.
+typedef struct sweepTransport {
+	const char* name;
+	void* state;
+
+	//Start (workers) workers that can simulate any point of (plan). Returns the number started.
+	int (*start)(struct sweepTransport* transport,int workers,const sweepPlan* plan);
+	//Wait up to (timeoutMs) for the next event. Returns 1 with an event, 0 on timeout and -1 on failure.
+	int (*next_event)(struct sweepTransport* transport,sweepEvent* event,int timeoutMs);
+	//Hand a chunk to an idle worker. Returns false if the worker cannot be reached.
+	bool (*assign)(struct sweepTransport* transport,int worker,const sweepChunk* chunk);
+	//Module count the worker is simulating right now (-1 when idle).
+	int (*progress)(struct sweepTransport* transport,int worker);
+	//Make a busy worker stop its chunk before (endModule).
+	void (*shrink)(struct sweepTransport* transport,int worker,int endModule);
+	//Stop all workers and release the transport.
+	void (*stop)(struct sweepTransport* transport);
+} sweepTransport;
+
+void local_transport(sweepTransport* transport);
+
+#endif
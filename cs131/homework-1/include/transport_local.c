@@ -0,0 +1,345 @@
+#include "transport.h"
+#include "coordinator.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+//Local sweep transport: workers are fork'd processes that connect back to the coordinator
+//through a Unix socket and publish their results in a lock-free shared memory ring.
+
+#define LOCAL_RING_CAPACITY 4096
+#define LOCAL_CONNECT_TIMEOUT_MS 10000
+
+typedef enum {
+	MessageReady = 0,
+	MessageAssign = 1,
+	MessageStop = 2
+} localMessageType;
+
+//Control messages exchanged on the Unix socket (results never go through it).
+typedef struct localMessage {
+	int type;
+	int worker;
+	sweepChunk chunk;
+} localMessage;
+
+//Chunk bounds shared with each worker so a busy worker can be told to stop early.
+typedef struct workerControl {
+	atomic_int endModule;
+	atomic_int currentModule;
+} workerControl;
+
+typedef struct localState {
+	char path[sizeof(((struct sockaddr_un*) 0)->sun_path)];
+	int listenFd;
+	int workerCount;
+	pid_t* pids;
+	int* fds;	//Socket of every worker (-1 once it is gone)
+	int* initialReady;	//Workers whose first ready event has not been reported yet
+	int initialCount;
+
+	resultRing* ring;
+	workerControl* controls;	//Shared mapping, one entry per worker
+	const sweepPlan* plan;
+} localState;
+
+static bool send_message(int fd,const localMessage* message){
+	return send(fd,message,sizeof(localMessage),MSG_NOSIGNAL) == sizeof(localMessage);
+}
+
+static bool receive_message(int fd,localMessage* message){
+	return recv(fd,message,sizeof(localMessage),0) == sizeof(localMessage);
+}
+
+//Body of a worker process: ask for chunks and simulate their points until told to stop.
+static void worker_main(localState* state,int worker){
+	struct sockaddr_un address;
+	localMessage message;
+	workerControl* control = &(state->controls[worker]);
+
+	stats_set_worker(worker);
+
+	//Pin the worker and give it node-local memory before it allocates anything.
+	place_worker(state->plan->config->placement,state->plan->config->hugePages,worker);
+
+	int fd = socket(AF_UNIX,SOCK_SEQPACKET,0);
+	memset(&address,0,sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path,state->path,sizeof(address.sun_path));
+
+	if(fd < 0 || connect(fd,(struct sockaddr*) &address,sizeof(address)) < 0){
+		release_placement();
+		return;
+	}
+
+	message.type = MessageReady;
+	message.worker = worker;
+	send_message(fd,&message);
+
+	while(receive_message(fd,&message) && message.type == MessageAssign){
+		int modules;
+
+		//The coordinator may lower the end of the chunk while it runs to hand the tail to an idle worker.
+		for(modules = message.chunk.firstModule; modules < atomic_load_explicit(&(control->endModule),memory_order_acquire); modules++){
+			ringRecord record;
+
+			atomic_store_explicit(&(control->currentModule),modules,memory_order_relaxed);
+
+			record.point = sweep_point_index(state->plan,message.chunk.row,modules);
+			record.worker = worker;
+			simulate_sweep_point(state->plan,message.chunk.row,modules,&(record.result));
+			ring_push(state->ring,&record);
+		}
+
+		atomic_store_explicit(&(control->currentModule),-1,memory_order_relaxed);
+
+		message.type = MessageReady;
+		message.worker = worker;
+		send_message(fd,&message);
+	}
+
+	close(fd);
+	release_placement();
+}
+
+//Wait for a connection on the listening socket for at most (timeoutMs).
+static int accept_worker(localState* state,int timeoutMs){
+	struct pollfd listener;
+
+	listener.fd = state->listenFd;
+	listener.events = POLLIN;
+
+	if(poll(&listener,1,timeoutMs) <= 0){
+		return -1;
+	}
+
+	return accept(state->listenFd,NULL,NULL);
+}
+
+static int local_start(sweepTransport* transport,int workers,const sweepPlan* plan){
+	localState* state = (localState*) calloc(1,sizeof(localState));
+	struct sockaddr_un address;
+	int i;
+
+	transport->state = state;
+	state->plan = plan;
+	state->workerCount = workers;
+	state->pids = (pid_t*) calloc(workers,sizeof(pid_t));
+	state->fds = (int*) malloc(workers * sizeof(int));
+	state->initialReady = (int*) malloc(workers * sizeof(int));
+	state->listenFd = -1;
+
+	for(i = 0; i < workers; i++){
+		state->fds[i] = -1;
+	}
+
+	//The ring and the chunk bounds must be mapped before forking so that all processes share them.
+	state->ring = create_result_ring(LOCAL_RING_CAPACITY);
+	state->controls = (workerControl*) mmap(NULL,workers * sizeof(workerControl),PROT_READ | PROT_WRITE,MAP_SHARED | MAP_ANONYMOUS,-1,0);
+	if(state->ring == NULL || state->controls == MAP_FAILED){
+		return 0;
+	}
+
+	for(i = 0; i < workers; i++){
+		atomic_init(&(state->controls[i].endModule),0);
+		atomic_init(&(state->controls[i].currentModule),-1);
+	}
+
+	snprintf(state->path,sizeof(state->path),"/tmp/memsim-%d.sock",(int) getpid());
+	unlink(state->path);
+
+	memset(&address,0,sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path,state->path,sizeof(address.sun_path));
+
+	state->listenFd = socket(AF_UNIX,SOCK_SEQPACKET,0);
+	if(state->listenFd < 0 || bind(state->listenFd,(struct sockaddr*) &address,sizeof(address)) < 0 || listen(state->listenFd,workers) < 0){
+		return 0;
+	}
+
+	//Buffered output would otherwise be written once by every worker.
+	fflush(NULL);
+
+	for(i = 0; i < workers; i++){
+		pid_t pid = fork();
+
+		if(pid == 0){
+			close(state->listenFd);
+			worker_main(state,i);
+			_exit(0);
+		}
+
+		state->pids[i] = pid;
+	}
+
+	//Every worker introduces itself with a ready message carrying its index.
+	for(i = 0; i < workers; i++){
+		localMessage message;
+		int fd = accept_worker(state,LOCAL_CONNECT_TIMEOUT_MS);
+
+		if(fd < 0){
+			break;
+		}
+
+		if(!receive_message(fd,&message) || message.worker < 0 || message.worker >= workers){
+			close(fd);
+			continue;
+		}
+
+		state->fds[message.worker] = fd;
+		state->initialReady[state->initialCount++] = message.worker;
+	}
+
+	return state->initialCount;
+}
+
+static int local_next_event(sweepTransport* transport,sweepEvent* event,int timeoutMs){
+	localState* state = (localState*) transport->state;
+	struct pollfd* fds;
+	int i,ready;
+
+	//Results are drained first so that they are merged as early as possible.
+	if(ring_pop(state->ring,&(event->record))){
+		event->type = PointFinished;
+		event->worker = event->record.worker;
+		return 1;
+	}
+
+	if(state->initialCount > 0){
+		event->type = WorkerReady;
+		event->worker = state->initialReady[--(state->initialCount)];
+		return 1;
+	}
+
+	fds = (struct pollfd*) malloc(state->workerCount * sizeof(struct pollfd));
+	for(i = 0; i < state->workerCount; i++){
+		fds[i].fd = state->fds[i];
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+
+	ready = poll(fds,state->workerCount,timeoutMs);
+
+	for(i = 0; ready > 0 && i < state->workerCount; i++){
+		localMessage message;
+
+		if(fds[i].revents == 0){
+			continue;
+		}
+
+		free(fds);
+
+		if(!receive_message(state->fds[i],&message)){
+			close(state->fds[i]);
+			state->fds[i] = -1;
+			event->type = WorkerLost;
+			event->worker = i;
+			return 1;
+		}
+
+		event->type = WorkerReady;
+		event->worker = i;
+		return 1;
+	}
+
+	free(fds);
+
+	//A worker may have published a result while we were waiting on the sockets.
+	if(ring_pop(state->ring,&(event->record))){
+		event->type = PointFinished;
+		event->worker = event->record.worker;
+		return 1;
+	}
+
+	return ready < 0 ? -1 : 0;
+}
+
+static bool local_assign(sweepTransport* transport,int worker,const sweepChunk* chunk){
+	localState* state = (localState*) transport->state;
+	localMessage message;
+
+	if(state->fds[worker] < 0){
+		return false;
+	}
+
+	atomic_store_explicit(&(state->controls[worker].endModule),chunk->endModule,memory_order_release);
+	atomic_store_explicit(&(state->controls[worker].currentModule),chunk->firstModule,memory_order_relaxed);
+
+	message.type = MessageAssign;
+	message.worker = worker;
+	message.chunk = *chunk;
+	return send_message(state->fds[worker],&message);
+}
+
+static int local_progress(sweepTransport* transport,int worker){
+	localState* state = (localState*) transport->state;
+	return atomic_load_explicit(&(state->controls[worker].currentModule),memory_order_relaxed);
+}
+
+static void local_shrink(sweepTransport* transport,int worker,int endModule){
+	localState* state = (localState*) transport->state;
+	atomic_store_explicit(&(state->controls[worker].endModule),endModule,memory_order_release);
+}
+
+static void local_stop(sweepTransport* transport){
+	localState* state = (localState*) transport->state;
+	int i;
+
+	if(state == NULL){
+		return;
+	}
+
+	for(i = 0; i < state->workerCount; i++){
+		if(state->fds[i] >= 0){
+			localMessage message;
+
+			message.type = MessageStop;
+			message.worker = i;
+			send_message(state->fds[i],&message);
+			close(state->fds[i]);
+		}
+	}
+
+	for(i = 0; i < state->workerCount; i++){
+		if(state->pids[i] > 0){
+			waitpid(state->pids[i],NULL,0);
+		}
+	}
+
+	if(state->listenFd >= 0){
+		close(state->listenFd);
+		unlink(state->path);
+	}
+
+	if(state->ring != NULL){
+		destroy_result_ring(state->ring);
+	}
+	if(state->controls != NULL && state->controls != MAP_FAILED){
+		munmap(state->controls,state->workerCount * sizeof(workerControl));
+	}
+
+	free(state->pids);
+	free(state->fds);
+	free(state->initialReady);
+	free(state);
+	transport->state = NULL;
+}
+
+//Fill (transport) with the operations of the local fork + Unix socket + shared memory backend.
+void local_transport(sweepTransport* transport){
+	transport->name = "local";
+	transport->state = NULL;
+	transport->start = local_start;
+	transport->next_event = local_next_event;
+	transport->assign = local_assign;
+	transport->progress = local_progress;
+	transport->shrink = local_shrink;
+	transport->stop = local_stop;
+}
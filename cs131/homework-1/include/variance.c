@@ -0,0 +1,266 @@
+#include "variance.h"
+
+#include <math.h>
+#include <string.h>
+
+//Implementation in C of the statistics of variance-reduced sweep points: the random streams common to every
+//module count of a processor configuration, the control variate of uniform requests, the combination of a
+//point's simulations into one estimate, and the summary a session reports.
+
+void init_batches(batchMeans* batches){
+	memset(batches,0,sizeof(batchMeans));
+}
+
+//Record the average of a quantity per cycle of a simulation after (cycle) cycles. Called on every cycle;
+//a batch mean is kept whenever (cycle) ends a batch.
+void record_batch(batchMeans* batches,int cycle,double average){
+	if(cycle % VARIANCE_BATCH_CYCLES != 0){
+		return;
+	}
+
+	//Grow the batch array geometrically as batches complete.
+	if(batches->count == batches->capacity){
+		batches->capacity = batches->capacity == 0 ? 64 : batches->capacity * 2;
+		batches->means = (double*) realloc(batches->means,batches->capacity * sizeof(double));
+	}
+
+	double total = average * cycle;
+	batches->means[batches->count++] = (total - batches->lastTotal) / VARIANCE_BATCH_CYCLES;
+	batches->lastTotal = total;
+}
+
+void free_batches(batchMeans* batches){
+	free(batches->means);
+	init_batches(batches);
+}
+
+void setup_request_control(requestControl* control,int modules){
+	control->requesters = (int*) calloc(modules,sizeof(int));
+	control->requesting = 0;
+	control->sum = 0.0;
+	init_batches(&(control->batches));
+}
+
+void free_request_control(requestControl* control){
+	free(control->requesters);
+	control->requesters = NULL;
+	free_batches(&(control->batches));
+}
+
+//Seed of the stream of processor (process) in configurations of (processCount) processors.
+//It does not depend on the module count or the distribution, so all points of a row share their streams.
+static unsigned int stream_seed(unsigned int seed,int processCount,int process){
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned int fields[3] = {seed,(unsigned int) processCount,(unsigned int) process};
+	int i;
+
+	for(i = 0; i < 3; i++){
+		hash ^= fields[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return (unsigned int) (hash ^ (hash >> 32));
+}
+
+//Create a seeded stream for every processor of a configuration, and a last one for the draws that belong
+//to no processor (the drift of the Gaussian means). The calling thread's stream stays active.
+threadRandom* open_common_streams(unsigned int seed,int processCount){
+	threadRandom* streams = (threadRandom*) malloc((processCount + 1) * sizeof(threadRandom));
+	threadRandom* previous = activeRandom;
+	int i;
+
+	for(i = 0; i <= processCount; i++){
+		use_thread_random(&(streams[i]));
+		seed_random(stream_seed(seed,processCount,i));
+	}
+	switch_thread_random(previous);
+
+	return streams;
+}
+
+void close_common_streams(threadRandom* streams){
+	free(streams);
+}
+
+//Make every stream of (streams) hand out its antithetic values, or its values again.
+void mirror_common_streams(threadRandom* streams,int processCount,bool mirrored){
+	int i;
+
+	for(i = 0; i <= processCount; i++){
+		streams[i].mirror = mirrored ? RAND_MAX : 0;
+	}
+}
+
+//Combine the (replicas) simulations of a point into one estimate. (targets) are the batch means of the point's
+//simulations and (targetWaits) their wait times; (controls) and (controlMeans), when not NULL, are the batch means
+//and the overall mean of the control of each simulation, whose expectation is zero.
+//All simulations must have run for the same number of cycles, so that their batches line up.
+//The weight of the control is the regression coefficient of the point's batch means on the control's, which
+//minimizes the variance of wait - beta * control mean. A control whose correlation with the point is within
+//the noise of (batches) samples is left out, since weighing it would only add that noise.
+void combine_replicas(const batchMeans* targets,const double* targetWaits,const batchMeans* controls,const double* controlMeans,
+	int replicas,varianceEstimate* estimate){
+	double controlMean = 0.0;
+	int r,b;
+
+	memset(estimate,0,sizeof(varianceEstimate));
+	estimate->simulations = replicas;
+	estimate->plainWait = targetWaits[0];
+
+	for(r = 0; r < replicas; r++){
+		estimate->wait += targetWaits[r] / replicas;
+		if(controls != NULL){
+			controlMean += controlMeans[r] / replicas;
+		}
+	}
+
+	int count = targets[0].count;
+	if(controls == NULL || count < VARIANCE_MIN_BATCHES){
+		return;
+	}
+
+	//Regress the replicas' averaged batch means on the controls'.
+	double sumY = 0.0,sumX = 0.0,sumXX = 0.0,sumXY = 0.0,sumYY = 0.0;
+	for(b = 0; b < count; b++){
+		double y = 0.0,x = 0.0;
+
+		for(r = 0; r < replicas; r++){
+			y += targets[r].means[b] / replicas;
+			x += controls[r].means[b] / replicas;
+		}
+		sumY += y;
+		sumX += x;
+		sumXX += x * x;
+		sumXY += x * y;
+		sumYY += y * y;
+	}
+
+	double covariance = sumXY - sumX * sumY / count;
+	double controlSpread = sumXX - sumX * sumX / count;
+	double targetSpread = sumYY - sumY * sumY / count;
+
+	if(controlSpread > 0.0 && targetSpread > 0.0){
+		estimate->correlation = covariance / sqrt(controlSpread * targetSpread);
+		if(fabs(estimate->correlation) > 2.0 / sqrt(count)){
+			estimate->beta = covariance / controlSpread;
+			estimate->wait -= estimate->beta * controlMean;
+		}
+	}
+}
+
+//Two-sided 95% quantile of Student's t distribution with (freedom) degrees of freedom (Cornish-Fisher expansion).
+double student_quantile(int freedom){
+	double z = 1.959964;
+
+	return z + (z * z * z + z) / (4.0 * freedom) + (5.0 * pow(z,5) + 16.0 * z * z * z + 3.0 * z) / (96.0 * freedom * freedom);
+}
+
+//Start the summary of a session without any points.
+void begin_variance_summary(varianceSummary* summary){
+	memset(summary,0,sizeof(varianceSummary));
+}
+
+//Add a point of distribution (dist) to the session's (summary).
+void account_variance(varianceSummary* summary,int dist,int processCount,int modules,const varianceEstimate* estimate){
+	varianceTotals* totals = &(summary->totals[dist]);
+
+	totals->points++;
+	totals->simulations += estimate->simulations;
+
+	if(estimate->correlation != 0.0){
+		totals->controlled++;
+		totals->correlationTotal += estimate->correlation;
+	}
+	if(estimate->beta != 0.0){
+		totals->weighted++;
+		totals->betaTotal += estimate->beta;
+	}
+
+	if(processCount == totals->lastProcessCount && modules == totals->lastModules + 1){
+		totals->consecutive = totals->consecutive < 2 ? totals->consecutive + 1 : 2;
+	} else {
+		totals->consecutive = 0;
+	}
+
+	if(totals->consecutive == 2){
+		double plain = totals->plainWaits[1] - 2.0 * totals->plainWaits[0] + estimate->plainWait;
+		double reduced = totals->waits[1] - 2.0 * totals->waits[0] + estimate->wait;
+
+		totals->triples++;
+		totals->plainRoughness += plain * plain;
+		totals->reducedRoughness += reduced * reduced;
+	}
+
+	totals->lastProcessCount = processCount;
+	totals->lastModules = modules;
+	totals->plainWaits[1] = totals->plainWaits[0];
+	totals->plainWaits[0] = estimate->plainWait;
+	totals->waits[1] = totals->waits[0];
+	totals->waits[0] = estimate->wait;
+}
+
+//Add the wait times of two independent plain simulations of the same point of distribution (dist).
+//Half their squared difference estimates the variance of a plain point, whatever makes the simulations differ.
+void account_probe(varianceSummary* summary,int dist,double first,double second){
+	summary->totals[dist].probes++;
+	summary->totals[dist].probeVariance += (first - second) * (first - second) / 2.0;
+}
+
+//Write the names of the modes set in (modes), separated by commas, into (text) and return their length.
+int format_variance_modes(char* text,int modes){
+	int length = 0;
+
+	text[0] = '\0';
+	if(modes & VarianceCommon){
+		length += sprintf(text + length,"%scrn",length > 0 ? "," : "");
+	}
+	if(modes & VarianceAntithetic){
+		length += sprintf(text + length,"%santithetic",length > 0 ? "," : "");
+	}
+	if(modes & VarianceControl){
+		length += sprintf(text + length,"%scontrol",length > 0 ? "," : "");
+	}
+	if(length == 0){
+		length = sprintf(text,"none");
+	}
+
+	return length;
+}
+
+//Print how much the variance reduction of a session with simulations of (cycles) cycles saved on each distribution,
+//according to its (summary). The baseline is the noise rows of plain, independent simulations would have, measured by the probes.
+void report_variance(FILE* out,const varianceSummary* summary,int modes,int cycles){
+	const char* names[2] = {"uniform","gaussian"};
+	char modeNames[64];
+	int dist;
+
+	format_variance_modes(modeNames,modes);
+	fprintf(out,"Variance reduction (%s), simulations of %d cycles:\n",modeNames,cycles);
+
+	for(dist = 0; dist < 2; dist++){
+		const varianceTotals* totals = &(summary->totals[dist]);
+
+		if(totals->points == 0){
+			continue;
+		}
+
+		double cost = (double) totals->simulations / totals->points;
+		fprintf(out,"  %s: %ld points, %.2f simulations per point\n",names[dist],totals->points,cost);
+
+		if(totals->triples > 0 && totals->probes > 0 && totals->reducedRoughness > 0.0){
+			double plain = totals->plainRoughness / totals->triples;
+			double reduced = totals->reducedRoughness / totals->triples;
+			double independent = 6.0 * totals->probeVariance / totals->probes;
+
+			fprintf(out,"    noise along the rows (mean squared second difference): %e with plain independent simulations (%ld probes), "
+				"%e in the first simulations, %e in the estimates\n",independent,totals->probes,plain,reduced);
+			fprintf(out,"    plain independent simulations would need %.2fx the cycles for rows this smooth\n",independent / reduced / cost);
+		}
+
+		if(totals->controlled > 0){
+			fprintf(out,"    control: mean correlation %f over %ld points, used on %ld of them with a mean weight of %f\n",
+				totals->correlationTotal / totals->controlled,totals->controlled,totals->weighted,
+				totals->weighted > 0 ? totals->betaTotal / totals->weighted : 0.0);
+		}
+	}
+}
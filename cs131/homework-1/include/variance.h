@@ -0,0 +1,119 @@
+#ifndef VARIANCE_H
+#define VARIANCE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "rng.h"
+
+#define VARIANCE_DEFAULT_CYCLES 4096	//Cycles every simulation of a variance-reduced point runs for
+#define VARIANCE_BATCH_CYCLES 32	//Cycles whose mean wait is one sample of the fluctuation of a simulation
+#define VARIANCE_MIN_BATCHES 8	//Batches a simulation needs before its fluctuation is estimated
+#define VARIANCE_PROBE_SPACING 16	//Module counts between the points that are also simulated plainly to measure the gain
+
+//Variance reduction applied to the sweep points. The modes are flags and can be combined.
+typedef enum {
+	VarianceNone = 0,
+	VarianceCommon = 1,	//Common random numbers: every processor has its own stream, shared by all module counts
+	VarianceAntithetic = 2,	//Each point is simulated again with the antithetic draws and the two are averaged
+	VarianceControl = 4	//Uniform points are corrected by how crowded their requests' modules were compared to the analytical expectation
+} varianceMode;
+
+//Mean wait of every completed batch of cycles of one simulation.
+typedef struct batchMeans {
+	double* means;
+	int count;
+	int capacity;
+	double lastTotal;	//Wait per processor accumulated up to the end of the last batch
+} batchMeans;
+
+//Control variate of a uniform simulation. Each new request adds the number of other processors whose current request
+//is the same module, minus the (requesting) / moduleCount of them it meets on average: a uniform draw is independent
+//of where the others are, so the terms have mean zero exactly while tracking the contention the requests run into.
+typedef struct requestControl {
+	int* requesters;	//Processors whose current request is each module
+	int requesting;	//Processors that have a request
+	double sum;	//Sum of the terms of every request so far
+	batchMeans batches;	//Mean of the terms per cycle of every batch
+} requestControl;
+
+//Outcome of combining the simulations of one point.
+typedef struct varianceEstimate {
+	double wait;	//Estimate of the point's wait time
+	double plainWait;	//Wait time of the first simulation alone
+	int simulations;	//Simulations the estimate combines
+	double beta;	//Weight of the control (0 when it was not used)
+	double correlation;	//Correlation of the batch means of the point and its control
+} varianceEstimate;
+
+//Totals of the variance-reduced points of one distribution. The noise of a sweep is measured by the second
+//differences w(m - 1) - 2 w(m) + w(m + 1) along its rows: they cancel the trend of a smooth curve and leave
+//the noise, whose variance is 6 v for independent points that each have variance v.
+typedef struct varianceTotals {
+	long points;
+	long simulations;
+	long controlled;	//Points with a control
+	long weighted;	//Points whose control was correlated enough to be used
+	double betaTotal;
+	double correlationTotal;
+
+	long triples;	//Runs of three consecutive module counts of a row
+	double plainRoughness;	//Sum of the squared second differences of the first simulations' waits
+	double reducedRoughness;	//Same of the combined estimates
+	long probes;	//Points simulated twice more, independently and plainly, to measure v
+	double probeVariance;	//Sum of their estimates of v
+
+	int lastProcessCount;
+	int lastModules;
+	int consecutive;	//Points just before the current one that are its neighbours in the row (at most 2 counted)
+	double plainWaits[2];	//Last two points, the latest first
+	double waits[2];
+} varianceTotals;
+
+//Summary a session keeps of its variance-reduced points. The session owns it, so sessions and engines running
+//at the same time never add to the same one.
+typedef struct varianceSummary {
+	varianceTotals totals[2];	//Indexed by the distribution
+} varianceSummary;
+
+void init_batches(batchMeans* batches);
+void record_batch(batchMeans* batches,int cycle,double average);
+void free_batches(batchMeans* batches);
+
+void setup_request_control(requestControl* control,int modules);
+void free_request_control(requestControl* control);
+
+threadRandom* open_common_streams(unsigned int seed,int processCount);
+void close_common_streams(threadRandom* streams);
+void mirror_common_streams(threadRandom* streams,int processCount,bool mirrored);
+
+void combine_replicas(const batchMeans* targets,const double* targetWaits,const batchMeans* controls,const double* controlMeans,
+	int replicas,varianceEstimate* estimate);
+double student_quantile(int freedom);
+
+void begin_variance_summary(varianceSummary* summary);
+void account_variance(varianceSummary* summary,int dist,int processCount,int modules,const varianceEstimate* estimate);
+void account_probe(varianceSummary* summary,int dist,double first,double second);
+void report_variance(FILE* out,const varianceSummary* summary,int modes,int cycles);
+int format_variance_modes(char* text,int modes);
+
+//Account the request of a processor for (module), replacing its request for (previous) (-1 for its first one).
+static inline void control_request(requestControl* control,int previous,int module,int moduleCount){
+	if(previous >= 0){
+		control->requesters[previous]--;
+		control->requesting--;
+	}
+
+	control->sum += control->requesters[module] - (double) control->requesting / moduleCount;
+	control->requesters[module]++;
+	control->requesting++;
+}
+
+//Random number in [0, range) taken from the fraction of RAND_MAX it represents rather than from its remainder,
+//so that the same random number lands on nearly the same relative position of every range.
+static inline int scaled_draw(int range){
+	return (int) ((double) next_random() / ((double) RAND_MAX + 1.0) * range);
+}
+
+#endif
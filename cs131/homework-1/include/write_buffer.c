@@ -0,0 +1,82 @@
+#include "write_buffer.h"
+#include "placement.h"
+
+#include <string.h>
+
+//Implementation in C of the processors' write buffers. The rings are allocated with the rest of the
+//simulator's state, from the worker's arena when it has one, and never grow.
+
+//Set up an empty buffer of (capacity) writes for each of (processCount) processors. A capacity of 0 sets up none.
+void setup_write_buffers(writeBuffers* buffers,int capacity,int processCount){
+	buffers->capacity = capacity > 0 ? capacity : 0;
+	buffers->processCount = processCount;
+	buffers->modules = NULL;
+	buffers->heads = NULL;
+	buffers->counts = NULL;
+	buffers->held = 0;
+	buffers->peak = 0;
+	buffers->writeStalls = 0;
+
+	if(buffers->capacity > 0){
+		buffers->modules = (int*) placed_malloc((size_t) processCount * capacity * sizeof(int));
+		buffers->heads = (int*) placed_calloc(processCount,sizeof(int));
+		buffers->counts = (int*) placed_calloc(processCount,sizeof(int));
+	}
+}
+
+//Append a write to (module) to the buffer of (process). Returns false, leaving the buffer alone, when it is full.
+bool push_write(writeBuffers* buffers,int process,int module){
+	int count = buffers->counts[process];
+
+	if(count == buffers->capacity){
+		return false;
+	}
+
+	int slot = buffers->heads[process] + count;
+	slot -= slot >= buffers->capacity ? buffers->capacity : 0;
+	buffers->modules[process * buffers->capacity + slot] = module;
+	buffers->counts[process] = count + 1;
+	buffers->held++;
+	buffers->peak = buffers->held > buffers->peak ? buffers->held : buffers->peak;
+	return true;
+}
+
+//Module of the oldest write in the buffer of (process), or -1 when the buffer is empty.
+int oldest_write(const writeBuffers* buffers,int process){
+	if(buffers->counts[process] == 0){
+		return -1;
+	}
+
+	return buffers->modules[process * buffers->capacity + buffers->heads[process]];
+}
+
+//Remove the oldest write from the buffer of (process), which must not be empty.
+void pop_write(writeBuffers* buffers,int process){
+	int head = buffers->heads[process] + 1;
+
+	buffers->heads[process] = head == buffers->capacity ? 0 : head;
+	buffers->counts[process]--;
+	buffers->held--;
+}
+
+//Make (destination) hold the same writes as (source), which has the same capacity and processor count.
+void copy_write_buffers(writeBuffers* destination,const writeBuffers* source){
+	if(source->capacity > 0){
+		memcpy(destination->modules,source->modules,(size_t) source->processCount * source->capacity * sizeof(int));
+		memcpy(destination->heads,source->heads,source->processCount * sizeof(int));
+		memcpy(destination->counts,source->counts,source->processCount * sizeof(int));
+	}
+	destination->held = source->held;
+	destination->peak = source->peak;
+	destination->writeStalls = source->writeStalls;
+}
+
+void free_write_buffers(writeBuffers* buffers){
+	placed_free(buffers->modules);
+	placed_free(buffers->heads);
+	placed_free(buffers->counts);
+	buffers->modules = NULL;
+	buffers->heads = NULL;
+	buffers->counts = NULL;
+	buffers->capacity = 0;
+}
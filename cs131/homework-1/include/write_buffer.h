@@ -0,0 +1,29 @@
+#ifndef WRITE_BUFFER_H
+#define WRITE_BUFFER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define MAX_WRITE_BUFFER 64
+
+//Bounded write buffers of the processors: one ring of (capacity) modules per processor, all in one block.
+//A buffered write leaves its ring once its module has granted it.
+typedef struct writeBuffers {
+	int capacity;	//Writes a processor's buffer holds (0 when writes are not buffered)
+	int processCount;
+	int* modules;	//Module of every buffered write, (capacity) slots per processor
+	int* heads;	//Slot of the oldest write of every ring
+	int* counts;	//Writes in every ring
+	int held;	//Writes in all the rings
+	int peak;	//Most writes the rings have held at once
+	long writeStalls;	//Cycles processors waited for room in their full buffer
+} writeBuffers;
+
+void setup_write_buffers(writeBuffers* buffers,int capacity,int processCount);
+bool push_write(writeBuffers* buffers,int process,int module);
+int oldest_write(const writeBuffers* buffers,int process);
+void pop_write(writeBuffers* buffers,int process);
+void copy_write_buffers(writeBuffers* destination,const writeBuffers* source);
+void free_write_buffers(writeBuffers* buffers);
+
+#endif
@@ -1,12 +1,455 @@
 #include "simulator.h"
+#include "coordinator.h"
+#include "stats.h"
+#include "profiler.h"
+#include "result_cache.h"
+#include "kernels.h"
+#include "slo_search.h"
+
+#include <string.h>
+#include <getopt.h>
+
+//Options that change the memory model. The positional arguments (log files and seed)
+//follow the options, e.g. ./main --read-latency 4 logs/uniformLogs.csv logs/gaussianLogs.csv 1
+static struct option longOptions[] = {
+	{"read-latency",required_argument,NULL,'r'},
+	{"write-latency",required_argument,NULL,'w'},
+	{"write-ratio",required_argument,NULL,'W'},
+	{"latency-file",required_argument,NULL,'L'},
+	{"pattern",required_argument,NULL,'F'},
+	{"ports",required_argument,NULL,'p'},
+	{"lines",required_argument,NULL,'e'},
+	{"coalesce",no_argument,NULL,'c'},
+	{"private-cache",required_argument,NULL,'k'},
+	{"write-buffer",required_argument,NULL,'q'},
+	{"nodes",required_argument,NULL,'n'},
+	{"remote-latency",required_argument,NULL,'R'},
+	{"link-bandwidth",required_argument,NULL,'b'},
+	{"local-ratio",required_argument,NULL,'l'},
+	{"workers",required_argument,NULL,'j'},
+	{"seed-per-point",no_argument,NULL,'s'},
+	{"stats",required_argument,NULL,'S'},
+	{"profile",required_argument,NULL,'P'},
+	{"trace",required_argument,NULL,'t'},
+	{"trace-point",required_argument,NULL,'T'},
+	{"cache",required_argument,NULL,'C'},
+	{"isa",required_argument,NULL,'I'},
+	{"self-test",no_argument,NULL,'K'},
+	{"model-tolerance",required_argument,NULL,'M'},
+	{"series",required_argument,NULL,'u'},
+	{"series-point",required_argument,NULL,'U'},
+	{"arrivals",required_argument,NULL,'A'},
+	{"arrival-rate",required_argument,NULL,'a'},
+	{"burst",required_argument,NULL,'B'},
+	{"think-time",required_argument,NULL,'z'},
+	{"outstanding",required_argument,NULL,'o'},
+	{"log-sync",required_argument,NULL,'y'},
+	{"sigma",required_argument,NULL,'g'},
+	{"sigma-modules",required_argument,NULL,'G'},
+	{"drift",required_argument,NULL,'d'},
+	{"hot-regions",required_argument,NULL,'H'},
+	{"placement",required_argument,NULL,'x'},
+	{"huge-pages",required_argument,NULL,'X'},
+	{"variance-reduction",required_argument,NULL,'V'},
+	{"variance-cycles",required_argument,NULL,'E'},
+	{"slo-wait",required_argument,NULL,'O'},
+	{"slo-percentile",required_argument,NULL,'Q'},
+	{"slo-threads",required_argument,NULL,'J'},
+	{"slo-cycles",required_argument,NULL,'Z'},
+	{NULL,0,NULL,0}
+};
+
+static void usage(const char* program){
+	fprintf(stderr,"Usage: %s [options] [uniform log] [gaussian log] [seed]\n",program);
+	fprintf(stderr,"  -r, --read-latency N    cycles a module stays busy for a read (default %d)\n",DEFAULT_SERVICE_LATENCY);
+	fprintf(stderr,"  -w, --write-latency N   cycles a module stays busy for a write (default %d)\n",DEFAULT_SERVICE_LATENCY);
+	fprintf(stderr,"  -W, --write-ratio F     fraction of requests that are writes (default 0)\n");
+	fprintf(stderr,"  -L, --latency-file CSV  per-module latencies as rows of module,read,write\n");
+	fprintf(stderr,"  -F, --pattern FILE      access pattern programs the processors pick their requests with (see include/pattern_vm.c)\n");
+	fprintf(stderr,"  -p, --ports N           requests a memory module serves at once (default %d, at most %d)\n",DEFAULT_MODULE_PORTS,MAX_MODULE_PORTS);
+	fprintf(stderr,"  -e, --lines N           lines of a module coalesced and cached requests address (default %d)\n",DEFAULT_MODULE_LINES);
+	fprintf(stderr,"  -c, --coalesce          serve the reads queued at a module for the same line together\n");
+	fprintf(stderr,"  -k, --private-cache S,W give every processor a cache of S sets (a power of two) of W ways (at most %d)\n",CACHE_MAX_WAYS);
+	fprintf(stderr,"  -q, --write-buffer N    writes every processor buffers while they drain, stalling only when full (at most %d)\n",MAX_WRITE_BUFFER);
+	fprintf(stderr,"  -n, --nodes N           NUMA nodes processors and modules are split into (default 1)\n");
+	fprintf(stderr,"  -R, --remote-latency N  extra cycles of an access to another node's module (default 0)\n");
+	fprintf(stderr,"  -b, --link-bandwidth N  remote accesses the inter-node link carries per cycle (default unlimited)\n");
+	fprintf(stderr,"  -l, --local-ratio F     probability a request targets the processor's own node (default 0)\n");
+	fprintf(stderr,"  -g, --sigma F           sigma of Gaussian requests as a fraction of the module count (default 1/3)\n");
+	fprintf(stderr,"  -G, --sigma-modules N   sigma of Gaussian requests in modules, whatever the module count\n");
+	fprintf(stderr,"  -d, --drift EPOCH,F     every EPOCH cycles move each Gaussian mean by up to F of the modules (F >= 1 redraws it)\n");
+	fprintf(stderr,"  -H, --hot-regions N     processors share N Gaussian means instead of having their own\n");
+	fprintf(stderr,"  -A, --arrivals KIND     closed (default), poisson or onoff: how processors issue requests\n");
+	fprintf(stderr,"  -a, --arrival-rate F    mean requests per cycle of each open-loop processor (at most 1)\n");
+	fprintf(stderr,"  -B, --burst ON,OFF      mean cycles of the on and off periods of onoff arrivals\n");
+	fprintf(stderr,"  -z, --think-time N      cycles an open-loop processor pauses after each grant (default 0)\n");
+	fprintf(stderr,"  -o, --outstanding N     requests an open-loop processor holds before dropping arrivals (default unlimited)\n");
+	fprintf(stderr,"  -y, --log-sync POLICY   none (default), data (fdatasync every write) or direct (O_DIRECT) log writes\n");
+	fprintf(stderr,"  -j, --workers N         spread the sweep over N worker processes (implies --seed-per-point)\n");
+	fprintf(stderr,"  -x, --placement POLICY  none (default), compact or scatter: pin the workers to cores and keep their state on their node\n");
+	fprintf(stderr,"  -X, --huge-pages KIND   none (default), transparent or explicit huge pages for the workers' state\n");
+	fprintf(stderr,"  -s, --seed-per-point    derive an independent seed for every sweep point\n");
+	fprintf(stderr,"  -S, --stats FILE        publish live progress counters in FILE (view with memsim-top)\n");
+	fprintf(stderr,"  -P, --profile CSV       write per-phase performance counters of every point to CSV\n");
+	fprintf(stderr,"  -t, --trace FILE        record every event of one point in FILE (replay with memsim-replay)\n");
+	fprintf(stderr,"  -T, --trace-point P,M,D point to trace: processors, memory modules, uniform or gaussian\n");
+	fprintf(stderr,"  -u, --series FILE       record per-module utilization and queue depth of one point (view with memsim-series)\n");
+	fprintf(stderr,"  -U, --series-point P,M,D point to record: processors, memory modules, uniform or gaussian\n");
+	fprintf(stderr,"  -C, --cache DIR         reuse point results stored in DIR by earlier sessions (implies --seed-per-point)\n");
+	fprintf(stderr,"  -I, --isa NAME          kernel variant: scalar, sse4.2, avx2, avx512 or auto (default auto)\n");
+	fprintf(stderr,"  -V, --variance-reduction MODES  none (default) or a comma-separated list of crn, antithetic and control\n");
+	fprintf(stderr,"  -E, --variance-cycles N cycles every simulation of a variance-reduced point runs for (default %d)\n",VARIANCE_DEFAULT_CYCLES);
+	fprintf(stderr,"  -O, --slo-wait F        instead of the sweep, find the fewest modules keeping the average request wait at most F cycles for every processor count\n");
+	fprintf(stderr,"  -Q, --slo-percentile Q  compare the Qth percentile request wait with --slo-wait instead of the average wait\n");
+	fprintf(stderr,"  -J, --slo-threads N     module counts the search simulates at once (default: online cores)\n");
+	fprintf(stderr,"  -Z, --slo-cycles N      cycles every simulation of the search runs for (default %d)\n",SLO_DEFAULT_CYCLES);
+	fprintf(stderr,"  -M, --model-tolerance F estimate points whose wait time the analytical model predicts within F (implies --seed-per-point)\n");
+	fprintf(stderr,"  -K, --self-test         check that every kernel variant matches the reference and exit\n");
+}
+
+//Check every kernel variant the processor supports against the scalar reference, and the random
+//streams against the C library's random(). Returns the number of failed checks.
+static int self_test(void){
+	int failures = 0;
+
+	printf("Kernel variants (selected: %s)\n",isa_name(active_isa()));
+	failures += kernels_self_test(stdout);
+	printf("Random streams\n");
+	failures += random_self_test(stdout);
+	printf("%s\n",failures == 0 ? "All checks passed" : "Some checks FAILED");
+
+	return failures;
+}
+
+//Parse an --arrivals value into the arrival process of (config).
+//Returns false if the value names no process.
+static bool parse_arrivals(simulatorConfig* config,const char* value){
+	if(strcmp(value,"closed") == 0){
+		config->arrivals = ArrivalsClosed;
+	} else if(strcmp(value,"poisson") == 0){
+		config->arrivals = ArrivalsPoisson;
+	} else if(strcmp(value,"onoff") == 0){
+		config->arrivals = ArrivalsOnOff;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+//Parse a --log-sync value into the log writing policy of (config).
+//Returns false if the value names no policy.
+static bool parse_log_sync(simulatorConfig* config,const char* value){
+	if(strcmp(value,"none") == 0){
+		config->logSync = WriterSyncNone;
+	} else if(strcmp(value,"data") == 0){
+		config->logSync = WriterSyncData;
+	} else if(strcmp(value,"direct") == 0){
+		config->logSync = WriterSyncDirect;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+//Parse a --placement value into the worker placement policy of (config).
+//Returns false if the value names no policy.
+static bool parse_placement(simulatorConfig* config,const char* value){
+	if(strcmp(value,"none") == 0){
+		config->placement = PlacementNone;
+	} else if(strcmp(value,"compact") == 0){
+		config->placement = PlacementCompact;
+	} else if(strcmp(value,"scatter") == 0){
+		config->placement = PlacementScatter;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+//Parse a --huge-pages value into the page policy of (config).
+//Returns false if the value names no policy.
+static bool parse_huge_pages(simulatorConfig* config,const char* value){
+	if(strcmp(value,"none") == 0){
+		config->hugePages = HugePagesNone;
+	} else if(strcmp(value,"transparent") == 0){
+		config->hugePages = HugePagesTransparent;
+	} else if(strcmp(value,"explicit") == 0){
+		config->hugePages = HugePagesExplicit;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+//Parse a --variance-reduction value such as "crn,antithetic" into the variance reduction of (config).
+//Returns false if a mode is unknown.
+static bool parse_variance_modes(simulatorConfig* config,const char* value){
+	char modes[64];
+	char* name;
+	char* saved;
+
+	snprintf(modes,sizeof(modes),"%s",value);
+	config->varianceReduction = VarianceNone;
+
+	for(name = strtok_r(modes,",",&saved); name != NULL; name = strtok_r(NULL,",",&saved)){
+		if(strcmp(name,"crn") == 0){
+			config->varianceReduction |= VarianceCommon;
+		} else if(strcmp(name,"antithetic") == 0){
+			config->varianceReduction |= VarianceAntithetic;
+		} else if(strcmp(name,"control") == 0){
+			config->varianceReduction |= VarianceControl;
+		} else if(strcmp(name,"none") != 0){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Parse a point such as "8,64,gaussian", given to --trace-point or --series-point.
+//Returns false if the value does not name a point.
+static bool parse_point(const char* value,int* processCount,int* modules,distribution* dist){
+	char name[16];
+
+	if(sscanf(value,"%d,%d,%15s",processCount,modules,name) != 3){
+		return false;
+	}
+
+	if(strcmp(name,"uniform") == 0 || strcmp(name,"0") == 0){
+		*dist = Uniform;
+	} else if(strcmp(name,"gaussian") == 0 || strcmp(name,"1") == 0){
+		*dist = Gaussian;
+	} else {
+		return false;
+	}
+
+	return *processCount > 0 && *modules > 0;
+}
 
 int main(int argc, char** argv){
+	simulatorConfig config;
+	int option;
+	int workers = 0;
+	const char* statsFile = NULL;
+	const char* profileFile = NULL;
+	const char* cacheDirectory = NULL;
+	sloTarget slo = {0.0,0.0,0,SLO_DEFAULT_CYCLES};
+
+	default_config(&config);
+
+	while((option = getopt_long(argc,argv,"r:w:W:L:F:p:e:ck:q:n:R:b:l:j:sS:P:t:T:C:I:KM:u:U:A:a:B:z:o:y:g:G:d:H:x:X:V:E:O:Q:J:Z:",longOptions,NULL)) != -1){
+		switch(option){
+			case 'r':
+				config.readLatency = atoi(optarg);
+				break;
+			case 'w':
+				config.writeLatency = atoi(optarg);
+				break;
+			case 'W':
+				config.writeRatio = atof(optarg);
+				break;
+			case 'p':
+				config.modulePorts = atoi(optarg);
+				break;
+			case 'e':
+				config.moduleLines = atoi(optarg);
+				break;
+			case 'c':
+				config.coalesceReads = true;
+				break;
+			case 'k':
+				if(sscanf(optarg,"%d,%d",&(config.cacheSets),&(config.cacheWays)) != 2){
+					fprintf(stderr,"Invalid private cache %s (expected sets,ways)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'q':
+				config.writeBuffer = atoi(optarg);
+				break;
+			case 'L':
+				if(load_latency_overrides(&config,optarg) < 0){
+					fprintf(stderr,"Could not read latency file %s\n",optarg);
+					return 1;
+				}
+				break;
+			case 'F':
+				if(!load_patterns(&(config.patterns),optarg)){
+					return 1;
+				}
+				break;
+			case 'n':
+				config.nodeCount = atoi(optarg);
+				break;
+			case 'R':
+				config.remoteLatency = atoi(optarg);
+				break;
+			case 'b':
+				config.linkBandwidth = atoi(optarg);
+				break;
+			case 'l':
+				config.localRatio = atof(optarg);
+				break;
+			case 'A':
+				if(!parse_arrivals(&config,optarg)){
+					fprintf(stderr,"Unknown arrival process %s (expected closed, poisson or onoff)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'a':
+				config.arrivalRate = atof(optarg);
+				break;
+			case 'B':
+				if(sscanf(optarg,"%d,%d",&(config.burstCycles),&(config.idleCycles)) != 2){
+					fprintf(stderr,"Invalid burst %s (expected on cycles,off cycles)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'z':
+				config.thinkCycles = atoi(optarg);
+				break;
+			case 'o':
+				config.outstandingLimit = atoi(optarg);
+				break;
+			case 'y':
+				if(!parse_log_sync(&config,optarg)){
+					fprintf(stderr,"Unknown log sync policy %s (expected none, data or direct)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'g':
+				config.sigmaFraction = atof(optarg);
+				break;
+			case 'G':
+				config.sigmaModules = atof(optarg);
+				break;
+			case 'd':
+				if(sscanf(optarg,"%d,%lf",&(config.driftEpoch),&(config.driftDistance)) != 2){
+					fprintf(stderr,"Invalid drift %s (expected epoch cycles,fraction of the modules)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'H':
+				config.hotRegions = atoi(optarg);
+				break;
+			case 'x':
+				if(!parse_placement(&config,optarg)){
+					fprintf(stderr,"Unknown placement policy %s (expected none, compact or scatter)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'X':
+				if(!parse_huge_pages(&config,optarg)){
+					fprintf(stderr,"Unknown huge page policy %s (expected none, transparent or explicit)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'V':
+				if(!parse_variance_modes(&config,optarg)){
+					fprintf(stderr,"Unknown variance reduction %s (expected none or crn, antithetic and control separated by commas)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'E':
+				config.varianceCycles = atoi(optarg);
+				break;
+			case 'O':
+				slo.wait = atof(optarg);
+				break;
+			case 'Q':
+				slo.percentile = atof(optarg);
+				break;
+			case 'J':
+				slo.threads = atoi(optarg);
+				break;
+			case 'Z':
+				slo.cycles = atoi(optarg);
+				break;
+			case 'j':
+				workers = atoi(optarg);
+				break;
+			case 's':
+				config.seedPerPoint = true;
+				break;
+			case 'S':
+				statsFile = optarg;
+				break;
+			case 'P':
+				profileFile = optarg;
+				break;
+			case 'C':
+				cacheDirectory = optarg;
+				config.seedPerPoint = true;
+				break;
+			case 'I':
+				if(!select_isa(optarg)){
+					fprintf(stderr,"Kernel variant %s is unknown or not supported by this processor\n",optarg);
+					return 1;
+				}
+				break;
+			case 'K':
+				return self_test() == 0 ? 0 : 1;
+			case 'M':
+				config.modelTolerance = atof(optarg);
+				config.seedPerPoint = true;
+				break;
+			case 't':
+				config.tracePath = optarg;
+				break;
+			case 'T':
+				if(!parse_point(optarg,&(config.traceProcessors),&(config.traceModules),&(config.traceDist))){
+					fprintf(stderr,"Invalid trace point %s (expected processors,modules,uniform|gaussian)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'u':
+				config.seriesPath = optarg;
+				break;
+			case 'U':
+				if(!parse_point(optarg,&(config.seriesProcessors),&(config.seriesModules),&(config.seriesDist))){
+					fprintf(stderr,"Invalid series point %s (expected processors,modules,uniform|gaussian)\n",optarg);
+					return 1;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(!validate_config(&config,workers)){
+		return 1;
+	}
+
+	//Counters are opened for the calling process only, so profiling needs a serial session.
+	if(profileFile != NULL && workers > 0){
+		fprintf(stderr,"--profile cannot be combined with --workers\n");
+		return 1;
+	}
+
+	//The search simulates the closed loop on threads of this process, outside of the sweep and its per-point features.
+	if(slo.wait < 0.0 || slo.percentile < 0.0 || slo.percentile >= 100.0 || slo.threads < 0 || slo.cycles < 2 || (slo.percentile > 0.0 && slo.wait == 0.0)){
+		fprintf(stderr,"--slo-wait must be positive, --slo-percentile below 100 and --slo-cycles at least 2\n");
+		return 1;
+	}
+	if(slo.wait > 0.0 && (config.arrivals != ArrivalsClosed || workers > 0 || profileFile != NULL || cacheDirectory != NULL ||
+		config.tracePath != NULL || config.seriesPath != NULL || config.varianceReduction != VarianceNone || config.modelTolerance > 0.0)){
+		fprintf(stderr,"--slo-wait cannot be combined with open-loop arrivals, --workers, --profile, --cache, --trace, --series, --variance-reduction or --model-tolerance\n");
+		return 1;
+	}
+
 	printf("Program: %s\n",argv[0]);	
 	printf("Successfully included all files");
 
 	//Get name of *.csv files to redirect to when the simulation is done
 	//These files will hold the data to create the gaussian and uniform distribution plots.
 
+	argc -= optind - 1;
+	argv += optind - 1;
+
 	const char* uniformLog = argc > 1 ? argv[1] : "logs/uniformLogs.csv";
 	const char* gaussianLog = argc > 2 ? argv[2] : "logs/gaussianLogs.csv";
 	const int seed = argc > 3 ? atoi(argv[3]) : 1;
@@ -14,7 +457,8 @@ int main(int argc, char** argv){
 
 	printf("Setting up random number generator with seed %d\n",seed);
 	//Initialize random number generator with predefined seed.
-	srand(seed);	
+	seed_random(seed);
+	config.seed = seed;
 
 	//We will use a total of 6 processor configurations for this simulation
 	//2 simulations will be tested for memory modules of 1 - 2048 memory modules for 2 processors requesting memory access.
@@ -24,9 +468,67 @@ int main(int argc, char** argv){
 	//Another 2 simulations will be done the same way for a processor configuration of 4 processors, than 8, etc.
 
 	int processorConfigs[PROCESSOR_CONFIGURATION_COUNT] = {2,4,8,16,32,64};
+
+	//The stats file is mapped before any worker is forked so that all of them publish into it.
+	if(statsFile != NULL){
+		if(!stats_open(statsFile)){
+			fprintf(stderr,"Could not create stats file %s\n",statsFile);
+			free_config(&config);
+			return 1;
+		}
+		printf("Publishing live statistics in %s (run ./memsim-top %s)\n",statsFile,statsFile);
+	}
+
+	if(profileFile != NULL){
+		if(!profiler_open(profileFile)){
+			fprintf(stderr,"Could not create profile file %s\n",profileFile);
+			stats_close();
+			free_config(&config);
+			return 1;
+		}
+
+		if(!profiler_counter_available(CounterCycles)){
+			fprintf(stderr,"Hardware performance counters are unavailable; only elapsed time will be profiled\n");
+		}
+	}
+
+	if(cacheDirectory != NULL && !cache_open(cacheDirectory)){
+		fprintf(stderr,"Could not open result cache %s; every point will be simulated\n",cacheDirectory);
+	}
 	
 	//Run simulation for all possible memory module configurations for each of the 6 different processor counts.
-	run_session(processorConfigs,PROCESSOR_CONFIGURATION_COUNT,DEFAULT_MAX_MEMORY_MODULES,uniformLog,gaussianLog);
+	if(slo.wait > 0.0){
+		//Only the answers of the search are printed; the logs are left alone.
+		run_slo_search(processorConfigs,PROCESSOR_CONFIGURATION_COUNT,DEFAULT_MAX_MEMORY_MODULES,&config,&slo);
+	} else if(workers > 0){
+		//Distribute the points of the session over worker processes on this machine.
+		sweepTransport transport;
+		local_transport(&transport);
+
+		if(run_distributed_session(processorConfigs,PROCESSOR_CONFIGURATION_COUNT,DEFAULT_MAX_MEMORY_MODULES,uniformLog,gaussianLog,&config,workers,&transport) < 0){
+			fprintf(stderr,"Distributed session with %d workers failed\n",workers);
+			stats_close();
+			free_config(&config);
+			return 1;
+		}
+	} else {
+		//A serial session places itself like the first worker would be.
+		place_worker(config.placement,config.hugePages,0);
+		run_session(processorConfigs,PROCESSOR_CONFIGURATION_COUNT,DEFAULT_MAX_MEMORY_MODULES,uniformLog,gaussianLog,&config);
+		release_placement();
+
+		//Workers look points up in their own processes, so only a serial session can report the totals.
+		if(cacheDirectory != NULL){
+			long hits,misses;
+			cache_counts(&hits,&misses);
+			printf("Result cache: %ld points reused, %ld simulated\n",hits,misses);
+		}
+	}
+
+	cache_close();
+	profiler_close();
+	stats_close();
+	free_config(&config);
 		
 	return 0;
 }
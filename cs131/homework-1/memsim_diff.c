@@ -0,0 +1,345 @@
+#include "simulator.h"
+#include "reference_simulator.h"
+#include "parallel_engine.h"
+#include "trace.h"
+#include "rng.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//Differential tester: run randomized sweep points through an engine and through the reference
+//simulator and check that both make the same grants on the same cycles and end with the same result.
+//A failing case is printed with the options that rerun it alone.
+
+#define DEFAULT_CASES 1000
+#define DEFAULT_MAX_PROCESSORS 64
+#define DEFAULT_MAX_MODULES 64
+#define MAX_CASE_LATENCY 4	//Largest read or write latency of a generated case
+#define DIFF_BLOCK_PROCESSORS 4	//Processors per stream of the parallel engine, few enough to spread a case over threads
+#define DIFF_THREADS 4
+#define KNOWN_ANSWER_CYCLES 5000	//Cycles every known-answer point runs for
+#define KNOWN_ANSWER_TOLERANCE 0.01	//Largest distance from a known answer that still counts as holding it
+
+//One randomized point.
+typedef struct diffCase {
+	simulatorConfig config;
+	distribution dist;
+	int processCount;
+	int modules;
+	unsigned int seed;	//Seed of the random stream both engines start from
+} diffCase;
+
+//Engine under test. It simulates (diff) from the current random stream position, records its events in the
+//trace at (tracePath) and stores its outcome in (result). Returns false if it could not record the trace.
+//An engine that draws each block of (blockProcessors) processors' requests from a stream of its own seeds them
+//with seed_block_streams() instead, and the reference draws from the same streams.
+typedef struct candidateEngine {
+	const char* name;
+	bool (*simulate)(const diffCase* diff,const char* tracePath,simulationResult* result);
+	int blockProcessors;	//0 for an engine drawing from a single stream
+} candidateEngine;
+
+//The engine every sweep uses: setup_simulator() and run_simulator().
+static bool simulate_with_run_simulator(const diffCase* diff,const char* tracePath,simulationResult* result){
+	traceHeader header;
+	simulator sim;
+
+	fill_trace_header(&header,&(diff->config),diff->seed,diff->dist,diff->processCount,diff->modules);
+	if(!trace_open(tracePath,&header)){
+		return false;
+	}
+
+	setup_simulator(&sim,diff->processCount,diff->modules,&(diff->config));
+	run_simulator(&sim,diff->dist,NULL);
+	*result = sim.result;
+	free_simulator(&sim);
+
+	return trace_close(result->cycles,result->waitTime);
+}
+
+//The data-parallel engine, with blocks small enough for most cases to run on several threads.
+static bool simulate_with_parallel_engine(const diffCase* diff,const char* tracePath,simulationResult* result){
+	traceHeader header;
+
+	fill_trace_header(&header,&(diff->config),diff->seed,diff->dist,diff->processCount,diff->modules);
+	if(!trace_open(tracePath,&header)){
+		return false;
+	}
+
+	if(parallel_simulate(&(diff->config),diff->dist,diff->processCount,diff->modules,diff->seed,DIFF_THREADS,DIFF_BLOCK_PROCESSORS,result) < 0){
+		fprintf(stderr,"Could not start %d threads\n",DIFF_THREADS);
+		trace_close(0,0.0);
+		return false;
+	}
+
+	return trace_close(result->cycles,result->waitTime);
+}
+
+static const candidateEngine engines[] = {
+	{"run_simulator",simulate_with_run_simulator,0},
+	{"parallel",simulate_with_parallel_engine,DIFF_BLOCK_PROCESSORS}
+};
+
+//SplitMix64 step, used to derive the cases so that they never touch the simulation's random stream.
+static uint64_t mix(uint64_t value){
+	value += 0x9e3779b97f4a7c15ULL;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
+
+//Derive case (index) of a run seeded with (seed). Every case depends only on its own index.
+static void make_case(diffCase* diff,uint64_t seed,long index,int maxProcessors,int maxModules){
+	uint64_t state = mix(seed ^ mix((uint64_t) index));
+	uint64_t draw;
+
+	default_config(&(diff->config));
+	diff->dist = (distribution) ((state = mix(state)) & 1);
+	diff->processCount = 1 + (int) ((state = mix(state)) % maxProcessors);
+	diff->modules = 1 + (int) ((state = mix(state)) % maxModules);
+	diff->seed = (unsigned int) (state = mix(state));
+
+	//A third of the cases keep the single-cycle read-only model; the others vary the service times.
+	draw = (state = mix(state)) % 3;
+	if(draw > 0){
+		diff->config.readLatency = 1 + (int) ((state = mix(state)) % MAX_CASE_LATENCY);
+		diff->config.writeLatency = 1 + (int) ((state = mix(state)) % MAX_CASE_LATENCY);
+		diff->config.writeRatio = draw == 2 ? (double) ((state = mix(state)) % 1000) / 1000.0 : 0.0;
+	}
+	if(diff->dist == Gaussian && ((state = mix(state)) & 3) == 0){
+		diff->config.sigmaFraction = 0.01 + (double) ((state = mix(state)) % 100) / 100.0;
+	}
+}
+
+//A point the reference does not cover whose write stall follows from the model itself.
+typedef struct knownAnswer {
+	const char* name;
+	int processCount;
+	int modules;
+	double writeRatio;
+	int writeBuffer;
+	double writeStall;
+} knownAnswer;
+
+static const knownAnswer answers[] = {
+	//Buffered writes to a single-cycle module are granted one per cycle, so every one of 16 writers sharing it
+	//stalls on a full buffer 15 cycles in 16, however deep the buffers are.
+	{"16 writers, 1 module, 1-write buffers",16,1,1.0,1,15.0 / 16.0},
+	{"16 writers, 1 module, 4-write buffers",16,1,1.0,4,15.0 / 16.0},
+	//A lone writer's buffer drains as fast as it fills.
+	{"1 writer, 1 module, 1-write buffer",1,1,1.0,1,0.0}
+};
+
+//Run every known-answer point for a fixed number of cycles and report the ones whose write stall is off.
+//Returns the number of points that are.
+static int check_known_answers(void){
+	int failures = 0;
+
+	for(size_t i = 0; i < sizeof(answers) / sizeof(answers[0]); i++){
+		const knownAnswer* answer = &(answers[i]);
+		simulatorConfig config;
+		simulator sim;
+
+		default_config(&config);
+		config.writeRatio = answer->writeRatio;
+		config.writeBuffer = answer->writeBuffer;
+
+		seed_random(1);
+		setup_simulator(&sim,answer->processCount,answer->modules,&config);
+		sim.cycleLimit = KNOWN_ANSWER_CYCLES;
+		run_simulator(&sim,Uniform,NULL);
+		if(fabs(sim.result.writeStall - answer->writeStall) > KNOWN_ANSWER_TOLERANCE){
+			fprintf(stderr,"%s: write stall %f, expected %f\n",answer->name,sim.result.writeStall,answer->writeStall);
+			failures++;
+		}
+		free_simulator(&sim);
+	}
+
+	printf("known answers: %d of %d hold\n",(int) (sizeof(answers) / sizeof(answers[0])) - failures,(int) (sizeof(answers) / sizeof(answers[0])));
+	return failures;
+}
+
+static void describe_case(const diffCase* diff){
+	fprintf(stderr,"  %d processors, %d modules, %s, seed %u, read latency %d, write latency %d, write ratio %g, sigma fraction %g\n",
+		diff->processCount,diff->modules,diff->dist == Uniform ? "uniform" : "gaussian",diff->seed,diff->config.readLatency,
+		diff->config.writeLatency,diff->config.writeRatio,diff->config.sigmaFraction);
+}
+
+//Compare the grants recorded in the trace at (tracePath) and the candidate's (result) with the reference (run).
+//Returns true if they agree and reports the first difference otherwise.
+static bool compare_with_reference(const char* tracePath,const simulationResult* result,const referenceRun* run){
+	FILE* file = fopen(tracePath,"rb");
+	traceFooter footer;
+	traceRecord record;
+	uint64_t position;
+	long grant = 0;
+	bool same = true;
+
+	//The footer at the end tells how many records follow the header.
+	if(file == NULL || fseek(file,-(long) sizeof(traceFooter),SEEK_END) != 0 || fread(&footer,sizeof(footer),1,file) != 1 ||
+		footer.magic != TRACE_END_MAGIC || fseek(file,sizeof(traceHeader),SEEK_SET) != 0){
+		fprintf(stderr,"Could not read trace %s\n",tracePath);
+		if(file != NULL){
+			fclose(file);
+		}
+		return false;
+	}
+
+	for(position = 0; same && position < footer.records; position++){
+		if(fread(&record,sizeof(record),1,file) != 1){
+			fprintf(stderr,"Trace %s is truncated\n",tracePath);
+			same = false;
+			break;
+		}
+		if((record.moduleKind >> 24) != TraceGrant){
+			continue;
+		}
+
+		const referenceGrant* expected = grant < run->grantCount ? &(run->grants[grant]) : NULL;
+		int module = (int) (record.moduleKind & 0xffffffU);
+
+		if(expected == NULL || expected->cycle != (int) record.cycle || expected->processor != record.processor || expected->module != module){
+			fprintf(stderr,"Grant %ld differs: engine gave processor %u module %d on cycle %u, ",grant,record.processor,module,record.cycle);
+			if(expected != NULL){
+				fprintf(stderr,"reference gave processor %d module %d on cycle %d\n",expected->processor,expected->module,expected->cycle);
+			} else {
+				fprintf(stderr,"reference made only %ld grants\n",run->grantCount);
+			}
+			same = false;
+		}
+		grant++;
+	}
+	fclose(file);
+
+	if(same && grant != run->grantCount){
+		fprintf(stderr,"Engine made %ld grants, reference %ld\n",grant,run->grantCount);
+		same = false;
+	}
+
+	if(same && (result->cycles != run->cycles || result->waitTime != run->waitTime)){
+		fprintf(stderr,"Results differ: engine %d cycles, wait %.17g; reference %d cycles, wait %.17g\n",
+			result->cycles,result->waitTime,run->cycles,run->waitTime);
+		same = false;
+	}
+
+	return same;
+}
+
+static void usage(const char* program){
+	fprintf(stderr,"Usage: %s [-n cases] [-s seed] [-k case] [-p max processors] [-m max modules] [-e engine] [-c]\n",program);
+	fprintf(stderr,"  -c checks the points the reference does not cover against their known answers instead\n");
+	fprintf(stderr,"Engines:");
+	for(size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++){
+		fprintf(stderr," %s",engines[i].name);
+	}
+	fprintf(stderr,"\n");
+}
+
+int main(int argc,char** argv){
+	const candidateEngine* engine = &(engines[0]);
+	long cases = DEFAULT_CASES;
+	long first = 0;
+	uint64_t seed = 1;
+	int maxProcessors = DEFAULT_MAX_PROCESSORS;
+	int maxModules = DEFAULT_MAX_MODULES;
+	long failures = 0;
+	char tracePath[4096];
+	struct timespec started,finished;
+	int option;
+	long i;
+
+	while((option = getopt(argc,argv,"n:s:k:p:m:e:c")) != -1){
+		switch(option){
+			case 'n':
+				cases = atol(optarg);
+				break;
+			case 's':
+				seed = strtoull(optarg,NULL,10);
+				break;
+			case 'k':
+				first = atol(optarg);
+				cases = 1;
+				break;
+			case 'p':
+				maxProcessors = atoi(optarg);
+				break;
+			case 'm':
+				maxModules = atoi(optarg);
+				break;
+			case 'e':
+				engine = NULL;
+				for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++){
+					if(strcmp(optarg,engines[e].name) == 0){
+						engine = &(engines[e]);
+					}
+				}
+				if(engine == NULL){
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'c':
+				return check_known_answers() > 0 ? 2 : 0;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(cases < 1 || first < 0 || maxProcessors < 1 || maxModules < 1){
+		usage(argv[0]);
+		return 1;
+	}
+
+	const char* directory = getenv("TMPDIR");
+	snprintf(tracePath,sizeof(tracePath),"%s/memsim-diff-%d.trace",directory != NULL ? directory : "/tmp",(int) getpid());
+
+	clock_gettime(CLOCK_MONOTONIC,&started);
+	for(i = first; i < first + cases; i++){
+		diffCase diff;
+		referenceRun run;
+		simulationResult result;
+
+		make_case(&diff,seed,i,maxProcessors,maxModules);
+
+		threadRandom* streams = NULL;
+		if(engine->blockProcessors > 0){
+			int blocks = (diff.processCount + engine->blockProcessors - 1) / engine->blockProcessors;
+
+			streams = (threadRandom*) malloc(blocks * sizeof(threadRandom));
+			seed_block_streams(streams,blocks,diff.seed);
+		}
+
+		seed_random(diff.seed);
+		reference_simulate(&(diff.config),diff.dist,diff.processCount,diff.modules,streams,engine->blockProcessors,&run);
+		free(streams);
+
+		seed_random(diff.seed);
+		if(!engine->simulate(&diff,tracePath,&result)){
+			fprintf(stderr,"Could not record trace %s\n",tracePath);
+			free_reference_run(&run);
+			unlink(tracePath);
+			return 1;
+		}
+
+		if(!compare_with_reference(tracePath,&result,&run)){
+			fprintf(stderr,"Case %ld failed (rerun with -s %llu -k %ld):\n",i,(unsigned long long) seed,i);
+			describe_case(&diff);
+			failures++;
+		}
+
+		free_reference_run(&run);
+	}
+	clock_gettime(CLOCK_MONOTONIC,&finished);
+	unlink(tracePath);
+
+	double seconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+	printf("%s: %ld of %ld cases match the reference (%.0f cases per minute)\n",engine->name,cases - failures,cases,
+		seconds > 0.0 ? cases * 60.0 / seconds : 0.0);
+
+	return failures > 0 ? 2 : 0;
+}
@@ -0,0 +1,194 @@
+#include "queue.h"
+#include "rng.h"
+#include "kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+//Fuzzing entry points for the queue and random stream APIs. Each input is checked against a simple
+//model: the queue against an array, the stream against the C library's random_r() and its own saved states.
+//Any disagreement aborts, which is what libFuzzer and AFL report as a crash.
+//
+//libFuzzer: clang -g -O1 -fsanitize=fuzzer,address -DMEMSIM_LIBFUZZER -I./include memsim_fuzz.c include/queue.c include/rng.c include/kernels.c
+//AFL:       make memsim-fuzz CC=afl-gcc, then afl-fuzz -i inputs -o findings -- ./memsim-fuzz @@
+//Without a fuzzer, memsim-fuzz runs the inputs given as files (or standard input) once, to reproduce a finding.
+
+#define FUZZ_QUEUE_CAPACITY 4096	//Elements the model queue holds; longer inputs stop pushing
+#define FUZZ_MAX_DRAWS 100000	//Numbers drawn from a stream per input
+
+//Stop with a message when the API and the model disagree.
+static void check(bool condition,const char* what){
+	if(!condition){
+		fprintf(stderr,"Mismatch: %s\n",what);
+		abort();
+	}
+}
+
+//Interpret the input as queue operations: every byte picks an operation, the next one is its argument.
+static void fuzz_queue(const uint8_t* data,size_t size){
+	int model[FUZZ_QUEUE_CAPACITY];
+	int head = 0,length = 0;
+	node* queue = NULL;
+	size_t i;
+	int j;
+
+	for(i = 0; i + 1 < size; i += 2){
+		int value = data[i + 1];
+
+		switch(data[i] % 4){
+			case 0:
+				if(head + length < FUZZ_QUEUE_CAPACITY){
+					push(&queue,value);
+					model[head + length++] = value;
+				}
+				break;
+			case 1:
+				if(length > 0){
+					check(peek(&queue) == model[head],"peek");
+					check(pop(&queue) == model[head],"pop");
+					head++;
+					length--;
+				}
+				break;
+			case 2: {
+				bool present = false;
+				for(j = head; j < head + length; j++){
+					present = present || model[j] == value;
+				}
+				check(contains(&queue,value) == present,"contains");
+				break;
+			}
+			case 3:
+				check(empty(&queue) == (length == 0),"empty");
+				break;
+		}
+	}
+
+	destroyQueue(&queue);
+	check(empty(&queue),"destroyQueue");
+}
+
+//Interpret the input as a seed, a kernel variant, a number of draws and the positions of saved states.
+//The stream must match random_r() seeded the same way, and restoring a saved state must replay what followed it.
+static void fuzz_random(const uint8_t* data,size_t size){
+	static const char* variants[] = {"scalar","sse4.2","avx2","avx512"};
+	struct random_data reference;
+	char referenceState[RANDOM_STATE_BYTES];
+	char snapshot[RANDOM_STATE_BYTES];
+	threadRandom stream;
+	threadRandom* previous;
+	unsigned int seed = 0;
+	int draws,saveAt,i;
+	size_t k;
+
+	if(size < 7){
+		return;
+	}
+
+	memcpy(&seed,data,sizeof(seed));
+	if(!select_isa(variants[data[4] % 4])){
+		select_isa("scalar");
+	}
+	draws = 1 + (int) ((data[5] | (data[6] << 8)) * (size_t) FUZZ_MAX_DRAWS / 65536);
+	saveAt = size > 8 ? (int) ((data[7] | (data[8] << 8)) % draws) : 0;
+
+	previous = use_thread_random(&stream);
+	memset(&reference,0,sizeof(reference));
+	initstate_r(seed,referenceState,sizeof(referenceState),&reference);
+	seed_random(seed);
+
+	long* saved = (long*) malloc(draws * sizeof(long));
+	for(i = 0; i < draws; i++){
+		int32_t expected;
+
+		if(i == saveAt){
+			save_random_state(snapshot);
+		}
+		random_r(&reference,&expected);
+		saved[i] = next_random();
+		check(saved[i] == expected,"next_random against random_r");
+	}
+
+	//Replay from the saved state, possibly after drawing a few numbers elsewhere.
+	for(k = 9; k < size && k < 64; k++){
+		next_random();
+	}
+	restore_random_state(snapshot);
+	for(i = saveAt; i < draws; i++){
+		check(next_random() == saved[i],"restore_random_state");
+	}
+
+	free(saved);
+	use_thread_random(previous);
+	select_isa("auto");
+}
+
+//Entry point of libFuzzer (and of the standalone driver below): the first byte picks the API.
+int LLVMFuzzerTestOneInput(const uint8_t* data,size_t size){
+	if(size == 0){
+		return 0;
+	}
+
+	if(data[0] % 2 == 0){
+		fuzz_queue(data + 1,size - 1);
+	} else {
+		fuzz_random(data + 1,size - 1);
+	}
+
+	return 0;
+}
+
+#ifndef MEMSIM_LIBFUZZER
+//Read a whole file (or standard input for "-") into a buffer.
+static uint8_t* read_input(const char* path,size_t* size){
+	FILE* file = strcmp(path,"-") == 0 ? stdin : fopen(path,"rb");
+	uint8_t* data = NULL;
+	size_t capacity = 0;
+
+	*size = 0;
+	if(file == NULL){
+		return NULL;
+	}
+
+	while(true){
+		if(*size == capacity){
+			capacity = capacity > 0 ? 2 * capacity : 4096;
+			data = (uint8_t*) realloc(data,capacity);
+		}
+
+		size_t got = fread(data + *size,1,capacity - *size,file);
+		*size += got;
+		if(got == 0){
+			break;
+		}
+	}
+
+	if(file != stdin){
+		fclose(file);
+	}
+	return data;
+}
+
+//Run every input once (AFL runs the program on one file at a time).
+int main(int argc,char** argv){
+	int i;
+
+	for(i = 1; i < argc || (argc == 1 && i == 1); i++){
+		const char* path = argc > 1 ? argv[i] : "-";
+		size_t size;
+		uint8_t* data = read_input(path,&size);
+
+		if(data == NULL && size == 0 && strcmp(path,"-") != 0){
+			fprintf(stderr,"Could not read %s\n",path);
+			return 1;
+		}
+
+		LLVMFuzzerTestOneInput(data,size);
+		free(data);
+	}
+
+	return 0;
+}
+#endif
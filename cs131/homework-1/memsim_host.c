@@ -0,0 +1,420 @@
+#define _GNU_SOURCE	//pthread_setaffinity_np()
+
+#include "simulator.h"
+#include "locality.h"
+#include "placement.h"
+#include "rng.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//Measure on the host what the simulator predicts: every processor becomes a thread pinned to a core and every
+//memory module a lock (or a counter updated by compare-and-swap) on its own cache line. The threads pick their
+//modules with the uniform and Gaussian draws of the simulator and report the share of their time spent waiting
+//for a module another thread holds, which is the simulator's wait time per cycle. The rows use the schema of
+//logs/*.csv so that plotter.py can draw the measured curves like the simulated ones.
+
+#define DEFAULT_MODULES 64
+#define DEFAULT_MILLISECONDS 20
+#define DEFAULT_HOLD 1
+#define HOST_LINE_BYTES 64
+#define HOST_SPIN_LIMIT 64	//Spins on a held module before the thread yields its core
+#define HOST_UNIFORM_LOG "logs/hostUniformLogs.csv"
+#define HOST_GAUSSIAN_LOG "logs/hostGaussianLogs.csv"
+
+//How a thread accesses its module.
+typedef enum {
+	AccessLock = 0,	//Take the module's spinlock, update the counter (hold) times, release
+	AccessCas = 1	//Compute (hold) updates of the counter and publish them with one compare-and-swap
+} accessMode;
+
+//One memory module, alone on its cache line so that only threads after the same module contend.
+typedef struct hostModule {
+	_Alignas(HOST_LINE_BYTES) atomic_int lock;
+	atomic_long counter;
+} hostModule;
+
+//Settings shared by every thread of a point.
+typedef struct hostPoint {
+	hostModule* modules;
+	int moduleCount;
+	int processCount;
+	distribution dist;
+	accessMode mode;
+	int hold;
+	double sigma;	//Deviation of the Gaussian requests in modules
+	const int* means;	//Mean module of every thread's Gaussian requests
+	unsigned int seed;
+	const hostLayout* layout;	//NULL when the threads are not pinned
+	placementPolicy placement;
+	pthread_barrier_t start;
+	atomic_bool stop;
+} hostPoint;
+
+//What one thread measured.
+typedef struct hostThread {
+	hostPoint* point;
+	int index;
+	pthread_t thread;
+	long requests;
+	long long waitNanoseconds;
+	long long totalNanoseconds;
+	bool pinned;
+} hostThread;
+
+static void usage(const char* program){
+	fprintf(stderr,"Usage: %s [-p processors,...] [-m max modules] [-e module step] [-d milliseconds] [-l lock|cas] [-c hold]\n",program);
+	fprintf(stderr,"       [-x none|compact|scatter] [-g sigma fraction] [-s seed] [uniform log] [gaussian log]\n");
+	fprintf(stderr,"  -p thread counts to measure (default 2,4,8,16,32,64)\n");
+	fprintf(stderr,"  -d time every point runs for (default %d ms)\n",DEFAULT_MILLISECONDS);
+	fprintf(stderr,"  -l lock takes a spinlock per module (default), cas updates the module with compare-and-swap\n");
+	fprintf(stderr,"  -c counter updates of one access, the length of the critical section (default %d)\n",DEFAULT_HOLD);
+	fprintf(stderr,"  -x core placement of the threads (default compact)\n");
+	fprintf(stderr,"  logs default to %s and %s\n",HOST_UNIFORM_LOG,HOST_GAUSSIAN_LOG);
+}
+
+static long long nanoseconds(void){
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+//Spin until the lock of (module) looks free, yielding the core once the holder is likely descheduled.
+static void spin_while_held(hostModule* module){
+	int spins = 0;
+
+	while(atomic_load_explicit(&(module->lock),memory_order_relaxed) != 0){
+		if(++spins > HOST_SPIN_LIMIT){
+			sched_yield();
+			spins = 0;
+		}
+	}
+}
+
+//Access (module) once. Returns the nanoseconds spent waiting for other threads (0 when it was free).
+static long long access_module(hostModule* module,accessMode mode,int hold){
+	long long waitStarted = 0;
+	int i;
+
+	if(mode == AccessLock){
+		while(atomic_exchange_explicit(&(module->lock),1,memory_order_acquire) != 0){
+			if(waitStarted == 0){
+				waitStarted = nanoseconds();
+			}
+			spin_while_held(module);
+		}
+		long long waited = waitStarted != 0 ? nanoseconds() - waitStarted : 0;
+
+		for(i = 0; i < hold; i++){
+			atomic_store_explicit(&(module->counter),atomic_load_explicit(&(module->counter),memory_order_relaxed) + 1,memory_order_relaxed);
+		}
+		atomic_store_explicit(&(module->lock),0,memory_order_release);
+		return waited;
+	}
+
+	long expected = atomic_load_explicit(&(module->counter),memory_order_relaxed);
+	int spins = 0;
+
+	for(;;){
+		long updated = expected;
+
+		for(i = 0; i < hold; i++){
+			updated += 1;
+			__asm__ __volatile__("" : "+r"(updated));	//One update per step, like the lock's critical section
+		}
+		if(atomic_compare_exchange_weak_explicit(&(module->counter),&expected,updated,memory_order_acq_rel,memory_order_relaxed)){
+			break;
+		}
+		if(waitStarted == 0){
+			waitStarted = nanoseconds();
+		}
+		if(++spins > HOST_SPIN_LIMIT){
+			sched_yield();
+			spins = 0;
+		}
+	}
+
+	return waitStarted != 0 ? nanoseconds() - waitStarted : 0;
+}
+
+//Body of one processor: pin, meet the others, then access modules back to back until told to stop.
+static void* run_thread(void* argument){
+	hostThread* self = (hostThread*) argument;
+	hostPoint* point = self->point;
+	threadRandom stream;
+	int cpu = -1,node = -1;
+
+	self->pinned = false;
+	if(point->layout != NULL && placement_slot(point->layout,point->placement,self->index,&cpu,&node)){
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu,&set);
+		self->pinned = pthread_setaffinity_np(pthread_self(),sizeof(set),&set) == 0;
+	}
+
+	//Every thread draws from its own stream, so the draws do not contend on shared random state.
+	use_thread_random(&stream);
+	seed_random(point->seed + (unsigned int) self->index * 0x9e3779b9U);
+
+	pthread_barrier_wait(&(point->start));
+
+	long long started = nanoseconds();
+	long long waited = 0;
+	long requests = 0;
+
+	while(!atomic_load_explicit(&(point->stop),memory_order_relaxed)){
+		int module = point->dist == Uniform ? uniform_request(point->moduleCount) :
+			gaussian_request(point->means[self->index],point->sigma,point->moduleCount);
+
+		waited += access_module(&(point->modules[module]),point->mode,point->hold);
+		requests++;
+	}
+
+	self->totalNanoseconds = nanoseconds() - started;
+	self->waitNanoseconds = waited;
+	self->requests = requests;
+	use_thread_random(NULL);
+	return NULL;
+}
+
+//Measure one point for (milliseconds) and fill (result) with the mean share of time the threads waited,
+//averaged over the threads like getAverageWaitTime() averages over the processors.
+//Returns false if the threads could not be started.
+static bool measure_point(const simulatorConfig* config,distribution dist,int processCount,int modules,accessMode mode,int hold,
+	int milliseconds,const hostLayout* layout,simulationResult* result,int* pinned){
+	hostPoint point;
+	hostThread* threads = (hostThread*) calloc(processCount,sizeof(hostThread));
+	localityEngine locality;
+	struct timespec duration = {milliseconds / 1000,(milliseconds % 1000) * 1000000L};
+	long requests = 0;
+	int started = 0;
+	int i;
+
+	point.modules = (hostModule*) aligned_alloc(HOST_LINE_BYTES,modules * sizeof(hostModule));
+	for(i = 0; i < modules; i++){
+		atomic_init(&(point.modules[i].lock),0);
+		atomic_init(&(point.modules[i].counter),0);
+	}
+	point.moduleCount = modules;
+	point.processCount = processCount;
+	point.dist = dist;
+	point.mode = mode;
+	point.hold = hold;
+	point.seed = point_seed(config->seed,dist,processCount,modules);
+	point.layout = layout;
+	point.placement = config->placement;
+	atomic_init(&(point.stop),false);
+
+	//The Gaussian means are placed as begin_closed_loop() places them, from the point's stream.
+	point.sigma = gaussian_sigma(config->sigmaFraction,config->sigmaModules,modules);
+	setup_locality(&locality,point.sigma,0,0.0,config->hotRegions,processCount,modules);
+	locality_begin(&locality,dist == Gaussian);
+	seed_random(point.seed);
+	if(dist == Gaussian){
+		for(i = 0; i < processCount; i++){
+			locality_assign(&locality,i);
+		}
+	}
+	point.means = locality.means;
+
+	pthread_barrier_init(&(point.start),NULL,processCount + 1);
+	for(i = 0; i < processCount; i++){
+		threads[i].point = &point;
+		threads[i].index = i;
+		if(pthread_create(&(threads[i].thread),NULL,run_thread,&(threads[i])) != 0){
+			break;
+		}
+		started++;
+	}
+	if(started < processCount){
+		//The barrier cannot be met any more; the started threads are abandoned with the process.
+		fprintf(stderr,"Could not start %d threads\n",processCount);
+		return false;
+	}
+
+	pthread_barrier_wait(&(point.start));
+	nanosleep(&duration,NULL);
+	atomic_store_explicit(&(point.stop),true,memory_order_relaxed);
+
+	result->processCount = processCount;
+	result->moduleCount = modules;
+	result->waitTime = 0.0;
+	*pinned = 0;
+	for(i = 0; i < processCount; i++){
+		pthread_join(threads[i].thread,NULL);
+		if(threads[i].totalNanoseconds > 0){
+			result->waitTime += (double) threads[i].waitNanoseconds / threads[i].totalNanoseconds;
+		}
+		requests += threads[i].requests;
+		*pinned += threads[i].pinned ? 1 : 0;
+	}
+	result->waitTime /= processCount;
+	result->cycles = (int) (requests / processCount);	//Requests per thread stand for the simulated cycles
+
+	pthread_barrier_destroy(&(point.start));
+	free_locality(&locality);
+	free(point.modules);
+	free(threads);
+	return true;
+}
+
+//Parse a comma-separated list of thread counts into (counts). Returns how many there are, or -1 if one is invalid.
+static int parse_counts(const char* value,int* counts,int capacity){
+	char* end;
+	int count = 0;
+
+	while(*value != '\0'){
+		long parsed = strtol(value,&end,10);
+
+		if(end == value || parsed < 1 || count == capacity){
+			return -1;
+		}
+		counts[count++] = (int) parsed;
+		value = *end == ',' ? end + 1 : end;
+		if(*end != ',' && *end != '\0'){
+			return -1;
+		}
+	}
+
+	return count;
+}
+
+int main(int argc,char** argv){
+	simulatorConfig config;
+	int processorConfigs[64] = {2,4,8,16,32,64};
+	int configCount = PROCESSOR_CONFIGURATION_COUNT;
+	int maxModules = DEFAULT_MODULES;
+	int moduleStep = 1;
+	int milliseconds = DEFAULT_MILLISECONDS;
+	int hold = DEFAULT_HOLD;
+	accessMode mode = AccessLock;
+	const char* logPaths[2] = {HOST_UNIFORM_LOG,HOST_GAUSSIAN_LOG};
+	hostLayout layout;
+	bool haveLayout;
+	int option;
+	int i;
+
+	default_config(&config);
+	config.placement = PlacementCompact;
+
+	while((option = getopt(argc,argv,"p:m:e:d:l:c:x:g:s:")) != -1){
+		switch(option){
+			case 'p':
+				configCount = parse_counts(optarg,processorConfigs,64);
+				if(configCount < 1){
+					fprintf(stderr,"Invalid thread counts %s (expected a comma-separated list of up to 64)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'm':
+				maxModules = atoi(optarg);
+				break;
+			case 'e':
+				moduleStep = atoi(optarg);
+				break;
+			case 'd':
+				milliseconds = atoi(optarg);
+				break;
+			case 'l':
+				if(strcmp(optarg,"lock") == 0){
+					mode = AccessLock;
+				} else if(strcmp(optarg,"cas") == 0){
+					mode = AccessCas;
+				} else {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'c':
+				hold = atoi(optarg);
+				break;
+			case 'x':
+				if(strcmp(optarg,"none") == 0){
+					config.placement = PlacementNone;
+				} else if(strcmp(optarg,"compact") == 0){
+					config.placement = PlacementCompact;
+				} else if(strcmp(optarg,"scatter") == 0){
+					config.placement = PlacementScatter;
+				} else {
+					fprintf(stderr,"Unknown placement policy %s (expected none, compact or scatter)\n",optarg);
+					return 1;
+				}
+				break;
+			case 'g':
+				config.sigmaFraction = atof(optarg);
+				break;
+			case 's':
+				config.seed = (int) strtoul(optarg,NULL,10);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if(maxModules < 1 || moduleStep < 1 || milliseconds < 1 || hold < 0 || argc - optind > 2){
+		usage(argv[0]);
+		return 1;
+	}
+	for(i = 0; optind + i < argc; i++){
+		logPaths[i] = argv[optind + i];
+	}
+
+	haveLayout = config.placement != PlacementNone && read_host_layout(&layout);
+	if(config.placement != PlacementNone && !haveLayout){
+		fprintf(stderr,"Could not read the host layout; the threads are not pinned\n");
+	}
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for(i = 0; i < configCount; i++){
+		if(processorConfigs[i] > cores){
+			fprintf(stderr,"Warning: %d threads on %ld cores share cores; their waits include being descheduled\n",processorConfigs[i],cores);
+		}
+	}
+
+	printf("%s accesses of %d update%s, %d ms per point, %s placement\n",mode == AccessLock ? "Locked" : "Compare-and-swap",
+		hold,hold == 1 ? "" : "s",milliseconds,placement_name(config.placement));
+	printf("%-12s %10s %8s %12s %12s %7s\n","distribution","processors","modules","wait-times","requests","pinned");
+
+	for(int d = 0; d < 2; d++){
+		distribution dist = d == 0 ? Uniform : Gaussian;
+		FILE* log = fopen(logPaths[d],"w");
+
+		if(log == NULL){
+			fprintf(stderr,"Could not open %s\n",logPaths[d]);
+			return 1;
+		}
+		write_log_header(log,&config);
+
+		for(i = 0; i < configCount; i++){
+			for(int modules = 1; modules <= maxModules; modules += moduleStep){
+				simulationResult result;
+				int pinned;
+
+				memset(&result,0,sizeof(result));
+				if(!measure_point(&config,dist,processorConfigs[i],modules,mode,hold,milliseconds,haveLayout ? &layout : NULL,&result,&pinned)){
+					fclose(log);
+					return 1;
+				}
+				write_result(log,&result);
+				printf("%-12s %10d %8d %12.6f %12d %7d\n",dist == Uniform ? "uniform" : "gaussian",result.processCount,
+					result.moduleCount,result.waitTime,result.cycles,pinned);
+			}
+		}
+		fclose(log);
+	}
+
+	if(haveLayout){
+		free_host_layout(&layout);
+	}
+	free_config(&config);
+	return 0;
+}
@@ -0,0 +1,192 @@
+#include "simulator.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+//Re-execute the sweep point recorded in a trace and check that the new run produces
+//exactly the same events and result, bit for bit.
+
+static const char* eventNames[] = {"grant","request","wait","stall","complete","hit","buffer","buffer-full"};	//Indexed by the traceEvent
+
+//Print a record in readable form.
+static void describe(const char* label,const traceRecord* record){
+	unsigned int kind = record->moduleKind >> 24;
+
+	fprintf(stderr,"  %s: cycle %u, processor %u, module %u, %s, depth %u\n",label,record->cycle,record->processor,
+		record->moduleKind & 0xffffffU,kind < sizeof(eventNames) / sizeof(eventNames[0]) ? eventNames[kind] : "unknown",record->depth);
+}
+
+//Read the footer at the end of a trace and leave the file positioned at its first record.
+static bool read_footer(FILE* file,traceFooter* footer){
+	if(fseek(file,-(long) sizeof(traceFooter),SEEK_END) != 0 || fread(footer,sizeof(traceFooter),1,file) != 1 || footer->magic != TRACE_END_MAGIC){
+		return false;
+	}
+
+	return fseek(file,sizeof(traceHeader),SEEK_SET) == 0;
+}
+
+//Compare the records and footers of two traces of the same point.
+//Returns true if they are identical and reports the first difference otherwise.
+static bool compare_traces(FILE* recorded,FILE* replayed){
+	traceRecord expected,actual;
+	traceFooter expectedFooter,actualFooter;
+	uint64_t position,shortest;
+
+	if(!read_footer(recorded,&expectedFooter) || !read_footer(replayed,&actualFooter)){
+		fprintf(stderr,"A trace is truncated (no footer)\n");
+		return false;
+	}
+
+	shortest = expectedFooter.records < actualFooter.records ? expectedFooter.records : actualFooter.records;
+	for(position = 0; position < shortest; position++){
+		if(fread(&expected,sizeof(expected),1,recorded) != 1 || fread(&actual,sizeof(actual),1,replayed) != 1){
+			fprintf(stderr,"A trace is truncated at record %llu\n",(unsigned long long) position);
+			return false;
+		}
+
+		if(memcmp(&expected,&actual,sizeof(traceRecord)) != 0){
+			fprintf(stderr,"Record %llu differs\n",(unsigned long long) position);
+			describe("recorded",&expected);
+			describe("replayed",&actual);
+			return false;
+		}
+	}
+
+	if(expectedFooter.records != actualFooter.records){
+		fprintf(stderr,"Recorded %llu records but the replay produced %llu\n",(unsigned long long) expectedFooter.records,(unsigned long long) actualFooter.records);
+		return false;
+	}
+
+	if(memcmp(&expectedFooter,&actualFooter,sizeof(traceFooter)) != 0){
+		fprintf(stderr,"Results differ: recorded %u cycles, wait %f; replayed %u cycles, wait %f\n",
+			expectedFooter.cycles,expectedFooter.waitTime,actualFooter.cycles,actualFooter.waitTime);
+		return false;
+	}
+
+	printf("Replay matches: %llu records, %u cycles, wait time %f\n",(unsigned long long) expectedFooter.records,expectedFooter.cycles,expectedFooter.waitTime);
+	return true;
+}
+
+int main(int argc,char** argv){
+	simulatorConfig config;
+	traceHeader header;
+	simulator sim;
+	const char* replayPath = NULL;
+	char defaultReplayPath[4096];
+	bool keep = false;
+	int option;
+
+	default_config(&config);
+
+	while((option = getopt(argc,argv,"L:F:o:k")) != -1){
+		switch(option){
+			case 'L':
+				if(load_latency_overrides(&config,optarg) < 0){
+					fprintf(stderr,"Could not read latency file %s\n",optarg);
+					return 1;
+				}
+				break;
+			case 'F':
+				if(!load_patterns(&(config.patterns),optarg)){
+					return 1;
+				}
+				break;
+			case 'o':
+				replayPath = optarg;
+				break;
+			case 'k':
+				keep = true;
+				break;
+			default:
+				fprintf(stderr,"Usage: %s [-L latency file] [-F pattern file] [-o replay trace] [-k] <trace>\n",argv[0]);
+				return 1;
+		}
+	}
+
+	if(optind >= argc){
+		fprintf(stderr,"Usage: %s [-L latency file] [-F pattern file] [-o replay trace] [-k] <trace>\n",argv[0]);
+		return 1;
+	}
+
+	FILE* recorded = fopen(argv[optind],"rb");
+	if(recorded == NULL || fread(&header,sizeof(header),1,recorded) != 1 || header.magic != TRACE_MAGIC || header.version != TRACE_VERSION){
+		fprintf(stderr,"%s is not a version %d trace\n",argv[optind],TRACE_VERSION);
+		return 1;
+	}
+
+	if(header.overrideCount != config.overrideCount){
+		fprintf(stderr,"The trace was recorded with %d latency overrides; pass the same file with -L\n",header.overrideCount);
+		return 1;
+	}
+
+	if(header.patternHash != config.patterns.hash){
+		fprintf(stderr,header.patternHash != 0 ? "The trace was recorded with access pattern programs; pass the same pattern file with -F\n" :
+			"The trace was recorded without access pattern programs; leave out -F\n");
+		return 1;
+	}
+
+	if(replayPath == NULL){
+		snprintf(defaultReplayPath,sizeof(defaultReplayPath),"%s.replay",argv[optind]);
+		replayPath = defaultReplayPath;
+	}
+
+	//Rebuild the configuration of the recorded point.
+	config.readLatency = header.readLatency;
+	config.writeLatency = header.writeLatency;
+	config.writeRatio = header.writeRatio;
+	config.nodeCount = header.nodeCount;
+	config.remoteLatency = header.remoteLatency;
+	config.linkBandwidth = header.linkBandwidth;
+	config.localRatio = header.localRatio;
+	config.arrivals = (arrivalProcess) header.arrivals;
+	config.arrivalRate = header.arrivalRate;
+	config.burstCycles = header.burstCycles;
+	config.idleCycles = header.idleCycles;
+	config.thinkCycles = header.thinkCycles;
+	config.outstandingLimit = header.outstandingLimit;
+	config.sigmaFraction = header.sigmaFraction;
+	config.sigmaModules = header.sigmaModules;
+	config.driftEpoch = header.driftEpoch;
+	config.driftDistance = header.driftDistance;
+	config.hotRegions = header.hotRegions;
+	config.modulePorts = header.modulePorts;
+	config.moduleLines = header.moduleLines;
+	config.coalesceReads = header.coalesceReads != 0;
+	config.cacheSets = header.cacheSets;
+	config.cacheWays = header.cacheWays;
+	config.writeBuffer = header.writeBuffer;
+
+	printf("Replaying %s: %d processors, %d memory modules, %s distribution, seed %u\n",argv[optind],header.processCount,header.moduleCount,
+		header.dist == Uniform ? "uniform" : "gaussian",header.seed);
+
+	if(!trace_open(replayPath,&header)){
+		fprintf(stderr,"Could not record replay trace %s\n",replayPath);
+		return 1;
+	}
+
+	//Continue the random stream from where the recorded point started.
+	restore_random_state(header.randomState);
+
+	setup_simulator(&sim,header.processCount,header.moduleCount,&config);
+	run_simulator(&sim,(distribution) header.dist,NULL);
+	trace_close(sim.result.cycles,sim.result.waitTime);
+	free_simulator(&sim);
+
+	FILE* replayed = fopen(replayPath,"rb");
+	bool matches = replayed != NULL && compare_traces(recorded,replayed);
+
+	fclose(recorded);
+	if(replayed != NULL){
+		fclose(replayed);
+	}
+	if(!keep){
+		unlink(replayPath);
+	}
+	free_config(&config);
+
+	return matches ? 0 : 2;
+}
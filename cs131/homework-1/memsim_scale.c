@@ -0,0 +1,173 @@
+#include "simulator.h"
+#include "parallel_engine.h"
+#include "rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//Simulate one large configuration with the data-parallel engine. By default the point is run on 1, 2, 4, ...
+//threads up to the maximum and the speedup and efficiency of every thread count are reported, along with a
+//check that all of them produced the same result; with -j the point is run once on that many threads.
+
+#define DEFAULT_PROCESSORS 10000
+#define DEFAULT_MODULES 1000000
+
+static void usage(const char* program){
+	fprintf(stderr,"Usage: %s [-p processors] [-m modules] [-D uniform|gaussian] [-s seed] [-t max threads] [-j threads]\n",program);
+	fprintf(stderr,"       [-r read latency] [-w write latency] [-W write ratio] [-g sigma fraction] [-q]\n");
+	fprintf(stderr,"  -q also runs the sequential engine (run_simulator) for comparison\n");
+}
+
+static double seconds_since(const struct timespec* started){
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (now.tv_sec - started->tv_sec) + (now.tv_nsec - started->tv_nsec) / 1e9;
+}
+
+//Run the point on (threads) threads and print its row. (baseline) is the time of the single-threaded run
+//(0 for that run itself). Returns the elapsed seconds, or a negative value on failure.
+static double run_row(const simulatorConfig* config,distribution dist,int processCount,int modules,unsigned int seed,int threads,double baseline,simulationResult* result){
+	struct timespec started;
+
+	clock_gettime(CLOCK_MONOTONIC,&started);
+	int used = parallel_simulate(config,dist,processCount,modules,seed,threads,PARALLEL_BLOCK_PROCESSORS,result);
+	double seconds = seconds_since(&started);
+
+	if(used < 0){
+		fprintf(stderr,"Could not start %d threads\n",threads);
+		return -1.0;
+	}
+
+	double speedup = baseline > 0.0 ? baseline / seconds : 1.0;
+	printf("%7d %10.3f %14.0f %8.2f %10.1f%% %8d %12.6f\n",used,seconds,(double) result->cycles * processCount / seconds,
+		speedup,100.0 * speedup / used,result->cycles,result->waitTime);
+
+	return seconds;
+}
+
+int main(int argc,char** argv){
+	simulatorConfig config;
+	distribution dist = Uniform;
+	int processCount = DEFAULT_PROCESSORS;
+	int modules = DEFAULT_MODULES;
+	int maxThreads = PARALLEL_MAX_THREADS;
+	int onlyThreads = 0;
+	unsigned int seed = 1;
+	bool sequential = false;
+	int option;
+
+	default_config(&config);
+
+	while((option = getopt(argc,argv,"p:m:D:s:t:j:r:w:W:g:q")) != -1){
+		switch(option){
+			case 'p':
+				processCount = atoi(optarg);
+				break;
+			case 'm':
+				modules = atoi(optarg);
+				break;
+			case 'D':
+				if(strcmp(optarg,"uniform") == 0){
+					dist = Uniform;
+				} else if(strcmp(optarg,"gaussian") == 0){
+					dist = Gaussian;
+				} else {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 's':
+				seed = (unsigned int) strtoul(optarg,NULL,10);
+				break;
+			case 't':
+				maxThreads = atoi(optarg);
+				break;
+			case 'j':
+				onlyThreads = atoi(optarg);
+				break;
+			case 'r':
+				config.readLatency = atoi(optarg);
+				break;
+			case 'w':
+				config.writeLatency = atoi(optarg);
+				break;
+			case 'W':
+				config.writeRatio = atof(optarg);
+				break;
+			case 'g':
+				config.sigmaFraction = atof(optarg);
+				break;
+			case 'q':
+				sequential = true;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(processCount < 1 || modules < 1 || maxThreads < 1 || onlyThreads < 0 || config.readLatency < 1 || config.writeLatency < 1){
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%d processors, %d modules, %s requests, %ld online cores\n",processCount,modules,dist == Uniform ? "uniform" : "gaussian",
+		sysconf(_SC_NPROCESSORS_ONLN));
+
+	if(sequential){
+		struct timespec started;
+		simulator sim;
+
+		clock_gettime(CLOCK_MONOTONIC,&started);
+		seed_random(seed);
+		setup_simulator(&sim,processCount,modules,&config);
+		run_simulator(&sim,dist,NULL);
+		free_simulator(&sim);
+		printf("run_simulator: %.3f s, %d cycles, wait %.6f\n",seconds_since(&started),sim.result.cycles,sim.result.waitTime);
+
+		//Both engines compute the same model, but only a point of a single block draws the same requests.
+		if(processCount > PARALLEL_BLOCK_PROCESSORS){
+			printf("  (one random stream; the rows below draw from one per %d processors and agree with it in distribution only)\n",
+				PARALLEL_BLOCK_PROCESSORS);
+		} else {
+			printf("  (same random stream as the rows below, which match it exactly)\n");
+		}
+	}
+
+	printf("threads    seconds  proc-cycles/s  speedup efficiency   cycles    wait-time\n");
+
+	if(onlyThreads > 0){
+		simulationResult result;
+		return run_row(&config,dist,processCount,modules,seed,onlyThreads,0.0,&result) < 0.0 ? 1 : 0;
+	}
+
+	//Thread counts double up to the maximum, which is always run as well.
+	simulationResult first,result;
+	maxThreads = parallel_threads(processCount,modules,maxThreads,PARALLEL_BLOCK_PROCESSORS);
+	double baseline = run_row(&config,dist,processCount,modules,seed,1,0.0,&first);
+	bool same = baseline >= 0.0;
+	int threads = 2;
+
+	while(same && threads / 2 < maxThreads){
+		int count = threads < maxThreads ? threads : maxThreads;
+
+		if(run_row(&config,dist,processCount,modules,seed,count,baseline,&result) < 0.0){
+			return 1;
+		}
+		if(result.cycles != first.cycles || result.waitTime != first.waitTime){
+			fprintf(stderr,"%d threads gave a different result than one thread\n",count);
+			same = false;
+		}
+		threads *= 2;
+	}
+
+	if(same){
+		printf("Every thread count produced the same result\n");
+	}
+
+	return same ? 0 : 2;
+}
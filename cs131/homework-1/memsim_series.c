@@ -0,0 +1,186 @@
+#include "series.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+//Summarize a per-module series recorded with --series: overall utilization and imbalance,
+//the busiest modules, and optionally every kept window as CSV for plotting.
+
+#define DEFAULT_HOTTEST 10
+#define SATURATED_UTILIZATION 0.9	//Modules busier than this over the whole point are reported as saturated
+
+//Loaded contents of a series file.
+typedef struct seriesFile {
+	seriesHeader header;
+	uint32_t* windows;
+	uint8_t* utilization;
+	uint16_t* depth;
+	uint32_t* busyCycles;
+	uint64_t* depthCycles;
+} seriesFile;
+
+//Read the column of (count) elements of (size) bytes that follows in (file).
+static void* read_column(FILE* file,size_t size,size_t count){
+	void* column = malloc(size * (count > 0 ? count : 1));
+
+	if(column != NULL && fread(column,size,count,file) != count){
+		free(column);
+		return NULL;
+	}
+
+	return column;
+}
+
+//Load a series file. Returns false if it is missing, truncated or of another version.
+static bool load_series(const char* path,seriesFile* series){
+	FILE* file = fopen(path,"rb");
+	size_t cells;
+
+	memset(series,0,sizeof(seriesFile));
+	if(file == NULL){
+		return false;
+	}
+
+	if(fread(&(series->header),sizeof(seriesHeader),1,file) != 1 || series->header.magic != SERIES_MAGIC || series->header.version != SERIES_VERSION){
+		fclose(file);
+		return false;
+	}
+
+	cells = (size_t) series->header.samples * series->header.moduleCount;
+	series->windows = (uint32_t*) read_column(file,sizeof(uint32_t),series->header.samples);
+	series->utilization = (uint8_t*) read_column(file,sizeof(uint8_t),cells);
+	series->depth = (uint16_t*) read_column(file,sizeof(uint16_t),cells);
+	series->busyCycles = (uint32_t*) read_column(file,sizeof(uint32_t),series->header.moduleCount);
+	series->depthCycles = (uint64_t*) read_column(file,sizeof(uint64_t),series->header.moduleCount);
+	fclose(file);
+
+	return series->windows != NULL && series->utilization != NULL && series->depth != NULL &&
+		series->busyCycles != NULL && series->depthCycles != NULL;
+}
+
+static void free_series(seriesFile* series){
+	free(series->windows);
+	free(series->utilization);
+	free(series->depth);
+	free(series->busyCycles);
+	free(series->depthCycles);
+}
+
+//Print every kept window of every module as rows of "first cycle,module,utilization,mean depth".
+static void print_csv(const seriesFile* series){
+	uint32_t sample;
+	int module;
+
+	printf("cycle,module,utilization,queue depth\n");
+	for(sample = 0; sample < series->header.samples; sample++){
+		for(module = 0; module < series->header.moduleCount; module++){
+			size_t cell = (size_t) sample * series->header.moduleCount + module;
+
+			printf("%u,%d,%f,%f\n",series->windows[sample] * series->header.windowCycles,module,
+				series->utilization[cell] / 255.0,(double) series->depth[cell] / SERIES_DEPTH_SCALE);
+		}
+	}
+}
+
+//Print the utilization balance of the whole point and its (hottest) busiest modules.
+static void print_summary(const seriesFile* series,int hottest){
+	const seriesHeader* header = &(series->header);
+	int modules = header->moduleCount;
+	int* order = (int*) malloc(modules * sizeof(int));
+	double total = 0.0,squares = 0.0,busiest = 0.0;
+	int saturated = 0;
+	int i,j;
+
+	printf("Point: %d processors, %d modules, %s requests\n",header->processCount,modules,header->dist == 0 ? "uniform" : "gaussian");
+	printf("Cycles: %u, wait time %f, %u of %u windows of %u cycles kept\n",header->cycles,header->waitTime,header->samples,header->windowCount,header->windowCycles);
+
+	for(i = 0; i < modules; i++){
+		double utilization = (double) series->busyCycles[i] / header->cycles;
+
+		total += utilization;
+		squares += utilization * utilization;
+		busiest = utilization > busiest ? utilization : busiest;
+		saturated += utilization > SATURATED_UTILIZATION ? 1 : 0;
+	}
+
+	double mean = total / modules;
+	double deviation = sqrt(fmax(squares / modules - mean * mean,0.0));
+	printf("Utilization: mean %.3f, max %.3f, max/mean %.2f, coefficient of variation %.2f, %d modules above %.0f%%\n",
+		mean,busiest,mean > 0.0 ? busiest / mean : 0.0,mean > 0.0 ? deviation / mean : 0.0,saturated,SATURATED_UTILIZATION * 100);
+
+	//Partial selection sort: only the busiest few modules are needed.
+	for(i = 0; i < modules; i++){
+		order[i] = i;
+	}
+	hottest = hottest < modules ? hottest : modules;
+	for(i = 0; i < hottest; i++){
+		for(j = i + 1; j < modules; j++){
+			if(series->busyCycles[order[j]] > series->busyCycles[order[i]]){
+				int swap = order[i];
+				order[i] = order[j];
+				order[j] = swap;
+			}
+		}
+	}
+
+	printf("%8s %12s %12s %12s\n","module","utilization","mean depth","peak depth");
+	for(i = 0; i < hottest; i++){
+		int module = order[i];
+		uint16_t peak = 0;
+		uint32_t sample;
+
+		for(sample = 0; sample < header->samples; sample++){
+			uint16_t depth = series->depth[(size_t) sample * modules + module];
+			peak = depth > peak ? depth : peak;
+		}
+
+		printf("%8d %12.3f %12.3f %12.3f\n",module,(double) series->busyCycles[module] / header->cycles,
+			(double) series->depthCycles[module] / header->cycles,(double) peak / SERIES_DEPTH_SCALE);
+	}
+
+	free(order);
+}
+
+int main(int argc,char** argv){
+	seriesFile series;
+	int hottest = DEFAULT_HOTTEST;
+	bool csv = false;
+	int option;
+
+	while((option = getopt(argc,argv,"n:c")) != -1){
+		switch(option){
+			case 'n':
+				hottest = atoi(optarg);
+				break;
+			case 'c':
+				csv = true;
+				break;
+			default:
+				fprintf(stderr,"Usage: %s [-n busiest modules] [-c] <series>\n",argv[0]);
+				return 1;
+		}
+	}
+
+	if(optind >= argc){
+		fprintf(stderr,"Usage: %s [-n busiest modules] [-c] <series>\n",argv[0]);
+		return 1;
+	}
+
+	if(!load_series(argv[optind],&series)){
+		fprintf(stderr,"%s is not a version %d module series\n",argv[optind],SERIES_VERSION);
+		free_series(&series);
+		return 1;
+	}
+
+	if(csv){
+		print_csv(&series);
+	} else {
+		print_summary(&series,hottest);
+	}
+
+	free_series(&series);
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include "simulator.h"
+#include "splitting.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//Estimate how likely a request of one closed-loop point is to wait at least a threshold of cycles, by multilevel
+//splitting. With -q the same levels are also estimated by a plain simulation of as many cycles, as a check of the
+//splitting estimate and of what it saves.
+
+#define DEFAULT_PROCESSORS 64
+#define DEFAULT_MODULES 64
+
+static void usage(const char* program){
+	fprintf(stderr,"Usage: %s [-p processors] [-m modules] [-D uniform|gaussian] [-s seed] [-x threshold] [-k levels] [-f factor]\n",program);
+	fprintf(stderr,"       [-c cycles] [-u warm-up cycles] [-B batches] [-r read latency] [-w write latency] [-W write ratio]\n");
+	fprintf(stderr,"       [-g sigma fraction] [-n nodes] [-e remote latency] [-b link bandwidth] [-l local ratio] [-q]\n");
+	fprintf(stderr,"  -x wait of the rare event in cycles (default 1000)\n");
+	fprintf(stderr,"  -k levels up to the threshold (default: spaced by the decay of the pilot's tail)\n");
+	fprintf(stderr,"  -f split factor of every level (default: one over the measured probability of the next level)\n");
+	fprintf(stderr,"  -q also estimates the tail by a plain simulation of as many cycles\n");
+}
+
+static double seconds_since(const struct timespec* started){
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (now.tv_sec - started->tv_sec) + (now.tv_nsec - started->tv_nsec) / 1e9;
+}
+
+int main(int argc,char** argv){
+	simulatorConfig config;
+	splittingConfig splitting;
+	tailEstimate estimate;
+	distribution dist = Uniform;
+	int processCount = DEFAULT_PROCESSORS;
+	int modules = DEFAULT_MODULES;
+	bool plain = false;
+	struct timespec started;
+	int option;
+
+	default_config(&config);
+	default_splitting(&splitting);
+
+	while((option = getopt(argc,argv,"p:m:D:s:x:k:f:c:u:B:r:w:W:g:n:e:b:l:q")) != -1){
+		switch(option){
+			case 'p':
+				processCount = atoi(optarg);
+				break;
+			case 'm':
+				modules = atoi(optarg);
+				break;
+			case 'D':
+				if(strcmp(optarg,"uniform") == 0){
+					dist = Uniform;
+				} else if(strcmp(optarg,"gaussian") == 0){
+					dist = Gaussian;
+				} else {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 's':
+				splitting.seed = (unsigned int) strtoul(optarg,NULL,10);
+				break;
+			case 'x':
+				splitting.threshold = atoi(optarg);
+				break;
+			case 'k':
+				splitting.levelCount = atoi(optarg);
+				break;
+			case 'f':
+				splitting.factor = atoi(optarg);
+				break;
+			case 'c':
+				splitting.cycles = atoi(optarg);
+				break;
+			case 'u':
+				splitting.warmup = atoi(optarg);
+				break;
+			case 'B':
+				splitting.batches = atoi(optarg);
+				break;
+			case 'r':
+				config.readLatency = atoi(optarg);
+				break;
+			case 'w':
+				config.writeLatency = atoi(optarg);
+				break;
+			case 'W':
+				config.writeRatio = atof(optarg);
+				break;
+			case 'g':
+				config.sigmaFraction = atof(optarg);
+				break;
+			case 'n':
+				config.nodeCount = atoi(optarg);
+				break;
+			case 'e':
+				config.remoteLatency = atoi(optarg);
+				break;
+			case 'b':
+				config.linkBandwidth = atoi(optarg);
+				break;
+			case 'l':
+				config.localRatio = atof(optarg);
+				break;
+			case 'q':
+				plain = true;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(processCount < 1 || modules < 1 || config.readLatency < 1 || config.writeLatency < 1 || config.nodeCount < 1 ||
+		config.remoteLatency < 0 || config.linkBandwidth < 0 || splitting.levelCount > SPLITTING_MAX_LEVELS){
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%d processors, %d modules, %s requests, P(request wait >= %d cycles)\n",processCount,modules,
+		dist == Uniform ? "uniform" : "gaussian",splitting.threshold);
+
+	clock_gettime(CLOCK_MONOTONIC,&started);
+	if(!estimate_tail(&config,dist,processCount,modules,&splitting,&estimate)){
+		return 1;
+	}
+	printf("Splitting (%.2f s)\n",seconds_since(&started));
+	report_tail(stdout,&estimate);
+
+	if(plain){
+		//Every level of the splitting estimate, without splitting, for as many cycles as the splitting simulated.
+		splittingConfig brute = splitting;
+		tailEstimate reference;
+
+		brute.levelCount = estimate.levelCount;
+		brute.factor = 1;
+		brute.cycles = (int) (estimate.simulatedCycles - splitting.warmup);
+
+		clock_gettime(CLOCK_MONOTONIC,&started);
+		if(!estimate_tail(&config,dist,processCount,modules,&brute,&reference)){
+			return 1;
+		}
+		printf("Plain simulation of as many cycles (%.2f s)\n",seconds_since(&started));
+		report_tail(stdout,&reference);
+	}
+
+	return 0;
+}
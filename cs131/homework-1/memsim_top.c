@@ -0,0 +1,130 @@
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+
+//Viewer for the live statistics a simulation session publishes with --stats.
+//It only reads the mapped stats file, so watching a sweep never slows it down.
+
+//Copy of the counters at one refresh, used to compute rates between two refreshes.
+typedef struct snapshot {
+	long when;
+	long points;
+	long cycles;
+	long busyNanos[STATS_MAX_WORKERS];
+} snapshot;
+
+static void take_snapshot(statsSegment* segment,snapshot* shot){
+	int i;
+
+	shot->when = stats_now();
+	shot->points = 0;
+	shot->cycles = 0;
+
+	for(i = 0; i < STATS_MAX_WORKERS; i++){
+		workerStats* worker = &(segment->workers[i]);
+
+		shot->points += atomic_load_explicit(&(worker->points),memory_order_relaxed);
+		shot->cycles += atomic_load_explicit(&(worker->cycles),memory_order_relaxed);
+		shot->busyNanos[i] = atomic_load_explicit(&(worker->busyNanos),memory_order_relaxed);
+	}
+}
+
+//Print one refresh of the session's progress, rates since the last refresh and per-worker state.
+static void display(statsSegment* segment,snapshot* previous,snapshot* current){
+	double interval = (current->when - previous->when) / 1e9;
+	double elapsed = (current->when - atomic_load_explicit(&(segment->startNanos),memory_order_relaxed)) / 1e9;
+	long total = atomic_load_explicit(&(segment->totalPoints),memory_order_relaxed);
+	int workers = atomic_load_explicit(&(segment->workerCount),memory_order_relaxed);
+	double pointRate = interval > 0 ? (current->points - previous->points) / interval : 0.0;
+	double cycleRate = interval > 0 ? (current->cycles - previous->cycles) / interval : 0.0;
+	int i;
+
+	//The estimate uses the average rate of the whole session, which is steadier than the last interval.
+	double eta = current->points > 0 ? elapsed * (total - current->points) / current->points : -1.0;
+
+	printf("\033[H\033[2J");
+	printf("memsim-top: session %d %s\n",segment->pid,atomic_load_explicit(&(segment->finished),memory_order_relaxed) ? "(finished)" : "");
+	printf("points     %ld / %ld (%.1f%%)\n",current->points,total,total > 0 ? 100.0 * current->points / total : 0.0);
+	printf("elapsed    %.1fs   eta %.1fs\n",elapsed,eta);
+	printf("rate       %.1f points/s   %.0f cycles/s\n\n",pointRate,cycleRate);
+
+	printf("%-7s %8s %10s %12s %10s %10s %12s %10s %10s\n","worker","util","points","cycles","procs","modules","arena bytes","arena live","fallbacks");
+	for(i = 0; i < workers; i++){
+		workerStats* worker = &(segment->workers[i]);
+		int processors = atomic_load_explicit(&(worker->processors),memory_order_relaxed);
+		double utilization = interval > 0 ? (current->busyNanos[i] - previous->busyNanos[i]) / 1e9 / interval : 0.0;
+
+		printf("%-7d %7.1f%% %10ld %12ld ",i,100.0 * utilization,
+			atomic_load_explicit(&(worker->points),memory_order_relaxed),
+			atomic_load_explicit(&(worker->cycles),memory_order_relaxed));
+
+		if(processors > 0){
+			printf("%10d %10d ",processors,atomic_load_explicit(&(worker->modules),memory_order_relaxed));
+		} else {
+			printf("%10s %10s ","idle","-");
+		}
+
+		printf("%12ld %10ld %10ld\n",
+			atomic_load_explicit(&(worker->arenaBytes),memory_order_relaxed),
+			atomic_load_explicit(&(worker->arenaLive),memory_order_relaxed),
+			atomic_load_explicit(&(worker->heapFallbacks),memory_order_relaxed));
+	}
+
+	fflush(stdout);
+}
+
+int main(int argc,char** argv){
+	double interval = 1.0;
+	int iterations = -1;
+	int option;
+
+	while((option = getopt(argc,argv,"i:n:")) != -1){
+		switch(option){
+			case 'i':
+				interval = atof(optarg);
+				break;
+			case 'n':
+				iterations = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr,"Usage: %s [-i seconds] [-n refreshes] <stats file>\n",argv[0]);
+				return 1;
+		}
+	}
+
+	if(optind >= argc){
+		fprintf(stderr,"Usage: %s [-i seconds] [-n refreshes] <stats file>\n",argv[0]);
+		return 1;
+	}
+
+	statsSegment* segment = stats_map(argv[optind]);
+	if(segment == NULL){
+		fprintf(stderr,"%s is not a stats file of version %d\n",argv[optind],STATS_VERSION);
+		return 1;
+	}
+
+	snapshot previous,current;
+	take_snapshot(segment,&previous);
+
+	//Refresh until the session finishes or the requested number of refreshes is reached.
+	while(iterations != 0){
+		usleep((useconds_t) (interval * 1e6));
+		take_snapshot(segment,&current);
+		display(segment,&previous,&current);
+		previous = current;
+
+		if(iterations > 0){
+			iterations--;
+		}
+
+		if(atomic_load_explicit(&(segment->finished),memory_order_relaxed)){
+			break;
+		}
+	}
+
+	stats_unmap(segment);
+	return 0;
+}
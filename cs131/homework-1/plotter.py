@@ -112,7 +112,8 @@ if __name__ == "__main__":
 			## 1. The number of processor that was used in that simulation cycle.
 			## 2. The number of memory modules that was used in that simulation cycle.
 			## 3. The average time a processor had to wait to access a memory module during the simulation (in cycles)
-			processors,memory_modules,waitTime = row
+			## Sessions on NUMA machines append the local and remote parts of the wait time, which are not plotted.
+			processors,memory_modules,waitTime = row[:3]
 
 			## In the graph the x-axis will be number of memory modules for a given simulation configuration
 			## The y-axis will be the average wait time a processor has for a given simulation configuration
@@ -131,7 +132,7 @@ if __name__ == "__main__":
 		reader.next()
 
 		for row in reader:
-			processors,memory_modules,waitTime = row
+			processors,memory_modules,waitTime = row[:3]
 
 			processor_data_gaussian[processors]["x"].append(float(memory_modules))
 			processor_data_gaussian[processors]["y"].append(float(waitTime))
@@ -13,6 +13,94 @@ PLOTS_DIR=plots/
 NUM_REQUESTS=100
 MODULE_COUNT=2048
 
+#Set CACHE_DIR to reuse the points of earlier runs with the same parameters.
+CACHE_DIR="${CACHE_DIR:-}"
+CACHE_OPTIONS=""
+if [ -n "$CACHE_DIR" ];then
+	CACHE_OPTIONS="--cache $CACHE_DIR"
+fi
+
+#Set MODEL_TOLERANCE (e.g. 0.05) to estimate the points the analytical model predicts within that wait time.
+MODEL_TOLERANCE="${MODEL_TOLERANCE:-}"
+if [ -n "$MODEL_TOLERANCE" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --model-tolerance $MODEL_TOLERANCE"
+fi
+
+#Set ARRIVAL_RATE (e.g. 0.05) to issue requests open-loop at that rate per processor instead of back to back.
+#ARRIVALS selects the process (poisson or onoff; onoff also needs BURST as on cycles,off cycles).
+ARRIVAL_RATE="${ARRIVAL_RATE:-}"
+if [ -n "$ARRIVAL_RATE" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --arrivals ${ARRIVALS:-poisson} --arrival-rate $ARRIVAL_RATE"
+	if [ -n "$BURST" ];then
+		CACHE_OPTIONS="$CACHE_OPTIONS --burst $BURST"
+	fi
+fi
+
+#Set SIGMA (a fraction of the module count), DRIFT (epoch cycles,fraction) or HOT_REGIONS to change the locality of Gaussian requests.
+if [ -n "$SIGMA" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --sigma $SIGMA"
+fi
+if [ -n "$DRIFT" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --drift $DRIFT"
+fi
+if [ -n "$HOT_REGIONS" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --hot-regions $HOT_REGIONS"
+fi
+
+#Set PORTS to the requests a memory module serves at once, COALESCE to yes to serve the queued reads of a line
+#together, PRIVATE_CACHE (sets,ways) to put a cache in front of every processor, LINES to the lines of a module,
+#and WRITE_BUFFER to the writes every processor buffers (with WRITE_RATIO the fraction of requests that are writes).
+if [ -n "$PORTS" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --ports $PORTS"
+fi
+if [ "$COALESCE" = "yes" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --coalesce"
+fi
+if [ -n "$PRIVATE_CACHE" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --private-cache $PRIVATE_CACHE"
+fi
+if [ -n "$LINES" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --lines $LINES"
+fi
+if [ -n "$WRITE_RATIO" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --write-ratio $WRITE_RATIO"
+fi
+if [ -n "$WRITE_BUFFER" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --write-buffer $WRITE_BUFFER"
+fi
+
+#Set PATTERN to a file of access pattern programs (see patterns/) for the processors to pick their requests with.
+if [ -n "$PATTERN" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --pattern $PATTERN"
+fi
+
+#Set LOG_SYNC to data or direct to push the logs to the disk as they are written.
+LOG_SYNC="${LOG_SYNC:-}"
+if [ -n "$LOG_SYNC" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --log-sync $LOG_SYNC"
+fi
+
+#Set WORKERS to spread the sweep over that many processes, and PLACEMENT (compact or scatter) and
+#HUGE_PAGES (transparent or explicit) to pin them to cores with their state on their own node.
+if [ -n "$WORKERS" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --workers $WORKERS"
+fi
+if [ -n "$PLACEMENT" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --placement $PLACEMENT"
+fi
+if [ -n "$HUGE_PAGES" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --huge-pages $HUGE_PAGES"
+fi
+
+#Set VARIANCE_REDUCTION (crn, antithetic and control separated by commas) to smooth the curves, and
+#VARIANCE_CYCLES to the length of each of its simulations.
+if [ -n "$VARIANCE_REDUCTION" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --variance-reduction $VARIANCE_REDUCTION"
+fi
+if [ -n "$VARIANCE_CYCLES" ];then
+	CACHE_OPTIONS="$CACHE_OPTIONS --variance-cycles $VARIANCE_CYCLES"
+fi
+
 CREATE_GRAPHS="${1:-no}"
 CREATE_GRAPHS=`echo $CREATE_GRAPHS | tr "[:upper:]" "[:lower:]"`
 
@@ -21,7 +109,13 @@ make clean
 make
 
 echo "Performing simulation with $NUM_REQUESTS requests and up to $MODULE_COUNTS memory modules."
-./main $UNIFORM_LOG $GAUSSIAN_LOG $SEED
+./main $CACHE_OPTIONS $UNIFORM_LOG $GAUSSIAN_LOG $SEED
+
+#Set HOST_BENCHMARK to yes to also measure the contention of the same points with pinned threads on this host.
+if [ "$HOST_BENCHMARK" = "yes" ];then
+	echo "Measuring host contention."
+	./memsim-host -s $SEED ${LOG_DIR}hostUniformLogs.csv ${LOG_DIR}hostGaussianLogs.csv
+fi
 
 echo "Simulation done. Data stored in $LOG_DIR directory."
 